@@ -9,12 +9,28 @@
 set -e
 
 OUTDIR="sdcard/at.cavac.hhgg"
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+RATECTL="$SCRIPT_DIR/host/build/avi_ratectl"
 
 # Video settings
 WIDTH=600
 HEIGHT=480
 JPEG_QUALITY=5   # FFmpeg MJPEG quality (2-31, lower is better)
 
+# Rate control: the clip is encoded once per quality level (best first) and
+# each frame takes the best level that fits the player's budgets
+QUALITY_LADDER=${QUALITY_LADDER:-"$JPEG_QUALITY 7 10 14 20 31"}
+FRAME_MAX_BYTES=${FRAME_MAX_BYTES:-65536}   # Player's VIDEO_FRAME_MAX_SIZE
+CARD_BUDGET_KBPS=${CARD_BUDGET_KBPS:-8000}  # Sustained card rate, see host/build/sdbench
+
+# Pre-rotate: store frames in framebuffer orientation (transposed, padded to a
+# 16-pixel multiple) so the player decodes straight into the framebuffer
+PRE_ROTATE=${PRE_ROTATE:-1}
+
+# Restart markers every N MCU rows (16 pixels each) let the software JPEG
+# decoder split a frame across both cores; 0 keeps ffmpeg's frames as they are
+RESTART_ROWS=${RESTART_ROWS:-1}
+
 # Audio settings (MP3 for good compression + AVI compatibility)
 AUDIO_RATE=44100
 AUDIO_CHANNELS=2
@@ -40,6 +56,11 @@ fi
 # Create output directory
 mkdir -p "$OUTDIR"
 
+# Build the rate control muxer if needed
+if [ ! -x "$RATECTL" ]; then
+    make -C "$SCRIPT_DIR/host" >/dev/null
+fi
+
 echo "Converting: $INPUT"
 echo "Output: $OUTDIR/${BASE}.avi"
 
@@ -50,20 +71,55 @@ SRC_FPS=$(ffprobe -v error -select_streams v -of default=noprint_wrappers=1:noke
     -show_entries stream=r_frame_rate "$INPUT" | head -1)
 echo "Source: ${SRC_FPS} fps, ${DURATION}s duration"
 echo "Output: ${WIDTH}x${HEIGHT} MJPEG + MP3 ${AUDIO_BITRATE} stereo"
+echo "Budget: ${FRAME_MAX_BYTES} bytes/frame, ${CARD_BUDGET_KBPS} kbps, quality ladder: ${QUALITY_LADDER}"
+
+VIDEO_FILTER="scale=${WIDTH}:${HEIGHT}:force_original_aspect_ratio=decrease,pad=${WIDTH}:${HEIGHT}:(ow-iw)/2:(oh-ih)/2"
+RATECTL_ARGS=(-d "$RESTART_ROWS")
 
-# Create interleaved AVI with MJPEG video and MP3 audio
+# Chapters: a text file next to the input, one "m:ss title" line per chapter
+CHAPTERS="${INPUT%.mp4}.chapters"
+if [ -f "$CHAPTERS" ]; then
+    echo "Chapters: $CHAPTERS"
+    RATECTL_ARGS+=(-C "$CHAPTERS")
+fi
+if [ "$PRE_ROTATE" = "1" ]; then
+    VIDEO_FILTER="${VIDEO_FILTER},transpose=clock,pad=${HEIGHT}:$(( (WIDTH + 15) / 16 * 16 )):0:(oh-ih)/2"
+    RATECTL_ARGS+=(-R)
+fi
+
+# Encode one AVI per quality level with MJPEG video and MP3 audio
 # - Video: MJPEG at native framerate, scaled to 600x480 with letterboxing
-# - Audio: MP3 at 128kbps stereo 44.1kHz
-echo "Creating interleaved AVI..."
-ffmpeg -y -i "$INPUT" \
-    -c:v mjpeg \
-    -q:v $JPEG_QUALITY \
-    -vf "scale=${WIDTH}:${HEIGHT}:force_original_aspect_ratio=decrease,pad=${WIDTH}:${HEIGHT}:(ow-iw)/2:(oh-ih)/2,format=yuvj420p" \
-    -c:a libmp3lame \
-    -b:a $AUDIO_BITRATE \
-    -ar $AUDIO_RATE \
-    -ac $AUDIO_CHANNELS \
-    -f avi "$OUTDIR/${BASE}.avi"
+#   (then rotated to 480x608 unless PRE_ROTATE=0)
+# - Audio: MP3 at 128kbps stereo 44.1kHz (first level only, the muxer takes it from there)
+LEVELS=()
+AUDIO_ARGS=(-c:a libmp3lame -b:a $AUDIO_BITRATE -ar $AUDIO_RATE -ac $AUDIO_CHANNELS)
+for Q in $QUALITY_LADDER; do
+    LEVEL="$OUTDIR/${BASE}.q${Q}.tmp.avi"
+    echo "Encoding quality level ${Q}..."
+    ffmpeg -y -v error -i "$INPUT" \
+        -c:v mjpeg \
+        -q:v $Q \
+        -vf "${VIDEO_FILTER},format=yuvj420p" \
+        "${AUDIO_ARGS[@]}" \
+        -f avi "$LEVEL"
+    LEVELS+=("$LEVEL")
+    AUDIO_ARGS=(-an)
+done
+
+# Pick quality per frame and mux into the player's layout: one audio chunk
+# per frame, sector-aligned video frames, playback info and frame index
+echo "Rate control and muxing..."
+REPORT="${INPUT%.mp4}.rate.txt"
+STATUS=0
+"$RATECTL" -c "$FRAME_MAX_BYTES" -b "$CARD_BUDGET_KBPS" -r "$REPORT" "${RATECTL_ARGS[@]}" \
+    "$OUTDIR/${BASE}.avi" "${LEVELS[@]}" || STATUS=$?
+rm -f "${LEVELS[@]}"
+if [ $STATUS -eq 1 ]; then
+    echo "Error: muxing failed"
+    exit 1
+fi
+sed -n '/^Video frame sizes/p;/^Worst windows/,$p' "$REPORT"
+echo "Rate control report: $OUTDIR/${BASE}.rate.txt"
 
 # Show file size
 FILE_SIZE=$(stat -c%s "$OUTDIR/${BASE}.avi" 2>/dev/null || stat -f%z "$OUTDIR/${BASE}.avi")
@@ -0,0 +1,140 @@
+// AVI Frames - per-frame view of a parsed AVI for the converter tools
+
+#include "avi_frames.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    avi_span_t* items;
+    uint32_t* frame;            // Start frame per item (audio only)
+    uint32_t count;
+    uint32_t capacity;
+} span_list_t;
+
+static bool list_push(span_list_t* list, size_t offset, size_t size, uint32_t frame) {
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        avi_span_t* items = realloc(list->items, capacity * sizeof(avi_span_t));
+        if (items) list->items = items;
+        uint32_t* frames = realloc(list->frame, capacity * sizeof(uint32_t));
+        if (frames) list->frame = frames;
+        if (!items || !frames) return false;
+        list->capacity = capacity;
+    }
+    list->items[list->count] = (avi_span_t){offset, size};
+    list->frame[list->count] = frame;
+    list->count++;
+    return true;
+}
+
+// Video frame an audio chunk starts in, from the audio stream's time base
+static uint32_t audio_chunk_frame(const avi_info_t* info, uint32_t chunk_index, uint64_t bytes_before) {
+    // Position in audio stream units (blocks for VBR, samples for CBR)
+    uint64_t units = info->audio_sample_size ? bytes_before / info->audio_sample_size : chunk_index;
+    uint64_t num, den;
+    if (info->audio_rate && info->audio_scale) {
+        num = units * info->audio_scale * info->video_rate;
+        den = (uint64_t)info->audio_rate * info->video_scale;
+    } else {
+        num = bytes_before * info->video_rate;
+        den = (uint64_t)(info->audio_bytes_per_sec ? info->audio_bytes_per_sec : 1) * info->video_scale;
+    }
+    return den ? (uint32_t)(num / den) : 0;
+}
+
+esp_err_t avi_frames_load(avi_parser_t* parser, avi_frames_t* frames) {
+    memset(frames, 0, sizeof(avi_frames_t));
+    const avi_info_t* info = avi_parser_get_info(parser);
+    if (!info->has_video || info->video_rate == 0 || info->video_scale == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    span_list_t video = {0};
+    span_list_t audio = {0};
+    uint64_t audio_bytes = 0;
+    bool ok = true;
+
+    avi_parser_rewind(parser);
+    avi_chunk_t chunk;
+    while (ok && avi_parser_next_header(parser, &chunk) == ESP_OK) {
+        if (chunk.type == AVI_CHUNK_VIDEO) {
+            ok = list_push(&video, chunk.offset, chunk.size, video.count);
+        } else {
+            ok = list_push(&audio, chunk.offset, chunk.size, audio_chunk_frame(info, audio.count, audio_bytes));
+            audio_bytes += chunk.size;
+        }
+    }
+
+    frames->audio_first = ok && video.count > 0 ? malloc((video.count + 1) * sizeof(uint32_t)) : NULL;
+    if (!frames->audio_first) {
+        free(video.items);
+        free(video.frame);
+        free(audio.items);
+        free(audio.frame);
+        return ok ? ESP_ERR_NOT_FOUND : ESP_ERR_NO_MEM;
+    }
+
+    // Chunk timestamps only grow, so each frame's audio is a contiguous run
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < video.count; i++) {
+        frames->audio_first[i] = next;
+        bool last = i + 1 == video.count;
+        while (next < audio.count && (last || audio.frame[next] <= i)) next++;
+    }
+    frames->audio_first[video.count] = audio.count;
+
+    frames->video = video.items;
+    frames->audio = audio.items;
+    frames->frames = video.count;
+    frames->audio_count = audio.count;
+    free(video.frame);
+    free(audio.frame);
+    return ESP_OK;
+}
+
+size_t avi_frames_audio_size(const avi_frames_t* frames, uint32_t frame) {
+    size_t size = 0;
+    for (uint32_t i = frames->audio_first[frame]; i < frames->audio_first[frame + 1]; i++) {
+        size += frames->audio[i].size;
+    }
+    return size;
+}
+
+size_t avi_frames_read_audio(avi_parser_t* parser, const avi_frames_t* frames, uint32_t frame, uint8_t* buf,
+                             size_t buf_size) {
+    size_t size = 0;
+    for (uint32_t i = frames->audio_first[frame]; i < frames->audio_first[frame + 1]; i++) {
+        const avi_span_t* a = &frames->audio[i];
+        if (size + a->size > buf_size || !avi_source_read(&parser->source, a->offset, buf + size, a->size)) {
+            return 0;
+        }
+        size += a->size;
+    }
+    return size;
+}
+
+void avi_frames_writer_config(const avi_info_t* info, avi_writer_config_t* config) {
+    memset(config, 0, sizeof(avi_writer_config_t));
+    config->width = info->width;
+    config->height = info->height;
+    config->video_scale = info->video_scale;
+    config->video_rate = info->video_rate;
+    config->video_fourcc = AVI_FOURCC('M', 'J', 'P', 'G');
+    config->has_audio = info->has_audio;
+    config->audio_format = info->audio_format;
+    config->audio_channels = info->audio_channels;
+    config->audio_bits_per_sample = info->audio_bits_per_sample;
+    config->audio_sample_rate = info->audio_sample_rate;
+    config->audio_bytes_per_sec = info->audio_bytes_per_sec;
+    if (info->audio_stream >= 0) {
+        config->audio_language = info->streams[info->audio_stream].language;
+        config->audio_name = info->streams[info->audio_stream].name;
+    }
+}
+
+void avi_frames_free(avi_frames_t* frames) {
+    free(frames->video);
+    free(frames->audio);
+    free(frames->audio_first);
+    memset(frames, 0, sizeof(avi_frames_t));
+}
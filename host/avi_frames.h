@@ -0,0 +1,40 @@
+// AVI Frames - per-frame view of a parsed AVI for the converter tools
+// Lists every video chunk and groups the audio chunks by the video frame
+// during which they start playing, using the audio stream's time base
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "avi_parser.h"
+#include "avi_writer.h"
+#include "esp_err.h"
+
+// Chunk payload position in the source file
+typedef struct {
+    size_t offset;
+    size_t size;
+} avi_span_t;
+
+typedef struct {
+    avi_span_t* video;          // One per frame
+    avi_span_t* audio;          // Source audio chunks in stream order
+    uint32_t* audio_first;      // First audio chunk of each frame (frames + 1 entries)
+    uint32_t frames;
+    uint32_t audio_count;
+} avi_frames_t;
+
+// Scan the movi list of an opened parser (the parser is left at the end)
+// Audio that starts after the last video frame is attached to that frame
+esp_err_t avi_frames_load(avi_parser_t* parser, avi_frames_t* frames);
+
+// Total audio bytes that play during a frame
+size_t avi_frames_audio_size(const avi_frames_t* frames, uint32_t frame);
+
+// Read all audio of a frame into buf (capacity buf_size), returns bytes read or 0
+size_t avi_frames_read_audio(avi_parser_t* parser, const avi_frames_t* frames, uint32_t frame, uint8_t* buf,
+                             size_t buf_size);
+
+// Writer settings matching the parsed file
+void avi_frames_writer_config(const avi_info_t* info, avi_writer_config_t* config);
+
+void avi_frames_free(avi_frames_t* frames);
@@ -0,0 +1,183 @@
+// AVI Info - host tool that runs the badge's AVI parser over a file
+// Prints stream info and chunk statistics, and times a full demux pass
+// -a demuxes the audio track in the given language instead of the first one
+//
+// Usage: avi_info [-s stdio|mmap|stream] [-a language] [-v] <file.avi|->
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "avi_parser.h"
+#include "mp3_frame.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-s stdio|mmap|stream] [-a language] [-v] <file.avi|->\n", prog);
+    exit(1);
+}
+
+// Open source of the requested kind ("-" always reads stdin as a stream)
+static esp_err_t open_source(avi_source_t* src, const char* kind, const char* path) {
+    if (strcmp(path, "-") == 0 || strcmp(kind, "stream") == 0) {
+        FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+        return f ? avi_source_open_stream(src, f) : ESP_ERR_NOT_FOUND;
+    }
+    if (strcmp(kind, "stdio") == 0) {
+        return avi_source_open_file(src, path);
+    }
+    return avi_source_open_mmap(src, path);
+}
+
+int main(int argc, char** argv) {
+    const char* kind = "mmap";
+    const char* language = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:a:v")) != -1) {
+        switch (opt) {
+            case 's': kind = optarg; break;
+            case 'a': language = optarg; break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc) usage(argv[0]);
+    const char* path = argv[optind];
+
+    avi_source_t source;
+    if (open_source(&source, kind, path) != ESP_OK) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+
+    avi_parser_t parser;
+    if (avi_parser_open_source(&parser, &source) != ESP_OK) {
+        fprintf(stderr, "Failed to parse %s\n", path);
+        return 1;
+    }
+
+    if (language) {
+        int stream = avi_parser_find_audio(avi_parser_get_info(&parser), language);
+        if (stream < 0) {
+            fprintf(stderr, "No %s audio track in %s\n", language, path);
+            return 1;
+        }
+        avi_parser_select_audio(&parser, stream);
+    }
+
+    const avi_info_t* info = avi_parser_get_info(&parser);
+    printf("File:    %s (%s source)\n", path, parser.source.ops->name);
+    for (int i = 0; i < info->stream_count; i++) {
+        const avi_stream_t* stream = &info->streams[i];
+        char type[5] = {0};
+        memcpy(type, &stream->type, 4);
+        printf("Stream:  %d %s", i, type);
+        if (stream->audio_format) {
+            printf(" format 0x%04x, %lu Hz, %u ch", stream->audio_format, (unsigned long)stream->audio_sample_rate,
+                   stream->audio_channels);
+        }
+        if (stream->language) {
+            printf(", language 0x%04x", stream->language);
+        }
+        printf("%s%s%s%s\n", stream->name[0] ? " \"" : "", stream->name, stream->name[0] ? "\"" : "",
+               i == info->video_stream || i == info->audio_stream ? " (selected)" : "");
+    }
+    printf("Video:   %lux%lu @ %lu fps, %lu frames\n", (unsigned long)info->width, (unsigned long)info->height,
+           (unsigned long)info->fps, (unsigned long)info->video_frames);
+    if (info->has_audio) {
+        printf("Audio:   format 0x%04x, %lu Hz, %u ch, %lu bytes/s\n", info->audio_format,
+               (unsigned long)info->audio_sample_rate, info->audio_channels, (unsigned long)info->audio_bytes_per_sec);
+    } else {
+        printf("Audio:   no\n");
+    }
+
+    static char chapters[2048];
+    if (avi_parser_read_chapters(&parser, chapters, sizeof(chapters)) == ESP_OK) {
+        printf("Chapters:\n");
+        for (char* line = strtok(chapters, "\n"); line; line = strtok(NULL, "\n")) {
+            printf("         %s\n", line);
+        }
+    }
+
+    // Files from avi_remux carry playback info and a frame index
+    avi_index_entry_t* index = NULL;
+    uint32_t index_count = 0;
+    if (info->has_playback_info) {
+        const avi_playback_info_t* pb = &info->playback;
+        printf("Layout:  %s%s%s%s, max video %lu, max audio %lu, peak %lu bytes/frame\n",
+               pb->flags & AVI_FLAG_SECTOR_ALIGNED ? "sector-aligned" : "unaligned",
+               pb->flags & AVI_FLAG_AUDIO_PER_FRAME ? ", one audio chunk per frame" : "",
+               pb->flags & AVI_FLAG_PRE_ROTATED ? ", pre-rotated" : "",
+               pb->flags & AVI_FLAG_AUDIO_ALIGNED ? ", whole MP3 frames" : "",
+               (unsigned long)pb->max_video_size, (unsigned long)pb->max_audio_size, (unsigned long)pb->peak_bytes[0]);
+
+        index = malloc(pb->frame_count * sizeof(avi_index_entry_t));
+        if (index && avi_parser_read_index(&parser, 0, index, pb->frame_count) == ESP_OK) {
+            index_count = pb->frame_count;
+        }
+    }
+
+    size_t video_chunks = 0, audio_chunks = 0;
+    size_t video_bytes = 0, audio_bytes = 0;
+    size_t video_max = 0, audio_max = 0;
+    uint32_t checksum = 0;
+    uint32_t index_errors = 0;
+    uint32_t mp3_frames = 0;
+    size_t mp3_split_chunks = 0;              // Audio chunks that start or end mid-frame
+
+    int64_t t0 = esp_timer_get_time();
+    avi_chunk_t chunk;
+    while (avi_parser_next_chunk(&parser, &chunk) == ESP_OK) {
+        // Touch the payload so mmap sources are actually read
+        for (size_t i = 0; i < chunk.size; i += 64) checksum += chunk.data[i];
+
+        if (chunk.type == AVI_CHUNK_VIDEO) {
+            // Check the frame index against what the demuxer found
+            if (video_chunks < index_count && (index[video_chunks].video_offset != chunk.offset ||
+                                               index[video_chunks].video_size != chunk.size)) {
+                index_errors++;
+            }
+            video_chunks++;
+            video_bytes += chunk.size;
+            if (chunk.size > video_max) video_max = chunk.size;
+        } else if (chunk.type == AVI_CHUNK_AUDIO) {
+            if (info->audio_format == 0x55) {
+                uint32_t n = 0;
+                if (mp3_frame_whole(chunk.data, chunk.size, &n) != chunk.size) mp3_split_chunks++;
+                mp3_frames += n;
+            }
+            audio_chunks++;
+            audio_bytes += chunk.size;
+            if (chunk.size > audio_max) audio_max = chunk.size;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - t0;
+
+    printf("Chunks:  video=%zu (%zu bytes, max %zu)  audio=%zu (%zu bytes, max %zu)\n", video_chunks, video_bytes,
+           video_max, audio_chunks, audio_bytes, audio_max);
+    if (video_chunks > 0) {
+        printf("Frames:  avg %zu bytes\n", video_bytes / video_chunks);
+    }
+    if (info->audio_format == 0x55 && audio_chunks > 0) {
+        printf("MP3:     %lu whole frames, %zu of %zu chunks split a frame\n", (unsigned long)mp3_frames,
+               mp3_split_chunks, audio_chunks);
+    }
+    double mb = (video_bytes + audio_bytes) / (1024.0 * 1024.0);
+    printf("Demux:   %.1f MB in %.1f ms (%.1f MB/s, checksum %08x)\n", mb, elapsed_us / 1000.0,
+           elapsed_us > 0 ? mb / (elapsed_us / 1e6) : 0.0, checksum);
+
+    if (index_count > 0) {
+        printf("Index:   %lu entries, %s\n", (unsigned long)index_count,
+               index_errors == 0 && index_count == video_chunks ? "matches the movi list" : "MISMATCH");
+    }
+    free(index);
+
+    if (parser.source.bytes_read > 0) {
+        printf("Reads:   %llu bytes copied by the source in %.1f ms\n", (unsigned long long)parser.source.bytes_read,
+               parser.source.read_us / 1000.0);
+    }
+
+    avi_parser_close(&parser);
+    return 0;
+}
@@ -0,0 +1,371 @@
+// AVI Rate Control - build a clip that respects the player's byte budgets
+// Takes the same clip encoded at several JPEG qualities (best first), picks
+// the best quality per frame that keeps every frame under the size cap and
+// every sliding window under the card throughput budget, then muxes the
+// result like avi_remux. Writes a report of the frame-size distribution and
+// the worst windows. -R marks the stream as pre-rotated, -d re-encodes the
+// frames with a restart marker every mcu_rows MCU rows, -C stores the
+// chapters listed in a text file.
+//
+// Usage: avi_ratectl [-c cap_bytes] [-b budget_kbps] [-w window_ms] [-r report.txt] [-R] [-d mcu_rows] [-v]
+//                    [-C chapters.txt] <out.avi> <best.avi> [<smaller.avi> ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "avi_frames.h"
+#include "avi_parser.h"
+#include "avi_writer.h"
+#include "esp_log.h"
+
+#define MAX_LEVELS          16
+#define DEFAULT_CAP         (64 * 1024)     // Player's VIDEO_FRAME_MAX_SIZE
+#define DEFAULT_BUDGET_KBPS 8000
+#define DEFAULT_WINDOW_MS   1000
+#define CHUNK_OVERHEAD      (2 * 8 + 2)     // Two chunk headers and pad bytes
+#define HISTOGRAM_BUCKETS   16
+#define WORST_WINDOWS       5
+
+typedef struct {
+    const char* path;
+    avi_parser_t parser;
+    avi_frames_t frames;
+} level_t;
+
+static level_t levels[MAX_LEVELS];
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-c cap_bytes] [-b budget_kbps] [-w window_ms] [-r report.txt] [-R] [-d mcu_rows] [-v]\n"
+            "          [-C chapters.txt] <out.avi> <best.avi> [<smaller.avi> ...]\n",
+            prog);
+    exit(1);
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Estimated bytes a frame occupies on disk (alignment padding at its worst)
+static uint64_t frame_cost(int level, uint32_t frame, const size_t* audio_size) {
+    return levels[level].frames.video[frame].size + audio_size[frame] + CHUNK_OVERHEAD + 512;
+}
+
+// Pick per-frame quality levels: size cap first, then shave the largest frames
+// of every window that is over budget until it fits or nothing is left to shave
+static void choose_levels(int level_count, uint32_t frames, const size_t* audio_size, size_t cap,
+                          uint64_t budget, uint32_t window, uint8_t* choice) {
+    for (uint32_t i = 0; i < frames; i++) {
+        choice[i] = level_count - 1;
+        for (int l = 0; l < level_count; l++) {
+            if (levels[l].frames.video[i].size <= cap) {
+                choice[i] = l;
+                break;
+            }
+        }
+    }
+
+    if (window > frames) window = frames;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < window; i++) sum += frame_cost(choice[i], i, audio_size);
+
+    for (uint32_t start = 0; start + window <= frames; start++) {
+        while (sum > budget) {
+            // Largest frame in the window that still has a smaller encoding
+            uint32_t worst = UINT32_MAX;
+            size_t worst_size = 0;
+            for (uint32_t i = start; i < start + window; i++) {
+                size_t size = levels[choice[i]].frames.video[i].size;
+                if (choice[i] + 1 < level_count && size > worst_size) {
+                    worst = i;
+                    worst_size = size;
+                }
+            }
+            if (worst == UINT32_MAX) break;
+
+            sum -= frame_cost(choice[worst], worst, audio_size);
+            choice[worst]++;
+            sum += frame_cost(choice[worst], worst, audio_size);
+        }
+
+        if (start + window < frames) {
+            sum -= frame_cost(choice[start], start, audio_size);
+            sum += frame_cost(choice[start + window], start + window, audio_size);
+        }
+    }
+}
+
+// Report frame sizes, level usage and the worst windows of the written file
+static void write_report(FILE* out, int level_count, uint32_t frames, const uint8_t* choice, const uint32_t* sizes,
+                         const uint32_t* frame_bytes, size_t cap, uint32_t budget_kbps, uint32_t window,
+                         double fps) {
+    fprintf(out, "Frames:  %lu at %.3f fps, cap %zu bytes, budget %lu kbps over %lu frames\n", (unsigned long)frames,
+            fps, cap, (unsigned long)budget_kbps, (unsigned long)window);
+
+    fprintf(out, "\nQuality levels:\n");
+    for (int l = 0; l < level_count; l++) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < frames; i++) count += choice[i] == l;
+        fprintf(out, "  %-40s %7lu frames (%5.1f%%)\n", levels[l].path, (unsigned long)count,
+                100.0 * count / frames);
+    }
+
+    uint32_t* sorted = malloc(frames * sizeof(uint32_t));
+    memcpy(sorted, sizes, frames * sizeof(uint32_t));
+    qsort(sorted, frames, sizeof(uint32_t), compare_u32);
+    fprintf(out, "\nVideo frame sizes: p50 %lu  p90 %lu  p99 %lu  max %lu bytes\n",
+            (unsigned long)sorted[frames / 2], (unsigned long)sorted[(uint64_t)frames * 90 / 100],
+            (unsigned long)sorted[(uint64_t)frames * 99 / 100], (unsigned long)sorted[frames - 1]);
+    free(sorted);
+
+    // Histogram up to the cap (last bucket collects anything above it)
+    uint32_t histogram[HISTOGRAM_BUCKETS + 1] = {0};
+    size_t bucket = (cap + HISTOGRAM_BUCKETS - 1) / HISTOGRAM_BUCKETS;
+    uint32_t largest = 1;
+    for (uint32_t i = 0; i < frames; i++) {
+        size_t b = sizes[i] > cap ? HISTOGRAM_BUCKETS : sizes[i] / bucket;
+        if (b > HISTOGRAM_BUCKETS) b = HISTOGRAM_BUCKETS;
+        if (++histogram[b] > largest) largest = histogram[b];
+    }
+    for (int b = 0; b <= HISTOGRAM_BUCKETS; b++) {
+        if (histogram[b] == 0) continue;
+        char bar[41];
+        int len = (int)(40ULL * histogram[b] / largest);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        if (b == HISTOGRAM_BUCKETS) {
+            fprintf(out, "  > cap          %7lu %s\n", (unsigned long)histogram[b], bar);
+        } else {
+            fprintf(out, "  %6zu-%-6zu  %7lu %s\n", b * bucket, (b + 1) * bucket - 1, (unsigned long)histogram[b],
+                    bar);
+        }
+    }
+
+    // Worst non-overlapping windows by actual bytes on disk
+    if (window > frames) window = frames;
+    uint64_t* sums = malloc((frames - window + 1) * sizeof(uint64_t));
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        sum += frame_bytes[i];
+        if (i >= window) sum -= frame_bytes[i - window];
+        if (i + 1 >= window) sums[i + 1 - window] = sum;
+    }
+
+    uint32_t over = 0;
+    double kbps_per_byte = 8.0 * fps / window / 1000.0;
+    for (uint32_t s = 0; s + window <= frames; s++) over += sums[s] * kbps_per_byte > budget_kbps;
+
+    fprintf(out, "\nWorst windows (%lu over budget):\n", (unsigned long)over);
+    for (int n = 0; n < WORST_WINDOWS; n++) {
+        uint32_t best = UINT32_MAX;
+        for (uint32_t s = 0; s + window <= frames; s++) {
+            if (sums[s] != UINT64_MAX && (best == UINT32_MAX || sums[s] > sums[best])) best = s;
+        }
+        if (best == UINT32_MAX) break;
+
+        double kbps = sums[best] * kbps_per_byte;
+        double t = best / fps;
+        fprintf(out, "  %2d:%05.2f  frames %6lu-%-6lu %8.0f kbps (%3.0f%% of budget)\n", (int)(t / 60),
+                t - 60 * (int)(t / 60), (unsigned long)best, (unsigned long)(best + window - 1), kbps,
+                100.0 * kbps / budget_kbps);
+
+        // Exclude overlapping windows from further picks
+        uint32_t lo = best >= window ? best - window + 1 : 0;
+        for (uint32_t s = lo; s < best + window && s + window <= frames; s++) sums[s] = UINT64_MAX;
+    }
+    free(sums);
+}
+
+int main(int argc, char** argv) {
+    size_t cap = DEFAULT_CAP;
+    uint32_t budget_kbps = DEFAULT_BUDGET_KBPS;
+    uint32_t window_ms = DEFAULT_WINDOW_MS;
+    const char* report_path = NULL;
+    uint32_t flags = 0;
+    int restart_rows = 0;
+    const char* chapters_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:b:w:r:Rd:C:v")) != -1) {
+        switch (opt) {
+            case 'R': flags |= AVI_FLAG_PRE_ROTATED; break;
+            case 'd': restart_rows = atoi(optarg); break;
+            case 'C': chapters_path = optarg; break;
+            case 'c': cap = strtoul(optarg, NULL, 0); break;
+            case 'b': budget_kbps = strtoul(optarg, NULL, 0); break;
+            case 'w': window_ms = strtoul(optarg, NULL, 0); break;
+            case 'r': report_path = optarg; break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind + 2 > argc || cap == 0 || budget_kbps == 0 || window_ms == 0) usage(argv[0]);
+    const char* out_path = argv[optind];
+    int level_count = argc - optind - 1;
+    if (level_count > MAX_LEVELS) {
+        fprintf(stderr, "At most %d quality levels\n", MAX_LEVELS);
+        return 1;
+    }
+
+    // Open the ladder, all levels must describe the same frames
+    uint32_t frames = UINT32_MAX;
+    for (int l = 0; l < level_count; l++) {
+        level_t* level = &levels[l];
+        level->path = argv[optind + 1 + l];
+        avi_source_t source;
+        if (avi_source_open_mmap(&source, level->path) != ESP_OK ||
+            avi_parser_open_source(&level->parser, &source) != ESP_OK ||
+            avi_frames_load(&level->parser, &level->frames) != ESP_OK) {
+            fprintf(stderr, "Failed to read %s\n", level->path);
+            return 1;
+        }
+        if (level->frames.frames != frames && frames != UINT32_MAX) {
+            fprintf(stderr, "Warning: %s has %lu frames, using the first %lu\n", level->path,
+                    (unsigned long)level->frames.frames, (unsigned long)frames);
+        }
+        if (level->frames.frames < frames) frames = level->frames.frames;
+    }
+
+    // Audio always comes from the first level
+    level_t* base = &levels[0];
+    const avi_info_t* info = avi_parser_get_info(&base->parser);
+    double fps = (double)info->video_rate / info->video_scale;
+    uint32_t window = (uint32_t)(window_ms * fps / 1000.0 + 0.5);
+    if (window == 0) window = 1;
+    uint64_t budget = (uint64_t)budget_kbps * 1000 / 8 * window / fps;
+
+    size_t* audio_size = calloc(frames, sizeof(size_t));
+    uint8_t* choice = calloc(frames, 1);
+    uint32_t* sizes = calloc(frames, sizeof(uint32_t));
+    if (!audio_size || !choice || !sizes) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < frames; i++) {
+        audio_size[i] = avi_frames_audio_size(&base->frames, i);
+    }
+    // Audio past the shortest level's end belongs to its last frame
+    for (uint32_t i = frames; i < base->frames.frames; i++) {
+        audio_size[frames - 1] += avi_frames_audio_size(&base->frames, i);
+    }
+
+    choose_levels(level_count, frames, audio_size, cap, budget, window, choice);
+
+    avi_writer_config_t config;
+    avi_frames_writer_config(info, &config);
+    config.has_audio = config.has_audio && base->frames.audio_count > 0;
+    config.flags = flags;
+    config.restart_rows = restart_rows;
+
+    static char chapters[AVI_WRITER_CHAPTERS_MAX + 1];
+    if (chapters_path) {
+        if (avi_writer_load_chapters(chapters_path, chapters, sizeof(chapters)) != ESP_OK) {
+            fprintf(stderr, "Failed to read chapters from %s\n", chapters_path);
+            return 1;
+        }
+        config.chapters = chapters;
+    }
+
+    avi_writer_t writer;
+    if (avi_writer_open(&writer, out_path, &config) != ESP_OK) {
+        fprintf(stderr, "Failed to create %s\n", out_path);
+        return 1;
+    }
+
+    uint8_t* video_buf = malloc(cap > DEFAULT_CAP ? cap : DEFAULT_CAP);
+    size_t video_cap = cap > DEFAULT_CAP ? cap : DEFAULT_CAP;
+    uint8_t* audio_buf = NULL;
+    size_t audio_cap = 0;
+    uint32_t over_cap = 0;
+    esp_err_t ret = ESP_OK;
+
+    for (uint32_t i = 0; i < frames && ret == ESP_OK; i++) {
+        level_t* level = &levels[choice[i]];
+        const avi_span_t* v = &level->frames.video[i];
+        if (v->size > video_cap) {
+            video_cap = v->size;
+            video_buf = realloc(video_buf, video_cap);
+        }
+        if (audio_size[i] > audio_cap) {
+            audio_cap = audio_size[i] * 2;
+            audio_buf = realloc(audio_buf, audio_cap);
+        }
+
+        // Last frame also carries audio of frames missing from smaller levels
+        size_t got = 0;
+        for (uint32_t f = i; f < (i + 1 == frames ? base->frames.frames : i + 1); f++) {
+            size_t n = avi_frames_audio_size(&base->frames, f);
+            if (n > 0 && avi_frames_read_audio(&base->parser, &base->frames, f, audio_buf + got, audio_cap - got) != n) {
+                ret = ESP_FAIL;
+            }
+            got += n;
+        }
+        if (ret != ESP_OK || !avi_source_read(&level->parser.source, v->offset, video_buf, v->size)) {
+            ret = ESP_FAIL;
+            break;
+        }
+
+        sizes[i] = v->size;
+        ret = avi_writer_add_frame(&writer, video_buf, v->size, audio_buf, got);
+        over_cap += ret == ESP_OK && writer.index[i].video_size > cap;  // Size as written (after re-encoding)
+    }
+
+    FILE* report = stdout;
+    if (report_path && ret == ESP_OK) {
+        report = fopen(report_path, "w");
+        if (!report) {
+            fprintf(stderr, "Failed to create %s\n", report_path);
+            report = stdout;
+        }
+    }
+    if (ret == ESP_OK) {
+        fprintf(report, "Output:  %s\n", out_path);
+        write_report(report, level_count, frames, choice, sizes, writer.frame_bytes, cap, budget_kbps, window, fps);
+        if (over_cap > 0) {
+            fprintf(report, "\n%lu frames are over the cap even at the lowest quality\n", (unsigned long)over_cap);
+        }
+    }
+    if (report != stdout) fclose(report);
+
+    // Remaining budget violations are in the report; count them for the exit code
+    uint64_t sum = 0;
+    uint32_t over_budget = 0;
+    for (uint32_t i = 0; i < frames && ret == ESP_OK; i++) {
+        sum += writer.frame_bytes[i];
+        if (i >= window) sum -= writer.frame_bytes[i - window];
+        if (i + 1 >= window && sum > budget) over_budget++;
+    }
+
+    if (avi_writer_close(&writer) != ESP_OK || ret != ESP_OK) {
+        fprintf(stderr, "Failed to write %s\n", out_path);
+        return 1;
+    }
+
+    if (writer.restart_failures > 0) {
+        fprintf(stderr, "Warning: %lu frames could not be re-encoded with restart markers\n",
+                (unsigned long)writer.restart_failures);
+    }
+    if (writer.audio_dropped > 0) {
+        fprintf(stderr, "Warning: %llu audio bytes were not part of a whole MP3 frame and were dropped\n",
+                (unsigned long long)writer.audio_dropped);
+    }
+
+    for (int l = 0; l < level_count; l++) {
+        avi_frames_free(&levels[l].frames);
+        avi_parser_close(&levels[l].parser);
+    }
+    free(video_buf);
+    free(audio_buf);
+    free(audio_size);
+    free(choice);
+    free(sizes);
+
+    if (over_cap > 0 || over_budget > 0) {
+        fprintf(stderr, "Warning: %lu frames over the cap, %lu windows over budget (add a smaller level)\n",
+                (unsigned long)over_cap, (unsigned long)over_budget);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// AVI Remux - rewrite an ffmpeg AVI into the layout the badge plays best
+// Groups audio into one chunk per video frame, sector-aligns every video
+// payload and adds the playback info chunk and compact frame index
+// -R marks the stream as pre-rotated (encoded in framebuffer orientation),
+// -d re-encodes the frames with a restart marker every mcu_rows MCU rows,
+// -C stores the chapters listed in a text file (else the input's are kept),
+// -a keeps the audio track in the given language (else the first one); the
+// output has that one track, named as in the input
+//
+// Usage: avi_remux [-R] [-d mcu_rows] [-C chapters.txt] [-a language] [-v] <in.avi> <out.avi>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "avi_frames.h"
+#include "avi_parser.h"
+#include "avi_writer.h"
+#include "esp_log.h"
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-R] [-d mcu_rows] [-C chapters.txt] [-a language] [-v] <in.avi> <out.avi>\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    uint32_t flags = 0;
+    int restart_rows = 0;
+    const char* chapters_path = NULL;
+    const char* language = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "Rd:C:a:v")) != -1) {
+        switch (opt) {
+            case 'R': flags |= AVI_FLAG_PRE_ROTATED; break;
+            case 'd': restart_rows = atoi(optarg); break;
+            case 'C': chapters_path = optarg; break;
+            case 'a': language = optarg; break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind + 2 > argc) usage(argv[0]);
+    const char* in_path = argv[optind];
+    const char* out_path = argv[optind + 1];
+
+    avi_source_t source;
+    avi_parser_t parser;
+    if (avi_source_open_mmap(&source, in_path) != ESP_OK || avi_parser_open_source(&parser, &source) != ESP_OK) {
+        fprintf(stderr, "Failed to open %s\n", in_path);
+        return 1;
+    }
+    if (language) {
+        int stream = avi_parser_find_audio(avi_parser_get_info(&parser), language);
+        if (stream < 0) {
+            fprintf(stderr, "%s: no %s audio track\n", in_path, language);
+            return 1;
+        }
+        avi_parser_select_audio(&parser, stream);
+    }
+
+    avi_frames_t frames;
+    if (avi_frames_load(&parser, &frames) != ESP_OK) {
+        fprintf(stderr, "%s: no usable video stream\n", in_path);
+        return 1;
+    }
+
+    avi_writer_config_t config;
+    avi_frames_writer_config(avi_parser_get_info(&parser), &config);
+    config.has_audio = config.has_audio && frames.audio_count > 0;
+    config.flags = flags;
+    config.restart_rows = restart_rows;
+
+    static char chapters[AVI_WRITER_CHAPTERS_MAX + 1];
+    if (chapters_path) {
+        if (avi_writer_load_chapters(chapters_path, chapters, sizeof(chapters)) != ESP_OK) {
+            fprintf(stderr, "Failed to read chapters from %s\n", chapters_path);
+            return 1;
+        }
+        config.chapters = chapters;
+    } else if (avi_parser_read_chapters(&parser, chapters, sizeof(chapters)) == ESP_OK) {
+        config.chapters = chapters;
+    }
+
+    avi_writer_t writer;
+    if (avi_writer_open(&writer, out_path, &config) != ESP_OK) {
+        fprintf(stderr, "Failed to create %s\n", out_path);
+        return 1;
+    }
+
+    uint8_t* video_buf = NULL;
+    uint8_t* audio_buf = NULL;
+    size_t video_cap = 0;
+    size_t audio_cap = 0;
+    int oversized_audio = 0;
+    esp_err_t ret = ESP_OK;
+
+    for (uint32_t i = 0; i < frames.frames && ret == ESP_OK; i++) {
+        const avi_span_t* v = &frames.video[i];
+        size_t audio_size = avi_frames_audio_size(&frames, i);
+        if (v->size > video_cap) {
+            video_cap = v->size;
+            video_buf = realloc(video_buf, video_cap);
+        }
+        if (audio_size > audio_cap) {
+            audio_cap = audio_size * 2;
+            audio_buf = realloc(audio_buf, audio_cap);
+        }
+        if (audio_size > AVI_WRITER_AUDIO_CHUNK_MAX) oversized_audio++;
+
+        if ((audio_size > 0 && avi_frames_read_audio(&parser, &frames, i, audio_buf, audio_cap) != audio_size) ||
+            !avi_source_read(&parser.source, v->offset, video_buf, v->size)) {
+            ret = ESP_FAIL;
+            break;
+        }
+        ret = avi_writer_add_frame(&writer, video_buf, v->size, audio_buf, audio_size);
+    }
+
+    size_t in_size = parser.file_size;
+    avi_frames_free(&frames);
+    avi_parser_close(&parser);
+    free(video_buf);
+    free(audio_buf);
+
+    uint64_t padding = writer.padding_bytes;
+    if (avi_writer_close(&writer) != ESP_OK || ret != ESP_OK) {
+        fprintf(stderr, "Failed to write %s\n", out_path);
+        return 1;
+    }
+
+    const avi_playback_info_t* pb = &writer.playback;
+    printf("Output:  %s, %lu frames, %zu -> %zu bytes (%.1f%% alignment padding)\n", out_path,
+           (unsigned long)pb->frame_count, in_size, writer.pos, writer.pos ? 100.0 * padding / writer.pos : 0.0);
+    printf("Chunks:  max video %lu bytes, max audio %lu bytes\n", (unsigned long)pb->max_video_size,
+           (unsigned long)pb->max_audio_size);
+    if (pb->flags & AVI_FLAG_AUDIO_ALIGNED) {
+        printf("Audio:   whole MP3 frames per chunk, %llu bytes outside frames dropped\n",
+               (unsigned long long)writer.audio_dropped);
+    }
+    printf("Peak:   ");
+    for (int i = 0; i < AVI_PEAK_WINDOWS && pb->peak_bytes[i] > 0; i++) {
+        printf(" %u:%lu", 1u << i, (unsigned long)avi_writer_peak_kbps(&writer, i));
+    }
+    printf(" (frames:kbps)\n");
+
+    if (writer.restart_failures > 0) {
+        fprintf(stderr, "Warning: %lu frames could not be re-encoded with restart markers\n",
+                (unsigned long)writer.restart_failures);
+    }
+    if (oversized_audio > 0) {
+        fprintf(stderr, "Warning: %d frames carry more than %d bytes of audio, the player will drop them\n",
+                oversized_audio, AVI_WRITER_AUDIO_CHUNK_MAX);
+    }
+    return 0;
+}
@@ -0,0 +1,465 @@
+// AVI Writer - muxer for playback-optimized AVIs (host side)
+
+#include "avi_writer.h"
+#include "chapters.h"
+#include "jpeg_restart.h"
+#include "mp3_frame.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR_SIZE         512
+#define HEADER_MAX_SIZE     (1024 + AVI_WRITER_CHAPTERS_MAX + 16)
+
+// avih flags
+#define AVIF_HASINDEX       0x00000010
+#define AVIF_ISINTERLEAVED  0x00000100
+
+// idx1 flags
+#define AVIIF_KEYFRAME      0x00000010
+
+// Little-endian byte buffer for building headers
+typedef struct {
+    uint8_t* data;
+    size_t len;
+} bytes_t;
+
+static void put_u16(bytes_t* b, uint16_t v) {
+    b->data[b->len++] = v & 0xFF;
+    b->data[b->len++] = v >> 8;
+}
+
+static void put_u32(bytes_t* b, uint32_t v) {
+    put_u16(b, v & 0xFFFF);
+    put_u16(b, v >> 16);
+}
+
+static void set_u32(bytes_t* b, size_t at, uint32_t v) {
+    b->data[at] = v & 0xFF;
+    b->data[at + 1] = (v >> 8) & 0xFF;
+    b->data[at + 2] = (v >> 16) & 0xFF;
+    b->data[at + 3] = v >> 24;
+}
+
+// Open a LIST (or RIFF) and return the offset of its size field
+static size_t begin_list(bytes_t* b, uint32_t id, uint32_t type) {
+    put_u32(b, id);
+    size_t at = b->len;
+    put_u32(b, 0);
+    put_u32(b, type);
+    return at;
+}
+
+static void end_list(bytes_t* b, size_t at) {
+    set_u32(b, at, b->len - at - 4);
+}
+
+// Largest on-disk byte count over any run of window consecutive frames
+static uint64_t peak_window(const avi_writer_t* w, uint32_t window) {
+    if (window == 0 || window > w->frames) return 0;  // Clip too short to measure
+
+    uint64_t sum = 0;
+    uint64_t peak = 0;
+    for (uint32_t i = 0; i < w->frames; i++) {
+        sum += w->frame_bytes[i];
+        if (i >= window) sum -= w->frame_bytes[i - window];
+        if (sum > peak) peak = sum;
+    }
+    return peak;
+}
+
+// Build RIFF header, hdrl list and movi list header
+static size_t build_headers(const avi_writer_t* w, uint8_t* out, size_t riff_size, size_t movi_size) {
+    const avi_writer_config_t* c = &w->config;
+    bytes_t b = {out, 0};
+    uint32_t fps = c->video_scale ? (c->video_rate + c->video_scale / 2) / c->video_scale : 0;
+
+    put_u32(&b, AVI_FOURCC('R', 'I', 'F', 'F'));
+    put_u32(&b, riff_size);
+    put_u32(&b, AVI_FOURCC('A', 'V', 'I', ' '));
+
+    size_t hdrl = begin_list(&b, AVI_FOURCC('L', 'I', 'S', 'T'), AVI_FOURCC('h', 'd', 'r', 'l'));
+
+    // Main header
+    put_u32(&b, AVI_FOURCC('a', 'v', 'i', 'h'));
+    put_u32(&b, 56);
+    put_u32(&b, c->video_rate ? (uint32_t)(1000000ULL * c->video_scale / c->video_rate) : 0);
+    put_u32(&b, (uint32_t)peak_window(w, fps < w->frames ? fps : w->frames));  // Max bytes per second
+    put_u32(&b, SECTOR_SIZE);                               // Padding granularity
+    put_u32(&b, AVIF_HASINDEX | AVIF_ISINTERLEAVED);
+    put_u32(&b, w->frames);
+    put_u32(&b, 0);                                         // Initial frames
+    put_u32(&b, c->has_audio ? 2 : 1);
+    put_u32(&b, w->playback.max_video_size);                // Suggested buffer size
+    put_u32(&b, c->width);
+    put_u32(&b, c->height);
+    for (int i = 0; i < 4; i++) put_u32(&b, 0);
+
+    // Video stream
+    size_t strl = begin_list(&b, AVI_FOURCC('L', 'I', 'S', 'T'), AVI_FOURCC('s', 't', 'r', 'l'));
+    put_u32(&b, AVI_FOURCC('s', 't', 'r', 'h'));
+    put_u32(&b, 56);
+    put_u32(&b, AVI_FOURCC('v', 'i', 'd', 's'));
+    put_u32(&b, c->video_fourcc);
+    put_u32(&b, 0);                                         // Flags
+    put_u16(&b, 0);                                         // Priority
+    put_u16(&b, 0);                                         // Language
+    put_u32(&b, 0);                                         // Initial frames
+    put_u32(&b, c->video_scale);
+    put_u32(&b, c->video_rate);
+    put_u32(&b, 0);                                         // Start
+    put_u32(&b, w->frames);
+    put_u32(&b, w->playback.max_video_size);
+    put_u32(&b, 0xFFFFFFFF);                                // Quality
+    put_u32(&b, 0);                                         // Sample size
+    put_u16(&b, 0);
+    put_u16(&b, 0);
+    put_u16(&b, c->width);
+    put_u16(&b, c->height);
+
+    put_u32(&b, AVI_FOURCC('s', 't', 'r', 'f'));
+    put_u32(&b, 40);
+    put_u32(&b, 40);                                        // BITMAPINFOHEADER size
+    put_u32(&b, c->width);
+    put_u32(&b, c->height);
+    put_u16(&b, 1);                                         // Planes
+    put_u16(&b, 24);                                        // Bit count
+    put_u32(&b, c->video_fourcc);
+    put_u32(&b, c->width * c->height * 3);
+    for (int i = 0; i < 4; i++) put_u32(&b, 0);
+    end_list(&b, strl);
+
+    // Audio stream, declared as a byte stream because chunks hold a whole frame's worth
+    if (c->has_audio) {
+        bool mp3 = c->audio_format == 0x55;
+        uint16_t block_align = mp3 ? 1 : c->audio_channels * c->audio_bits_per_sample / 8;
+
+        strl = begin_list(&b, AVI_FOURCC('L', 'I', 'S', 'T'), AVI_FOURCC('s', 't', 'r', 'l'));
+        put_u32(&b, AVI_FOURCC('s', 't', 'r', 'h'));
+        put_u32(&b, 56);
+        put_u32(&b, AVI_FOURCC('a', 'u', 'd', 's'));
+        put_u32(&b, 0);
+        put_u32(&b, 0);
+        put_u16(&b, 0);
+        put_u16(&b, c->audio_language);
+        put_u32(&b, 0);
+        put_u32(&b, block_align);                           // Scale
+        put_u32(&b, c->audio_bytes_per_sec);                // Rate
+        put_u32(&b, 0);
+        put_u32(&b, (uint32_t)(w->audio_bytes / (block_align ? block_align : 1)));
+        put_u32(&b, w->playback.max_audio_size);
+        put_u32(&b, 0xFFFFFFFF);
+        put_u32(&b, block_align);                           // Sample size
+        for (int i = 0; i < 4; i++) put_u16(&b, 0);
+
+        put_u32(&b, AVI_FOURCC('s', 't', 'r', 'f'));
+        put_u32(&b, mp3 ? 30 : 18);
+        put_u16(&b, c->audio_format);
+        put_u16(&b, c->audio_channels);
+        put_u32(&b, c->audio_sample_rate);
+        put_u32(&b, c->audio_bytes_per_sec);
+        put_u16(&b, block_align);
+        put_u16(&b, c->audio_bits_per_sample);
+        if (mp3) {
+            // MPEGLAYER3WAVEFORMAT extension
+            put_u16(&b, 12);
+            put_u16(&b, 1);                                 // MPEGLAYER3_ID_MPEG
+            put_u32(&b, 2);                                 // MPEGLAYER3_FLAG_PADDING_OFF
+            put_u16(&b, 1);                                 // Block size
+            put_u16(&b, 1);                                 // Frames per block
+            put_u16(&b, 1393);                              // Codec delay
+        } else {
+            put_u16(&b, 0);
+        }
+
+        // Track name, for picking the track by language
+        if (c->audio_name && c->audio_name[0]) {
+            size_t size = strnlen(c->audio_name, AVI_STREAM_NAME_MAX - 1) + 1;
+            put_u32(&b, AVI_FOURCC('s', 't', 'r', 'n'));
+            put_u32(&b, size);
+            memcpy(b.data + b.len, c->audio_name, size - 1);
+            b.len += size - 1;
+            b.data[b.len++] = 0;
+            if (size & 1) b.data[b.len++] = 0;
+        }
+        end_list(&b, strl);
+    }
+
+    // Our playback info
+    put_u32(&b, AVI_FOURCC_PLAYBACK_INFO);
+    put_u32(&b, sizeof(avi_playback_info_t));
+    memcpy(b.data + b.len, &w->playback, sizeof(avi_playback_info_t));
+    b.len += sizeof(avi_playback_info_t);
+
+    end_list(&b, hdrl);
+
+    // Chapters, NUL-terminated text in LIST INFO as INFO strings are
+    if (w->config.chapters) {
+        size_t size = strlen(w->config.chapters) + 1;
+        size_t info = begin_list(&b, AVI_FOURCC('L', 'I', 'S', 'T'), AVI_FOURCC('I', 'N', 'F', 'O'));
+        put_u32(&b, AVI_FOURCC_CHAPTERS);
+        put_u32(&b, size);
+        memcpy(b.data + b.len, w->config.chapters, size);
+        b.len += size;
+        if (size & 1) b.data[b.len++] = 0;
+        end_list(&b, info);
+    }
+
+    put_u32(&b, AVI_FOURCC('L', 'I', 'S', 'T'));
+    put_u32(&b, movi_size);
+    put_u32(&b, AVI_FOURCC('m', 'o', 'v', 'i'));
+    return b.len;
+}
+
+static bool write_bytes(avi_writer_t* w, const void* data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, w->file) != size) return false;
+    w->pos += size;
+    return true;
+}
+
+// Write a chunk with its pad byte
+static bool write_chunk(avi_writer_t* w, uint32_t id, const uint8_t* data, size_t size) {
+    uint8_t header[8];
+    bytes_t b = {header, 0};
+    put_u32(&b, id);
+    put_u32(&b, size);
+    static const uint8_t pad = 0;
+    return write_bytes(w, header, 8) && write_bytes(w, data, size) && ((size & 1) == 0 || write_bytes(w, &pad, 1));
+}
+
+// Pad with a JUNK chunk so the next chunk's payload starts on a sector boundary
+static bool align_next_payload(avi_writer_t* w) {
+    size_t target = (w->pos + 8 + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE - 8;
+    if (target == w->pos) return true;
+    if (target < w->pos + 8) target += SECTOR_SIZE;  // JUNK needs room for its own header
+
+    static const uint8_t zeros[SECTOR_SIZE];
+    size_t size = target - w->pos - 8;
+    w->padding_bytes += target - w->pos;
+    return write_chunk(w, AVI_FOURCC('J', 'U', 'N', 'K'), zeros, size);
+}
+
+// Queue audio and move the whole MP3 frames to the front of the carry buffer
+// Bytes between frames are dropped; *ready is how many bytes can be written
+static bool collect_mp3_frames(avi_writer_t* w, const uint8_t* audio, size_t audio_size, size_t* ready) {
+    if (w->carry_size + audio_size > w->carry_capacity) {
+        size_t capacity = (w->carry_size + audio_size) * 2;
+        uint8_t* carry = realloc(w->audio_carry, capacity);
+        if (!carry) return false;
+        w->audio_carry = carry;
+        w->carry_capacity = capacity;
+    }
+    if (audio_size > 0) memcpy(w->audio_carry + w->carry_size, audio, audio_size);
+    w->carry_size += audio_size;
+
+    uint8_t* buf = w->audio_carry;
+    size_t in = 0, out = 0;
+    while (in < w->carry_size) {
+        size_t left = w->carry_size - in;
+        size_t whole = mp3_frame_whole(buf + in, left, NULL);
+        if (whole > 0) {
+            memmove(buf + out, buf + in, whole);
+            out += whole;
+            in += whole;
+            continue;
+        }
+        // Cut-off frame (or header) at the end: wait for the next chunk
+        if (left < 4 || mp3_frame_parse(buf + in, left, NULL) > 0) break;
+
+        // Not a frame: skip to the next sync, keeping a possible partial header
+        size_t skip = mp3_frame_sync(buf + in + 1, left - 1) + 1;
+        if (skip > left - 3) skip = left - 3;
+        w->audio_dropped += skip;
+        in += skip;
+    }
+
+    // Keep the remainder after the ready frames
+    memmove(buf + out, buf + in, w->carry_size - in);
+    w->carry_size = out + (w->carry_size - in);
+    *ready = out;
+    return true;
+}
+
+esp_err_t avi_writer_load_chapters(const char* path, char* text, size_t capacity) {
+    FILE* f = fopen(path, "r");
+    if (!f) return ESP_ERR_NOT_FOUND;
+
+    char line[256];
+    size_t len = 0;
+    int line_number = 0;
+    esp_err_t ret = ESP_OK;
+    text[0] = '\0';
+    while (ret == ESP_OK && fgets(line, sizeof(line), f)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0' || line[strspn(line, " \t")] == '#') continue;
+
+        uint32_t ms;
+        const char* title;
+        if (!chapters_parse_time(line, &ms, &title)) {
+            fprintf(stderr, "%s:%d: no chapter time\n", path, line_number);
+            ret = ESP_ERR_INVALID_ARG;
+            break;
+        }
+        int n = snprintf(text + len, capacity - len, "%lu:%02lu.%03lu %s\n", (unsigned long)(ms / 60000),
+                         (unsigned long)(ms / 1000 % 60), (unsigned long)(ms % 1000), title);
+        if (n < 0 || (size_t)n >= capacity - len) {
+            fprintf(stderr, "%s: more than %zu bytes of chapters\n", path, capacity - 1);
+            ret = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        len += n;
+    }
+    fclose(f);
+    return ret;
+}
+
+esp_err_t avi_writer_open(avi_writer_t* writer, const char* path, const avi_writer_config_t* config) {
+    if (config->chapters && strlen(config->chapters) > AVI_WRITER_CHAPTERS_MAX) return ESP_ERR_INVALID_SIZE;
+    memset(writer, 0, sizeof(avi_writer_t));
+    writer->config = *config;
+    writer->playback.version = AVI_PLAYBACK_INFO_VERSION;
+    writer->playback.flags = config->flags | AVI_FLAG_SECTOR_ALIGNED | (config->has_audio ? AVI_FLAG_AUDIO_PER_FRAME : 0);
+    if (config->has_audio && config->audio_format == 0x55) {
+        writer->playback.flags |= AVI_FLAG_AUDIO_ALIGNED;
+    }
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file) return ESP_ERR_NOT_FOUND;
+
+    uint8_t header[HEADER_MAX_SIZE];
+    writer->header_size = build_headers(writer, header, 0, 0);
+    if (!write_bytes(writer, header, writer->header_size)) {
+        fclose(writer->file);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t avi_writer_add_frame(avi_writer_t* writer, const uint8_t* video, size_t video_size, const uint8_t* audio,
+                               size_t audio_size) {
+    if (writer->frames == writer->capacity) {
+        uint32_t capacity = writer->capacity ? writer->capacity * 2 : 1024;
+        avi_index_entry_t* index = realloc(writer->index, capacity * sizeof(avi_index_entry_t));
+        if (index) writer->index = index;
+        uint32_t* frame_bytes = realloc(writer->frame_bytes, capacity * sizeof(uint32_t));
+        if (frame_bytes) writer->frame_bytes = frame_bytes;
+        if (!index || !frame_bytes) return ESP_ERR_NO_MEM;
+        writer->capacity = capacity;
+    }
+
+    avi_index_entry_t* entry = &writer->index[writer->frames];
+    memset(entry, 0, sizeof(avi_index_entry_t));
+    size_t start = writer->pos;
+
+    // Audio for this frame goes first so it reaches the decoder ahead of the picture
+    if (writer->config.has_audio) {
+        bool whole_frames = writer->playback.flags & AVI_FLAG_AUDIO_ALIGNED;
+        if (whole_frames) {
+            if (!collect_mp3_frames(writer, audio, audio_size, &audio_size)) return ESP_ERR_NO_MEM;
+            audio = writer->audio_carry;
+        }
+        entry->audio_offset = writer->pos + 8;
+        entry->audio_size = audio_size;
+        if (!write_chunk(writer, AVI_FOURCC('0', '1', 'w', 'b'), audio, audio_size)) return ESP_FAIL;
+        if (whole_frames) {
+            writer->carry_size -= audio_size;
+            memmove(writer->audio_carry, writer->audio_carry + audio_size, writer->carry_size);
+        }
+        writer->audio_bytes += audio_size;
+        if (audio_size > writer->playback.max_audio_size) writer->playback.max_audio_size = audio_size;
+    }
+
+    // Restart markers let the software decoder split the frame into strips
+    uint8_t* encoded = NULL;
+    if (writer->config.restart_rows > 0 && video_size > 0) {
+        size_t encoded_size = 0;
+        if (jpeg_restart_encode(video, video_size, writer->config.restart_rows, &encoded, &encoded_size) == ESP_OK) {
+            video = encoded;
+            video_size = encoded_size;
+        } else {
+            writer->restart_failures++;
+        }
+    }
+
+    bool ok = align_next_payload(writer);
+    entry->video_offset = writer->pos + 8;
+    entry->video_size = video_size;
+    ok = ok && write_chunk(writer, AVI_FOURCC('0', '0', 'd', 'c'), video, video_size);
+    free(encoded);
+    if (!ok) return ESP_FAIL;
+    if (video_size > writer->playback.max_video_size) writer->playback.max_video_size = video_size;
+
+    writer->frame_bytes[writer->frames] = writer->pos - start;
+    writer->frames++;
+    return ESP_OK;
+}
+
+esp_err_t avi_writer_close(avi_writer_t* writer) {
+    if (!writer->file) return ESP_ERR_INVALID_STATE;
+
+    bool ok = true;
+    size_t movi_fourcc = writer->header_size - 4;
+    size_t movi_size = writer->pos - movi_fourcc;
+
+    // Standard idx1 so desktop players can seek (offsets relative to the "movi" FourCC)
+    uint32_t entries = writer->frames * (writer->config.has_audio ? 2 : 1);
+    uint8_t row[16];
+    bytes_t b = {row, 0};
+    put_u32(&b, AVI_FOURCC('i', 'd', 'x', '1'));
+    put_u32(&b, entries * 16);
+    ok = ok && write_bytes(writer, row, 8);
+    for (uint32_t i = 0; i < writer->frames && ok; i++) {
+        const avi_index_entry_t* e = &writer->index[i];
+        if (writer->config.has_audio) {
+            b.len = 0;
+            put_u32(&b, AVI_FOURCC('0', '1', 'w', 'b'));
+            put_u32(&b, 0);
+            put_u32(&b, e->audio_offset - 8 - movi_fourcc);
+            put_u32(&b, e->audio_size);
+            ok = write_bytes(writer, row, 16);
+        }
+        b.len = 0;
+        put_u32(&b, AVI_FOURCC('0', '0', 'd', 'c'));
+        put_u32(&b, AVIIF_KEYFRAME);
+        put_u32(&b, e->video_offset - 8 - movi_fourcc);
+        put_u32(&b, e->video_size);
+        ok = ok && write_bytes(writer, row, 16);
+    }
+
+    // Compact frame index
+    writer->playback.index_offset = writer->pos;
+    writer->playback.frame_count = writer->frames;
+    ok = ok && write_chunk(writer, AVI_FOURCC_FRAME_INDEX, (const uint8_t*)writer->index,
+                           writer->frames * sizeof(avi_index_entry_t));
+
+    for (int i = 0; i < AVI_PEAK_WINDOWS; i++) {
+        writer->playback.peak_bytes[i] = (uint32_t)peak_window(writer, 1u << i);
+    }
+
+    // Rewrite headers with the final values (same size as the placeholder)
+    uint8_t header[HEADER_MAX_SIZE];
+    size_t header_size = build_headers(writer, header, writer->pos - 8, movi_size);
+    ok = ok && header_size == writer->header_size && fseek(writer->file, 0, SEEK_SET) == 0 &&
+         fwrite(header, 1, header_size, writer->file) == header_size;
+
+    if (fclose(writer->file) != 0) ok = false;
+    writer->file = NULL;
+
+    // A frame still cut off after the last chunk never completes
+    writer->audio_dropped += writer->carry_size;
+    free(writer->audio_carry);
+    writer->audio_carry = NULL;
+    writer->carry_size = 0;
+    free(writer->index);
+    free(writer->frame_bytes);
+    writer->index = NULL;
+    writer->frame_bytes = NULL;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+uint32_t avi_writer_peak_kbps(const avi_writer_t* writer, int window) {
+    const avi_writer_config_t* c = &writer->config;
+    if (window < 0 || window >= AVI_PEAK_WINDOWS || c->video_scale == 0) return 0;
+    uint64_t bits = (uint64_t)writer->playback.peak_bytes[window] * 8 * c->video_rate;
+    return (uint32_t)(bits / ((uint64_t)c->video_scale * (1u << window) * 1000));
+}
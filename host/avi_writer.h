@@ -0,0 +1,77 @@
+// AVI Writer - muxer for playback-optimized AVIs (host side)
+// Writes the layout the badge reads fastest: one audio chunk per video
+// frame, every video payload sector-aligned by JUNK padding, a playback info
+// chunk in hdrl and a compact frame index next to the standard idx1
+// MP3 audio is re-cut so every chunk holds whole frames: a frame the source
+// split across chunks moves entirely into the next video frame's chunk
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "avi_parser.h"
+#include "esp_err.h"
+
+// Largest audio chunk the badge's audio queue accepts
+#define AVI_WRITER_AUDIO_CHUNK_MAX 4096
+
+// Most chapter text the player reads (CHAPTERS_TEXT_MAX without the NUL)
+#define AVI_WRITER_CHAPTERS_MAX 2047
+
+// Stream parameters of the file to write
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t video_scale;           // Frame duration is scale/rate seconds
+    uint32_t video_rate;
+    uint32_t video_fourcc;          // Codec, e.g. AVI_FOURCC('M', 'J', 'P', 'G')
+    bool has_audio;
+    uint16_t audio_format;          // WAVE format tag (0x55 = MP3)
+    uint16_t audio_channels;
+    uint16_t audio_bits_per_sample;
+    uint32_t audio_sample_rate;
+    uint32_t audio_bytes_per_sec;
+    uint16_t audio_language;        // Windows LANGID for strh, 0 = not given
+    const char* audio_name;         // Track name for strn (cut to AVI_STREAM_NAME_MAX - 1), NULL = none
+    uint32_t flags;                 // Extra AVI_FLAG_* bits for the playback info
+    int restart_rows;               // Re-encode JPEG frames with a restart marker every N MCU rows (0 = as is)
+    const char* chapters;           // Chapter text for LIST INFO (AVI_FOURCC_CHAPTERS), NULL = none
+} avi_writer_config_t;
+
+typedef struct {
+    FILE* file;
+    avi_writer_config_t config;
+    size_t pos;                     // Current file offset
+    size_t header_size;             // Bytes before the movi list
+    avi_index_entry_t* index;       // One entry per frame
+    uint32_t* frame_bytes;          // Bytes on disk per frame (for the peak table)
+    uint32_t frames;
+    uint32_t capacity;
+    uint64_t audio_bytes;
+    uint64_t padding_bytes;         // JUNK written for alignment
+    uint8_t* audio_carry;           // Audio not yet written: a cut-off MP3 frame
+    size_t carry_size;
+    size_t carry_capacity;
+    uint64_t audio_dropped;         // Bytes that were not part of a whole MP3 frame
+    uint32_t restart_failures;      // Frames written as they were because re-encoding failed
+    avi_playback_info_t playback;   // Filled in as frames are written
+} avi_writer_t;
+
+// Read a chapter list, one "[h:]m:ss[.mmm] title" line per chapter (blank
+// lines and lines starting with # are skipped), into the form stored in the
+// file; ESP_ERR_INVALID_ARG names the first line without a time
+esp_err_t avi_writer_load_chapters(const char* path, char* text, size_t capacity);
+
+// Create file and write placeholder headers
+esp_err_t avi_writer_open(avi_writer_t* writer, const char* path, const avi_writer_config_t* config);
+
+// Append one video frame and the audio that plays during it (audio may be empty)
+// MP3 audio may be cut anywhere, the writer holds back the last partial frame
+esp_err_t avi_writer_add_frame(avi_writer_t* writer, const uint8_t* video, size_t video_size, const uint8_t* audio,
+                               size_t audio_size);
+
+// Write indices, patch headers and close the file
+esp_err_t avi_writer_close(avi_writer_t* writer);
+
+// Peak bitrate over 2^window consecutive frames in kbit/s
+uint32_t avi_writer_peak_kbps(const avi_writer_t* writer, int window);
@@ -0,0 +1,363 @@
+// FAT Image - host-side FAT12/16/32 reader for testing the extent fast path
+
+#include "fat_image.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    int fd;
+    uint64_t volume_offset;     // Byte offset of the volume in the image
+    uint32_t sector_size;
+    uint32_t sectors_per_cluster;
+    uint32_t fat_start;         // First FAT sector (volume relative)
+    uint32_t root_start;        // FAT12/16 fixed root directory sector
+    uint32_t root_sectors;
+    uint32_t data_start;        // First data sector (cluster 2)
+    uint32_t cluster_count;
+    uint32_t root_cluster;      // FAT32 root directory cluster
+    int fat_bits;               // 12, 16 or 32
+} fat_volume_t;
+
+static inline uint16_t rd16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t rd32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool read_sectors(const fat_volume_t* vol, uint64_t lba, void* buf, uint32_t count) {
+    size_t len = (size_t)count * vol->sector_size;
+    return pread(vol->fd, buf, len, vol->volume_offset + lba * vol->sector_size) == (ssize_t)len;
+}
+
+static bool is_boot_sector(const uint8_t* s) {
+    uint16_t bps = rd16(s + 11);
+    return s[510] == 0x55 && s[511] == 0xAA && (s[0] == 0xEB || s[0] == 0xE9) &&
+           (bps == 512 || bps == 1024 || bps == 2048 || bps == 4096) && s[13] != 0;
+}
+
+static esp_err_t mount_volume(fat_volume_t* vol, int fd) {
+    uint8_t sector[512];
+    memset(vol, 0, sizeof(fat_volume_t));
+    vol->fd = fd;
+
+    if (pread(fd, sector, 512, 0) != 512) return ESP_ERR_INVALID_SIZE;
+
+    // Card images start with an MBR, volume images with the boot sector
+    if (!is_boot_sector(sector)) {
+        if (sector[510] != 0x55 || sector[511] != 0xAA) return ESP_ERR_INVALID_ARG;
+        vol->volume_offset = (uint64_t)rd32(sector + 446 + 8) * 512;
+        if (pread(fd, sector, 512, vol->volume_offset) != 512 || !is_boot_sector(sector)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    vol->sector_size = rd16(sector + 11);
+    vol->sectors_per_cluster = sector[13];
+    uint32_t reserved = rd16(sector + 14);
+    uint32_t fats = sector[16];
+    uint32_t root_entries = rd16(sector + 17);
+    uint32_t total = rd16(sector + 19) ? rd16(sector + 19) : rd32(sector + 32);
+    uint32_t fat_size = rd16(sector + 22) ? rd16(sector + 22) : rd32(sector + 36);
+
+    vol->fat_start = reserved;
+    vol->root_start = reserved + fats * fat_size;
+    vol->root_sectors = (root_entries * 32 + vol->sector_size - 1) / vol->sector_size;
+    vol->data_start = vol->root_start + vol->root_sectors;
+    vol->cluster_count = (total - vol->data_start) / vol->sectors_per_cluster;
+    vol->fat_bits = vol->cluster_count < 4085 ? 12 : vol->cluster_count < 65525 ? 16 : 32;
+    vol->root_cluster = vol->fat_bits == 32 ? rd32(sector + 44) : 0;
+    return ESP_OK;
+}
+
+// Read FAT entry for a cluster (returns 0xFFFFFFFF at end of chain or on error)
+static uint32_t next_cluster(const fat_volume_t* vol, uint32_t cluster) {
+    uint64_t byte_offset;
+    switch (vol->fat_bits) {
+        case 12: byte_offset = cluster + cluster / 2; break;
+        case 16: byte_offset = cluster * 2; break;
+        default: byte_offset = (uint64_t)cluster * 4; break;
+    }
+
+    uint8_t buf[4] = {0};
+    uint64_t pos = vol->volume_offset + (uint64_t)vol->fat_start * vol->sector_size + byte_offset;
+    if (pread(vol->fd, buf, 4, pos) < 2) return 0xFFFFFFFF;
+
+    uint32_t value;
+    uint32_t eoc;
+    switch (vol->fat_bits) {
+        case 12:
+            value = rd16(buf);
+            value = (cluster & 1) ? value >> 4 : value & 0xFFF;
+            eoc = 0xFF8;
+            break;
+        case 16:
+            value = rd16(buf);
+            eoc = 0xFFF8;
+            break;
+        default:
+            value = rd32(buf) & 0x0FFFFFFF;
+            eoc = 0x0FFFFFF8;
+            break;
+    }
+
+    if (value < 2 || value >= eoc || value >= vol->cluster_count + 2) return 0xFFFFFFFF;
+    return value;
+}
+
+static uint64_t cluster_lba(const fat_volume_t* vol, uint32_t cluster) {
+    return vol->data_start + (uint64_t)(cluster - 2) * vol->sectors_per_cluster;
+}
+
+// Load a whole directory into memory (cluster 0 = FAT12/16 fixed root)
+static uint8_t* load_directory(const fat_volume_t* vol, uint32_t cluster, size_t* size_out) {
+    if (cluster == 0) {
+        size_t size = (size_t)vol->root_sectors * vol->sector_size;
+        uint8_t* buf = malloc(size);
+        if (!buf || !read_sectors(vol, vol->root_start, buf, vol->root_sectors)) {
+            free(buf);
+            return NULL;
+        }
+        *size_out = size;
+        return buf;
+    }
+
+    size_t cluster_bytes = (size_t)vol->sectors_per_cluster * vol->sector_size;
+    uint8_t* buf = NULL;
+    size_t size = 0;
+    for (uint32_t n = 0; cluster != 0xFFFFFFFF && n < vol->cluster_count; n++) {
+        uint8_t* grown = realloc(buf, size + cluster_bytes);
+        if (!grown) break;
+        buf = grown;
+        if (!read_sectors(vol, cluster_lba(vol, cluster), buf + size, vol->sectors_per_cluster)) break;
+        size += cluster_bytes;
+        cluster = next_cluster(vol, cluster);
+    }
+    *size_out = size;
+    return buf;
+}
+
+// Format 8.3 short name as "NAME.EXT"
+static void short_name(const uint8_t* entry, char* out) {
+    int n = 0;
+    for (int i = 0; i < 8 && entry[i] != ' '; i++) out[n++] = entry[i];
+    if (entry[8] != ' ') {
+        out[n++] = '.';
+        for (int i = 8; i < 11 && entry[i] != ' '; i++) out[n++] = entry[i];
+    }
+    out[n] = '\0';
+}
+
+// Find name in directory, returns pointer to its 32-byte entry
+static const uint8_t* find_entry(const uint8_t* dir, size_t size, const char* name, size_t name_len) {
+    char lfn[256];
+    bool have_lfn = false;
+
+    for (size_t off = 0; off + 32 <= size; off += 32) {
+        const uint8_t* e = dir + off;
+        if (e[0] == 0x00) break;
+        if (e[0] == 0xE5) {
+            have_lfn = false;
+            continue;
+        }
+
+        if (e[11] == 0x0F) {
+            // Long name fragment: 13 UCS-2 characters, stored last-first
+            int seq = (e[0] & 0x1F) - 1;
+            if (e[0] & 0x40) {
+                memset(lfn, 0, sizeof(lfn));
+                have_lfn = true;
+            }
+            static const int pos[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+            for (int i = 0; i < 13 && seq >= 0 && seq * 13 + i < 255; i++) {
+                uint16_t c = rd16(e + pos[i]);
+                lfn[seq * 13 + i] = (c == 0 || c == 0xFFFF) ? '\0' : (c < 128 ? (char)c : '?');
+            }
+            continue;
+        }
+
+        if (e[11] & 0x08) {
+            have_lfn = false;
+            continue;  // Volume label
+        }
+
+        char sfn[13];
+        short_name(e, sfn);
+        bool match = (strlen(sfn) == name_len && strncasecmp(sfn, name, name_len) == 0) ||
+                     (have_lfn && strlen(lfn) == name_len && strncasecmp(lfn, name, name_len) == 0);
+        have_lfn = false;
+        if (match) return e;
+    }
+    return NULL;
+}
+
+esp_err_t fat_image_build_map(const char* image_path, const char* path, fat_extent_map_t** map_out,
+                              uint64_t* volume_offset) {
+    int fd = open(image_path, O_RDONLY);
+    if (fd < 0) return ESP_ERR_NOT_FOUND;
+
+    fat_volume_t vol;
+    esp_err_t ret = mount_volume(&vol, fd);
+    if (ret != ESP_OK) {
+        close(fd);
+        return ret;
+    }
+
+    // Walk the path one directory at a time
+    uint32_t cluster = vol.root_cluster;
+    uint32_t file_size = 0;
+    bool is_dir = true;
+    const char* p = path;
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+
+        if (!is_dir) {
+            close(fd);
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        size_t dir_size = 0;
+        uint8_t* dir = load_directory(&vol, cluster, &dir_size);
+        const uint8_t* e = dir ? find_entry(dir, dir_size, p, len) : NULL;
+        if (!e) {
+            free(dir);
+            close(fd);
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        cluster = ((uint32_t)rd16(e + 20) << 16) | rd16(e + 26);
+        file_size = rd32(e + 28);
+        is_dir = (e[11] & 0x10) != 0;
+        free(dir);
+        p += len;
+    }
+
+    if (is_dir) {
+        close(fd);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Worst case every cluster is its own extent
+    uint32_t cluster_bytes = vol.sectors_per_cluster * vol.sector_size;
+    uint32_t max_extents = file_size / cluster_bytes + 1;
+    fat_extent_map_t* map = fat_extent_map_alloc(max_extents);
+    if (!map) {
+        close(fd);
+        return ESP_ERR_NO_MEM;
+    }
+    map->sector_size = vol.sector_size;
+    map->cluster_size = cluster_bytes;
+    map->file_size = file_size;
+
+    // Walk the cluster chain
+    uint64_t covered = 0;
+    while (cluster >= 2 && cluster != 0xFFFFFFFF && covered < file_size) {
+        if (!fat_extent_map_append(map, cluster_lba(&vol, cluster), 1, max_extents)) break;
+        covered += cluster_bytes;
+        cluster = next_cluster(&vol, cluster);
+    }
+    close(fd);
+
+    if (covered < file_size) {
+        fat_extent_map_free(map);
+        return ESP_ERR_INVALID_SIZE;  // Chain shorter than the file
+    }
+
+    *map_out = map;
+    if (volume_offset) *volume_offset = vol.volume_offset;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// AVI source over the extent map
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int fd;
+    uint64_t volume_offset;
+    fat_extent_map_t* map;
+    uint8_t* bounce;            // One sector for unaligned reads
+} image_ctx_t;
+
+static bool image_sector_read(void* arg, uint64_t lba, void* buf, uint32_t count) {
+    image_ctx_t* ctx = arg;
+    size_t len = (size_t)count * ctx->map->sector_size;
+    return pread(ctx->fd, buf, len, ctx->volume_offset + lba * ctx->map->sector_size) == (ssize_t)len;
+}
+
+static size_t image_read_sectors(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    image_ctx_t* ctx = src->ctx;
+    return fat_extent_read(ctx->map, offset, buf, count, image_sector_read, ctx);
+}
+
+// Byte-granular reads go sector by sector through the bounce buffer
+static size_t image_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    image_ctx_t* ctx = src->ctx;
+    uint32_t ss = ctx->map->sector_size;
+    if (offset >= src->size) return 0;
+    if (count > src->size - offset) count = src->size - offset;
+
+    size_t done = 0;
+    while (done < count) {
+        size_t pos = offset + done;
+        size_t in_sector = pos % ss;
+        size_t n = ss - in_sector;
+        if (n > count - done) n = count - done;
+
+        if (fat_extent_read(ctx->map, pos - in_sector, ctx->bounce, ss, image_sector_read, ctx) == 0) break;
+        memcpy((uint8_t*)buf + done, ctx->bounce + in_sector, n);
+        done += n;
+    }
+    return done;
+}
+
+static void image_close(avi_source_t* src) {
+    image_ctx_t* ctx = src->ctx;
+    close(ctx->fd);
+    fat_extent_map_free(ctx->map);
+    free(ctx->bounce);
+    free(ctx);
+}
+
+static const avi_source_ops_t image_ops = {
+    .name = "fat-image",
+    .read_at = image_read_at,
+    .read_sectors = image_read_sectors,
+    .close = image_close,
+};
+
+esp_err_t fat_image_open_source(avi_source_t* src, const char* image_path, const char* path) {
+    memset(src, 0, sizeof(avi_source_t));
+
+    image_ctx_t* ctx = calloc(1, sizeof(image_ctx_t));
+    if (!ctx) return ESP_ERR_NO_MEM;
+
+    esp_err_t ret = fat_image_build_map(image_path, path, &ctx->map, &ctx->volume_offset);
+    if (ret != ESP_OK) {
+        free(ctx);
+        return ret;
+    }
+
+    ctx->fd = open(image_path, O_RDONLY);
+    ctx->bounce = malloc(ctx->map->sector_size);
+    if (ctx->fd < 0 || !ctx->bounce) {
+        if (ctx->fd >= 0) close(ctx->fd);
+        fat_extent_map_free(ctx->map);
+        free(ctx->bounce);
+        free(ctx);
+        return ESP_FAIL;
+    }
+
+    src->ops = &image_ops;
+    src->size = ctx->map->file_size;
+    src->ctx = ctx;
+    return ESP_OK;
+}
@@ -0,0 +1,20 @@
+// FAT Image - host-side FAT12/16/32 reader for testing the extent fast path
+// Finds a file in a raw volume or MBR-partitioned card image, walks its
+// cluster chain into a fat_extent_map_t and serves it as an AVI source
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "avi_source.h"
+#include "esp_err.h"
+#include "fat_extent.h"
+
+// Build the extent map of a file inside a FAT image
+// path uses '/' separators relative to the volume root
+// *volume_offset receives the byte offset of the volume inside the image
+esp_err_t fat_image_build_map(const char* image_path, const char* path, fat_extent_map_t** map_out,
+                              uint64_t* volume_offset);
+
+// Open a file inside a FAT image as an AVI source
+// Sector reads go through the extent map as pread() calls on the image
+esp_err_t fat_image_open_source(avi_source_t* src, const char* image_path, const char* path);
@@ -0,0 +1,107 @@
+// FAT Frag - host tool that checks how a clip is laid out inside a FAT image
+// Walks the cluster chain the way the badge does at open, prints the extent
+// map and optionally compares the extent reads against a reference copy
+//
+// Usage: fatfrag [-r reference.avi] [-v] <card.img> <path/in/image.avi>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fat_image.h"
+
+#define COMPARE_BLOCK (256 * 1024)
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-r reference.avi] [-v] <card.img> <path/in/image.avi>\n", prog);
+    exit(1);
+}
+
+// Read the whole file through the extent fast path and compare with a copy
+static int compare_with(avi_source_t* src, const char* reference) {
+    FILE* f = fopen(reference, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", reference);
+        return 1;
+    }
+
+    uint8_t* a = malloc(COMPARE_BLOCK);
+    uint8_t* b = malloc(COMPARE_BLOCK);
+    size_t offset = 0;
+    int result = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (offset < src->size) {
+        size_t want = src->size - offset < COMPARE_BLOCK ? src->size - offset : COMPARE_BLOCK;
+        size_t got = src->ops->read_sectors(src, offset, a, COMPARE_BLOCK);
+        if (got != want || fread(b, 1, want, f) != want || memcmp(a, b, want) != 0) {
+            printf("Compare: MISMATCH in block at offset %zu\n", offset);
+            result = 1;
+            break;
+        }
+        offset += want;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - t0;
+
+    if (result == 0) {
+        uint8_t extra;
+        if (fread(&extra, 1, 1, f) == 1) {
+            printf("Compare: MISMATCH, reference is longer than the image file\n");
+            result = 1;
+        } else {
+            printf("Compare: identical, %zu bytes in %.1f ms\n", offset, elapsed_us / 1000.0);
+        }
+    }
+
+    free(a);
+    free(b);
+    fclose(f);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const char* reference = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:v")) != -1) {
+        switch (opt) {
+            case 'r': reference = optarg; break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind + 2 > argc) usage(argv[0]);
+    const char* image = argv[optind];
+    const char* path = argv[optind + 1];
+
+    fat_extent_map_t* map;
+    esp_err_t ret = fat_image_build_map(image, path, &map, NULL);
+    if (ret != ESP_OK) {
+        fprintf(stderr, "Failed to map %s in %s (%s)\n", path, image, esp_err_to_name(ret));
+        return 1;
+    }
+
+    printf("File:    %s (%llu bytes)\n", path, (unsigned long long)map->file_size);
+    printf("Layout:  %lu clusters of %lu bytes in %lu extent%s (%s)\n", (unsigned long)map->clusters,
+           (unsigned long)map->cluster_size, (unsigned long)map->count, map->count == 1 ? "" : "s",
+           fat_extent_map_is_contiguous(map) ? "contiguous" : "fragmented");
+    for (uint32_t i = 0; i < map->count; i++) {
+        const fat_extent_t* ext = &map->extents[i];
+        printf("  %4lu: offset %10llu  LBA %10llu  %8lu sectors (%lu KB)\n", (unsigned long)i,
+               (unsigned long long)ext->file_offset, (unsigned long long)ext->lba, (unsigned long)ext->sectors,
+               (unsigned long)((uint64_t)ext->sectors * map->sector_size / 1024));
+    }
+    fat_extent_log(map, path);
+    fat_extent_map_free(map);
+
+    if (!reference) return 0;
+
+    avi_source_t source;
+    if (fat_image_open_source(&source, image, path) != ESP_OK) {
+        fprintf(stderr, "Failed to open %s in %s\n", path, image);
+        return 1;
+    }
+    int result = compare_with(&source, reference);
+    avi_source_close(&source);
+    return result;
+}
@@ -0,0 +1,239 @@
+// Fuzz AVI - fuzz target for the AVI parser
+// Every input is parsed twice, through a mappable memory source (zero-copy
+// payloads) and through a read-only one (frame buffer copies, header resync).
+// Each pass walks all chunks, reads payloads both mapped and into a ring-slot
+// sized buffer, reads the frame index and rewinds.
+//
+// Built three ways:
+//   make -C host fuzz          libFuzzer + ASan/UBSan (needs clang):
+//                              host/build/fuzz_avi_libfuzzer host/build/fuzz_corpus
+//   CC=afl-clang-fast make -C host build/fuzz_avi
+//                              AFL: afl-fuzz -i host/build/fuzz_corpus -o findings -- host/build/fuzz_avi @@
+//   make -C host               plain replay of files, with -n a seeded byte mutator
+//                              for quick runs under -fsanitize=address without clang
+//
+// Seed corpus: make -C host fuzz-corpus (short clips cut from sdcard/*.avi)
+//
+// Usage: fuzz_avi [-n mutations] [-s seed] <file>...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "avi_parser.h"
+#include "avi_source.h"
+#include "esp_log.h"
+
+#define SLOT_SIZE           (64 * 1024 + 2 * AVI_SOURCE_SECTOR_SIZE)
+#define INDEX_ENTRIES       64
+
+// ---------------------------------------------------------------------------
+// Target
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+} input_t;
+
+// Plain read_at over the input, so the parser takes its buffered paths
+static size_t input_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    const input_t* in = src->ctx;
+    if (offset >= in->size) {
+        return 0;
+    }
+    size_t n = count < in->size - offset ? count : in->size - offset;
+    memcpy(buf, in->data + offset, n);
+    return n;
+}
+
+static void input_close(avi_source_t* src) {
+}
+
+static const avi_source_ops_t input_ops = {
+    .name = "fuzz",
+    .read_at = input_read_at,
+    .close = input_close,
+};
+
+static volatile uint32_t sink;  // Payload bytes are touched so the sanitizers see every access
+
+static void touch(const uint8_t* data, size_t size) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < size; i += 64) {
+        sum += data[i];
+    }
+    if (size > 0) {
+        sum += data[size - 1];
+    }
+    sink += sum;
+}
+
+static void parse(const uint8_t* data, size_t size, bool mappable) {
+    static uint8_t* slot;
+    if (!slot) {
+        slot = aligned_alloc(64, SLOT_SIZE);
+    }
+
+    input_t in = {data, size};
+    avi_source_t source;
+    if (mappable) {
+        avi_source_open_memory(&source, data, size);
+    } else {
+        source = (avi_source_t){.ops = &input_ops, .size = size, .ctx = &in};
+    }
+
+    avi_parser_t parser;
+    if (avi_parser_open_source(&parser, &source) != ESP_OK) {
+        return;
+    }
+    const avi_info_t* info = avi_parser_get_info(&parser);
+    sink += info->width + info->height + info->fps;
+
+    // Every chunk consumes at least its 8-byte header, more iterations means the parser is stuck
+    size_t limit = size / 8 + 2;
+    size_t chunks = 0;
+    avi_chunk_t chunk;
+    while (avi_parser_next_header(&parser, &chunk) == ESP_OK) {
+        if (++chunks > limit) {
+            fprintf(stderr, "Parser made no progress after %zu chunks\n", chunks);
+            abort();
+        }
+        bool into_slot = chunks & 1;
+        if (avi_parser_read_payload(&parser, &chunk, into_slot ? slot : NULL, into_slot ? SLOT_SIZE : 0) == ESP_OK) {
+            touch(chunk.data, chunk.size);
+        }
+        sink += avi_parser_get_progress(&parser);
+    }
+
+    static avi_index_entry_t entries[INDEX_ENTRIES];
+    uint32_t count = info->playback.frame_count < INDEX_ENTRIES ? info->playback.frame_count : INDEX_ENTRIES;
+    if (avi_parser_read_index(&parser, 0, entries, count) == ESP_OK && count > 0) {
+        sink += entries[count - 1].video_size;
+    }
+    avi_parser_read_index(&parser, info->playback.frame_count, entries, 1);     // Past the end, must fail
+
+    avi_parser_rewind(&parser);
+    if (avi_parser_next_chunk(&parser, &chunk) == ESP_OK) {
+        touch(chunk.data, chunk.size);
+    }
+    avi_parser_close(&parser);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    parse(data, size, true);
+    parse(data, size, false);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Standalone driver (replay, AFL, quick mutation runs)
+// ---------------------------------------------------------------------------
+
+#ifndef FUZZ_LIBFUZZER
+
+static uint64_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// Values that break size arithmetic
+static const uint32_t interesting[] = {0, 1, 3, 4, 7, 8, 12, 0x7FFFFFFF, 0x80000000, 0xFFFFFFF4, 0xFFFFFFF8,
+                                       0xFFFFFFFF, 16 * 1024, 100 * 1024};
+
+// A few random edits, mostly in the first 16KB where the headers live
+static size_t mutate(uint8_t* data, size_t size) {
+    int edits = 1 + rng_next() % 4;
+    for (int e = 0; e < edits && size > 8; e++) {
+        size_t span = size > 16384 && rng_next() % 4 ? 16384 : size;
+        size_t at = rng_next() % (span - 4);
+        switch (rng_next() % 5) {
+            case 0: data[at] ^= 1 << (rng_next() % 8); break;
+            case 1: data[at] = rng_next(); break;
+            case 2: {
+                uint32_t v = interesting[rng_next() % (sizeof(interesting) / sizeof(interesting[0]))];
+                memcpy(data + (at & ~(size_t)3), &v, 4);
+                break;
+            }
+            case 3: {
+                // Small size tweak around the current value (off-by-one, odd sizes)
+                uint32_t v;
+                memcpy(&v, data + (at & ~(size_t)3), 4);
+                v += (int32_t)(rng_next() % 17) - 8;
+                memcpy(data + (at & ~(size_t)3), &v, 4);
+                break;
+            }
+            case 4: size = 8 + rng_next() % (size - 8); break;     // Truncate
+        }
+    }
+    return size;
+}
+
+static uint8_t* load(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = malloc(len > 0 ? len : 1);
+    if (data && fread(data, 1, len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = len;
+    return data;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-n mutations] [-s seed] <file>...\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    long mutations = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': mutations = atol(optarg); break;
+            case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc) usage(argv[0]);
+    host_log_level = ESP_LOG_NONE;
+
+    for (int i = optind; i < argc; i++) {
+        size_t size;
+        uint8_t* data = load(argv[i], &size);
+        if (!data) {
+            return 1;
+        }
+        LLVMFuzzerTestOneInput(data, size);
+
+        // Each mutant starts from the original; rerun with the same -s to reproduce
+        uint8_t* work = malloc(size > 0 ? size : 1);
+        for (long n = 0; n < mutations; n++) {
+            memcpy(work, data, size);
+            size_t work_size = mutate(work, size);
+            // Exact-size copy so reads past the end hit the sanitizer redzone
+            uint8_t* exact = malloc(work_size > 0 ? work_size : 1);
+            memcpy(exact, work, work_size);
+            LLVMFuzzerTestOneInput(exact, work_size);
+            free(exact);
+        }
+        printf("%s: %zu bytes, %ld mutations\n", argv[i], size, mutations);
+        free(work);
+        free(data);
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,5 @@
+// Host shim runtime state
+
+#include "esp_log.h"
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
@@ -0,0 +1,2 @@
+// Host shim for sdkconfig.h - no ESP-IDF configuration on the host
+#pragma once
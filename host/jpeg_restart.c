@@ -0,0 +1,341 @@
+// JPEG Restart - lossless re-encode of baseline JPEG frames with DRI restart markers
+
+#include "jpeg_restart.h"
+#include "sw_jpeg.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Encoding table: code and length per symbol
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+    uint8_t bits[17];
+    uint8_t symbols[256];
+    int count;
+} huff_code_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t capacity;
+    uint32_t acc;                   // Pending bits, right-aligned
+    int nbits;
+    bool ok;
+} writer_t;
+
+static void put_byte(writer_t* w, uint8_t b) {
+    if (w->len == w->capacity) {
+        size_t capacity = w->capacity ? w->capacity * 2 : 65536;
+        uint8_t* data = realloc(w->data, capacity);
+        if (!data) {
+            w->ok = false;
+            return;
+        }
+        w->data = data;
+        w->capacity = capacity;
+    }
+    w->data[w->len++] = b;
+}
+
+static void put_bytes(writer_t* w, const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) put_byte(w, p[i]);
+}
+
+static void put_bits(writer_t* w, uint32_t value, int n) {
+    w->acc = (w->acc << n) | (value & ((1u << n) - 1));
+    w->nbits += n;
+    while (w->nbits >= 8) {
+        uint8_t b = (uint8_t)(w->acc >> (w->nbits - 8));
+        put_byte(w, b);
+        if (b == 0xFF) put_byte(w, 0x00);  // Byte stuffing
+        w->nbits -= 8;
+    }
+}
+
+// Pad the last byte with 1 bits
+static void flush_bits(writer_t* w) {
+    if (w->nbits > 0) put_bits(w, 0x7F, 8 - w->nbits);
+    w->acc = 0;
+}
+
+// Bits needed for the magnitude of v (the JPEG "category")
+static int category(int v) {
+    if (v < 0) v = -v;
+    int n = 0;
+    while (v) {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+// Optimal length-limited Huffman code from symbol counts (T.81 K.2)
+static void build_optimal(const uint32_t counts[256], huff_code_t* h) {
+    long freq[257];
+    int codesize[257];
+    int others[257];
+    int bits[33] = {0};
+
+    for (int i = 0; i < 256; i++) freq[i] = counts[i];
+    freq[256] = 1;  // Reserved so no real code is all ones
+    for (int i = 0; i <= 256; i++) {
+        codesize[i] = 0;
+        others[i] = -1;
+    }
+
+    for (;;) {
+        int c1 = -1, c2 = -1;
+        long v = 0x7FFFFFFF;
+        for (int i = 0; i <= 256; i++) {
+            if (freq[i] && freq[i] <= v) {
+                v = freq[i];
+                c1 = i;
+            }
+        }
+        v = 0x7FFFFFFF;
+        for (int i = 0; i <= 256; i++) {
+            if (freq[i] && freq[i] <= v && i != c1) {
+                v = freq[i];
+                c2 = i;
+            }
+        }
+        if (c2 < 0) break;
+
+        freq[c1] += freq[c2];
+        freq[c2] = 0;
+        codesize[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            codesize[c1]++;
+        }
+        others[c1] = c2;
+        codesize[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            codesize[c2]++;
+        }
+    }
+
+    for (int i = 0; i <= 256; i++) {
+        if (codesize[i]) bits[codesize[i]]++;
+    }
+
+    // Move codes longer than 16 bits up the tree
+    for (int i = 32; i > 16; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) j--;
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+    int longest = 16;
+    while (bits[longest] == 0) longest--;
+    bits[longest]--;  // Drop the reserved code
+
+    memset(h, 0, sizeof(huff_code_t));
+    for (int l = 1; l <= 16; l++) h->bits[l] = (uint8_t)bits[l];
+    for (int l = 1; l <= 32; l++) {
+        for (int s = 0; s < 256; s++) {
+            if (codesize[s] == l) h->symbols[h->count++] = (uint8_t)s;
+        }
+    }
+
+    // Canonical codes in symbol order
+    int code = 0, k = 0;
+    for (int l = 1; l <= 16; l++) {
+        for (int i = 0; i < h->bits[l]; i++, k++, code++) {
+            h->code[h->symbols[k]] = (uint16_t)code;
+            h->size[h->symbols[k]] = (uint8_t)l;
+        }
+        code <<= 1;
+    }
+}
+
+// Visit every symbol a block codes to: count it, or write it
+typedef struct {
+    uint32_t dc_counts[4][256];
+    uint32_t ac_counts[4][256];
+    huff_code_t dc[4];
+    huff_code_t ac[4];
+    bool used_dc[4], used_ac[4];
+} tables_t;
+
+static void code_block(tables_t* t, writer_t* w, const sw_jpeg_component_t* comp, const int16_t* coef, int diff) {
+    int s = category(diff);
+    if (!w) {
+        t->dc_counts[comp->dc_table][s]++;
+    } else {
+        put_bits(w, t->dc[comp->dc_table].code[s], t->dc[comp->dc_table].size[s]);
+        if (s) put_bits(w, diff < 0 ? diff - 1 : diff, s);
+    }
+
+    const huff_code_t* ac = &t->ac[comp->ac_table];
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int v = coef[k];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            if (!w) t->ac_counts[comp->ac_table][0xF0]++;
+            else put_bits(w, ac->code[0xF0], ac->size[0xF0]);
+            run -= 16;
+        }
+        s = category(v);
+        int rs = (run << 4) | s;
+        if (!w) {
+            t->ac_counts[comp->ac_table][rs]++;
+        } else {
+            put_bits(w, ac->code[rs], ac->size[rs]);
+            put_bits(w, v < 0 ? v - 1 : v, s);
+        }
+        run = 0;
+    }
+    if (run > 0) {
+        if (!w) t->ac_counts[comp->ac_table][0x00]++;
+        else put_bits(w, ac->code[0x00], ac->size[0x00]);
+    }
+}
+
+// Code every block in order, with restarts every interval MCUs (w = NULL counts symbols)
+static void code_scan(tables_t* t, writer_t* w, const sw_jpeg_t* jpeg, const int16_t* coefs, uint32_t interval) {
+    uint32_t total = (uint32_t)jpeg->mcus_x * jpeg->mcus_y;
+    int pred[SW_JPEG_MAX_COMPONENTS] = {0};
+    const int16_t* block = coefs;
+    for (uint32_t mcu = 0; mcu < total; mcu++) {
+        if (mcu > 0 && mcu % interval == 0) {
+            memset(pred, 0, sizeof(pred));
+            if (w) {
+                flush_bits(w);
+                put_byte(w, 0xFF);
+                put_byte(w, (uint8_t)(0xD0 + ((mcu / interval - 1) & 7)));
+            }
+        }
+        for (int c = 0; c < jpeg->components; c++) {
+            for (int b = 0; b < sw_jpeg_blocks_per_mcu(jpeg, c); b++, block += 64) {
+                code_block(t, w, &jpeg->comp[c], block, block[0] - pred[c]);
+                pred[c] = block[0];
+            }
+        }
+    }
+    if (w) flush_bits(w);
+}
+
+// Write the header segments of in up to SOS, without DHT and DRI, and return the SOS offset
+static size_t copy_headers(writer_t* w, const uint8_t* in, size_t in_size) {
+    put_bytes(w, in, 2);  // SOI
+    size_t pos = 2;
+    while (pos + 4 <= in_size) {
+        if (in[pos] != 0xFF) return 0;
+        uint8_t marker = in[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        size_t len = ((size_t)in[pos + 2] << 8) | in[pos + 3];
+        if (marker == 0xDA) return pos;
+        if (marker != 0xC4 && marker != 0xDD) put_bytes(w, in + pos, 2 + len);
+        pos += 2 + len;
+    }
+    return 0;
+}
+
+esp_err_t jpeg_restart_encode(const uint8_t* in, size_t in_size, int mcu_rows, uint8_t** out, size_t* out_size) {
+    if (mcu_rows <= 0) return ESP_ERR_INVALID_ARG;
+
+    sw_jpeg_t* jpeg = malloc(sizeof(sw_jpeg_t));
+    tables_t* t = calloc(1, sizeof(tables_t));
+    if (!jpeg || !t) {
+        free(jpeg);
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = sw_jpeg_parse(jpeg, in, in_size);
+
+    // Decode every block's coefficients (DC stored absolute)
+    uint32_t total = (uint32_t)jpeg->mcus_x * jpeg->mcus_y;
+    int blocks_per_mcu = 0;
+    for (int c = 0; c < jpeg->components; c++) blocks_per_mcu += sw_jpeg_blocks_per_mcu(jpeg, c);
+    int16_t* coefs = ret == ESP_OK ? malloc((size_t)total * blocks_per_mcu * 64 * sizeof(int16_t)) : NULL;
+    if (ret == ESP_OK && !coefs) ret = ESP_ERR_NO_MEM;
+
+    if (ret == ESP_OK) {
+        sw_jpeg_bits_t bits;
+        sw_jpeg_bits_init(&bits, jpeg->scan, jpeg->scan + jpeg->scan_size);
+        int pred[SW_JPEG_MAX_COMPONENTS] = {0};
+        int16_t* block = coefs;
+        for (uint32_t mcu = 0; mcu < total && ret == ESP_OK; mcu++) {
+            if (jpeg->restart_interval && mcu > 0 && mcu % jpeg->restart_interval == 0) {
+                sw_jpeg_bits_restart(&bits);
+                memset(pred, 0, sizeof(pred));
+            }
+            for (int c = 0; c < jpeg->components && ret == ESP_OK; c++) {
+                for (int b = 0; b < sw_jpeg_blocks_per_mcu(jpeg, c); b++, block += 64) {
+                    if (!sw_jpeg_decode_coefficients(jpeg, &bits, c, &pred[c], block)) {
+                        ret = ESP_ERR_INVALID_RESPONSE;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    writer_t w = {.ok = true};
+    size_t sos = ret == ESP_OK ? copy_headers(&w, in, in_size) : 0;
+    if (ret == ESP_OK && sos == 0) ret = ESP_ERR_INVALID_SIZE;
+
+    if (ret == ESP_OK) {
+        uint32_t interval = (uint32_t)mcu_rows * jpeg->mcus_x;
+        if (interval > 0xFFFF) interval = 0xFFFF;
+
+        // Count symbols, then build tables for the ones this frame uses
+        code_scan(t, NULL, jpeg, coefs, interval);
+        for (int c = 0; c < jpeg->components; c++) {
+            t->used_dc[jpeg->comp[c].dc_table] = true;
+            t->used_ac[jpeg->comp[c].ac_table] = true;
+        }
+
+        // DHT with all tables
+        size_t dht = w.len;
+        put_bytes(&w, (const uint8_t[]){0xFF, 0xC4, 0, 0}, 4);
+        for (int cls = 0; cls < 2; cls++) {
+            for (int id = 0; id < 4; id++) {
+                if (!(cls ? t->used_ac[id] : t->used_dc[id])) continue;
+                huff_code_t* h = cls ? &t->ac[id] : &t->dc[id];
+                build_optimal(cls ? t->ac_counts[id] : t->dc_counts[id], h);
+                put_byte(&w, (uint8_t)(cls << 4 | id));
+                put_bytes(&w, h->bits + 1, 16);
+                put_bytes(&w, h->symbols, h->count);
+            }
+        }
+        if (w.ok) {
+            size_t len = w.len - dht - 2;
+            w.data[dht + 2] = (uint8_t)(len >> 8);
+            w.data[dht + 3] = (uint8_t)len;
+        }
+
+        // DRI, the original SOS header, then the new scan
+        put_bytes(&w, (const uint8_t[]){0xFF, 0xDD, 0, 4, (uint8_t)(interval >> 8), (uint8_t)interval}, 6);
+        size_t sos_len = ((size_t)in[sos + 2] << 8) | in[sos + 3];
+        put_bytes(&w, in + sos, 2 + sos_len);
+        code_scan(t, &w, jpeg, coefs, interval);
+        put_bytes(&w, (const uint8_t[]){0xFF, 0xD9}, 2);
+        if (!w.ok) ret = ESP_ERR_NO_MEM;
+    }
+
+    free(coefs);
+    free(jpeg);
+    free(t);
+    if (ret != ESP_OK) {
+        free(w.data);
+        return ret;
+    }
+    *out = w.data;
+    *out_size = w.len;
+    return ESP_OK;
+}
@@ -0,0 +1,13 @@
+// JPEG Restart - lossless re-encode of baseline JPEG frames with DRI restart markers
+// The coefficients are kept as they are; only the entropy coding is redone,
+// with a restart marker every few MCU rows and Huffman tables optimized for
+// the frame, so the badge's software decoder can split it into strips
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Re-encode in (in_size bytes) with a restart interval of mcu_rows MCU rows
+// On success *out is a malloc'd JPEG of *out_size bytes, to be freed by the caller
+esp_err_t jpeg_restart_encode(const uint8_t* in, size_t in_size, int mcu_rows, uint8_t** out, size_t* out_size);
@@ -0,0 +1,232 @@
+// JPEG Strips - host check of restart-marker encoding and strip decoding
+// Re-encodes each video frame with restart markers, decodes it as strips on
+// several threads (rotated into a framebuffer layout like the badge does)
+// and compares the pixels with a plain single-threaded decode of the original.
+// The 1/8 scale DC-only decode is checked against 8x8 block means of it
+//
+// Usage: jpeg_strips [-d mcu_rows] [-t threads] [-n frames] [-o frame.ppm] [-f frame] <file.avi>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "avi_frames.h"
+#include "avi_parser.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "jpeg_restart.h"
+#include "sw_jpeg.h"
+
+#define MAX_THREADS 8
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-d mcu_rows] [-t threads] [-n frames] [-o frame.ppm] [-f frame] <file.avi>\n",
+            prog);
+    exit(1);
+}
+
+typedef struct {
+    const sw_jpeg_t* jpeg;
+    sw_jpeg_output_t out;
+    uint32_t first, count;
+    esp_err_t ret;
+} strip_job_t;
+
+static void* strip_thread(void* arg) {
+    strip_job_t* job = arg;
+    job->ret = sw_jpeg_decode_strips(job->jpeg, job->first, job->count, &job->out);
+    return NULL;
+}
+
+// Decode on up to threads threads, strips split evenly
+static esp_err_t decode_parallel(const sw_jpeg_t* jpeg, const sw_jpeg_output_t* out, int threads) {
+    if (threads > (int)jpeg->strip_count) threads = jpeg->strip_count;
+    pthread_t tid[MAX_THREADS];
+    strip_job_t jobs[MAX_THREADS];
+    uint32_t next = 0;
+    for (int i = 0; i < threads; i++) {
+        uint32_t end = (uint32_t)((uint64_t)jpeg->strip_count * (i + 1) / threads);
+        jobs[i] = (strip_job_t){jpeg, *out, next, end - next, ESP_OK};
+        next = end;
+        if (i > 0) pthread_create(&tid[i], NULL, strip_thread, &jobs[i]);
+    }
+    strip_thread(&jobs[0]);
+    esp_err_t ret = jobs[0].ret;
+    for (int i = 1; i < threads; i++) {
+        pthread_join(tid[i], NULL);
+        if (jobs[i].ret != ESP_OK) ret = jobs[i].ret;
+    }
+    return ret;
+}
+
+static void write_ppm(const char* path, const uint8_t* bgr, int width, int height) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return;
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    for (int i = 0; i < width * height; i++) {
+        uint8_t rgb[3] = {bgr[i * 3 + 2], bgr[i * 3 + 1], bgr[i * 3]};
+        fwrite(rgb, 1, 3, f);
+    }
+    fclose(f);
+}
+
+int main(int argc, char** argv) {
+    int rows = 1;
+    int threads = 2;
+    uint32_t max_frames = 0;
+    const char* ppm_path = NULL;
+    uint32_t ppm_frame = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:n:o:f:")) != -1) {
+        switch (opt) {
+            case 'd': rows = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'n': max_frames = strtoul(optarg, NULL, 0); break;
+            case 'o': ppm_path = optarg; break;
+            case 'f': ppm_frame = strtoul(optarg, NULL, 0); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc || rows < 1 || threads < 1 || threads > MAX_THREADS) usage(argv[0]);
+    const char* path = argv[optind];
+
+    avi_source_t source;
+    avi_parser_t parser;
+    avi_frames_t frames;
+    if (avi_source_open_mmap(&source, path) != ESP_OK || avi_parser_open_source(&parser, &source) != ESP_OK ||
+        avi_frames_load(&parser, &frames) != ESP_OK) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+    if (max_frames == 0 || max_frames > frames.frames) max_frames = frames.frames;
+
+    sw_jpeg_t* jpeg = malloc(sizeof(sw_jpeg_t));
+    uint8_t* frame = NULL;
+    size_t frame_cap = 0;
+    uint8_t* reference = NULL;
+    uint8_t* rotated = NULL;
+    uint8_t* reduced = NULL;
+    size_t pixels_cap = 0;
+
+    uint64_t in_bytes = 0, out_bytes = 0;
+    int64_t plain_us = 0, strips_us = 0, reduced_us = 0;
+    uint32_t strips_total = 0, mismatches = 0, failures = 0, empty = 0;
+    uint64_t reduced_error = 0, reduced_samples = 0;
+    int reduced_worst = 0;
+
+    for (uint32_t i = 0; i < max_frames; i++) {
+        const avi_span_t* v = &frames.video[i];
+        if (v->size == 0) {
+            empty++;                // Repeats the previous frame
+            continue;
+        }
+        if (v->size > frame_cap) {
+            frame_cap = v->size * 2;
+            frame = realloc(frame, frame_cap);
+        }
+        if (!avi_source_read(&parser.source, v->offset, frame, v->size) ||
+            sw_jpeg_parse(jpeg, frame, v->size) != ESP_OK) {
+            failures++;
+            continue;
+        }
+
+        int w = jpeg->width, h = jpeg->height;
+        size_t pixels = (size_t)w * h * 3;
+        if (pixels > pixels_cap) {
+            pixels_cap = pixels;
+            reference = realloc(reference, pixels);
+            rotated = realloc(rotated, pixels);
+            reduced = realloc(reduced, pixels);
+        }
+
+        // Reference: whole frame, one thread, row-major
+        sw_jpeg_output_t plain = sw_jpeg_output_rows(reference, w * 3);
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t ret = sw_jpeg_decode_strips(jpeg, 0, jpeg->strip_count, &plain);
+        plain_us += esp_timer_get_time() - t0;
+
+        uint8_t* encoded = NULL;
+        size_t encoded_size = 0;
+        if (ret != ESP_OK || jpeg_restart_encode(frame, v->size, rows, &encoded, &encoded_size) != ESP_OK ||
+            sw_jpeg_parse(jpeg, encoded, encoded_size) != ESP_OK) {
+            failures++;
+            free(encoded);
+            continue;
+        }
+        in_bytes += v->size;
+        out_bytes += encoded_size;
+        strips_total += jpeg->strip_count;
+
+        // Strips in parallel, rotated 270 degrees as in the badge's framebuffer
+        // (source row y becomes column h-1-y, source column x becomes row x)
+        sw_jpeg_output_t rot = {rotated + (size_t)(h - 1) * 3, h * 3, -3};
+        t0 = esp_timer_get_time();
+        ret = decode_parallel(jpeg, &rot, threads);
+        strips_us += esp_timer_get_time() - t0;
+
+        bool same = ret == ESP_OK;
+        for (int y = 0; y < h && same; y++) {
+            for (int x = 0; x < w && same; x++) {
+                const uint8_t* expect = reference + ((size_t)y * w + x) * 3;
+                same = memcmp(expect, rotated + ((size_t)x * h + (h - 1 - y)) * 3, 3) == 0;
+            }
+        }
+        if (!same) mismatches++;
+
+        // 1/8 scale of the restart-marker stream against the block means of the reference
+        int rw = sw_jpeg_reduced_size(w), rh = sw_jpeg_reduced_size(h);
+        sw_jpeg_output_t small = sw_jpeg_output_rows(reduced, rw * 3);
+        t0 = esp_timer_get_time();
+        ret = sw_jpeg_decode_reduced(jpeg, &small);
+        reduced_us += esp_timer_get_time() - t0;
+        free(encoded);
+        if (ret != ESP_OK) {
+            mismatches++;
+            continue;
+        }
+        for (int by = 0; by < rh; by++) {
+            for (int bx = 0; bx < rw; bx++) {
+                for (int c = 0; c < 3; c++) {
+                    int sum = 0, n = 0;
+                    for (int y = by * 8; y < by * 8 + 8 && y < h; y++) {
+                        for (int x = bx * 8; x < bx * 8 + 8 && x < w; x++, n++) {
+                            sum += reference[((size_t)y * w + x) * 3 + c];
+                        }
+                    }
+                    int diff = abs(reduced[((size_t)by * rw + bx) * 3 + c] - (sum + n / 2) / n);
+                    reduced_error += diff;
+                    reduced_samples++;
+                    if (diff > reduced_worst) reduced_worst = diff;
+                }
+            }
+        }
+
+        if (ppm_path && i == ppm_frame) {
+            write_ppm(ppm_path, reference, w, h);
+        }
+    }
+
+    uint32_t done = max_frames - failures - empty;
+    printf("File:    %s, %lu frames checked\n", path, (unsigned long)done);
+    if (done > 0) {
+        printf("Size:    %llu -> %llu bytes (%+.1f%%) with restart every %d MCU row(s), %.1f strips/frame\n",
+               (unsigned long long)in_bytes, (unsigned long long)out_bytes,
+               in_bytes ? 100.0 * ((double)out_bytes - in_bytes) / in_bytes : 0.0, rows, (double)strips_total / done);
+        printf("Decode:  %.2f ms/frame plain, %.2f ms/frame in strips on %d threads (rotated)\n",
+               plain_us / 1000.0 / done, strips_us / 1000.0 / done, threads);
+        printf("Reduced: %.2f ms/frame at 1/8 scale, %.2f mean / %d worst difference to block means\n",
+               reduced_us / 1000.0 / done, reduced_samples ? (double)reduced_error / reduced_samples : 0.0,
+               reduced_worst);
+    }
+    printf("Result:  %lu mismatches, %lu failures\n", (unsigned long)mismatches, (unsigned long)failures);
+
+    free(jpeg);
+    free(frame);
+    free(reference);
+    free(rotated);
+    free(reduced);
+    avi_frames_free(&frames);
+    avi_parser_close(&parser);
+    return mismatches || failures ? 2 : 0;
+}
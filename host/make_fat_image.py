@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Build a FAT32 card image holding the given clips, optionally fragmented.
+
+Used to exercise the extent-map fast path on the host:
+
+    host/make_fat_image.py --fragment 4 card.img apps/at.cavac.hhgg sdcard/at.cavac.hhgg/*.avi
+    host/build/fatfrag -r sdcard/at.cavac.hhgg/earth.avi card.img apps/at.cavac.hhgg/earth.avi
+
+With --fragment N the files are allocated round-robin in runs of N clusters,
+the way a card fills up when several files are copied at the same time.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+SECTOR = 512
+RESERVED = 32
+FAT_EOC = 0x0FFFFFFF
+
+
+def lfn_checksum(short):
+    s = 0
+    for c in short:
+        s = (((s & 1) << 7) + (s >> 1) + c) & 0xFF
+    return s
+
+
+def short_name(name, index):
+    """8.3 name for a directory entry, and whether a long name is needed."""
+    base, _, ext = name.rpartition('.') if '.' in name else (name, '', '')
+    clean = lambda s: ''.join(c for c in s.upper() if c.isalnum() or c in '_-~')
+    b, e = clean(base), clean(ext)[:3]
+    needs_lfn = name != name.upper() or len(base) > 8 or len(ext) > 3 or b != base.upper() or name.count('.') > 1
+    if needs_lfn:
+        b = b[:6] + '~%d' % index
+    return (b.ljust(8)[:8] + e.ljust(3)).encode('ascii'), needs_lfn
+
+
+def dir_entries(name, attr, cluster, size, index):
+    short, needs_lfn = short_name(name, index)
+    out = b''
+    if needs_lfn:
+        chars = [ord(c) for c in name] + [0]
+        chars += [0xFFFF] * (-len(chars) % 13)
+        parts = [chars[i:i + 13] for i in range(0, len(chars), 13)]
+        csum = lfn_checksum(short)
+        for seq in range(len(parts), 0, -1):
+            p = parts[seq - 1]
+            e = bytearray(32)
+            e[0] = seq | (0x40 if seq == len(parts) else 0)
+            e[11] = 0x0F
+            e[13] = csum
+            struct.pack_into('<5H', e, 1, *p[0:5])
+            struct.pack_into('<6H', e, 14, *p[5:11])
+            struct.pack_into('<2H', e, 28, *p[11:13])
+            out += bytes(e)
+    e = bytearray(32)
+    e[0:11] = short
+    e[11] = attr
+    struct.pack_into('<HHI', e, 20, cluster >> 16, 0, 0)
+    struct.pack_into('<HI', e, 26, cluster & 0xFFFF, size)
+    return out + bytes(e)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--fragment', type=int, default=0, metavar='N', help='interleave files in runs of N clusters')
+    ap.add_argument('--cluster-kb', type=int, default=4, help='cluster size in KB (default 4)')
+    ap.add_argument('--size-mb', type=int, default=0, help='volume size (default: just large enough for FAT32)')
+    ap.add_argument('--mbr', action='store_true', help='wrap the volume in an MBR partition table like a card')
+    ap.add_argument('image')
+    ap.add_argument('directory', help='destination directory inside the image, e.g. apps/at.cavac.hhgg')
+    ap.add_argument('files', nargs='+')
+    args = ap.parse_args()
+
+    spc = args.cluster_kb * 1024 // SECTOR
+    cluster_bytes = spc * SECTOR
+    sizes = [os.path.getsize(f) for f in args.files]
+    dirs = [d for d in args.directory.strip('/').split('/') if d]
+
+    need_clusters = sum((s + cluster_bytes - 1) // cluster_bytes for s in sizes) + len(dirs) + 1
+    clusters = max(need_clusters + 64, 65600)  # FAT32 needs at least 65525 clusters
+    if args.size_mb:
+        clusters = max(clusters, args.size_mb * 1024 * 1024 // cluster_bytes)
+    fat_sectors = ((clusters + 2) * 4 + SECTOR - 1) // SECTOR
+    total = RESERVED + 2 * fat_sectors + clusters * spc
+    data_start = RESERVED + 2 * fat_sectors
+    fat = [0] * (clusters + 2)
+    fat[0], fat[1] = 0x0FFFFFF8, FAT_EOC
+
+    next_free = [2]
+
+    def alloc(count, chain):
+        for _ in range(count):
+            c = next_free[0]
+            next_free[0] += 1
+            if chain:
+                fat[chain[-1]] = c
+            fat[c] = FAT_EOC
+            chain.append(c)
+
+    # Root and one cluster per directory level
+    dir_chains = [[] for _ in range(len(dirs) + 1)]
+    for chain in dir_chains:
+        alloc(1, chain)
+
+    # File data, sequential or interleaved
+    chains = [[] for _ in args.files]
+    remaining = [(s + cluster_bytes - 1) // cluster_bytes for s in sizes]
+    while any(remaining):
+        for i, left in enumerate(remaining):
+            n = left if args.fragment <= 0 else min(left, args.fragment)
+            alloc(n, chains[i])
+            remaining[i] -= n
+
+    offset = 2048 * SECTOR if args.mbr else 0
+    with open(args.image, 'wb') as img:
+        img.truncate(offset + total * SECTOR)
+
+        def write_at(lba, data):
+            img.seek(offset + lba * SECTOR)
+            img.write(data)
+
+        def cluster_lba(c):
+            return data_start + (c - 2) * spc
+
+        if args.mbr:
+            mbr = bytearray(SECTOR)
+            struct.pack_into('<B3xB3xII', mbr, 446, 0x00, 0x0C, 2048, total)
+            mbr[510:512] = b'\x55\xAA'
+            img.seek(0)
+            img.write(mbr)
+
+        boot = bytearray(SECTOR)
+        boot[0:3] = b'\xEB\x58\x90'
+        boot[3:11] = b'MSWIN4.1'
+        struct.pack_into('<HBHBHHBHHHII', boot, 11, SECTOR, spc, RESERVED, 2, 0, 0, 0xF8, 0, 63, 255,
+                         2048 if args.mbr else 0, total)
+        struct.pack_into('<IHHIHH', boot, 36, fat_sectors, 0, 0, 2, 1, 6)
+        struct.pack_into('<BBBI11s8s', boot, 64, 0x80, 0, 0x29, 0x1234ABCD, b'NO NAME    ', b'FAT32   ')
+        boot[510:512] = b'\x55\xAA'
+        fsinfo = bytearray(SECTOR)
+        struct.pack_into('<I', fsinfo, 0, 0x41615252)
+        struct.pack_into('<III', fsinfo, 484, 0x61417272, clusters + 2 - next_free[0], next_free[0])
+        struct.pack_into('<I', fsinfo, 508, 0xAA550000)
+        write_at(0, boot)
+        write_at(1, fsinfo)
+        write_at(6, boot)
+        write_at(7, fsinfo)
+
+        fat_bytes = struct.pack('<%dI' % len(fat), *fat)
+        write_at(RESERVED, fat_bytes)
+        write_at(RESERVED + fat_sectors, fat_bytes)
+
+        # Directory tree: each level holds the next, the last holds the files
+        for level, chain in enumerate(dir_chains):
+            data = b''
+            if level > 0:
+                parent = dir_chains[level - 1][0] if level > 1 else 0
+                for name, cluster in ((b'.          ', chain[0]), (b'..         ', parent)):
+                    e = bytearray(32)
+                    e[0:11] = name
+                    e[11] = 0x10
+                    struct.pack_into('<H', e, 26, cluster)
+                    data += bytes(e)
+            if level < len(dirs):
+                data += dir_entries(dirs[level], 0x10, dir_chains[level + 1][0], 0, 1)
+            else:
+                for i, f in enumerate(args.files):
+                    data += dir_entries(os.path.basename(f), 0x20, chains[i][0] if chains[i] else 0, sizes[i], i + 1)
+            if len(data) > cluster_bytes:
+                sys.exit('too many files for one directory cluster')
+            write_at(cluster_lba(chain[0]), data)
+
+        # File contents, cluster by cluster
+        for i, f in enumerate(args.files):
+            with open(f, 'rb') as src:
+                for c in chains[i]:
+                    write_at(cluster_lba(c), src.read(cluster_bytes))
+
+    print('%s: %d MB FAT32, %d KB clusters, %d files%s' % (
+        args.image, (offset + total * SECTOR) >> 20, args.cluster_kb, len(args.files),
+        ', fragmented in runs of %d clusters' % args.fragment if args.fragment > 0 else ''))
+
+
+if __name__ == '__main__':
+    main()
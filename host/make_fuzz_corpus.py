@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Cut a small AVI fuzzing seed corpus out of the player's clips.
+
+Each clip is cut after its first few video frames. Everything before the cut
+is kept byte for byte (headers, sector padding, chunk offsets), the RIFF and
+movi sizes are patched to the new length, and for files from our muxer the
+hhix frame index is re-appended with the matching entries and hhgi updated to
+point at it. A second seed per clip is the plain truncated prefix, with the
+sizes still claiming the whole file.
+
+    host/make_fuzz_corpus.py host/build/fuzz_corpus sdcard/at.cavac.hhgg/*.avi
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+HHGI = b'hhgi'
+HHIX = b'hhix'
+INDEX_ENTRY = struct.Struct('<4I')
+
+
+def chunks(data, start, end):
+    """Yield (offset, fourcc, size) for the chunks in data[start:end]."""
+    pos = start
+    while pos + 8 <= end:
+        fourcc, size = data[pos:pos + 4], struct.unpack_from('<I', data, pos + 4)[0]
+        yield pos, fourcc, size
+        pos += 8 + size + (size & 1)
+
+
+def cut(data, frames):
+    """The clip cut after `frames` video frames, or None if it is not an AVI."""
+    if data[:4] != b'RIFF' or data[8:12] != b'AVI ':
+        return None
+    movi = hhix = None
+    for pos, fourcc, size in chunks(data, 12, len(data)):
+        if fourcc == b'LIST' and data[pos + 8:pos + 12] == b'movi':
+            movi = pos
+        elif fourcc == HHIX:
+            hhix = (pos, size)
+    if movi is None:
+        return None
+
+    movi_size = struct.unpack_from('<I', data, movi + 4)[0]
+    end, seen = movi + 12, 0
+    for pos, fourcc, size in chunks(data, movi + 12, min(movi + 8 + movi_size, len(data))):
+        end = pos + 8 + size + (size & 1)
+        if fourcc[2:] in (b'dc', b'db'):
+            seen += 1
+            if seen == frames:
+                break
+
+    out = bytearray(data[:end])
+    struct.pack_into('<I', out, movi + 4, end - movi - 8)
+
+    # Our muxer's frame index: keep the entries for the frames that are left
+    info = data.find(HHGI, 12, movi)
+    if hhix and info > 0:
+        entries = data[hhix[0] + 8:hhix[0] + 8 + seen * INDEX_ENTRY.size]
+        index_offset = len(out)
+        out += HHIX + struct.pack('<I', len(entries)) + entries
+        struct.pack_into('<I', out, info + 8 + 8, seen)            # frame_count
+        struct.pack_into('<I', out, info + 8 + 20, index_offset)   # index_offset
+
+    struct.pack_into('<I', out, 4, len(out) - 8)
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('output', help='corpus directory to write')
+    ap.add_argument('clips', nargs='+', help='AVI files to cut seeds from')
+    ap.add_argument('--frames', type=int, default=2, help='video frames to keep per seed (default 2)')
+    args = ap.parse_args()
+
+    os.makedirs(args.output, exist_ok=True)
+    for path in args.clips:
+        with open(path, 'rb') as f:
+            data = f.read()
+        seed = cut(data, args.frames)
+        if seed is None:
+            print('%s: not an AVI with a movi list, skipped' % path, file=sys.stderr)
+            continue
+        name = os.path.splitext(os.path.basename(path))[0]
+        with open(os.path.join(args.output, name + '.avi'), 'wb') as f:
+            f.write(seed)
+        with open(os.path.join(args.output, name + '-truncated.avi'), 'wb') as f:
+            f.write(data[:len(seed) * 3 // 4])
+        print('%s: %d byte seed, %d byte truncated seed' % (path, len(seed), len(seed) * 3 // 4))
+
+
+if __name__ == '__main__':
+    main()
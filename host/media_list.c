@@ -0,0 +1,99 @@
+// Media List - host tool that lists a video directory like the player's menu
+// Runs the badge's media scanner with its header cache, then applies the
+// directory's playlist.json; run it twice to see the second pass served from
+// the cache
+//
+// Usage: media_list [-c cache] [-p playlist.json] [-x skip.avi] [-v] <dir>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "media_loader.h"
+#include "media_scan.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-c cache] [-p playlist.json] [-x skip.avi] [-v] <dir>\n", prog);
+    exit(1);
+}
+
+// FourCC as text, '.' for unprintable bytes
+static void fourcc_text(uint32_t fourcc, char* text) {
+    for (int i = 0; i < 4; i++) {
+        char c = (char)(fourcc >> (8 * i));
+        text[i] = c >= 32 && c < 127 ? c : '.';
+    }
+    text[4] = '\0';
+}
+
+int main(int argc, char** argv) {
+    const char* cache = NULL;
+    const char* json = NULL;
+    const char* skip = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:p:x:v")) != -1) {
+        switch (opt) {
+            case 'c': cache = optarg; break;
+            case 'p': json = optarg; break;
+            case 'x': skip = optarg; break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc) usage(argv[0]);
+    const char* dir = argv[optind];
+
+    char default_cache[256];
+    if (!cache) {
+        snprintf(default_cache, sizeof(default_cache), "%s/media.bin", dir);
+        cache = default_cache;
+    }
+    char default_json[256];
+    if (!json) {
+        snprintf(default_json, sizeof(default_json), "%s/playlist.json", dir);
+        json = default_json;
+    }
+
+    static playlist_t playlist;
+    int64_t t0 = esp_timer_get_time();
+    if (media_scan(dir, cache, skip, &playlist) != ESP_OK) {
+        fprintf(stderr, "Failed to scan %s\n", dir);
+        return 1;
+    }
+    playlist_load(json, &playlist);
+    int64_t elapsed_us = esp_timer_get_time() - t0;
+
+    for (int i = 0; i < playlist_count(&playlist); i++) {
+        const video_entry_t* entry = playlist_get(&playlist, i);
+        const media_info_t* info = &entry->info;
+        char codec[5];
+        fourcc_text(info->video_codec, codec);
+        printf("%-20s %-20s %3lu:%02lu.%03lu  %ux%u %s", entry->video_file, entry->display_name,
+               (unsigned long)(info->duration_ms / 60000), (unsigned long)(info->duration_ms / 1000 % 60),
+               (unsigned long)(info->duration_ms % 1000), info->width, info->height, codec);
+        if (info->audio_format) {
+            printf("  audio 0x%04x %lu Hz %u ch", info->audio_format, (unsigned long)info->audio_sample_rate,
+                   info->audio_channels);
+        } else {
+            printf("  no audio");
+        }
+        if (info->peak_kbps) {
+            printf("  peak %lu kbit/s", (unsigned long)info->peak_kbps);
+        } else {
+            printf("  peak unknown");
+        }
+        printf("%s\n", info->indexed_frames ? "  indexed" : "");
+        for (int c = 0; c < entry->chapter_count; c++) {
+            uint32_t ms = entry->chapters[c].start_ms;
+            printf("    %3lu:%02lu.%03lu  %s\n", (unsigned long)(ms / 60000), (unsigned long)(ms / 1000 % 60),
+                   (unsigned long)(ms % 1000), entry->chapters[c].title);
+        }
+    }
+    printf("%s\n", playlist.title);
+    printf("%d videos in %.1f ms, list uses %zu bytes (cache %s)\n", playlist.video_count, elapsed_us / 1000.0,
+           playlist_memory(&playlist), cache);
+    playlist_free(&playlist);
+    return 0;
+}
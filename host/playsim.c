@@ -0,0 +1,674 @@
+// Play Sim - deterministic playback simulator with a virtual clock
+// Runs the firmware's demux ring and frame scheduler (main/playback.c) and the
+// real parser against an AVI on disk, with the card, JPEG decode, framebuffer
+// copy, blit, vsync and the audio task replaced by cost models on one virtual
+// clock. The main loop mirrors app_main's PLAYING state (process frame, vsync
+// wait, blit, 1-tick delay), so buffering constants can be tuned and
+// regression-tested in seconds without a badge.
+//
+// Costs are distributions in microseconds, components joined with '+':
+//   const:V  uniform:A:B  normal:MEAN:SD  lognormal:MEDIAN:SIGMA
+//   spike:P:V (adds V with probability P)  per_kb:V (adds V per KB handled)
+// e.g. -S 'lognormal:400:0.5+per_kb:45+spike:0.002:80000' for a card with rare
+// 80 ms stalls. The same seed gives the same run.
+//
+// Prints the playback stats summary, drops/repeats, sync error and audio
+// underruns; -o writes buffer occupancy over time as CSV. -x exits with 2 when
+// more than max_drops frames were dropped or audio ran dry (for regression
+// scripts; the scheduler normally drops frame 0 because the clock starts at
+// the audio already written into the DMA buffer).
+//
+// -R plays at a speed in percent: the clock runs scaled, frames are skipped at
+// the demux as on the badge, and each MP3 frame plays for 100/speed of its
+// duration (add the time stretcher's cost to -A).
+//
+// -T rate:at_ms:hold_ms holds a trick play key: at_ms into playback the audio
+// stops and the scan starts (negative rate rewinds; from PLAYBACK_TRICK_REDUCED
+// on, frames cost -E instead of -D), after hold_ms playback seeks back to the
+// frame on screen and restarts the audio there, as on the badge.
+//
+// Usage: playsim [-r ring_frames] [-c chunks_per_step] [-p prebuffer_ms] [-q audio_queue]
+//                [-S sd] [-D decode] [-C copy] [-B blit] [-V vsync] [-A audio_decode]
+//                [-l audio_dma_ms] [-t tick_us] [-R speed] [-s seed] [-o occupancy.csv] [-i interval_ms]
+//                [-T rate:at_ms:hold_ms] [-E reduced_decode] [-x max_drops] [-v] <file.avi>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "avi_parser.h"
+#include "avi_source.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "mp3_frame.h"
+#include "play_stats.h"
+#include "playback.h"
+
+#define MAX_COMPONENTS      8
+#define AUDIO_QUEUE_MAX     256
+#define AUDIO_PUSH_WAIT_US  5000        // audio_player_push_chunk() blocks this long on a full queue
+#define AUDIO_WAIT_STEP_US  250
+#define VSYNC_TIMEOUT_US    50000       // xSemaphoreTake(vsync_sem, 50 ms)
+
+// ---------------------------------------------------------------------------
+// Cost distributions
+// ---------------------------------------------------------------------------
+
+typedef enum { DIST_CONST, DIST_UNIFORM, DIST_NORMAL, DIST_LOGNORMAL, DIST_SPIKE, DIST_PER_KB } dist_kind_t;
+
+typedef struct {
+    dist_kind_t kind;
+    double a, b;
+} dist_component_t;
+
+typedef struct {
+    dist_component_t parts[MAX_COMPONENTS];
+    int count;
+} dist_t;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+// xorshift64*, the same sequence for the same seed on every host
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static double rng_uniform(void) {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_normal(void) {
+    double u = rng_uniform();
+    double v = rng_uniform();
+    return sqrt(-2.0 * log(u > 0 ? u : 1e-300)) * cos(2 * M_PI * v);
+}
+
+static int dist_parse(const char* spec, dist_t* dist) {
+    static const struct {
+        const char* name;
+        dist_kind_t kind;
+        int args;
+    } kinds[] = {
+        {"const", DIST_CONST, 1},     {"uniform", DIST_UNIFORM, 2}, {"normal", DIST_NORMAL, 2},
+        {"lognormal", DIST_LOGNORMAL, 2}, {"spike", DIST_SPIKE, 2}, {"per_kb", DIST_PER_KB, 1},
+    };
+    char buf[256];
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    dist->count = 0;
+
+    char* save = NULL;
+    for (char* part = strtok_r(buf, "+", &save); part; part = strtok_r(NULL, "+", &save)) {
+        if (dist->count == MAX_COMPONENTS) {
+            return -1;
+        }
+        char* colon = strchr(part, ':');
+        if (!colon) {
+            return -1;
+        }
+        *colon = 0;
+        dist_component_t* c = &dist->parts[dist->count];
+        int args = -1;
+        for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+            if (strcmp(part, kinds[k].name) == 0) {
+                c->kind = kinds[k].kind;
+                args = kinds[k].args;
+            }
+        }
+        if (args < 0) {
+            return -1;
+        }
+        char* end = NULL;
+        c->a = strtod(colon + 1, &end);
+        c->b = 0;
+        if (args == 2) {
+            if (*end != ':') {
+                return -1;
+            }
+            c->b = strtod(end + 1, &end);
+        }
+        if (*end != 0) {
+            return -1;
+        }
+        dist->count++;
+    }
+    return dist->count > 0 ? 0 : -1;
+}
+
+// One sample in microseconds for an operation on bytes of data
+static int64_t dist_sample(const dist_t* dist, size_t bytes) {
+    double us = 0;
+    for (int i = 0; i < dist->count; i++) {
+        const dist_component_t* c = &dist->parts[i];
+        switch (c->kind) {
+            case DIST_CONST: us += c->a; break;
+            case DIST_UNIFORM: us += c->a + (c->b - c->a) * rng_uniform(); break;
+            case DIST_NORMAL: us += c->a + c->b * rng_normal(); break;
+            case DIST_LOGNORMAL: us += c->a * exp(c->b * rng_normal()); break;
+            case DIST_SPIKE: us += rng_uniform() < c->a ? c->b : 0; break;
+            case DIST_PER_KB: us += c->a * bytes / 1024.0; break;
+        }
+    }
+    return us > 0 ? (int64_t)(us + 0.5) : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Virtual clock and models
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    dist_t sd, decode, reduced_decode, copy, blit, vsync, audio_decode;
+    int64_t audio_dma_us;       // Audio the I2S DMA buffers hold
+    int64_t tick_us;            // FreeRTOS tick (vTaskDelay granularity)
+    int audio_queue_length;
+    int speed;                  // Percent of normal tempo
+    int trick_rate;             // Trick play from trick_at_us for trick_hold_us, 0 = none
+    int64_t trick_at_us;
+    int64_t trick_hold_us;
+} sim_config_t;
+
+typedef struct {
+    uint32_t frames;            // Whole MP3 frames in the chunk (fraction carried to the next)
+    int64_t push_us;
+} audio_entry_t;
+
+typedef struct {
+    const sim_config_t* config;
+    int64_t now;
+
+    // Card: FATFS keeps the last partially read sector in the FIL buffer
+    avi_source_t inner;
+    int64_t cached_sector;
+    uint64_t card_accesses;
+
+    // Vsync semaphore (binary: one missed vsync is remembered)
+    int64_t next_vsync;
+    bool vsync_pending;
+
+    // Audio task: queue -> decode one MP3 frame -> i2s write into DMA buffer
+    bool audio_enabled;
+    bool audio_stopped;         // audio_player_stop() during trick play
+    audio_entry_t queue[AUDIO_QUEUE_MAX];
+    int queue_head, queue_count;
+    uint32_t current_frames;    // Frames left in the chunk being decoded
+    int64_t task_us;            // When the task is next free
+    int64_t decoded_us;         // When the frame being decoded is ready, 0 = not started
+    int64_t dma_end_us;         // When the DMA buffer runs dry
+    uint64_t samples_written;
+    uint64_t start_samples;     // Position the audio (re)started at, no underrun before the first write
+    uint32_t sample_rate;
+    uint16_t frame_samples;
+    uint32_t bitrate_kbps;
+    double frame_carry;         // Fraction of a frame carried between chunks
+    uint32_t underruns;
+    int64_t underrun_us;
+} sim_t;
+
+static sim_t sim;
+
+static int64_t sim_now(void* ctx) {
+    return sim.now;
+}
+
+// Run the audio task model up to the current time
+static void audio_update(void) {
+    if (!sim.audio_enabled || sim.audio_stopped || sim.sample_rate == 0) {
+        return;
+    }
+    int64_t frame_us = (int64_t)sim.frame_samples * 1000000 * PLAYBACK_SPEED_NORMAL / sim.config->speed /
+                       sim.sample_rate;
+    for (;;) {
+        if (sim.current_frames == 0) {
+            if (sim.queue_count == 0) {
+                return;
+            }
+            const audio_entry_t* e = &sim.queue[sim.queue_head];
+            int64_t take = e->push_us > sim.task_us ? e->push_us : sim.task_us;
+            if (take > sim.now) {
+                return;
+            }
+            sim.current_frames = e->frames;
+            sim.task_us = take;
+            sim.queue_head = (sim.queue_head + 1) % AUDIO_QUEUE_MAX;
+            sim.queue_count--;
+            continue;
+        }
+
+        // Decode one frame, then block in i2s_channel_write() until the DMA has room
+        if (sim.decoded_us == 0) {
+            sim.decoded_us = sim.task_us + dist_sample(&sim.config->audio_decode, 0);
+        }
+        int64_t decoded = sim.decoded_us;
+        int64_t room = sim.dma_end_us - sim.config->audio_dma_us;
+        int64_t written = decoded > room ? decoded : room;
+        if (written > sim.now) {
+            return;
+        }
+        if (sim.samples_written > sim.start_samples && decoded > sim.dma_end_us) {
+            sim.underruns++;
+            sim.underrun_us += decoded - sim.dma_end_us;
+        }
+        sim.dma_end_us = (sim.dma_end_us > written ? sim.dma_end_us : written) + frame_us;
+        sim.samples_written += sim.frame_samples;
+        sim.task_us = written;
+        sim.decoded_us = 0;
+        sim.current_frames--;
+    }
+}
+
+// Whole frames in a chunk: CBR byte count turned into frames, fractions carried
+static uint32_t audio_chunk_frames(const uint8_t* data, size_t size) {
+    if (sim.bitrate_kbps == 0) {
+        size_t at = mp3_frame_sync(data, size);
+        mp3_frame_t frame;
+        if (at < size && mp3_frame_parse(data + at, size - at, &frame)) {
+            sim.bitrate_kbps = frame.bitrate_kbps;
+            sim.sample_rate = frame.sample_rate;
+            sim.frame_samples = frame.samples;
+        } else {
+            return 0;
+        }
+    }
+    double frame_bytes = (double)sim.frame_samples * sim.bitrate_kbps * 1000 / 8 / sim.sample_rate;
+    sim.frame_carry += size / frame_bytes;
+    uint32_t frames = (uint32_t)sim.frame_carry;
+    sim.frame_carry -= frames;
+    return frames;
+}
+
+static esp_err_t sim_audio_push(void* ctx, const uint8_t* data, size_t size) {
+    if (!sim.audio_enabled || sim.audio_stopped) {
+        return ESP_OK;
+    }
+    int64_t deadline = sim.now + AUDIO_PUSH_WAIT_US;
+    audio_update();
+    while (sim.queue_count >= sim.config->audio_queue_length) {
+        if (sim.now >= deadline) {
+            return ESP_ERR_TIMEOUT;
+        }
+        sim.now += AUDIO_WAIT_STEP_US;
+        audio_update();
+    }
+    int tail = (sim.queue_head + sim.queue_count) % AUDIO_QUEUE_MAX;
+    sim.queue[tail] = (audio_entry_t){audio_chunk_frames(data, size), sim.now};
+    sim.queue_count++;
+    return ESP_OK;
+}
+
+// audio_player_stop(): queued and buffered audio is dropped
+static void sim_audio_stop(void) {
+    sim.audio_stopped = true;
+    sim.queue_count = 0;
+    sim.current_frames = 0;
+    sim.decoded_us = 0;
+    sim.frame_carry = 0;
+}
+
+// audio_player_start_at(): an empty pipeline counting from position_ms
+static void sim_audio_start_at(uint32_t position_ms) {
+    sim.audio_stopped = false;
+    sim.task_us = sim.now;
+    sim.dma_end_us = sim.now;
+    sim.samples_written = (uint64_t)position_ms * sim.sample_rate / 1000;
+    sim.start_samples = sim.samples_written;
+}
+
+static uint32_t sim_audio_position_ms(void* ctx) {
+    audio_update();
+    return sim.sample_rate ? (uint32_t)(sim.samples_written * 1000 / sim.sample_rate) : 0;
+}
+
+// Card access cost: the FIL sector buffer makes reads inside the last
+// partially read sector free, everything else is one command to the card
+static int64_t card_cost(size_t offset, size_t count, bool whole_sectors) {
+    int64_t first = offset / AVI_SOURCE_SECTOR_SIZE;
+    int64_t last = (offset + count - 1) / AVI_SOURCE_SECTOR_SIZE;
+    if (!whole_sectors) {
+        if (first == last && first == sim.cached_sector) {
+            return 0;
+        }
+        if (first == sim.cached_sector) {
+            first++;
+        }
+        sim.cached_sector = last;
+    }
+    sim.card_accesses++;
+    return dist_sample(&sim.config->sd, (last - first + 1) * AVI_SOURCE_SECTOR_SIZE);
+}
+
+static size_t sim_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    sim.now += card_cost(offset, count, false);
+    return sim.inner.ops->read_at(&sim.inner, offset, buf, count);
+}
+
+static size_t sim_read_sectors(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    sim.now += card_cost(offset, count, true);
+    return sim.inner.ops->read_sectors(&sim.inner, offset, buf, count);
+}
+
+static void sim_close(avi_source_t* src) {
+    avi_source_close(&sim.inner);
+}
+
+static const avi_source_ops_t sim_source_ops = {
+    .name = "sim",
+    .read_at = sim_read_at,
+    .read_sectors = sim_read_sectors,
+    .close = sim_close,
+};
+
+// xSemaphoreTake(vsync_sem, 50 ms) against a panel with the modelled period
+static void wait_vsync(void) {
+    while (sim.next_vsync <= sim.now) {
+        sim.vsync_pending = true;
+        sim.next_vsync += dist_sample(&sim.config->vsync, 0);
+    }
+    if (sim.vsync_pending) {
+        sim.vsync_pending = false;
+        return;
+    }
+    if (sim.next_vsync - sim.now > VSYNC_TIMEOUT_US) {
+        sim.now += VSYNC_TIMEOUT_US;
+        return;
+    }
+    sim.now = sim.next_vsync;
+    sim.next_vsync += dist_sample(&sim.config->vsync, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Main loop
+// ---------------------------------------------------------------------------
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-r ring_frames] [-c chunks_per_step] [-p prebuffer_ms] [-q audio_queue]\n"
+            "          [-S sd] [-D decode] [-C copy] [-B blit] [-V vsync] [-A audio_decode]\n"
+            "          [-l audio_dma_ms] [-t tick_us] [-R speed] [-s seed] [-o occupancy.csv] [-i interval_ms]\n"
+            "          [-T rate:at_ms:hold_ms] [-E reduced_decode] [-x max_drops] [-v]\n"
+            "          <file.avi>\n",
+            prog);
+    exit(1);
+}
+
+static void parse_dist(const char* prog, const char* spec, dist_t* dist) {
+    if (dist_parse(spec, dist) != 0) {
+        fprintf(stderr, "Bad distribution: %s\n", spec);
+        usage(prog);
+    }
+}
+
+int main(int argc, char** argv) {
+    playback_config_t config = PLAYBACK_CONFIG_DEFAULT;
+    sim_config_t model = {
+        .audio_dma_us = 50000,
+        .tick_us = 1000,
+        .audio_queue_length = 16,
+        .speed = PLAYBACK_SPEED_NORMAL,
+    };
+    // Defaults: a decent card, hardware JPEG for 480x600 and a 60 Hz panel
+    parse_dist(argv[0], "lognormal:400:0.4+per_kb:45", &model.sd);
+    parse_dist(argv[0], "normal:11000:1200+per_kb:40", &model.decode);
+    parse_dist(argv[0], "normal:5000:500+per_kb:10", &model.reduced_decode);
+    parse_dist(argv[0], "const:0", &model.copy);
+    parse_dist(argv[0], "normal:1500:100", &model.blit);
+    parse_dist(argv[0], "const:16667", &model.vsync);
+    parse_dist(argv[0], "normal:1800:200", &model.audio_decode);
+
+    const char* csv_path = NULL;
+    int interval_ms = 100;
+    int max_drops = -1;
+    int opt;
+    int trick_at_ms = 0, trick_hold_ms = 0;
+    while ((opt = getopt(argc, argv, "r:c:p:q:S:D:E:C:B:V:A:l:t:R:T:s:o:i:x:v")) != -1) {
+        switch (opt) {
+            case 'r':
+                config.ring_frames = atoi(optarg);
+                config.ring_bytes = (size_t)config.ring_frames * PLAYBACK_SLOT_SIZE;
+                break;
+            case 'c': config.chunks_per_step = atoi(optarg); break;
+            case 'p': config.prebuffer_ms = atoi(optarg); break;
+            case 'q': model.audio_queue_length = atoi(optarg); break;
+            case 'S': parse_dist(argv[0], optarg, &model.sd); break;
+            case 'D': parse_dist(argv[0], optarg, &model.decode); break;
+            case 'E': parse_dist(argv[0], optarg, &model.reduced_decode); break;
+            case 'C': parse_dist(argv[0], optarg, &model.copy); break;
+            case 'B': parse_dist(argv[0], optarg, &model.blit); break;
+            case 'V': parse_dist(argv[0], optarg, &model.vsync); break;
+            case 'A': parse_dist(argv[0], optarg, &model.audio_decode); break;
+            case 'l': model.audio_dma_us = atoi(optarg) * 1000LL; break;
+            case 't': model.tick_us = atoi(optarg); break;
+            case 'R': model.speed = atoi(optarg); break;
+            case 'T':
+                if (sscanf(optarg, "%d:%d:%d", &model.trick_rate, &trick_at_ms, &trick_hold_ms) != 3) {
+                    usage(argv[0]);
+                }
+                model.trick_at_us = trick_at_ms * 1000LL;
+                model.trick_hold_us = trick_hold_ms * 1000LL;
+                break;
+            case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+            case 'o': csv_path = optarg; break;
+            case 'i': interval_ms = atoi(optarg); break;
+            case 'x': max_drops = atoi(optarg); break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc || config.ring_frames < 3 || config.ring_frames > PLAYBACK_RING_MAX ||
+        config.chunks_per_step < 1 || model.audio_queue_length < 1 || model.audio_queue_length > AUDIO_QUEUE_MAX ||
+        model.tick_us < 1 || interval_ms < 1 || model.speed < PLAYBACK_SPEED_MIN || model.speed > PLAYBACK_SPEED_MAX ||
+        abs(model.trick_rate) == 1 || abs(model.trick_rate) > PLAYBACK_TRICK_MAX || trick_at_ms < 0 ||
+        trick_hold_ms < 0) {
+        usage(argv[0]);
+    }
+    const char* path = argv[optind];
+
+    FILE* csv = NULL;
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            perror(csv_path);
+            return 1;
+        }
+        fprintf(csv, "time_ms,ring_fill,ring_size,audio_queued,audio_ms,video_ms,av_offset_ms,dropped,underruns\n");
+    }
+
+    sim.config = &model;
+    sim.cached_sector = -1;
+    sim.now = 1000000;          // Away from zero so nothing reads a 0 timestamp as "unset"
+    sim.next_vsync = sim.now + dist_sample(&model.vsync, 0);
+
+    static playback_t pb;
+    const playback_ops_t ops = {
+        .audio_push = sim_audio_push,
+        .audio_position_ms = sim_audio_position_ms,
+        .now_us = sim_now,
+    };
+    playback_init(&pb, &config, &ops);
+    playback_set_speed(&pb, model.speed);
+
+    if (avi_source_open_direct(&sim.inner, path) != ESP_OK) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+    avi_source_t source = {.ops = &sim_source_ops, .size = sim.inner.size};
+    if (avi_parser_open_source(&pb.parser, &source) != ESP_OK) {
+        fprintf(stderr, "Not a playable AVI: %s\n", path);
+        return 1;
+    }
+    if (playback_prepare(&pb, 30) != ESP_OK) {
+        return 1;
+    }
+    const avi_info_t* info = avi_parser_get_info(&pb.parser);
+    sim.audio_enabled = info->has_audio && info->audio_format == 0x55;
+    if (info->has_audio && !sim.audio_enabled) {
+        fprintf(stderr, "Audio is not MP3, simulating video only\n");
+    }
+
+    // start_playback(): prebuffer, clear the screen, start the clock
+    int64_t open_us = sim.now;
+    playback_prebuffer(&pb);
+    int64_t prebuffer_us = sim.now - open_us;
+    sim.now += dist_sample(&model.blit, 0);
+    playback_start_clock(&pb);
+    play_stats_reset(playback_frame_interval_us(&pb));
+    int64_t start_us = sim.now;
+
+    int frame_to_present = -1;
+    int64_t next_sample = sim.now;
+    uint64_t fill_sum = 0;
+    uint32_t fill_samples = 0;
+    int fill_min = pb.ring_frames;
+    uint32_t loops = 0;
+
+    // Trick play key: 0 = not pressed yet, 1 = held, 2 = released
+    int trick_phase = model.trick_rate ? 0 : 2;
+    int trick_from = 0, trick_to = 0;
+    uint32_t trick_presented = 0;
+    int64_t resume_us = 0;
+
+    for (;;) {
+        if (trick_phase == 0 && sim.now - start_us >= model.trick_at_us) {
+            sim_audio_stop();
+            if (playback_set_trick(&pb, model.trick_rate) != ESP_OK) {
+                fprintf(stderr, "No frame index, trick play needs a file from avi_remux\n");
+                return 1;
+            }
+            trick_from = pb.shown_frame;
+            trick_presented = play_stats_presented();
+            trick_phase = 1;
+        } else if (trick_phase == 1 && sim.now - start_us >= model.trick_at_us + model.trick_hold_us) {
+            // Key released: seek to the frame on screen, prebuffer, restart audio and clock
+            trick_to = pb.shown_frame;
+            trick_presented = play_stats_presented() - trick_presented;
+            int64_t t = sim.now;
+            playback_set_trick(&pb, 0);
+            sim_audio_start_at((uint32_t)(playback_pts_us(&pb, pb.current_frame) / 1000));
+            playback_prebuffer(&pb);
+            playback_start_clock(&pb);
+            resume_us = sim.now - t;
+            trick_phase = 2;
+        }
+
+        // process_video_frame()
+        playback_fill(&pb);
+        if (playback_finished(&pb)) {
+            break;
+        }
+        const playback_frame_t* frame = playback_due_frame(&pb);
+        if (frame) {
+            int64_t t0 = sim.now;
+            bool reduced = abs(pb.trick_rate) >= PLAYBACK_TRICK_REDUCED;
+            sim.now += dist_sample(reduced ? &model.reduced_decode : &model.decode, frame->size);
+            int frame_index = frame->frame_index;
+            playback_release_frame(&pb, true);
+            int64_t t1 = sim.now;
+            sim.now += dist_sample(&model.copy, 0);
+            play_stats_add(PLAY_STAT_DECODE, t1 - t0);
+            play_stats_add(PLAY_STAT_COPY, sim.now - t1);
+            frame_to_present = frame_index;
+        }
+
+        // Vsync wait and blit
+        int64_t tv0 = sim.now;
+        wait_vsync();
+        int64_t tv1 = sim.now;
+        sim.now += dist_sample(&model.blit, 0);
+        int64_t tv2 = sim.now;
+        play_stats_add(PLAY_STAT_VSYNC, tv1 - tv0);
+        play_stats_add(PLAY_STAT_BLIT, tv2 - tv1);
+        if (frame_to_present >= 0) {
+            int64_t pts_us = playback_pts_us(&pb, frame_to_present);
+            play_stats_present(tv2, (int32_t)(tv2 - playback_due_time_us(&pb, frame_to_present)));
+            if (sim.audio_enabled && !sim.audio_stopped) {
+                play_stats_av((int32_t)(sim_audio_position_ms(NULL) - pts_us / 1000));
+            }
+            frame_to_present = -1;
+        }
+
+        // Buffer occupancy over time
+        while (sim.now >= next_sample) {
+            audio_update();
+            fill_sum += pb.buffered;
+            fill_samples++;
+            if (pb.buffered < fill_min) {
+                fill_min = pb.buffered;
+            }
+            if (csv) {
+                uint32_t audio_ms = sim_audio_position_ms(NULL);
+                uint32_t video_ms = (uint32_t)(playback_pts_us(&pb, pb.current_frame) / 1000);
+                fprintf(csv, "%lld,%d,%d,%d,%lu,%lu,%ld,%lu,%lu\n", (long long)(next_sample - start_us) / 1000,
+                        pb.buffered, pb.ring_frames, sim.queue_count, (unsigned long)audio_ms,
+                        (unsigned long)video_ms, sim.audio_enabled ? (long)audio_ms - (long)video_ms : 0L,
+                        (unsigned long)play_stats_dropped_count(), (unsigned long)sim.underruns);
+            }
+            next_sample += interval_ms * 1000LL;
+        }
+
+        // vTaskDelay(1): sleep to the next tick
+        sim.now = (sim.now / model.tick_us + 1) * model.tick_us;
+        loops++;
+    }
+    if (csv) {
+        fclose(csv);
+    }
+
+    int64_t played_us = sim.now - start_us;
+    printf("=== %s ===\n", path);
+    printf("Video: %lux%lu @ %d fps, %lu frames, audio %s\n", (unsigned long)info->width,
+           (unsigned long)info->height, pb.fps, (unsigned long)info->video_frames,
+           sim.audio_enabled ? "mp3" : "none");
+    printf("Config: ring %d x %zu bytes, %d chunks/step, prebuffer %d ms, audio queue %d, dma %lld ms\n",
+           pb.ring_frames, pb.slot_size, config.chunks_per_step, config.prebuffer_ms, model.audio_queue_length,
+           (long long)model.audio_dma_us / 1000);
+    if (pb.speed != PLAYBACK_SPEED_NORMAL) {
+        printf("Speed: %d%%, every %d frame(s) read\n", pb.speed, pb.frame_step);
+    }
+    if (trick_phase == 2 && model.trick_rate) {
+        printf("Trick: %+dx for %d ms, frame %d to %d, %lu frames shown, resumed in %.1f ms\n", model.trick_rate,
+               trick_hold_ms, trick_from, trick_to, (unsigned long)trick_presented, resume_us / 1000.0);
+    } else if (trick_phase == 1) {
+        printf("Trick: %+dx from frame %d ran to the end, %lu frames shown\n", model.trick_rate, trick_from,
+               (unsigned long)(play_stats_presented() - trick_presented));
+    }
+    printf("Startup: prebuffer %.1f ms, %d frames\n", prebuffer_us / 1000.0, config.prebuffer_ms * pb.fps / 1000);
+    printf("Played: %.2f s in %lu loop iterations, %llu card accesses, %.1f MB read\n", played_us / 1e6,
+           (unsigned long)loops, (unsigned long long)sim.card_accesses, pb.read_bytes / 1e6);
+    printf("Frames: %lu presented, %lu dropped, %lu repeated\n", (unsigned long)play_stats_presented(),
+           (unsigned long)play_stats_dropped_count(), (unsigned long)play_stats_repeated_count());
+    printf("Ring: min %d, mean %.1f of %d frames\n", fill_min, fill_samples ? (double)fill_sum / fill_samples : 0,
+           pb.ring_frames);
+
+    static const char* const names[PLAY_STAT_COUNT] = {"read", "decode", "copy", "vsync", "blit", "interval",
+                                                       "jitter"};
+    printf("%-9s %7s %8s %8s %8s %8s\n", "stage", "count", "p50", "p95", "p99", "max");
+    for (int i = 0; i < PLAY_STAT_COUNT; i++) {
+        play_stats_summary_t s;
+        play_stats_summarize(i, &s);
+        if (s.count > 0) {
+            printf("%-9s %7lu %6.2fms %6.2fms %6.2fms %6.2fms\n", names[i], (unsigned long)s.count, s.p50 / 1000.0,
+                   s.p95 / 1000.0, s.p99 / 1000.0, s.max / 1000.0);
+        }
+    }
+    if (sim.audio_enabled) {
+        int32_t p1, p50, p99, min, max;
+        play_stats_av_offset(&p1, &p50, &p99, &min, &max);
+        printf("A/V offset (audio - video): p1=%+ldms p50=%+ldms p99=%+ldms, min=%+ldms max=%+ldms\n", (long)p1,
+               (long)p50, (long)p99, (long)min, (long)max);
+        printf("Audio: %lu underruns, %.1f ms silent\n", (unsigned long)sim.underruns, sim.underrun_us / 1000.0);
+    }
+
+    avi_parser_close(&pb.parser);
+    heap_caps_free(pb.ring_memory);
+    bool clean = (int64_t)play_stats_dropped_count() <= max_drops && sim.underruns == 0;
+    return max_drops >= 0 && !clean ? 2 : 0;
+}
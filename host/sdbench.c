@@ -0,0 +1,50 @@
+// SD Bench - host build of the badge's storage benchmark
+// Runs the same tests against files on local disk (note: the OS page cache
+// makes repeated runs optimistic; drop caches first for cold numbers)
+//
+// Usage: sdbench [-m max_mb_per_file] [-v] <file.avi>...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "storage_bench.h"
+
+static void print_progress(const char* message, void* arg) {
+    (void)arg;
+    fprintf(stderr, "%s...\n", message);
+}
+
+int main(int argc, char** argv) {
+    size_t max_bytes = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:v")) != -1) {
+        switch (opt) {
+            case 'm': max_bytes = (size_t)atoi(optarg) * 1024 * 1024; break;
+            case 'v': host_log_level = ESP_LOG_INFO; break;
+            default:
+                fprintf(stderr, "Usage: %s [-m max_mb_per_file] [-v] <file.avi>...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-m max_mb_per_file] [-v] <file.avi>...\n", argv[0]);
+        return 1;
+    }
+
+    static storage_bench_report_t report;
+    esp_err_t ret = storage_bench_run((const char* const*)&argv[optind], argc - optind, max_bytes, &report,
+                                      print_progress, NULL);
+    if (ret != ESP_OK) {
+        fprintf(stderr, "Benchmark failed: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+
+    char lines[6 + STORAGE_BENCH_MAX_FILES][STORAGE_BENCH_LINE_LEN];
+    int n = storage_bench_format(&report, lines, 6 + STORAGE_BENCH_MAX_FILES);
+    for (int i = 0; i < n; i++) {
+        printf("%s\n", lines[i]);
+    }
+
+    return report.unsustainable_count > 0 ? 2 : 0;
+}
@@ -0,0 +1,351 @@
+// Time Stretch Test - host check of the WSOLA stretcher (main/time_stretch.c)
+// Stretches synthetic signals at every player speed, fed in MP3-frame sized
+// batches the way the audio task does, and checks that:
+//   - the output length matches the speed (up to the input still buffered)
+//   - the pitch is unchanged (strongest frequency, within 1%)
+//   - the level is unchanged and a pure tone has no splice clicks
+//   - draining back to normal speed continues without a jump
+// It also times the stretcher and turns the splice search cost into a
+// share of the badge's audio core (-b budget in percent).
+//
+// With -i, a 16-bit stereo WAV file is stretched to -o at speed -r instead,
+// for listening tests (e.g. ffmpeg -i clip.avi -ac 2 -ar 44100 in.wav).
+//
+// Usage: time_stretch_test [-b budget_percent] [-i in.wav -o out.wav -r speed_percent]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "esp_log.h"
+#include "time_stretch.h"
+
+#define SAMPLE_RATE         44100
+#define BATCH_FRAMES        1152        // One MP3 frame, what the audio task puts per call
+#define SIGNAL_SECONDS      4
+#define CORE_MHZ            360         // ESP32-P4 HP core
+#define CYCLES_PER_MAC      3           // 16x16 multiply-add with both loads, no SIMD
+
+static const int speeds[] = {50, 75, 100, 125, 150, 200};
+
+typedef struct {
+    int16_t* pcm;
+    int frames;
+    int capacity;
+} pcm_buf_t;
+
+static void pcm_append(pcm_buf_t* b, const int16_t* pcm, int frames) {
+    if (b->frames + frames > b->capacity) {
+        b->capacity = (b->frames + frames) * 2;
+        b->pcm = realloc(b->pcm, b->capacity * 2 * sizeof(int16_t));
+    }
+    memcpy(b->pcm + b->frames * 2, pcm, frames * 2 * sizeof(int16_t));
+    b->frames += frames;
+}
+
+// ---------------------------------------------------------------------------
+// Signals
+// ---------------------------------------------------------------------------
+
+typedef enum { SIGNAL_SINE, SIGNAL_CHORD, SIGNAL_VOICE, SIGNAL_COUNT } signal_t;
+static const char* const signal_names[SIGNAL_COUNT] = {"sine 440", "chord", "voice"};
+
+static void make_signal(signal_t kind, pcm_buf_t* b, int frames) {
+    b->pcm = malloc(frames * 2 * sizeof(int16_t));
+    b->frames = b->capacity = frames;
+    for (int i = 0; i < frames; i++) {
+        double t = (double)i / SAMPLE_RATE;
+        double l, r;
+        switch (kind) {
+            case SIGNAL_SINE:
+                l = r = 0.5 * sin(2 * M_PI * 440 * t);
+                break;
+            case SIGNAL_CHORD:
+                l = 0.3 * sin(2 * M_PI * 220 * t) + 0.2 * sin(2 * M_PI * 277.18 * t);
+                r = 0.3 * sin(2 * M_PI * 220 * t) + 0.2 * sin(2 * M_PI * 329.63 * t);
+                break;
+            default: {
+                // 150 Hz glottal-like pulse train under a 4 Hz syllable envelope
+                double phase = fmod(150 * t, 1.0);
+                double pulse = phase < 0.4 ? sin(M_PI * phase / 0.4) : 0;
+                double envelope = 0.55 + 0.45 * sin(2 * M_PI * 4 * t);
+                l = r = 0.6 * envelope * (pulse - 0.25);
+                break;
+            }
+        }
+        b->pcm[2 * i] = (int16_t)lrint(l * 32767);
+        b->pcm[2 * i + 1] = (int16_t)lrint(r * 32767);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Measurements
+// ---------------------------------------------------------------------------
+
+// Power at hz in a Hann-windowed block of the left channel (Goertzel)
+static double tone_power(const pcm_buf_t* b, int at, int window, double hz) {
+    double coeff = 2 * cos(2 * M_PI * hz / SAMPLE_RATE);
+    double s1 = 0, s2 = 0;
+    for (int i = 0; i < window; i++) {
+        double hann = 0.5 - 0.5 * cos(2 * M_PI * i / (window - 1));
+        double s0 = b->pcm[2 * (at + i)] * hann + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    return s1 * s1 + s2 * s2 - coeff * s1 * s2;
+}
+
+// Strongest frequency between 60 Hz and 1 kHz around frame at: 2 Hz steps, then 0.05 Hz around the best
+static double dominant_hz(const pcm_buf_t* b, int at) {
+    const int window = 8192;
+    if (at + window > b->frames) {
+        at = b->frames - window;
+    }
+    double best_hz = 0, best = -1;
+    for (double hz = 60; hz <= 1000; hz += 2) {
+        double p = tone_power(b, at, window, hz);
+        if (p > best) {
+            best = p;
+            best_hz = hz;
+        }
+    }
+    double coarse = best_hz;
+    for (double hz = coarse - 2; hz <= coarse + 2; hz += 0.05) {
+        double p = tone_power(b, at, window, hz);
+        if (p > best) {
+            best = p;
+            best_hz = hz;
+        }
+    }
+    return best_hz;
+}
+
+static double rms(const pcm_buf_t* b, int from, int to) {
+    double sum = 0;
+    for (int i = from; i < to; i++) {
+        sum += (double)b->pcm[2 * i] * b->pcm[2 * i];
+    }
+    return sqrt(sum / (to - from));
+}
+
+static int max_step(const pcm_buf_t* b, int from, int to) {
+    int worst = 0;
+    for (int i = from + 1; i < to; i++) {
+        for (int c = 0; c < 2; c++) {
+            int d = abs(b->pcm[2 * i + c] - b->pcm[2 * (i - 1) + c]);
+            if (d > worst) worst = d;
+        }
+    }
+    return worst;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Stretch in batches like the audio task, optionally draining at normal speed at the end
+static void stretch(time_stretch_t* ts, const pcm_buf_t* in, int speed, bool drain, pcm_buf_t* out, double* seconds) {
+    int16_t* segment = malloc(time_stretch_output_frames(ts) * 2 * sizeof(int16_t));
+    time_stretch_reset(ts);
+    time_stretch_set_speed(ts, speed);
+    double t0 = now_s();
+    for (int at = 0; at < in->frames;) {
+        int batch = in->frames - at < BATCH_FRAMES ? in->frames - at : BATCH_FRAMES;
+        at += time_stretch_put(ts, in->pcm + at * 2, batch);
+        int n;
+        while ((n = time_stretch_get(ts, segment)) > 0) {
+            pcm_append(out, segment, n);
+        }
+    }
+    if (seconds) {
+        *seconds = now_s() - t0;
+    }
+    if (drain) {
+        int n;
+        while ((n = time_stretch_drain(ts, segment)) > 0) {
+            pcm_append(out, segment, n);
+        }
+    }
+    free(segment);
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, const char* signal, int speed, double value) {
+    if (!ok) {
+        printf("FAIL %s at %d%%: %s (%.3f)\n", signal, speed, what, value);
+        failures++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// WAV files
+// ---------------------------------------------------------------------------
+
+static bool wav_read(const char* path, pcm_buf_t* b, uint32_t* rate) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t header[12];
+    bool ok = fread(header, 1, 12, f) == 12 && !memcmp(header, "RIFF", 4) && !memcmp(header + 8, "WAVE", 4);
+    bool format_ok = false;
+    while (ok) {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, 8, f) != 8) {
+            ok = false;
+            break;
+        }
+        uint32_t size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            uint8_t fmt[16];
+            ok = fread(fmt, 1, 16, f) == 16 && fseek(f, size - 16 + (size & 1), SEEK_CUR) == 0;
+            *rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            format_ok = fmt[0] == 1 && fmt[2] == 2 && fmt[14] == 16;
+        } else if (!memcmp(chunk, "data", 4)) {
+            b->frames = b->capacity = size / 4;
+            b->pcm = malloc(size + 4);
+            ok = format_ok && fread(b->pcm, 4, b->frames, f) == (size_t)b->frames;
+            break;
+        } else {
+            ok = fseek(f, size + (size & 1), SEEK_CUR) == 0;
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "%s: not a 16-bit stereo PCM WAV file\n", path);
+    }
+    return ok;
+}
+
+static bool wav_write(const char* path, const pcm_buf_t* b, uint32_t rate) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint32_t data = b->frames * 4;
+    uint32_t h[11] = {0x46464952, 36 + data, 0x45564157, 0x20746d66, 16, 0x00020001, rate, rate * 4, 0x00100004,
+                      0x61746164, data};
+    bool ok = fwrite(h, 4, 11, f) == 11 && fwrite(b->pcm, 4, b->frames, f) == (size_t)b->frames;
+    return fclose(f) == 0 && ok;
+}
+
+static int stretch_file(const char* in_path, const char* out_path, int speed) {
+    pcm_buf_t in = {0}, out = {0};
+    uint32_t rate = 0;
+    if (!wav_read(in_path, &in, &rate)) {
+        return 1;
+    }
+    time_stretch_t ts;
+    if (time_stretch_init(&ts, rate, BATCH_FRAMES) != ESP_OK) {
+        fprintf(stderr, "Unsupported sample rate %lu\n", (unsigned long)rate);
+        return 1;
+    }
+    double seconds;
+    stretch(&ts, &in, speed, true, &out, &seconds);
+    printf("%s: %.2f s -> %.2f s at %d%% in %.1f ms\n", out_path, (double)in.frames / rate,
+           (double)out.frames / rate, speed, seconds * 1000);
+    time_stretch_free(&ts);
+    return wav_write(out_path, &out, rate) ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-b budget_percent] [-i in.wav -o out.wav -r speed_percent]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    double budget = 10;
+    const char* in_path = NULL;
+    const char* out_path = NULL;
+    int file_speed = 150;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:i:o:r:")) != -1) {
+        switch (opt) {
+            case 'b': budget = atof(optarg); break;
+            case 'i': in_path = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'r': file_speed = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    host_log_level = ESP_LOG_WARN;
+    if (in_path || out_path) {
+        if (!in_path || !out_path) usage(argv[0]);
+        return stretch_file(in_path, out_path, file_speed);
+    }
+
+    time_stretch_t ts;
+    if (time_stretch_init(&ts, SAMPLE_RATE, BATCH_FRAMES) != ESP_OK) {
+        return 1;
+    }
+    int segment = time_stretch_output_frames(&ts);
+
+    printf("%-9s %5s %9s %9s %8s %8s %7s %9s\n", "signal", "speed", "length", "expected", "pitch", "level",
+           "click", "us/s out");
+    double worst_us = 0;
+    for (int s = 0; s < SIGNAL_COUNT; s++) {
+        pcm_buf_t in = {0};
+        make_signal(s, &in, SIGNAL_SECONDS * SAMPLE_RATE);
+        double in_hz = dominant_hz(&in, in.frames / 2);
+        double in_rms = rms(&in, in.frames / 4, in.frames * 3 / 4);
+        int in_step = max_step(&in, 0, in.frames);
+
+        for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+            int speed = speeds[i];
+            pcm_buf_t out = {0};
+            double seconds;
+            stretch(&ts, &in, speed, false, &out, &seconds);
+
+            double expected = (double)in.frames * 100 / speed;
+            double pitch = dominant_hz(&out, out.frames / 2) / in_hz;
+            double level = 20 * log10(rms(&out, out.frames / 4, out.frames * 3 / 4) / in_rms);
+            double click = (double)max_step(&out, 0, out.frames) / in_step;
+            double us_per_s = seconds * 1e6 / ((double)out.frames / SAMPLE_RATE);
+            if (us_per_s > worst_us) worst_us = us_per_s;
+            printf("%-9s %4d%% %9d %9.0f %8.4f %+7.2fdB %7.2f %9.1f\n", signal_names[s], speed, out.frames, expected,
+                   pitch, level, click, us_per_s);
+
+            // Input still buffered is at most one segment plus the seek window at this speed
+            double slack = (segment + ts.seek + ts.sequence) * 100.0 / speed;
+            check(fabs(out.frames - expected) <= slack, "length", signal_names[s], speed, out.frames - expected);
+            check(fabs(pitch - 1) < 0.01, "pitch", signal_names[s], speed, pitch);
+            check(fabs(level) < 1.5, "level", signal_names[s], speed, level);
+            if (s == SIGNAL_SINE) {
+                check(click < 1.5, "splice click", signal_names[s], speed, click);
+            }
+            free(out.pcm);
+        }
+
+        // Stretch then return to normal speed: the drained tail must continue the last segment
+        if (s == SIGNAL_SINE) {
+            pcm_buf_t out = {0};
+            stretch(&ts, &in, 150, true, &out, NULL);
+            double click = (double)max_step(&out, 0, out.frames) / in_step;
+            check(click < 1.5 && ts.input_frames == 0, "drain", signal_names[s], 100, click);
+            printf("%-9s drain: %d frames, step %.2f\n", signal_names[s], out.frames, click);
+            free(out.pcm);
+        }
+        free(in.pcm);
+    }
+
+    // Badge estimate from the search (the bulk of the work); copies and fades add about one
+    // multiply per output sample on top
+    uint32_t macs = time_stretch_search_macs(&ts);
+    double load = (double)(macs + 2) * CYCLES_PER_MAC * SAMPLE_RATE / (CORE_MHZ * 1e6) * 100;
+    printf("Search: %lu MAC per output frame, ~%.1f%% of a %d MHz core (budget %.0f%%); host %.1f us/s\n",
+           (unsigned long)macs, load, CORE_MHZ, budget, worst_us);
+    check(load <= budget, "CPU budget", "all", 0, load);
+    time_stretch_free(&ts);
+
+    printf(failures ? "%d checks failed\n" : "All checks passed\n", failures);
+    return failures ? 1 : 0;
+}
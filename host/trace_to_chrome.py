@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Convert a trace ring dump from the badge console into Chrome trace JSON.
+
+Press 't' on the badge after (or during) playback; the ring is printed as
+"@T ..." lines between "@T begin" and "@T end". Capture the console and
+convert the last dump in it:
+
+    idf.py monitor | tee console.log
+    host/trace_to_chrome.py console.log trace.json
+
+Open the result in https://ui.perfetto.dev or chrome://tracing. Each core is
+a process and each recording task a thread in it; begin/end pairs become
+complete ("X") events with the event argument attached, and monitor samples
+(core load, free heap) become counter tracks. A short per-event
+summary is printed to stderr.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+RECORD = struct.Struct('<IBBH')
+PHASE_BEGIN, PHASE_END, PHASE_INSTANT, PHASE_COUNTER = 0, 1, 2, 3
+LINE = re.compile(r'@T (\w+)(?: (.*))?$')
+
+
+def read_dumps(lines):
+    """Yield (header, events, tasks, raw records) for each complete dump."""
+    dump = None
+    for line in lines:
+        m = LINE.search(line.rstrip('\r\n'))
+        if not m:
+            continue
+        kind, rest = m.group(1), m.group(2) or ''
+        if kind == 'begin':
+            recorded, count, now = (int(x) for x in rest.split())
+            dump = {'recorded': recorded, 'count': count, 'now': now, 'events': {}, 'tasks': {}, 'data': bytearray()}
+        elif dump is None:
+            continue
+        elif kind == 'event':
+            num, name = rest.split(' ', 1)
+            dump['events'][int(num)] = name
+        elif kind == 'task':
+            num, name = rest.split(' ', 1)
+            dump['tasks'][int(num)] = name
+        elif kind == 'data':
+            dump['data'] += bytes.fromhex(rest.strip())
+        elif kind == 'end':
+            yield dump
+            dump = None
+
+
+def unwrap(records):
+    """Extend the 32-bit microsecond timestamps, which wrap every ~71 minutes."""
+    base, last = 0, None
+    for time_us, event, flags, arg in records:
+        if last is not None and time_us < last and last - time_us > 1 << 31:
+            base += 1 << 32
+        last = time_us
+        yield base + time_us, event, flags, arg
+
+
+def convert(dump):
+    records = [RECORD.unpack_from(dump['data'], i) for i in range(0, len(dump['data']) - RECORD.size + 1, RECORD.size)]
+    names = dump['events']
+    tasks = dump['tasks']
+    out = []
+    open_events = {}
+    stats = {}
+    start = None
+    cores = set()
+    for t, event, flags, arg in unwrap(records):
+        if start is None:
+            start = t
+        ts = t - start
+        phase, core, task = flags & 3, (flags >> 2) & 1, flags >> 4
+        name = names.get(event, 'event %d' % event)
+        cores.add(core)
+        if phase == PHASE_BEGIN:
+            open_events.setdefault((task, event), []).append((ts, core))
+        elif phase == PHASE_END:
+            stack = open_events.get((task, event))
+            if not stack:
+                continue                # Began before the oldest record in the ring
+            begin, begin_core = stack.pop()
+            dur = ts - begin
+            out.append({'name': name, 'ph': 'X', 'ts': begin, 'dur': dur, 'pid': begin_core, 'tid': task,
+                        'args': {'arg': arg}})
+            s = stats.setdefault(name, [0, 0, 0])
+            s[0] += 1
+            s[1] += dur
+            s[2] = max(s[2], dur)
+        elif phase == PHASE_COUNTER:
+            out.append({'name': name, 'ph': 'C', 'ts': ts, 'pid': core, 'args': {'value': arg}})
+        else:
+            out.append({'name': name, 'ph': 'i', 's': 't', 'ts': ts, 'pid': core, 'tid': task, 'args': {'arg': arg}})
+            stats.setdefault(name, [0, 0, 0])[0] += 1
+
+    for core in sorted(cores):
+        out.append({'name': 'process_name', 'ph': 'M', 'pid': core, 'args': {'name': 'Core %d' % core}})
+        for task, task_name in tasks.items():
+            out.append({'name': 'thread_name', 'ph': 'M', 'pid': core, 'tid': task, 'args': {'name': task_name}})
+    return out, stats, len(records)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('log', help='console capture containing "@T" lines (- for stdin)')
+    ap.add_argument('output', help='Chrome trace JSON to write')
+    ap.add_argument('--dump', type=int, default=-1, help='which dump in the log to convert (default: the last)')
+    args = ap.parse_args()
+
+    f = sys.stdin if args.log == '-' else open(args.log, errors='replace')
+    dumps = list(read_dumps(f))
+    if not dumps:
+        sys.exit('No complete trace dump found in %s' % args.log)
+    dump = dumps[args.dump]
+
+    events, stats, count = convert(dump)
+    with open(args.output, 'w') as out:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, out)
+
+    lost = dump['recorded'] - dump['count']
+    print('%d records (%d older ones overwritten), %d trace events' % (count, lost, len(events)), file=sys.stderr)
+    for name, (n, total, longest) in sorted(stats.items()):
+        if total:
+            print('  %-14s %6d  avg %8.1f us  max %8d us' % (name, n, total / n, longest), file=sys.stderr)
+        else:
+            print('  %-14s %6d' % (name, n), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -12,6 +12,9 @@
 #include "bsp/audio.h"
 #include "driver/i2s_std.h"
 #include "esp_mp3_dec.h"
+#include "mp3_frame.h"
+#include "time_stretch.h"
+#include "trace.h"
 #include <string.h>
 
 static const char* TAG = "audio_player";
@@ -47,7 +50,10 @@ static QueueHandle_t audio_queue = NULL;
 static volatile bool audio_playing = false;
 static volatile bool audio_stop_requested = false;
 static volatile bool stream_ended = false;
+static bool chunks_whole_frames = false;       // Every chunk starts and ends on an MP3 frame boundary
 static volatile uint64_t samples_written = 0;
+static volatile uint64_t media_samples_x100 = 0;   // Stream samples played, in hundredths (speed scaled)
+static volatile int requested_speed = 100;          // Percent, applied by the audio task
 static SemaphoreHandle_t audio_mutex = NULL;
 
 // Timing for A/V sync
@@ -95,6 +101,10 @@ esp_err_t audio_player_init(void) {
 }
 
 esp_err_t audio_player_start(void) {
+    return audio_player_start_at(0);
+}
+
+esp_err_t audio_player_start_at(uint32_t position_ms) {
     if (audio_playing) {
         ESP_LOGW(TAG, "Audio already playing, stopping first");
         audio_player_stop();
@@ -110,6 +120,7 @@ esp_err_t audio_player_start(void) {
     xSemaphoreTake(audio_mutex, portMAX_DELAY);
 
     samples_written = 0;
+    media_samples_x100 = (uint64_t)position_ms * actual_sample_rate / 10;
     audio_stop_requested = false;
     stream_ended = false;
     audio_playing = true;
@@ -138,7 +149,7 @@ esp_err_t audio_player_start(void) {
         return ESP_ERR_NO_MEM;
     }
 
-    ESP_LOGI(TAG, "Audio playback started");
+    ESP_LOGI(TAG, "Audio playback started at %lu ms", (unsigned long)position_ms);
     return ESP_OK;
 }
 
@@ -165,6 +176,10 @@ esp_err_t audio_player_push_chunk(const uint8_t* data, size_t size) {
     return ESP_OK;
 }
 
+void audio_player_set_whole_frames(bool whole_frames) {
+    chunks_whole_frames = whole_frames;
+}
+
 void audio_player_end_stream(void) {
     stream_ended = true;
 }
@@ -215,7 +230,20 @@ bool audio_player_is_playing(void) {
 }
 
 uint32_t audio_player_get_position_ms(void) {
-    return (uint32_t)((samples_written * 1000ULL) / actual_sample_rate);
+    return (uint32_t)((media_samples_x100 * 10ULL) / actual_sample_rate);
+}
+
+void audio_player_set_speed(int speed_percent) {
+    if (speed_percent < TIME_STRETCH_SPEED_MIN) speed_percent = TIME_STRETCH_SPEED_MIN;
+    if (speed_percent > TIME_STRETCH_SPEED_MAX) speed_percent = TIME_STRETCH_SPEED_MAX;
+    requested_speed = speed_percent;
+}
+
+uint32_t audio_player_queued_chunks(uint32_t* capacity) {
+    if (capacity) {
+        *capacity = AUDIO_QUEUE_LENGTH;
+    }
+    return audio_queue ? uxQueueMessagesWaiting(audio_queue) : 0;
 }
 
 void audio_player_set_volume(int volume) {
@@ -236,13 +264,124 @@ void audio_player_deinit(void) {
     ESP_LOGI(TAG, "Audio player deinitialized");
 }
 
+// Log the stream format once and take its sample rate
+static void take_format(const esp_audio_dec_info_t* dec_info) {
+    static bool format_logged = false;
+    if (!format_logged) {
+        ESP_LOGI(TAG, "Audio format: %d Hz, %d ch, %d bits",
+                 dec_info->sample_rate, dec_info->channel, dec_info->bits_per_sample);
+        if (dec_info->sample_rate > 0) {
+            actual_sample_rate = dec_info->sample_rate;
+        }
+        format_logged = true;
+    }
+}
+
+// Scale PCM to 50% volume and write it to I2S, one DMA-sized piece at a time
+// Every frame written plays speed percent of a frame of the stream
+static void write_pcm(const int16_t* pcm, size_t frames, int speed) {
+    while (frames > 0) {
+        size_t count = frames > PCM_BUFFER_SAMPLES ? PCM_BUFFER_SAMPLES : frames;
+
+        // Copy to aligned PCM buffer with 50% volume
+        for (size_t i = 0; i < count * 2; i++) {
+            pcm_buffer[i] = pcm[i] >> 1;
+        }
+
+        // Write to I2S
+        size_t bytes_written = 0;
+        TRACE_BEGIN(I2S_WRITE);
+        i2s_channel_write(i2s_tx_handle, pcm_buffer, count * 2 * sizeof(int16_t),
+                          &bytes_written, portMAX_DELAY);
+        TRACE_END(I2S_WRITE, bytes_written / 4);
+
+        samples_written += bytes_written / 4;
+        media_samples_x100 += (uint64_t)(bytes_written / 4) * speed;
+        pcm += count * 2;
+        frames -= count;
+    }
+}
+
+// Speed changes reach the decoded PCM here: normal speed passes straight
+// through, other speeds go through the time stretcher, and on the way back
+// to normal speed the stretcher's buffered audio is played out first
+typedef struct {
+    time_stretch_t ts;
+    int16_t* segment;           // One output segment
+    bool ready;                 // Buffers allocated for the stream's sample rate
+    bool failed;                // No memory, play everything at normal speed
+    bool active;                // Holds audio from a non-normal speed
+    int64_t busy_us;
+} stretch_state_t;
+
+static void stretch_drain(stretch_state_t* st) {
+    int frames;
+    while ((frames = time_stretch_drain(&st->ts, st->segment)) > 0) {
+        write_pcm(st->segment, frames, 100);
+    }
+    st->active = false;
+}
+
+static void output_pcm(stretch_state_t* st, const int16_t* pcm, size_t frames) {
+    int speed = requested_speed;
+    if (speed != 100 && !st->ready && !st->failed) {
+        st->failed = time_stretch_init(&st->ts, actual_sample_rate, PCM_BUFFER_SAMPLES) != ESP_OK;
+        if (!st->failed) {
+            st->segment = heap_caps_malloc(time_stretch_output_frames(&st->ts) * 2 * sizeof(int16_t),
+                                           MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            st->failed = st->segment == NULL;
+            if (st->failed) {
+                time_stretch_free(&st->ts);
+            }
+        }
+        st->ready = !st->failed;
+        if (st->failed) {
+            ESP_LOGW(TAG, "Time stretch unavailable, playing at normal speed");
+        }
+    }
+    if (!st->ready || (speed == 100 && !st->active)) {
+        write_pcm(pcm, frames, 100);
+        return;
+    }
+    if (speed == 100) {
+        stretch_drain(st);
+        write_pcm(pcm, frames, 100);
+        return;
+    }
+
+    if (!st->active) {
+        time_stretch_reset(&st->ts);
+        st->active = true;
+    }
+    time_stretch_set_speed(&st->ts, speed);
+    while (frames > 0) {
+        int taken = time_stretch_put(&st->ts, pcm, frames);
+        pcm += taken * 2;
+        frames -= taken;
+        for (;;) {
+            int64_t t = esp_timer_get_time();
+            TRACE_BEGIN(STRETCH);
+            int out = time_stretch_get(&st->ts, st->segment);
+            TRACE_END(STRETCH, out);
+            st->busy_us += esp_timer_get_time() - t;
+            if (out == 0) {
+                break;
+            }
+            write_pcm(st->segment, out, speed);
+        }
+        if (taken == 0) {
+            break;  // Cannot happen with put_max >= a decoded frame
+        }
+    }
+}
+
 // Audio decode and playback task
 static void audio_task(void* arg) {
     (void)arg;
     void* mp3_decoder = NULL;
     esp_audio_err_t ret;
 
-    ESP_LOGI(TAG, "Audio task started");
+    ESP_LOGI(TAG, "Audio task started (%s chunks)", chunks_whole_frames ? "whole-frame" : "byte-stream");
 
     // Create MP3 decoder
     ret = esp_mp3_dec_open(NULL, 0, &mp3_decoder);
@@ -258,6 +397,8 @@ static void audio_task(void* arg) {
         goto cleanup;
     }
 
+    stretch_state_t stretch = {0};
+
     // Diagnostics
     uint32_t chunks_received = 0;
     uint32_t frames_decoded = 0;
@@ -272,6 +413,9 @@ static void audio_task(void* arg) {
         if (xQueueReceive(audio_queue, &chunk, wait_time) != pdTRUE) {
             if (stream_ended) {
                 // No more chunks and stream ended
+                if (stretch.active) {
+                    stretch_drain(&stretch);
+                }
                 ESP_LOGI(TAG, "=== AUDIO END: samples=%llu ===", (unsigned long long)samples_written);
                 ESP_LOGI(TAG, "=== AUDIO STATS: chunks=%lu, decoded=%lu, errors=%lu ===",
                          (unsigned long)chunks_received, (unsigned long)frames_decoded,
@@ -286,9 +430,21 @@ static void audio_task(void* arg) {
         // Decode MP3 chunk - may contain multiple frames
         size_t consumed = 0;
         while (consumed < chunk.size && !audio_stop_requested) {
+            // Whole-frame chunks: hand the decoder exactly one frame, so nothing
+            // is ever carried into the next chunk and a bad frame is skipped
+            // without losing sync
+            size_t frame_size = 0;
+            if (chunks_whole_frames) {
+                frame_size = mp3_frame_parse(chunk.data + consumed, chunk.size - consumed, NULL);
+                if (frame_size == 0 || frame_size > chunk.size - consumed) {
+                    frames_errors++;
+                    break;
+                }
+            }
+
             esp_audio_dec_in_raw_t raw = {
                 .buffer = chunk.data + consumed,
-                .len = chunk.size - consumed,
+                .len = frame_size ? frame_size : chunk.size - consumed,
                 .consumed = 0,
                 .frame_recover = ESP_AUDIO_DEC_RECOVERY_NONE,
             };
@@ -301,43 +457,19 @@ static void audio_task(void* arg) {
             };
 
             esp_audio_dec_info_t dec_info = {0};
+            TRACE_BEGIN(AUDIO_DECODE);
             ret = esp_mp3_dec_decode(mp3_decoder, &raw, &frame, &dec_info);
+            TRACE_END(AUDIO_DECODE, frame.decoded_size / 4);
 
             if (ret == ESP_AUDIO_ERR_OK && frame.decoded_size > 0) {
                 frames_decoded++;
-
-                // Log format info once
-                static bool format_logged = false;
-                if (!format_logged) {
-                    ESP_LOGI(TAG, "Audio format: %d Hz, %d ch, %d bits",
-                             dec_info.sample_rate, dec_info.channel, dec_info.bits_per_sample);
-                    if (dec_info.sample_rate > 0) {
-                        actual_sample_rate = dec_info.sample_rate;
-                    }
-                    format_logged = true;
-                }
-
-                // Copy to aligned PCM buffer with 50% volume
-                size_t copy_size = frame.decoded_size;
-                if (copy_size > PCM_BUFFER_SIZE) {
-                    copy_size = PCM_BUFFER_SIZE;
-                }
-
-                int16_t* src = (int16_t*)frame_buffer;
-                int16_t* dst = pcm_buffer;
-                size_t num_samples = copy_size / 2;
-                for (size_t i = 0; i < num_samples; i++) {
-                    dst[i] = src[i] >> 1;
-                }
-
-                // Write to I2S
-                size_t bytes_written = 0;
-                i2s_channel_write(i2s_tx_handle, pcm_buffer, copy_size,
-                                  &bytes_written, portMAX_DELAY);
-
-                samples_written += bytes_written / 4;
-
-                consumed += raw.consumed;
+                take_format(&dec_info);
+                output_pcm(&stretch, (const int16_t*)frame_buffer, frame.decoded_size / (2 * sizeof(int16_t)));
+                consumed += frame_size ? frame_size : raw.consumed;
+            } else if (frame_size) {
+                // A whole frame that does not decode: drop just that frame
+                frames_errors++;
+                consumed += frame_size;
             } else if (raw.consumed > 0) {
                 // Decoder consumed data but didn't output (partial frame)
                 consumed += raw.consumed;
@@ -363,6 +495,14 @@ static void audio_task(void* arg) {
         }
     }
 
+    if (stretch.ready) {
+        if (stretch.ts.segments > 0) {
+            ESP_LOGI(TAG, "Time stretch: %lu segments, %lld us per segment",
+                     (unsigned long)stretch.ts.segments, stretch.busy_us / stretch.ts.segments);
+        }
+        time_stretch_free(&stretch.ts);
+        heap_caps_free(stretch.segment);
+    }
     heap_caps_free(frame_buffer);
 
 cleanup:
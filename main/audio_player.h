@@ -12,6 +12,15 @@ esp_err_t audio_player_init(void);
 // Creates audio task and queue for receiving chunks
 esp_err_t audio_player_start(void);
 
+// Start audio playback with the position counting from position_ms, for
+// continuing a stream after a seek
+esp_err_t audio_player_start_at(uint32_t position_ms);
+
+// Declare that every chunk of the next stream holds whole MP3 frames
+// (AVI_FLAG_AUDIO_ALIGNED); the decoder then takes one frame per call and
+// never carries partial data between chunks. Call before audio_player_start()
+void audio_player_set_whole_frames(bool whole_frames);
+
 // Push audio chunk to playback queue (called from main loop)
 // Data is copied, caller can reuse buffer after return
 // Returns ESP_OK on success, ESP_ERR_TIMEOUT if queue is full
@@ -27,8 +36,16 @@ void audio_player_stop(void);
 bool audio_player_is_playing(void);
 
 // Get current playback position in milliseconds (for A/V sync)
+// Counts media time: at 200% speed a second of output is two seconds of the stream
 uint32_t audio_player_get_position_ms(void);
 
+// Play at speed_percent of normal tempo (50-200), pitch preserved by the
+// time stretcher; takes effect with the next decoded frame
+void audio_player_set_speed(int speed_percent);
+
+// Chunks waiting in the queue; capacity (may be NULL) receives the queue length
+uint32_t audio_player_queued_chunks(uint32_t* capacity);
+
 // Set volume (0-100)
 void audio_player_set_volume(int volume);
 
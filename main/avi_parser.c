@@ -1,9 +1,9 @@
 // AVI Parser - RIFF/AVI container parsing for MJPEG video (file streaming)
 
 #include "avi_parser.h"
-#include "fastopen.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char* TAG = "avi_parser";
@@ -11,24 +11,34 @@ static const char* TAG = "avi_parser";
 // Maximum size for a single video frame (100KB should be plenty for MJPEG)
 #define MAX_FRAME_SIZE (100 * 1024)
 
+// Read-ahead hint passed to the source after each chunk
+#define PREFETCH_SIZE (64 * 1024)
+
 // Buffer size for reading AVI headers
 #define HEADER_BUFFER_SIZE (16 * 1024)
 
+// How far past a corrupt chunk header to look for the next valid one
+#define RESYNC_LIMIT (2 * MAX_FRAME_SIZE)
+#define RESYNC_WINDOW 256
+
 // RIFF/AVI chunk IDs (little-endian FourCC)
 #define FOURCC_RIFF 0x46464952  // "RIFF"
 #define FOURCC_AVI  0x20495641  // "AVI "
 #define FOURCC_LIST 0x5453494C  // "LIST"
 #define FOURCC_HDRL 0x6C726468  // "hdrl"
 #define FOURCC_MOVI 0x69766F6D  // "movi"
+#define FOURCC_INFO 0x4F464E49  // "INFO"
 #define FOURCC_AVIH 0x68697661  // "avih"
 #define FOURCC_STRH 0x68727473  // "strh"
 #define FOURCC_STRF 0x66727473  // "strf"
+#define FOURCC_STRN 0x6E727473  // "strn"
 #define FOURCC_VIDS 0x73646976  // "vids"
 #define FOURCC_AUDS 0x73647561  // "auds"
+#define FOURCC_JUNK 0x4B4E554A  // "JUNK"
 
 // Read a 32-bit little-endian value
 static inline uint32_t read_u32_le(const uint8_t* p) {
-    return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
 // Read a 16-bit little-endian value
@@ -36,9 +46,64 @@ static inline uint16_t read_u16_le(const uint8_t* p) {
     return p[0] | (p[1] << 8);
 }
 
-// Read bytes from file at current position
-static bool read_bytes(FILE* f, uint8_t* buf, size_t count) {
-    return fread(buf, 1, count, f) == count;
+// Chunk IDs that can appear in a movi list: "##dc", "##wb" (two stream digits,
+// two lowercase letters), "ix##" indexes, padding and lists
+static bool is_movi_chunk_id(uint32_t id) {
+    uint8_t c0 = id & 0xFF, c1 = (id >> 8) & 0xFF, c2 = (id >> 16) & 0xFF, c3 = id >> 24;
+    bool digits01 = c0 >= '0' && c0 <= '9' && c1 >= '0' && c1 <= '9';
+    bool digits23 = c2 >= '0' && c2 <= '9' && c3 >= '0' && c3 <= '9';
+    if (digits01) {
+        return c2 >= 'a' && c2 <= 'z' && c3 >= 'a' && c3 <= 'z';
+    }
+    return (c0 == 'i' && c1 == 'x' && digits23) || id == FOURCC_JUNK || id == FOURCC_LIST;
+}
+
+// A plausible chunk header at pos: known ID and a size inside the movi list
+static bool movi_header_valid(const avi_parser_t* parser, size_t pos, const uint8_t* header) {
+    uint32_t chunk_size = read_u32_le(header + 4);
+    return is_movi_chunk_id(read_u32_le(header)) && chunk_size <= parser->movi_end - pos - 8;
+}
+
+// Scan forward from a corrupt header for the next valid one (seekable sources only)
+// Returns true with current_pos on it, false when none is found within RESYNC_LIMIT
+static bool resync(avi_parser_t* parser) {
+    uint8_t window[RESYNC_WINDOW + 8];
+    size_t start = parser->current_pos;
+    size_t pos = start + 1;
+    size_t limit = parser->movi_end - pos < RESYNC_LIMIT ? parser->movi_end : pos + RESYNC_LIMIT;
+
+    while (pos + 8 <= limit) {
+        size_t count = limit - pos < sizeof(window) ? limit - pos : sizeof(window);
+        if (!avi_source_read(&parser->source, pos, window, count)) {
+            break;
+        }
+        for (size_t i = 0; i + 8 <= count; i++) {
+            if (movi_header_valid(parser, pos + i, window + i)) {
+                parser->current_pos = pos + i;
+                ESP_LOGW(TAG, "Corrupt chunk header at %zu, resynced %zu bytes later", start, pos + i - start);
+                return true;
+            }
+        }
+        pos += count - 7;
+    }
+
+    ESP_LOGE(TAG, "Corrupt chunk header at %zu, no valid chunk follows", start);
+    return false;
+}
+
+// Get pointer to chunk payload, zero-copy when the source allows it
+static const uint8_t* map_or_buffer_payload(avi_parser_t* parser, size_t offset, size_t size) {
+    const uint8_t* data = avi_source_map(&parser->source, offset, size);
+    if (data) {
+        return data;
+    }
+    if (!parser->frame_buffer || size > parser->frame_buffer_size) {
+        return NULL;
+    }
+    if (!avi_source_read(&parser->source, offset, parser->frame_buffer, size)) {
+        return NULL;
+    }
+    return parser->frame_buffer;
 }
 
 // Parse AVI main header (avih chunk)
@@ -50,49 +115,44 @@ static void parse_avih(const uint8_t* data, size_t size, avi_info_t* info) {
     info->width = read_u32_le(data + 32);
     info->height = read_u32_le(data + 36);
     info->video_frames = read_u32_le(data + 16);
+    info->max_bytes_per_sec = read_u32_le(data + 4);
 
     ESP_LOGI(TAG, "AVI header: %lux%lu @ %lu fps, %lu frames",
              (unsigned long)info->width, (unsigned long)info->height,
              (unsigned long)info->fps, (unsigned long)info->video_frames);
 }
 
-// Parse stream header (strh chunk)
-static void parse_strh(const uint8_t* data, size_t size, avi_info_t* info,
-                       bool* is_video, bool* is_audio) {
+// Parse stream header (strh chunk) into a new stream table entry
+static void parse_strh(const uint8_t* data, size_t size, avi_stream_t* stream) {
     if (size < 48) return;
 
-    uint32_t fcc_type = read_u32_le(data);
+    stream->type = read_u32_le(data);
+    stream->language = read_u16_le(data + 14);
+    stream->scale = read_u32_le(data + 20);
+    stream->rate = read_u32_le(data + 24);
+    stream->length = read_u32_le(data + 32);
+    stream->sample_size = read_u32_le(data + 44);
 
-    if (fcc_type == FOURCC_VIDS) {
-        *is_video = true;
-        info->has_video = true;
-        uint32_t scale = read_u32_le(data + 20);
-        uint32_t rate = read_u32_le(data + 24);
-        if (scale > 0) {
-            info->fps = rate / scale;
-        }
-        ESP_LOGI(TAG, "Video stream: rate=%lu scale=%lu fps=%lu",
-                 (unsigned long)rate, (unsigned long)scale, (unsigned long)info->fps);
-    } else if (fcc_type == FOURCC_AUDS) {
-        *is_audio = true;
-        info->has_audio = true;
-        ESP_LOGI(TAG, "Audio stream found");
-    }
+    char fourcc[5] = {0};
+    memcpy(fourcc, data, 4);
+    ESP_LOGI(TAG, "Stream %s: rate=%lu scale=%lu language=0x%04x", fourcc, (unsigned long)stream->rate,
+             (unsigned long)stream->scale, stream->language);
 }
 
 // Parse stream format (strf chunk) for video
-static void parse_strf_video(const uint8_t* data, size_t size, avi_info_t* info) {
+static void parse_strf_video(const uint8_t* data, size_t size, avi_stream_t* stream) {
     if (size < 40) return;
 
     uint32_t width = read_u32_le(data + 4);
     uint32_t height = read_u32_le(data + 8);
 
     if ((int32_t)height < 0) {
-        height = (uint32_t)(-(int32_t)height);
+        height = 0u - height;  // Top-down bitmap
     }
 
-    info->width = width;
-    info->height = height;
+    stream->width = width;
+    stream->height = height;
+    stream->codec = read_u32_le(data + 16);
 
     char fourcc[5] = {0};
     memcpy(fourcc, data + 16, 4);
@@ -100,34 +160,160 @@ static void parse_strf_video(const uint8_t* data, size_t size, avi_info_t* info)
              (unsigned long)width, (unsigned long)height, fourcc);
 }
 
+// Parse stream format (strf chunk) for audio (WAVEFORMATEX)
+static void parse_strf_audio(const uint8_t* data, size_t size, avi_stream_t* stream) {
+    if (size < 16) return;
+
+    stream->audio_format = read_u16_le(data);
+    stream->audio_channels = read_u16_le(data + 2);
+    stream->audio_sample_rate = read_u32_le(data + 4);
+    stream->audio_bytes_per_sec = read_u32_le(data + 8);
+    stream->audio_block_align = read_u16_le(data + 12);
+    stream->audio_bits_per_sample = read_u16_le(data + 14);
+
+    ESP_LOGI(TAG, "Audio format: 0x%04x %lu Hz, %u ch, %lu bytes/s", stream->audio_format,
+             (unsigned long)stream->audio_sample_rate, stream->audio_channels,
+             (unsigned long)stream->audio_bytes_per_sec);
+}
+
+// Parse stream name (strn chunk), NUL-terminated text
+static void parse_strn(const uint8_t* data, size_t size, avi_stream_t* stream) {
+    size_t len = 0;
+    while (len < size && len < sizeof(stream->name) - 1 && data[len]) {
+        len++;
+    }
+    memcpy(stream->name, data, len);
+    stream->name[len] = '\0';
+}
+
+// Describe the selected video stream in the info's video fields
+static void apply_video_stream(avi_info_t* info) {
+    info->has_video = info->video_stream >= 0;
+    if (!info->has_video) {
+        return;
+    }
+    const avi_stream_t* stream = &info->streams[info->video_stream];
+    if (stream->scale > 0) {
+        info->fps = stream->rate / stream->scale;
+    }
+    info->video_scale = stream->scale;
+    info->video_rate = stream->rate;
+    if (stream->width > 0) {
+        info->width = stream->width;
+        info->height = stream->height;
+        info->video_codec = stream->codec;
+    }
+}
+
+// Describe the selected audio stream in the info's audio fields
+static void apply_audio_stream(avi_info_t* info) {
+    static const avi_stream_t none;
+    info->has_audio = info->audio_stream >= 0;
+    const avi_stream_t* stream = info->has_audio ? &info->streams[info->audio_stream] : &none;
+    info->audio_scale = stream->scale;
+    info->audio_rate = stream->rate;
+    info->audio_sample_size = stream->sample_size;
+    info->audio_format = stream->audio_format;
+    info->audio_channels = stream->audio_channels;
+    info->audio_sample_rate = stream->audio_sample_rate;
+    info->audio_bytes_per_sec = stream->audio_bytes_per_sec;
+    info->audio_block_align = stream->audio_block_align;
+    info->audio_bits_per_sample = stream->audio_bits_per_sample;
+}
+
+// Parse our playback info chunk
+static void parse_playback_info(const uint8_t* data, size_t size, avi_info_t* info) {
+    if (size < sizeof(avi_playback_info_t) || read_u32_le(data) != AVI_PLAYBACK_INFO_VERSION) return;
+
+    memcpy(&info->playback, data, sizeof(avi_playback_info_t));
+    info->has_playback_info = true;
+
+    ESP_LOGI(TAG, "Playback info: flags=0x%lx max video=%lu audio=%lu, peak %lu bytes/frame",
+             (unsigned long)info->playback.flags, (unsigned long)info->playback.max_video_size,
+             (unsigned long)info->playback.max_audio_size, (unsigned long)info->playback.peak_bytes[0]);
+}
+
 // Parse header list from buffer
+// Declared sizes are clamped to the buffer: a chunk cut off by the end of the
+// buffer (or lying about its size) is parsed as far as it goes and ends the list
+// Every strh starts a stream, numbered in order; the first video and the
+// first audio stream are selected
 static void parse_hdrl_buffer(const uint8_t* buffer, size_t size, avi_info_t* info) {
-    bool current_is_video = false;
-    bool current_is_audio = false;
+    avi_stream_t* current = NULL;
+    int streams = 0;
     size_t offset = 0;
 
     while (offset + 8 <= size) {
         uint32_t chunk_id = read_u32_le(buffer + offset);
         uint32_t chunk_size = read_u32_le(buffer + offset + 4);
+        size_t available = size - offset - 8;
+        size_t body_size = chunk_size < available ? chunk_size : available;
+        const uint8_t* body = buffer + offset + 8;
 
         if (chunk_id == FOURCC_AVIH) {
-            parse_avih(buffer + offset + 8, chunk_size, info);
+            parse_avih(body, body_size, info);
         } else if (chunk_id == FOURCC_LIST) {
             offset += 12;
             continue;
         } else if (chunk_id == FOURCC_STRH) {
-            parse_strh(buffer + offset + 8, chunk_size, info,
-                      &current_is_video, &current_is_audio);
-        } else if (chunk_id == FOURCC_STRF) {
-            if (current_is_video) {
-                parse_strf_video(buffer + offset + 8, chunk_size, info);
+            // Streams past the table keep their number, their chunks are skipped
+            current = streams < AVI_MAX_STREAMS ? &info->streams[streams] : NULL;
+            streams++;
+            if (current) {
+                parse_strh(body, body_size, current);
             }
-            current_is_video = false;
-            current_is_audio = false;
+        } else if (chunk_id == FOURCC_STRF && current) {
+            if (current->type == FOURCC_VIDS) {
+                parse_strf_video(body, body_size, current);
+            } else if (current->type == FOURCC_AUDS) {
+                parse_strf_audio(body, body_size, current);
+            }
+        } else if (chunk_id == FOURCC_STRN && current) {
+            parse_strn(body, body_size, current);
+        } else if (chunk_id == AVI_FOURCC_PLAYBACK_INFO) {
+            parse_playback_info(body, body_size, info);
+        }
+
+        if (chunk_size >= available) {
+            break;
         }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
 
-        offset += 8 + chunk_size;
-        if (chunk_size & 1) offset++;
+    info->stream_count = streams < AVI_MAX_STREAMS ? streams : AVI_MAX_STREAMS;
+    if (streams > AVI_MAX_STREAMS) {
+        ESP_LOGW(TAG, "%d streams, only the first %d are used", streams, AVI_MAX_STREAMS);
+    }
+    info->video_stream = -1;
+    info->audio_stream = -1;
+    for (int i = info->stream_count - 1; i >= 0; i--) {
+        if (info->streams[i].type == FOURCC_VIDS) {
+            info->video_stream = i;
+        } else if (info->streams[i].type == FOURCC_AUDS) {
+            info->audio_stream = i;
+        }
+    }
+    apply_video_stream(info);
+    apply_audio_stream(info);
+}
+
+// Find our chapter text among the LIST INFO entries at offset (its data)
+static void parse_info_list(avi_parser_t* parser, size_t offset, size_t size) {
+    size_t end = offset + size;
+    uint8_t header[8];
+    while (offset + 8 <= end && avi_source_read(&parser->source, offset, header, 8)) {
+        uint32_t id = read_u32_le(header);
+        uint32_t chunk_size = read_u32_le(header + 4);
+        if (chunk_size > end - offset - 8) {
+            break;
+        }
+        if (id == AVI_FOURCC_CHAPTERS) {
+            parser->info.chapters_offset = offset + 8;
+            parser->info.chapters_size = chunk_size;
+            ESP_LOGI(TAG, "Chapters: %lu bytes", (unsigned long)chunk_size);
+            return;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
     }
 }
 
@@ -136,8 +322,7 @@ static esp_err_t parse_avi_headers(avi_parser_t* parser) {
     uint8_t header[12];
 
     // Read and verify RIFF header
-    fseek(parser->file, 0, SEEK_SET);
-    if (!read_bytes(parser->file, header, 12)) {
+    if (!avi_source_read(&parser->source, 0, header, 12)) {
         ESP_LOGE(TAG, "Failed to read RIFF header");
         return ESP_ERR_INVALID_STATE;
     }
@@ -155,40 +340,53 @@ static esp_err_t parse_avi_headers(avi_parser_t* parser) {
              parser->file_size, (unsigned long)riff_size);
 
     // Scan for hdrl and movi lists
+    parser->info.video_stream = -1;
+    parser->info.audio_stream = -1;
     size_t offset = 12;
     uint8_t chunk_header[12];
 
     while (offset + 12 <= parser->file_size) {
-        fseek(parser->file, offset, SEEK_SET);
-        if (!read_bytes(parser->file, chunk_header, 12)) {
+        if (!avi_source_read(&parser->source, offset, chunk_header, 12)) {
             break;
         }
 
         uint32_t chunk_id = read_u32_le(chunk_header);
         uint32_t chunk_size = read_u32_le(chunk_header + 4);
 
-        if (chunk_id == FOURCC_LIST) {
+        if (chunk_id == FOURCC_LIST && chunk_size >= 4) {
             uint32_t list_type = read_u32_le(chunk_header + 8);
 
             if (list_type == FOURCC_HDRL) {
-                // Read header list into temporary buffer and parse
+                // Read header list into temporary buffer and parse (never past the end of the file)
                 size_t hdrl_size = chunk_size - 4;
                 if (hdrl_size > HEADER_BUFFER_SIZE) {
                     hdrl_size = HEADER_BUFFER_SIZE;
                 }
+                if (hdrl_size > parser->file_size - offset - 12) {
+                    hdrl_size = parser->file_size - offset - 12;
+                }
 
-                uint8_t* hdrl_buffer = malloc(hdrl_size);
-                if (hdrl_buffer) {
-                    fseek(parser->file, offset + 12, SEEK_SET);
-                    if (read_bytes(parser->file, hdrl_buffer, hdrl_size)) {
-                        parse_hdrl_buffer(hdrl_buffer, hdrl_size, &parser->info);
+                const uint8_t* hdrl_data = avi_source_map(&parser->source, offset + 12, hdrl_size);
+                if (hdrl_data) {
+                    parse_hdrl_buffer(hdrl_data, hdrl_size, &parser->info);
+                } else {
+                    uint8_t* hdrl_buffer = malloc(hdrl_size);
+                    if (hdrl_buffer) {
+                        if (avi_source_read(&parser->source, offset + 12, hdrl_buffer, hdrl_size)) {
+                            parse_hdrl_buffer(hdrl_buffer, hdrl_size, &parser->info);
+                        }
+                        free(hdrl_buffer);
                     }
-                    free(hdrl_buffer);
                 }
+            } else if (list_type == FOURCC_INFO && chunk_size - 4 <= parser->file_size - offset - 12) {
+                parse_info_list(parser, offset + 12, chunk_size - 4);
             } else if (list_type == FOURCC_MOVI) {
-                // Found movi list
+                // Found movi list, a truncated file ends at its last byte
                 parser->movi_start = offset + 12;
-                parser->movi_end = offset + 8 + chunk_size;
+                parser->movi_end = parser->movi_start + (chunk_size - 4);
+                if (chunk_size - 4 > parser->file_size - parser->movi_start) {
+                    parser->movi_end = parser->file_size;
+                }
                 parser->current_pos = parser->movi_start;
 
                 ESP_LOGI(TAG, "Found movi list: offset=%zu size=%zu",
@@ -203,8 +401,12 @@ static esp_err_t parse_avi_headers(avi_parser_t* parser) {
             }
         }
 
-        offset += 8 + chunk_size;
-        if (chunk_size & 1) offset++;
+        // A chunk reaching past the end of the file ends the scan (and the
+        // size check keeps offset from wrapping with 32-bit size_t)
+        if (chunk_size > parser->file_size - offset - 8) {
+            break;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
     }
 
     ESP_LOGE(TAG, "movi list not found");
@@ -216,58 +418,201 @@ esp_err_t avi_parser_open(avi_parser_t* parser, const char* path) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    memset(parser, 0, sizeof(avi_parser_t));
-
     // Open file with fast I/O
-    parser->file = fastopen(path, "rb");
-    if (!parser->file) {
+    avi_source_t source;
+    esp_err_t ret = avi_source_open_file(&source, path);
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open AVI file: %s", path);
-        return ESP_ERR_NOT_FOUND;
+        return ret;
     }
 
-    // Get file size
-    fseek(parser->file, 0, SEEK_END);
-    parser->file_size = ftell(parser->file);
-    fseek(parser->file, 0, SEEK_SET);
+    return avi_parser_open_source(parser, &source);
+}
 
-    // Allocate frame buffer in PSRAM
-    parser->frame_buffer_size = MAX_FRAME_SIZE;
-    parser->frame_buffer = heap_caps_malloc(parser->frame_buffer_size, MALLOC_CAP_SPIRAM);
-    if (!parser->frame_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate frame buffer (%zu bytes)", parser->frame_buffer_size);
-        fastclose(parser->file);
-        parser->file = NULL;
-        return ESP_ERR_NO_MEM;
+esp_err_t avi_parser_open_source(avi_parser_t* parser, avi_source_t* source) {
+    if (!parser || !source || !source->ops) {
+        return ESP_ERR_INVALID_ARG;
     }
 
+    memset(parser, 0, sizeof(avi_parser_t));
+    parser->source = *source;
+    memset(source, 0, sizeof(avi_source_t));
+    parser->file_size = parser->source.size;
+
+    // Mappable sources hand out chunk pointers directly, others need a frame buffer in PSRAM
+    parser->frame_buffer_size = MAX_FRAME_SIZE;
+
     // Parse headers
     esp_err_t ret = parse_avi_headers(parser);
     if (ret != ESP_OK) {
-        heap_caps_free(parser->frame_buffer);
-        parser->frame_buffer = NULL;
-        fastclose(parser->file);
-        parser->file = NULL;
+        avi_source_close(&parser->source);
         return ret;
     }
 
+    // Files from our muxer declare their largest chunk, shrink the buffer to fit exactly
+    const avi_playback_info_t* playback = &parser->info.playback;
+    if (parser->info.has_playback_info) {
+        size_t largest = playback->max_video_size > playback->max_audio_size ? playback->max_video_size
+                                                                               : playback->max_audio_size;
+        if (largest > 0 && largest < parser->frame_buffer_size) {
+            parser->frame_buffer_size = largest;
+        }
+    }
+
+    if (!avi_source_can_map(&parser->source)) {
+        parser->frame_buffer = heap_caps_malloc(parser->frame_buffer_size, MALLOC_CAP_SPIRAM);
+        if (!parser->frame_buffer) {
+            ESP_LOGE(TAG, "Failed to allocate frame buffer (%zu bytes)", parser->frame_buffer_size);
+            avi_source_close(&parser->source);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    ESP_LOGI(TAG, "Reading via %s source%s", parser->source.ops->name,
+             avi_source_can_map(&parser->source) ? " (zero-copy)" : "");
     return ESP_OK;
 }
 
+esp_err_t avi_parser_probe(const char* path, avi_info_t* info) {
+    if (!path || !info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    avi_parser_t parser;
+    memset(&parser, 0, sizeof(parser));
+    esp_err_t ret = avi_source_open_file(&parser.source, path);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open AVI file: %s", path);
+        return ret;
+    }
+    parser.file_size = parser.source.size;
+
+    ret = parse_avi_headers(&parser);
+    avi_source_close(&parser.source);
+    *info = parser.info;
+    return ret;
+}
+
 const avi_info_t* avi_parser_get_info(const avi_parser_t* parser) {
     return &parser->info;
 }
 
-esp_err_t avi_parser_next_chunk(avi_parser_t* parser, avi_chunk_t* chunk) {
-    if (!parser || !chunk || !parser->file) {
+// Route a movi chunk by its stream number and suffix: ##dc/##db of the
+// selected video stream, ##wb of the selected audio stream
+// Without a stream table (no strh) the suffix alone decides
+static avi_chunk_type_t chunk_type(const avi_info_t* info, uint32_t chunk_id) {
+    uint8_t c0 = chunk_id & 0xFF, c1 = (chunk_id >> 8) & 0xFF;
+    uint8_t type_hi = (chunk_id >> 16) & 0xFF;
+    uint8_t type_lo = (chunk_id >> 24) & 0xFF;
+    if (c0 < '0' || c0 > '9' || c1 < '0' || c1 > '9') {
+        return AVI_CHUNK_OTHER;
+    }
+    int stream = (c0 - '0') * 10 + (c1 - '0');
+    bool any = info->stream_count == 0;
+
+    if (type_hi == 'd' && (type_lo == 'c' || type_lo == 'b') && (any || stream == info->video_stream)) {
+        // Video: xxdc (compressed) or xxdb (uncompressed)
+        return AVI_CHUNK_VIDEO;
+    }
+    if (type_hi == 'w' && type_lo == 'b' && (any || stream == info->audio_stream)) {
+        // Audio: xxwb (wave bytes)
+        return AVI_CHUNK_AUDIO;
+    }
+    return AVI_CHUNK_OTHER;
+}
+
+// Codes for the primary language of a Windows LANGID (strh wLanguage)
+static const struct {
+    uint16_t primary;
+    char code[2][4];            // ISO 639-1 and 639-2
+} langid_codes[] = {
+    {0x04, {"zh", "zho"}}, {0x07, {"de", "deu"}}, {0x09, {"en", "eng"}}, {0x0A, {"es", "spa"}},
+    {0x0C, {"fr", "fra"}}, {0x10, {"it", "ita"}}, {0x11, {"ja", "jpn"}}, {0x13, {"nl", "nld"}},
+    {0x16, {"pt", "por"}}, {0x19, {"ru", "rus"}},
+};
+
+// Case-insensitive compare of len bytes of a with the string b
+static bool word_equals(const char* a, size_t len, const char* b) {
+    for (size_t i = 0; i < len; i++) {
+        char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] + 32 : a[i];
+        char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] + 32 : b[i];
+        if (x != y || !b[i]) {
+            return false;
+        }
+    }
+    return b[len] == '\0';
+}
+
+static bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c & 0x80);
+}
+
+// A stream in language: the whole name, one of its words, or its LANGID's code
+static bool stream_language_is(const avi_stream_t* stream, const char* language) {
+    if (word_equals(stream->name, strlen(stream->name), language)) {
+        return true;
+    }
+    for (const char* p = stream->name; *p;) {
+        const char* end = p;
+        while (is_word_char(*end)) {
+            end++;
+        }
+        if (end > p && word_equals(p, end - p, language)) {
+            return true;
+        }
+        p = *end ? end + 1 : end;
+    }
+    for (size_t i = 0; i < sizeof(langid_codes) / sizeof(langid_codes[0]); i++) {
+        if ((stream->language & 0x3FF) == langid_codes[i].primary) {
+            return word_equals(langid_codes[i].code[0], 2, language) ||
+                   word_equals(langid_codes[i].code[1], 3, language);
+        }
+    }
+    return false;
+}
+
+int avi_parser_find_audio(const avi_info_t* info, const char* language) {
+    if (!info || !language || !*language) {
+        return -1;
+    }
+    for (int i = 0; i < info->stream_count; i++) {
+        const avi_stream_t* stream = &info->streams[i];
+        if (stream->type == FOURCC_AUDS && stream_language_is(stream, language)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t avi_parser_select_audio(avi_parser_t* parser, int stream) {
+    if (!parser || stream < -1 || stream >= parser->info.stream_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream >= 0 && parser->info.streams[stream].type != FOURCC_AUDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    parser->info.audio_stream = stream;
+    apply_audio_stream(&parser->info);
+    if (stream >= 0) {
+        ESP_LOGI(TAG, "Audio track: stream %d \"%s\"", stream, parser->info.streams[stream].name);
+    } else {
+        ESP_LOGI(TAG, "Audio track: none");
+    }
+    return ESP_OK;
+}
+
+esp_err_t avi_parser_next_header(avi_parser_t* parser, avi_chunk_t* chunk) {
+    if (!parser || !chunk || !parser->source.ops) {
         return ESP_ERR_INVALID_ARG;
     }
 
     uint8_t chunk_header[8];
+    // Forward-only streams can't look ahead or back, they take sizes as declared
+    bool seekable = parser->source.size != AVI_SOURCE_SIZE_UNKNOWN;
 
     while (parser->current_pos + 8 <= parser->movi_end) {
-        // Seek to current position and read chunk header
-        fseek(parser->file, parser->current_pos, SEEK_SET);
-        if (!read_bytes(parser->file, chunk_header, 8)) {
+        // Read chunk header at current position
+        if (!avi_source_read(&parser->source, parser->current_pos, chunk_header, 8)) {
             ESP_LOGE(TAG, "Failed to read chunk header at %zu", parser->current_pos);
             break;
         }
@@ -275,74 +620,163 @@ esp_err_t avi_parser_next_chunk(avi_parser_t* parser, avi_chunk_t* chunk) {
         uint32_t chunk_id = read_u32_le(chunk_header);
         uint32_t chunk_size = read_u32_le(chunk_header + 4);
 
-        // Sanity check chunk size
-        if (chunk_size > parser->frame_buffer_size) {
-            ESP_LOGW(TAG, "Chunk too large: %lu bytes (max %zu), skipping",
-                     (unsigned long)chunk_size, parser->frame_buffer_size);
-            parser->current_pos += 8 + chunk_size;
-            if (chunk_size & 1) parser->current_pos++;
-            continue;
-        }
-
-        // Identify chunk type
-        uint8_t type_hi = (chunk_id >> 16) & 0xFF;
-        uint8_t type_lo = (chunk_id >> 24) & 0xFF;
-
-        // Video: xxdc (compressed) or xxdb (uncompressed)
-        if (type_hi == 'd' && (type_lo == 'c' || type_lo == 'b')) {
-            // Read video chunk data
-            if (!read_bytes(parser->file, parser->frame_buffer, chunk_size)) {
-                ESP_LOGE(TAG, "Failed to read video chunk data");
-                break;
+        // Garbage ID or a size past the end of the list: find the next real header
+        if (!movi_header_valid(parser, parser->current_pos, chunk_header)) {
+            if (seekable && resync(parser)) {
+                continue;
             }
-
-            chunk->type = AVI_CHUNK_VIDEO;
-            chunk->data = parser->frame_buffer;
-            chunk->size = chunk_size;
-
-            // Move to next chunk
-            parser->current_pos += 8 + chunk_size;
-            if (chunk_size & 1) parser->current_pos++;
-
-            return ESP_OK;
+            break;
         }
+        size_t next_pos = parser->current_pos + 8 + chunk_size + (chunk_size & 1);
+        avi_chunk_type_t type = chunk_type(&parser->info, chunk_id);
 
-        // Audio: xxwb (wave bytes)
-        if (type_hi == 'w' && type_lo == 'b') {
-            // Read audio chunk data
-            if (!read_bytes(parser->file, parser->frame_buffer, chunk_size)) {
-                ESP_LOGE(TAG, "Failed to read audio chunk data");
+        // Sanity check chunk size, skipping only when a valid header follows
+        // (a corrupt size would otherwise jump over good frames)
+        if (chunk_size > parser->frame_buffer_size) {
+            if (type != AVI_CHUNK_OTHER) {
+                ESP_LOGW(TAG, "Chunk too large: %lu bytes (max %zu), skipping",
+                         (unsigned long)chunk_size, parser->frame_buffer_size);
+            }
+            uint8_t next_header[8];
+            if (seekable && next_pos + 8 <= parser->movi_end &&
+                (!avi_source_read(&parser->source, next_pos, next_header, 8) ||
+                 !movi_header_valid(parser, next_pos, next_header))) {
+                if (resync(parser)) {
+                    continue;
+                }
                 break;
             }
+            parser->current_pos = next_pos;
+            continue;
+        }
 
-            chunk->type = AVI_CHUNK_AUDIO;
-            chunk->data = parser->frame_buffer;
-            chunk->size = chunk_size;
+        size_t payload_pos = parser->current_pos + 8;
 
-            // Move to next chunk
-            parser->current_pos += 8 + chunk_size;
-            if (chunk_size & 1) parser->current_pos++;
+        // Move to next chunk
+        parser->current_pos = next_pos;
 
-            return ESP_OK;
+        // Skip other chunks (index, unselected streams, etc.) by their header
+        if (type == AVI_CHUNK_OTHER) {
+            continue;
         }
 
-        // Skip other chunks (index, etc.)
-        parser->current_pos += 8 + chunk_size;
-        if (chunk_size & 1) parser->current_pos++;
+        // Hint the source about the chunk after this one
+        avi_source_prefetch(&parser->source, parser->current_pos, PREFETCH_SIZE);
+
+        chunk->type = type;
+        chunk->data = NULL;
+        chunk->size = chunk_size;
+        chunk->offset = payload_pos;
+        return ESP_OK;
     }
 
     chunk->type = AVI_CHUNK_END;
     chunk->data = NULL;
     chunk->size = 0;
+    chunk->offset = 0;
     return ESP_ERR_NOT_FOUND;
 }
 
+esp_err_t avi_parser_read_payload(avi_parser_t* parser, avi_chunk_t* chunk, uint8_t* dest, size_t dest_size) {
+    if (!parser || !chunk || !parser->source.ops) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint8_t* data;
+    if (dest) {
+        data = avi_source_read_into(&parser->source, chunk->offset, chunk->size, dest, dest_size);
+    } else {
+        data = map_or_buffer_payload(parser, chunk->offset, chunk->size);
+    }
+
+    if (!data) {
+        ESP_LOGE(TAG, "Failed to read %s chunk data at %zu", chunk->type == AVI_CHUNK_VIDEO ? "video" : "audio",
+                 chunk->offset);
+        return ESP_FAIL;
+    }
+
+    chunk->data = data;
+    return ESP_OK;
+}
+
+esp_err_t avi_parser_next_chunk(avi_parser_t* parser, avi_chunk_t* chunk) {
+    esp_err_t ret = avi_parser_next_header(parser, chunk);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = avi_parser_read_payload(parser, chunk, NULL, 0);
+    if (ret != ESP_OK) {
+        chunk->type = AVI_CHUNK_END;
+        chunk->data = NULL;
+        chunk->size = 0;
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t avi_parser_read_index(avi_parser_t* parser, uint32_t first, avi_index_entry_t* entries, uint32_t count) {
+    if (!parser || !entries || !parser->source.ops) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const avi_playback_info_t* playback = &parser->info.playback;
+    if (!parser->info.has_playback_info || playback->index_offset == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (first > playback->frame_count || count > playback->frame_count - first) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Entries follow the 8-byte chunk header and have to lie inside the file
+    // (64-bit math, the header values are untrusted and size_t is 32 bits on the badge)
+    uint64_t offset = (uint64_t)playback->index_offset + 8 + (uint64_t)first * sizeof(avi_index_entry_t);
+    uint64_t bytes = (uint64_t)count * sizeof(avi_index_entry_t);
+    if (offset > parser->file_size || bytes > parser->file_size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!avi_source_read(&parser->source, (size_t)offset, entries, (size_t)bytes)) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t avi_parser_read_chapters(avi_parser_t* parser, char* text, size_t capacity) {
+    if (!parser || !text || capacity == 0 || !parser->source.ops) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    text[0] = '\0';
+    if (parser->info.chapters_offset == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t size = parser->info.chapters_size < capacity - 1 ? parser->info.chapters_size : capacity - 1;
+    if (!avi_source_read(&parser->source, parser->info.chapters_offset, text, size)) {
+        return ESP_FAIL;
+    }
+    text[size] = '\0';
+    return ESP_OK;
+}
+
 void avi_parser_rewind(avi_parser_t* parser) {
     if (parser) {
         parser->current_pos = parser->movi_start;
     }
 }
 
+esp_err_t avi_parser_seek(avi_parser_t* parser, size_t offset) {
+    if (!parser || !parser->source.ops) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (parser->source.size == AVI_SOURCE_SIZE_UNKNOWN) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (offset < parser->movi_start + 8 || offset > parser->movi_end) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    parser->current_pos = offset - 8;
+    return ESP_OK;
+}
+
 void avi_parser_close(avi_parser_t* parser) {
     if (!parser) return;
 
@@ -351,10 +785,8 @@ void avi_parser_close(avi_parser_t* parser) {
         parser->frame_buffer = NULL;
     }
 
-    if (parser->file) {
-        fastclose(parser->file);
-        parser->file = NULL;
-    }
+    avi_source_log_stats(&parser->source);
+    avi_source_close(&parser->source);
 
     parser->file_size = 0;
     parser->movi_start = 0;
@@ -4,10 +4,71 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include "esp_err.h"
+#include "avi_source.h"
+
+// Build a little-endian FourCC chunk ID
+#define AVI_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+// Chunks written by our muxer (host/avi_remux)
+#define AVI_FOURCC_PLAYBACK_INFO AVI_FOURCC('h', 'h', 'g', 'i')  // In hdrl: avi_playback_info_t
+#define AVI_FOURCC_FRAME_INDEX   AVI_FOURCC('h', 'h', 'i', 'x')  // After movi: avi_index_entry_t[]
+#define AVI_FOURCC_CHAPTERS      AVI_FOURCC('I', 'C', 'H', 'P')  // In LIST INFO: "[h:]m:ss[.mmm] title" lines
+
+#define AVI_PLAYBACK_INFO_VERSION 1
+#define AVI_PEAK_WINDOWS          8     // Peak tables over 1, 2, 4 .. 128 frames
+
+// Playback info flags
+#define AVI_FLAG_SECTOR_ALIGNED   (1 << 0)  // Every video payload starts on a 512-byte boundary
+#define AVI_FLAG_AUDIO_PER_FRAME  (1 << 1)  // Exactly one audio chunk before each video chunk
+#define AVI_FLAG_PRE_ROTATED      (1 << 2)  // Frames are stored in framebuffer orientation (transposed)
+#define AVI_FLAG_AUDIO_ALIGNED    (1 << 3)  // Every audio chunk holds whole MP3 frames
+
+// Playback info chunk, stored as-is (little-endian) in the file
+typedef struct {
+    uint32_t version;
+    uint32_t flags;
+    uint32_t frame_count;
+    uint32_t max_video_size;    // Largest video payload
+    uint32_t max_audio_size;    // Largest audio payload
+    uint32_t index_offset;      // File offset of the frame index chunk, 0 if none
+    uint32_t peak_bytes[AVI_PEAK_WINDOWS];  // Most bytes on disk over 2^i consecutive frames
+} avi_playback_info_t;
+
+// Frame index entry, one per video frame (payload offsets, 0 size = no chunk)
+typedef struct {
+    uint32_t video_offset;
+    uint32_t video_size;
+    uint32_t audio_offset;
+    uint32_t audio_size;
+} avi_index_entry_t;
+
+#define AVI_MAX_STREAMS           8     // Streams described, chunks of later ones are skipped
+#define AVI_STREAM_NAME_MAX       32    // strn text kept, including the NUL
+
+// One stream of the header list; its chunks carry its position as two
+// digits ("01wb" = the second strl)
+typedef struct {
+    uint32_t type;                  // strh fccType: vids, auds, txts ...
+    uint32_t scale;                 // Time base, scale/rate seconds per frame or block
+    uint32_t rate;
+    uint32_t sample_size;
+    uint32_t length;                // In scale/rate units
+    uint16_t language;              // strh wLanguage (Windows LANGID), 0 = not given
+    uint32_t codec;                 // Video: compression FourCC from strf
+    uint32_t width;
+    uint32_t height;
+    uint16_t audio_format;          // Audio: WAVEFORMATEX from strf
+    uint16_t audio_channels;
+    uint16_t audio_bits_per_sample;
+    uint16_t audio_block_align;
+    uint32_t audio_sample_rate;
+    uint32_t audio_bytes_per_sec;
+    char name[AVI_STREAM_NAME_MAX]; // strn, often the language of an audio track; "" = none
+} avi_stream_t;
 
 // AVI stream info
+// The video and audio fields describe the selected streams
 typedef struct {
     uint32_t width;
     uint32_t height;
@@ -16,33 +77,52 @@ typedef struct {
     uint32_t audio_sample_rate;
     uint16_t audio_channels;
     uint16_t audio_bits_per_sample;
+    uint16_t audio_format;          // WAVE format tag (0x55 = MP3)
+    uint16_t audio_block_align;
+    uint32_t audio_bytes_per_sec;
+    uint32_t audio_scale;           // Audio stream time base (strh)
+    uint32_t audio_rate;
+    uint32_t audio_sample_size;     // 0 = every chunk is one block of scale/rate seconds
+    uint32_t video_scale;           // Video frame duration is scale/rate seconds
+    uint32_t video_rate;
+    uint32_t video_codec;           // Compression FourCC from strf (MJPG)
+    uint32_t max_bytes_per_sec;     // Peak data rate declared in avih, 0 = not given
+    uint32_t chapters_offset;       // File offset of the ICHP text in LIST INFO, 0 = none
+    uint32_t chapters_size;
     bool has_video;
     bool has_audio;
+    bool has_playback_info;         // File written by our muxer, playback is valid
+    avi_playback_info_t playback;
+    avi_stream_t streams[AVI_MAX_STREAMS];
+    int stream_count;
+    int video_stream;               // Streams whose chunks are returned, -1 = none
+    int audio_stream;
 } avi_info_t;
 
 // AVI chunk types
 typedef enum {
-    AVI_CHUNK_VIDEO,    // 00dc - compressed video
-    AVI_CHUNK_AUDIO,    // 01wb - audio data
-    AVI_CHUNK_OTHER,    // Other chunks (ignored)
+    AVI_CHUNK_VIDEO,    // ##dc - compressed video of the selected video stream
+    AVI_CHUNK_AUDIO,    // ##wb - audio data of the selected audio stream
+    AVI_CHUNK_OTHER,    // Other chunks and other streams (skipped unread)
     AVI_CHUNK_END,      // End of movi list
 } avi_chunk_type_t;
 
 // AVI chunk descriptor
 typedef struct {
     avi_chunk_type_t type;
-    uint8_t* data;      // Pointer into frame buffer
+    const uint8_t* data; // Pointer into frame buffer or directly into the source
     size_t size;        // Chunk data size
+    size_t offset;      // Source offset of the chunk data
 } avi_chunk_t;
 
-// AVI parser state (for streaming from file)
+// AVI parser state (for streaming from a byte source)
 typedef struct {
-    FILE* file;             // Open file handle
-    size_t file_size;       // Total file size
+    avi_source_t source;    // Byte source (file, memory, mmap, stream)
+    size_t file_size;       // Total source size
     size_t movi_start;      // Start of movi list data (file offset)
     size_t movi_end;        // End of movi list
     size_t current_pos;     // Current position in file
-    uint8_t* frame_buffer;  // Buffer for reading chunks
+    uint8_t* frame_buffer;  // Buffer for reading chunks (NULL for mappable sources)
     size_t frame_buffer_size;
     avi_info_t info;        // Parsed stream info
 } avi_parser_t;
@@ -52,18 +132,64 @@ typedef struct {
 // Parses headers and locates movi list
 esp_err_t avi_parser_open(avi_parser_t* parser, const char* path);
 
+// Initialize parser on an already opened byte source
+// The parser takes ownership of the source and closes it on avi_parser_close()
+// Sources that can hand out pointers are read zero-copy
+esp_err_t avi_parser_open_source(avi_parser_t* parser, avi_source_t* source);
+
+// Read only the headers of a file (everything before the movi list) and close
+// it again, for listing videos without preparing them for playback
+esp_err_t avi_parser_probe(const char* path, avi_info_t* info);
+
 // Get stream info
 const avi_info_t* avi_parser_get_info(const avi_parser_t* parser);
 
+// Stream number of the first audio track in language, matched against the
+// words of its name (strn) and its LANGID as a code like "en" or "eng", or
+// as the name itself; -1 when there is none
+int avi_parser_find_audio(const avi_info_t* info, const char* language);
+
+// Route the chunks of audio stream number stream to the caller and skip those
+// of the other audio tracks (-1 = skip all audio), and describe it in the
+// info's audio fields; the first audio stream is selected on open
+// Call before reading chunks
+esp_err_t avi_parser_select_audio(avi_parser_t* parser, int stream);
+
 // Get next video chunk from movi list (skips audio chunks)
-// Reads chunk into internal buffer
+// Reads chunk into internal buffer, or points into the source when mappable
+// chunk->data is valid until the next call
 // Returns ESP_OK if chunk found, ESP_ERR_NOT_FOUND at end
 esp_err_t avi_parser_next_chunk(avi_parser_t* parser, avi_chunk_t* chunk);
 
+// Get next audio or video chunk header without reading its data
+// chunk->data is NULL until avi_parser_read_payload() is called
+// Returns ESP_OK if chunk found, ESP_ERR_NOT_FOUND at end
+esp_err_t avi_parser_next_header(avi_parser_t* parser, avi_chunk_t* chunk);
+
+// Read data of a chunk returned by avi_parser_next_header()
+// With dest == NULL the data lands in the internal buffer (or is mapped)
+// Otherwise it is read into dest (capacity dest_size, at least
+// avi_source_span_size(chunk->size)); sector-capable sources DMA whole
+// sectors into dest, so dest must be DMA-capable and cache-line aligned.
+// On success chunk->data points at the payload inside dest.
+esp_err_t avi_parser_read_payload(avi_parser_t* parser, avi_chunk_t* chunk, uint8_t* dest, size_t dest_size);
+
+// Read count frame index entries starting at frame first
+// Only available when info.has_playback_info and playback.index_offset != 0
+esp_err_t avi_parser_read_index(avi_parser_t* parser, uint32_t first, avi_index_entry_t* entries, uint32_t count);
+
+// Read the chapter text (AVI_FOURCC_CHAPTERS) into text, NUL-terminated and
+// cut to capacity - 1 bytes; ESP_ERR_NOT_FOUND when the file has none
+esp_err_t avi_parser_read_chapters(avi_parser_t* parser, char* text, size_t capacity);
+
 // Reset parser to beginning of movi list
 void avi_parser_rewind(avi_parser_t* parser);
 
-// Close file and free resources
+// Continue parsing at the chunk whose payload starts at offset (an index
+// entry's audio or video offset), the header is 8 bytes before it
+esp_err_t avi_parser_seek(avi_parser_t* parser, size_t offset);
+
+// Close source and free resources
 void avi_parser_close(avi_parser_t* parser);
 
 // Get current position estimate (for progress display)
@@ -0,0 +1,558 @@
+// AVI Source - Pluggable byte sources for the AVI parser
+
+#include "avi_source.h"
+#include "fastopen.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#include "fat_extent.h"
+#include "ff.h"
+#include "sdcard.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char* TAG = "avi_source";
+
+// Get size of a stdio file, leaves position at start
+static size_t stdio_file_size(FILE* f) {
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    return size > 0 ? (size_t)size : 0;
+}
+
+// ---------------------------------------------------------------------------
+// stdio file (fastopen)
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    FILE* file;
+    size_t pos;         // Current stdio position (avoids redundant fseek)
+} file_ctx_t;
+
+static size_t file_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    file_ctx_t* ctx = src->ctx;
+
+    // fseek discards the stdio buffer, only seek when not already there
+    if (offset != ctx->pos) {
+        if (fseek(ctx->file, offset, SEEK_SET) != 0) {
+            return 0;
+        }
+        ctx->pos = offset;
+    }
+
+    size_t got = fread(buf, 1, count, ctx->file);
+    ctx->pos += got;
+    return got;
+}
+
+static void file_close(avi_source_t* src) {
+    file_ctx_t* ctx = src->ctx;
+    fastclose(ctx->file);
+    free(ctx);
+}
+
+static const avi_source_ops_t file_ops = {
+    .name = "stdio",
+    .read_at = file_read_at,
+    .close = file_close,
+};
+
+esp_err_t avi_source_open_file(avi_source_t* src, const char* path) {
+    memset(src, 0, sizeof(avi_source_t));
+
+    file_ctx_t* ctx = calloc(1, sizeof(file_ctx_t));
+    if (!ctx) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ctx->file = fastopen(path, "rb");
+    if (!ctx->file) {
+        free(ctx);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    src->ops = &file_ops;
+    src->size = stdio_file_size(ctx->file);
+    src->ctx = ctx;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Memory block (caller-owned, PSRAM image, mmap)
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const uint8_t* data;
+    void (*release)(void* data, size_t size, void* arg);
+    void* release_arg;
+} memory_ctx_t;
+
+static size_t memory_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    memory_ctx_t* ctx = src->ctx;
+    if (offset >= src->size) return 0;
+    if (count > src->size - offset) count = src->size - offset;
+    memcpy(buf, ctx->data + offset, count);
+    return count;
+}
+
+static const uint8_t* memory_map(avi_source_t* src, size_t offset, size_t count) {
+    memory_ctx_t* ctx = src->ctx;
+    (void)count;
+    return ctx->data + offset;
+}
+
+static void memory_close(avi_source_t* src) {
+    memory_ctx_t* ctx = src->ctx;
+    if (ctx->release) {
+        ctx->release((void*)ctx->data, src->size, ctx->release_arg);
+    }
+    free(ctx);
+}
+
+#ifndef ESP_PLATFORM
+static void memory_prefetch(avi_source_t* src, size_t offset, size_t count) {
+    memory_ctx_t* ctx = src->ctx;
+    if (offset >= src->size) return;
+    if (count > src->size - offset) count = src->size - offset;
+
+    // madvise needs a page-aligned start
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)(ctx->data + offset) & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)(ctx->data + offset + count);
+    madvise((void*)start, end - start, MADV_WILLNEED);
+}
+#endif
+
+static const avi_source_ops_t memory_ops = {
+    .name = "memory",
+    .read_at = memory_read_at,
+    .map = memory_map,
+    .close = memory_close,
+};
+
+static esp_err_t open_memory(avi_source_t* src, const avi_source_ops_t* ops, const void* data, size_t size,
+                             void (*release)(void*, size_t, void*), void* release_arg) {
+    memset(src, 0, sizeof(avi_source_t));
+
+    memory_ctx_t* ctx = calloc(1, sizeof(memory_ctx_t));
+    if (!ctx) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ctx->data = data;
+    ctx->release = release;
+    ctx->release_arg = release_arg;
+
+    src->ops = ops;
+    src->size = size;
+    src->ctx = ctx;
+    return ESP_OK;
+}
+
+esp_err_t avi_source_open_memory(avi_source_t* src, const void* data, size_t size) {
+    if (!data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return open_memory(src, &memory_ops, data, size, NULL, NULL);
+}
+
+static void psram_release(void* data, size_t size, void* arg) {
+    (void)size;
+    (void)arg;
+    heap_caps_free(data);
+}
+
+static const avi_source_ops_t psram_ops = {
+    .name = "psram",
+    .read_at = memory_read_at,
+    .map = memory_map,
+    .close = memory_close,
+};
+
+esp_err_t avi_source_open_psram(avi_source_t* src, const char* path) {
+    FILE* f = fastopen(path, "rb");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t size = stdio_file_size(f);
+    uint8_t* data = heap_caps_malloc(size ? size : 1, MALLOC_CAP_SPIRAM);
+    if (!data) {
+        ESP_LOGE(TAG, "Failed to allocate %zu bytes in PSRAM for %s", size, path);
+        fastclose(f);
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t got = fread(data, 1, size, f);
+    fastclose(f);
+    if (got != size) {
+        ESP_LOGE(TAG, "Short read loading %s (%zu of %zu bytes)", path, got, size);
+        heap_caps_free(data);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = open_memory(src, &psram_ops, data, size, psram_release, NULL);
+    if (ret != ESP_OK) {
+        heap_caps_free(data);
+    }
+    return ret;
+}
+
+// ---------------------------------------------------------------------------
+// Forward-only stream
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    FILE* stream;
+    size_t pos;         // Bytes consumed from the stream so far
+} stream_ctx_t;
+
+static size_t stream_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    stream_ctx_t* ctx = src->ctx;
+
+    if (offset < ctx->pos) {
+        ESP_LOGE(TAG, "Stream cannot seek backwards (%zu < %zu)", offset, ctx->pos);
+        return 0;
+    }
+
+    // Discard bytes up to the requested offset
+    uint8_t scratch[256];
+    while (ctx->pos < offset) {
+        size_t skip = offset - ctx->pos;
+        if (skip > sizeof(scratch)) skip = sizeof(scratch);
+        size_t got = fread(scratch, 1, skip, ctx->stream);
+        ctx->pos += got;
+        if (got != skip) return 0;
+    }
+
+    size_t got = fread(buf, 1, count, ctx->stream);
+    ctx->pos += got;
+    return got;
+}
+
+static void stream_close(avi_source_t* src) {
+    stream_ctx_t* ctx = src->ctx;
+    fclose(ctx->stream);
+    free(ctx);
+}
+
+static const avi_source_ops_t stream_ops = {
+    .name = "stream",
+    .read_at = stream_read_at,
+    .close = stream_close,
+};
+
+esp_err_t avi_source_open_stream(avi_source_t* src, FILE* stream) {
+    memset(src, 0, sizeof(avi_source_t));
+    if (!stream) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stream_ctx_t* ctx = calloc(1, sizeof(stream_ctx_t));
+    if (!ctx) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->stream = stream;
+
+    src->ops = &stream_ops;
+    src->size = AVI_SOURCE_SIZE_UNKNOWN;
+    src->ctx = ctx;
+    return ESP_OK;
+}
+
+#ifdef ESP_PLATFORM
+
+// ---------------------------------------------------------------------------
+// Raw FATFS file
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    FIL fil;
+    fat_extent_map_t* extents;  // Cluster runs, NULL if unavailable
+} fatfs_ctx_t;
+
+// With a sector-aligned file pointer and whole-sector counts, f_read() hands
+// the sectors to disk_read() straight into buf (no FIL sector buffer, no
+// newlib buffer), so the SDMMC DMA writes directly into the destination
+static size_t fatfs_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    fatfs_ctx_t* ctx = src->ctx;
+
+    if (f_tell(&ctx->fil) != offset) {
+        if (f_lseek(&ctx->fil, offset) != FR_OK) {
+            return 0;
+        }
+    }
+
+    UINT got = 0;
+    if (f_read(&ctx->fil, buf, count, &got) != FR_OK) {
+        return 0;
+    }
+    return got;
+}
+
+// Sector reads through the extent map go straight to the card as one
+// multi-sector transfer per extent, with no FAT lookups on the way
+static size_t fatfs_read_sectors(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    fatfs_ctx_t* ctx = src->ctx;
+    if (!ctx->extents) {
+        return fatfs_read_at(src, offset, buf, count);
+    }
+    return fat_extent_read(ctx->extents, offset, buf, count, fat_extent_disk_read, ctx->fil.obj.fs);
+}
+
+static void fatfs_close(avi_source_t* src) {
+    fatfs_ctx_t* ctx = src->ctx;
+    fat_extent_map_free(ctx->extents);
+    f_close(&ctx->fil);
+    heap_caps_free(ctx);
+}
+
+static const avi_source_ops_t fatfs_ops = {
+    .name = "fatfs",
+    .read_at = fatfs_read_at,
+    .read_sectors = fatfs_read_sectors,
+    .close = fatfs_close,
+};
+
+esp_err_t avi_source_open_fatfs(avi_source_t* src, const char* path) {
+    memset(src, 0, sizeof(avi_source_t));
+
+    char fatfs_path[160];
+    esp_err_t ret = sdcard_get_fatfs_path(path, fatfs_path, sizeof(fatfs_path));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // FIL holds the sector buffer, keep it in internal RAM
+    fatfs_ctx_t* ctx = heap_caps_calloc(1, sizeof(fatfs_ctx_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    if (!ctx) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (f_open(&ctx->fil, fatfs_path, FA_READ) != FR_OK) {
+        heap_caps_free(ctx);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Walk the cluster chain once and report fragmentation
+    ctx->extents = fat_extent_build(&ctx->fil);
+    if (ctx->extents) {
+        fat_extent_log(ctx->extents, path);
+    }
+
+    src->ops = &fatfs_ops;
+    src->size = f_size(&ctx->fil);
+    src->ctx = ctx;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Flash partition mmap
+// ---------------------------------------------------------------------------
+
+static void partition_release(void* data, size_t size, void* arg) {
+    (void)data;
+    (void)size;
+    esp_partition_munmap((esp_partition_mmap_handle_t)(uintptr_t)arg);
+}
+
+static const avi_source_ops_t partition_ops = {
+    .name = "flash",
+    .read_at = memory_read_at,
+    .map = memory_map,
+    .close = memory_close,
+};
+
+esp_err_t avi_source_open_partition(avi_source_t* src, const char* label) {
+    const esp_partition_t* part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        ESP_LOGE(TAG, "Partition not found: %s", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void* data = NULL;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t ret = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mmap partition %s: %s", label, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = open_memory(src, &partition_ops, data, part->size, partition_release, (void*)(uintptr_t)handle);
+    if (ret != ESP_OK) {
+        esp_partition_munmap(handle);
+    }
+    return ret;
+}
+
+esp_err_t avi_source_open_direct(avi_source_t* src, const char* path) {
+    return avi_source_open_fatfs(src, path);
+}
+
+#else
+
+// ---------------------------------------------------------------------------
+// Host pread (stand-in for raw FATFS reads)
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int fd;
+} posix_ctx_t;
+
+static size_t posix_read_at(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    posix_ctx_t* ctx = src->ctx;
+    size_t done = 0;
+    while (done < count) {
+        ssize_t got = pread(ctx->fd, (uint8_t*)buf + done, count - done, offset + done);
+        if (got <= 0) break;
+        done += got;
+    }
+    return done;
+}
+
+static void posix_close(avi_source_t* src) {
+    posix_ctx_t* ctx = src->ctx;
+    close(ctx->fd);
+    free(ctx);
+}
+
+static const avi_source_ops_t posix_ops = {
+    .name = "pread",
+    .read_at = posix_read_at,
+    .read_sectors = posix_read_at,
+    .close = posix_close,
+};
+
+esp_err_t avi_source_open_direct(avi_source_t* src, const char* path) {
+    memset(src, 0, sizeof(avi_source_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+
+    posix_ctx_t* ctx = calloc(1, sizeof(posix_ctx_t));
+    if (!ctx) {
+        close(fd);
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->fd = fd;
+
+    src->ops = &posix_ops;
+    src->size = st.st_size;
+    src->ctx = ctx;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Host mmap
+// ---------------------------------------------------------------------------
+
+static void mmap_release(void* data, size_t size, void* arg) {
+    (void)arg;
+    if (size > 0) {
+        munmap(data, size);
+    }
+}
+
+static const avi_source_ops_t mmap_ops = {
+    .name = "mmap",
+    .read_at = memory_read_at,
+    .map = memory_map,
+    .prefetch = memory_prefetch,
+    .close = memory_close,
+};
+
+esp_err_t avi_source_open_mmap(avi_source_t* src, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = open_memory(src, &mmap_ops, data, st.st_size, mmap_release, NULL);
+    if (ret != ESP_OK) {
+        munmap(data, st.st_size);
+    }
+    return ret;
+}
+
+#endif
+
+bool avi_source_read(avi_source_t* src, size_t offset, void* buf, size_t count) {
+    int64_t t0 = esp_timer_get_time();
+    size_t got = src->ops->read_at(src, offset, buf, count);
+    src->read_us += esp_timer_get_time() - t0;
+    src->bytes_read += got;
+    return got == count;
+}
+
+const uint8_t* avi_source_read_into(avi_source_t* src, size_t offset, size_t size, uint8_t* dest, size_t dest_size) {
+    if (!src->ops->read_sectors) {
+        if (size > dest_size || !avi_source_read(src, offset, dest, size)) {
+            return NULL;
+        }
+        return dest;
+    }
+
+    // Widen to whole sectors around the payload
+    size_t start = offset & ~(size_t)(AVI_SOURCE_SECTOR_SIZE - 1);
+    size_t end = (offset + size + AVI_SOURCE_SECTOR_SIZE - 1) & ~(size_t)(AVI_SOURCE_SECTOR_SIZE - 1);
+    if (end - start > dest_size) {
+        return NULL;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    size_t got = src->ops->read_sectors(src, start, dest, end - start);
+    src->read_us += esp_timer_get_time() - t0;
+    src->bytes_read += got;
+
+    // The last sector may be short at end of file
+    if (got < offset + size - start) {
+        return NULL;
+    }
+    return dest + (offset - start);
+}
+
+void avi_source_log_stats(const avi_source_t* src) {
+    if (!src || !src->ops || src->bytes_read == 0) return;
+
+    float mb = src->bytes_read / (1024.0f * 1024.0f);
+    float seconds = src->read_us / 1000000.0f;
+    ESP_LOGI(TAG, "Read %.1f MB via %s in %.2f s (%.2f MB/s)", mb, src->ops->name, seconds,
+             seconds > 0 ? mb / seconds : 0.0f);
+}
+
+void avi_source_close(avi_source_t* src) {
+    if (!src || !src->ops) return;
+    src->ops->close(src);
+    memset(src, 0, sizeof(avi_source_t));
+}
@@ -0,0 +1,120 @@
+// AVI Source - Pluggable byte sources for the AVI parser
+// A source hands out bytes by absolute offset. Sources that keep the whole
+// stream addressable (memory, PSRAM images, flash/host mmap) also hand out
+// direct pointers, letting the parser skip the copy into its frame buffer.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+// Size reported by sources that cannot know their length (pipes, sockets)
+#define AVI_SOURCE_SIZE_UNKNOWN SIZE_MAX
+
+// Sector size used for direct (DMA) reads
+#define AVI_SOURCE_SECTOR_SIZE  512
+
+typedef struct avi_source avi_source_t;
+
+// Source operations (read_at and close are mandatory, the rest are optional)
+typedef struct {
+    const char* name;
+
+    // Read count bytes starting at offset into buf
+    // Returns the number of bytes actually read (short on EOF or error)
+    size_t (*read_at)(avi_source_t* src, size_t offset, void* buf, size_t count);
+
+    // Get a direct pointer to count bytes at offset
+    // Returns NULL if the range is not directly addressable
+    const uint8_t* (*map)(avi_source_t* src, size_t offset, size_t count);
+
+    // Read whole sectors straight into buf, which must be DMA-capable and
+    // cache-line aligned; offset and count are multiples of AVI_SOURCE_SECTOR_SIZE
+    // Returns the number of bytes read (short only at end of file)
+    size_t (*read_sectors)(avi_source_t* src, size_t offset, void* buf, size_t count);
+
+    // Hint that the range will be read soon (may start I/O early)
+    void (*prefetch)(avi_source_t* src, size_t offset, size_t count);
+
+    // Release all resources held by the source
+    void (*close)(avi_source_t* src);
+} avi_source_ops_t;
+
+// Source instance
+struct avi_source {
+    const avi_source_ops_t* ops;
+    size_t size;            // Total size in bytes, AVI_SOURCE_SIZE_UNKNOWN for streams
+    void* ctx;              // Implementation state
+    uint64_t bytes_read;    // Statistics: bytes delivered by reads
+    int64_t read_us;        // Statistics: time spent inside reads
+};
+
+// Buffered stdio file opened through fastopen()
+esp_err_t avi_source_open_file(avi_source_t* src, const char* path);
+
+// Caller-provided memory block (not freed on close)
+esp_err_t avi_source_open_memory(avi_source_t* src, const void* data, size_t size);
+
+// Whole file loaded into PSRAM (freed on close)
+esp_err_t avi_source_open_psram(avi_source_t* src, const char* path);
+
+// Forward-only stream (pipe, socket wrapped in FILE*)
+// Seeking backwards fails, seeking forwards reads and discards
+// The FILE* is closed together with the source
+esp_err_t avi_source_open_stream(avi_source_t* src, FILE* stream);
+
+// Unbuffered sector reads (raw FATFS on the badge, pread() on the host)
+esp_err_t avi_source_open_direct(avi_source_t* src, const char* path);
+
+#ifdef ESP_PLATFORM
+// Raw FATFS file read with f_read, bypassing newlib stdio (VFS path like /sd/...)
+esp_err_t avi_source_open_fatfs(avi_source_t* src, const char* path);
+
+// Data partition memory-mapped from flash (partition label)
+esp_err_t avi_source_open_partition(avi_source_t* src, const char* label);
+#else
+// File memory-mapped with mmap() (host builds)
+esp_err_t avi_source_open_mmap(avi_source_t* src, const char* path);
+#endif
+
+// Read exactly count bytes at offset, returns true on success
+bool avi_source_read(avi_source_t* src, size_t offset, void* buf, size_t count);
+
+// Buffer space avi_source_read_into() needs for a payload of size bytes
+// (sector-aligned reads may pull in up to one extra sector on each side)
+static inline size_t avi_source_span_size(size_t size) {
+    return size + 2 * AVI_SOURCE_SECTOR_SIZE;
+}
+
+// Read size bytes at offset into dest (capacity dest_size)
+// Sources with read_sectors transfer the enclosing whole sectors straight into
+// dest, so dest must be DMA-capable and cache-line aligned and the payload
+// starts somewhere inside dest. Returns pointer to the payload, NULL on error.
+const uint8_t* avi_source_read_into(avi_source_t* src, size_t offset, size_t size, uint8_t* dest, size_t dest_size);
+
+// Direct pointer to count bytes at offset, NULL if not supported
+static inline const uint8_t* avi_source_map(avi_source_t* src, size_t offset, size_t count) {
+    if (!src->ops->map) return NULL;
+    if (src->size != AVI_SOURCE_SIZE_UNKNOWN && (offset > src->size || count > src->size - offset)) return NULL;
+    return src->ops->map(src, offset, count);
+}
+
+// True if the source can hand out direct pointers
+static inline bool avi_source_can_map(const avi_source_t* src) {
+    return src->ops && src->ops->map != NULL;
+}
+
+// Hint upcoming read range
+static inline void avi_source_prefetch(avi_source_t* src, size_t offset, size_t count) {
+    if (src->ops->prefetch) {
+        src->ops->prefetch(src, offset, count);
+    }
+}
+
+// Log read throughput statistics
+void avi_source_log_stats(const avi_source_t* src);
+
+// Close source (safe to call on a zeroed or already closed source)
+void avi_source_close(avi_source_t* src);
@@ -0,0 +1,194 @@
+// Chapters - named sections of the playing video
+
+#include "chapters.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char* TAG = "chapters";
+
+// A chapter may start on an empty frame (one repeating the previous picture);
+// it is moved to the next frame with data, at most this far on
+#define EMPTY_FRAME_LOOKAHEAD 8
+
+typedef struct {
+    int frame;
+    char title[CHAPTERS_TITLE_MAX];
+} chapter_t;
+
+static chapter_t chapters[CHAPTERS_MAX];
+static int chapter_count = 0;
+static int restart_frames = 0;
+static char text[CHAPTERS_TEXT_MAX];
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool chapters_parse_time(const char* p, uint32_t* ms, const char** rest) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+
+    // Up to three fields of digits separated by colons, most significant first
+    uint32_t seconds = 0;
+    for (int field = 0; field < 3; field++) {
+        if (!is_digit(*p)) {
+            return false;
+        }
+        uint32_t value = 0;
+        while (is_digit(*p)) {
+            if (value < 1000000) {
+                value = value * 10 + (*p - '0');
+            }
+            p++;
+        }
+        seconds = seconds * 60 + value;
+        if (*p != ':') {
+            break;
+        }
+        p++;
+    }
+    if (seconds > 1000000) {
+        return false;
+    }
+
+    // Fraction, to the millisecond
+    uint32_t fraction = 0;
+    if (*p == '.') {
+        p++;
+        for (int scale = 100; is_digit(*p); p++, scale /= 10) {
+            fraction += (*p - '0') * scale;
+        }
+    }
+    if (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        return false;
+    }
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    *ms = seconds * 1000 + fraction;
+    *rest = p;
+    return true;
+}
+
+static int frame_at_ms(const avi_info_t* info, uint32_t ms) {
+    if (info->video_rate > 0 && info->video_scale > 0) {
+        return (int)((uint64_t)ms * info->video_rate / ((uint64_t)info->video_scale * 1000));
+    }
+    return (int)((uint64_t)ms * (info->fps ? info->fps : 15) / 1000);
+}
+
+// Resolve a chapter to an index position and insert it in frame order
+static void add_chapter(playback_t* pb, uint32_t start_ms, const char* title, size_t title_len) {
+    int frames = playback_indexed_frames(pb);
+    int frame = frame_at_ms(avi_parser_get_info(&pb->parser), start_ms);
+    if (frame >= frames) {
+        ESP_LOGW(TAG, "Chapter at %lu ms is past the end, skipped", (unsigned long)start_ms);
+        return;
+    }
+    if (chapter_count == CHAPTERS_MAX) {
+        ESP_LOGW(TAG, "More than %d chapters, skipping the rest", CHAPTERS_MAX);
+        return;
+    }
+
+    avi_index_entry_t entries[EMPTY_FRAME_LOOKAHEAD];
+    int count = frames - frame < EMPTY_FRAME_LOOKAHEAD ? frames - frame : EMPTY_FRAME_LOOKAHEAD;
+    if (avi_parser_read_index(&pb->parser, frame, entries, count) == ESP_OK) {
+        for (int i = 0; i < count; i++) {
+            if (entries[i].video_size > 0) {
+                frame += i;
+                break;
+            }
+        }
+    }
+
+    int at = chapter_count++;
+    while (at > 0 && chapters[at - 1].frame > frame) {
+        chapters[at] = chapters[at - 1];
+        at--;
+    }
+    chapter_t* chapter = &chapters[at];
+    chapter->frame = frame;
+    if (title_len >= CHAPTERS_TITLE_MAX) {
+        title_len = CHAPTERS_TITLE_MAX - 1;
+    }
+    memcpy(chapter->title, title, title_len);
+    chapter->title[title_len] = '\0';
+}
+
+esp_err_t chapters_load(playback_t* pb, const video_entry_t* entry) {
+    chapter_count = 0;
+    if (playback_indexed_frames(pb) == 0) {
+        return ESP_OK;      // Jumps need the frame index of a remuxed file
+    }
+
+    if (entry && entry->chapter_count > 0) {
+        for (int i = 0; i < entry->chapter_count; i++) {
+            const video_chapter_t* chapter = &entry->chapters[i];
+            add_chapter(pb, chapter->start_ms, chapter->title, strlen(chapter->title));
+        }
+    } else if (avi_parser_read_chapters(&pb->parser, text, sizeof(text)) == ESP_OK) {
+        for (char* line = text; *line;) {
+            char* end = strchr(line, '\n');
+            char* next = end ? end + 1 : line + strlen(line);
+            if (!end) {
+                end = next;
+            }
+            if (end > line && end[-1] == '\r') {
+                end--;
+            }
+            uint32_t start_ms;
+            const char* title;
+            if (chapters_parse_time(line, &start_ms, &title)) {
+                add_chapter(pb, start_ms, title, end > title ? (size_t)(end - title) : 0);
+            } else if (end > line) {
+                ESP_LOGW(TAG, "Ignoring chapter line without a time");
+            }
+            line = next;
+        }
+    }
+
+    restart_frames = frame_at_ms(avi_parser_get_info(&pb->parser), CHAPTERS_RESTART_MS);
+    if (chapter_count > 0) {
+        ESP_LOGI(TAG, "%d chapters, from %s", chapter_count, entry && entry->chapter_count ? "playlist" : "file");
+    }
+    return ESP_OK;
+}
+
+void chapters_clear(void) {
+    chapter_count = 0;
+}
+
+int chapters_count(void) {
+    return chapter_count;
+}
+
+int chapters_frame(int i) {
+    return chapters[i].frame;
+}
+
+const char* chapters_title(int i) {
+    return chapters[i].title;
+}
+
+int chapters_at(int frame) {
+    int i = chapter_count - 1;
+    while (i >= 0 && chapters[i].frame > frame) {
+        i--;
+    }
+    return i;
+}
+
+int chapters_target(int frame, int direction) {
+    int i = chapters_at(frame);
+    if (direction > 0) {
+        return i + 1 < chapter_count ? chapters[i + 1].frame : -1;
+    }
+    if (i < 0) {
+        return -1;
+    }
+    if (i == 0 || frame - chapters[i].frame > restart_frames) {
+        return chapters[i].frame;
+    }
+    return chapters[i - 1].frame;
+}
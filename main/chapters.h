@@ -0,0 +1,42 @@
+// Chapters - named sections of the playing video
+// Chapters come from the playlist entry or else from the file's LIST INFO
+// chunk (AVI_FOURCC_CHAPTERS, written by avi_remux and avi_ratectl), and are
+// resolved to frame index positions when the video is opened, so a jump is
+// one seek. Videos without a frame index have no chapters
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "playback.h"
+#include "playlist.h"
+
+#define CHAPTERS_MAX            32      // Chapters kept per video, later ones are dropped
+#define CHAPTERS_TITLE_MAX      48      // Including the NUL, longer titles are cut
+#define CHAPTERS_TEXT_MAX       2048    // Chapter text read from a file
+#define CHAPTERS_RESTART_MS     3000    // Back jumps to the start of the chapter after this much of it
+
+// Parse "[h:]m:ss[.mmm]" or plain seconds at the start of text; *rest is set
+// to the title after the time and its spaces
+bool chapters_parse_time(const char* text, uint32_t* ms, const char** rest);
+
+// Resolve the chapters of entry (NULL = from the file only) for the video
+// open in pb; leaves none when it has no frame index
+esp_err_t chapters_load(playback_t* pb, const video_entry_t* entry);
+
+// Forget the chapters, for videos played without an entry
+void chapters_clear(void);
+
+int chapters_count(void);
+
+// First frame of chapter i
+int chapters_frame(int i);
+
+const char* chapters_title(int i);
+
+// Chapter playing at frame, -1 before the first one
+int chapters_at(int frame);
+
+// Frame to jump to from frame: the next chapter, or going back the start of
+// this chapter, or of the previous one near that start; -1 = none
+int chapters_target(int frame, int direction);
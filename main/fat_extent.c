@@ -0,0 +1,199 @@
+// FAT Extent Map - cluster chain of a file as a list of contiguous sector runs
+
+#include "fat_extent.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "diskio_impl.h"
+#endif
+
+static const char* TAG = "fat_extent";
+
+fat_extent_map_t* fat_extent_map_alloc(uint32_t max_extents) {
+    fat_extent_map_t* map = calloc(1, sizeof(fat_extent_map_t) + max_extents * sizeof(fat_extent_t));
+    return map;
+}
+
+void fat_extent_map_free(fat_extent_map_t* map) {
+    free(map);
+}
+
+bool fat_extent_map_append(fat_extent_map_t* map, uint64_t first_lba, uint32_t clusters, uint32_t max_extents) {
+    uint32_t sectors_per_cluster = map->cluster_size / map->sector_size;
+    uint32_t sectors = clusters * sectors_per_cluster;
+
+    // Continues the previous run on disk: grow it
+    if (map->count > 0) {
+        fat_extent_t* last = &map->extents[map->count - 1];
+        if (last->lba + last->sectors == first_lba) {
+            last->sectors += sectors;
+            map->clusters += clusters;
+            return true;
+        }
+    }
+
+    if (map->count >= max_extents) {
+        return false;
+    }
+
+    fat_extent_t* ext = &map->extents[map->count++];
+    ext->file_offset = (uint64_t)map->clusters * map->cluster_size;
+    ext->lba = first_lba;
+    ext->sectors = sectors;
+    map->clusters += clusters;
+    return true;
+}
+
+// Find extent containing offset (binary search, extents are sorted by offset)
+static const fat_extent_t* find_extent(const fat_extent_map_t* map, uint64_t offset) {
+    uint32_t lo = 0;
+    uint32_t hi = map->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        const fat_extent_t* ext = &map->extents[mid];
+        uint64_t end = ext->file_offset + (uint64_t)ext->sectors * map->sector_size;
+        if (offset < ext->file_offset) {
+            hi = mid;
+        } else if (offset >= end) {
+            lo = mid + 1;
+        } else {
+            return ext;
+        }
+    }
+    return NULL;
+}
+
+size_t fat_extent_read(const fat_extent_map_t* map, size_t offset, void* buf, size_t count,
+                       fat_extent_read_fn read_fn, void* arg) {
+    if (!map || offset % map->sector_size != 0 || offset >= map->file_size) {
+        return 0;
+    }
+
+    // Never read past the sector holding the last byte of the file
+    uint64_t file_end = (map->file_size + map->sector_size - 1) / map->sector_size * map->sector_size;
+    if (count > file_end - offset) {
+        count = file_end - offset;
+    }
+
+    size_t done = 0;
+    while (done < count) {
+        uint64_t pos = offset + done;
+        const fat_extent_t* ext = find_extent(map, pos);
+        if (!ext) break;
+
+        // One multi-sector read up to the end of this extent
+        uint64_t ext_end = ext->file_offset + (uint64_t)ext->sectors * map->sector_size;
+        size_t n = count - done;
+        if (n > ext_end - pos) n = ext_end - pos;
+        uint32_t sectors = (n + map->sector_size - 1) / map->sector_size;
+        uint64_t lba = ext->lba + (pos - ext->file_offset) / map->sector_size;
+
+        if (!read_fn(arg, lba, (uint8_t*)buf + done, sectors)) {
+            ESP_LOGE(TAG, "Sector read failed at LBA %llu (%lu sectors)", (unsigned long long)lba,
+                     (unsigned long)sectors);
+            break;
+        }
+        done += (size_t)sectors * map->sector_size;
+    }
+
+    // Report only bytes that belong to the file
+    if (done > map->file_size - offset) {
+        done = map->file_size - offset;
+    }
+    return done;
+}
+
+void fat_extent_log(const fat_extent_map_t* map, const char* name) {
+    if (!map || map->count == 0) return;
+
+    uint32_t largest = 0;
+    for (uint32_t i = 0; i < map->count; i++) {
+        if (map->extents[i].sectors > largest) largest = map->extents[i].sectors;
+    }
+
+    uint32_t sectors_per_kb = 1024 / map->sector_size;
+    if (sectors_per_kb == 0) sectors_per_kb = 1;
+
+    if (map->count == 1) {
+        ESP_LOGI(TAG, "%s: contiguous, %lu clusters of %lu bytes from LBA %llu", name,
+                 (unsigned long)map->clusters, (unsigned long)map->cluster_size,
+                 (unsigned long long)map->extents[0].lba);
+    } else {
+        ESP_LOGW(TAG, "%s: fragmented, %lu clusters in %lu extents (largest %lu KB, average %lu KB)", name,
+                 (unsigned long)map->clusters, (unsigned long)map->count,
+                 (unsigned long)(largest / sectors_per_kb),
+                 (unsigned long)(map->clusters * (map->cluster_size / 1024) / map->count));
+    }
+}
+
+#ifdef ESP_PLATFORM
+
+fat_extent_map_t* fat_extent_build(FIL* fil) {
+#if FF_USE_FASTSEEK
+    FATFS* fs = fil->obj.fs;
+
+    // First call with a tiny table reports the size needed in tbl[0]
+    DWORD probe[4] = {4};
+    fil->cltbl = probe;
+    FRESULT fr = f_lseek(fil, CREATE_LINKMAP);
+    DWORD* tbl = probe;
+    if (fr == FR_NOT_ENOUGH_CORE) {
+        DWORD needed = probe[0];
+        tbl = malloc(needed * sizeof(DWORD));
+        if (!tbl) {
+            fil->cltbl = NULL;
+            return NULL;
+        }
+        tbl[0] = needed;
+        fil->cltbl = tbl;
+        fr = f_lseek(fil, CREATE_LINKMAP);
+    }
+    fil->cltbl = NULL;
+
+    fat_extent_map_t* map = NULL;
+    if (fr == FR_OK) {
+        // Table layout: size, then (cluster count, first cluster) pairs, then 0
+        uint32_t max_extents = (tbl[0] - 2) / 2;
+        map = fat_extent_map_alloc(max_extents > 0 ? max_extents : 1);
+        if (map) {
+#if FF_MAX_SS != FF_MIN_SS
+            map->sector_size = fs->ssize;
+#else
+            map->sector_size = FF_MAX_SS;
+#endif
+            map->cluster_size = (uint32_t)fs->csize * map->sector_size;
+            map->file_size = f_size(fil);
+
+            for (DWORD* p = tbl + 1; p[0] != 0; p += 2) {
+                uint64_t lba = fs->database + (uint64_t)fs->csize * (p[1] - 2);
+                if (!fat_extent_map_append(map, lba, p[0], max_extents)) break;
+            }
+        }
+    } else {
+        ESP_LOGW(TAG, "Failed to build cluster link map: %d", fr);
+    }
+
+    if (tbl != probe) {
+        free(tbl);
+    }
+    return map;
+#else
+    // Without CONFIG_FATFS_USE_FASTSEEK every file takes the f_read() path
+    static bool warned = false;
+    if (!warned) {
+        ESP_LOGW(TAG, "FATFS fast seek disabled, no extent map or contiguous fast path");
+        warned = true;
+    }
+    (void)fil;
+    return NULL;
+#endif
+}
+
+bool fat_extent_disk_read(void* arg, uint64_t lba, void* buf, uint32_t count) {
+    FATFS* fs = arg;
+    return ff_disk_read(fs->pdrv, buf, (LBA_t)lba, count) == RES_OK;
+}
+
+#endif
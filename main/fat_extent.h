@@ -0,0 +1,64 @@
+// FAT Extent Map - cluster chain of a file as a list of contiguous sector runs
+// Built once at open, then used to turn file offsets into card sectors without
+// walking the FAT, so large reads go to the card as single multi-sector reads
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// One contiguous run of clusters
+typedef struct {
+    uint64_t file_offset;   // Byte offset of the run within the file
+    uint64_t lba;           // First sector of the run on the volume
+    uint32_t sectors;       // Run length in sectors
+} fat_extent_t;
+
+// Extent map of a whole file
+typedef struct {
+    uint32_t sector_size;   // Bytes per sector
+    uint32_t cluster_size;  // Bytes per cluster
+    uint64_t file_size;     // File size in bytes
+    uint32_t count;         // Number of extents (1 = contiguous)
+    uint32_t clusters;      // Total clusters in the chain
+    fat_extent_t extents[]; // count entries
+} fat_extent_map_t;
+
+// Sector reader used by fat_extent_read (reads count sectors from lba)
+typedef bool (*fat_extent_read_fn)(void* arg, uint64_t lba, void* buf, uint32_t count);
+
+// Allocate map with room for max_extents runs
+fat_extent_map_t* fat_extent_map_alloc(uint32_t max_extents);
+
+// Free map
+void fat_extent_map_free(fat_extent_map_t* map);
+
+// Append a run of clusters starting at first_lba, merging with the previous
+// run when it continues it on disk. Returns false when the map is full.
+bool fat_extent_map_append(fat_extent_map_t* map, uint64_t first_lba, uint32_t clusters, uint32_t max_extents);
+
+// True if the whole file is one contiguous run
+static inline bool fat_extent_map_is_contiguous(const fat_extent_map_t* map) {
+    return map && map->count == 1;
+}
+
+// Read count bytes at a sector-aligned offset straight from the card
+// Requests are split only where the file jumps to another extent
+// Returns bytes read (short at end of file or on error)
+size_t fat_extent_read(const fat_extent_map_t* map, size_t offset, void* buf, size_t count,
+                       fat_extent_read_fn read_fn, void* arg);
+
+// Log fragmentation summary for a file
+void fat_extent_log(const fat_extent_map_t* map, const char* name);
+
+#ifdef ESP_PLATFORM
+#include "ff.h"
+
+// Build extent map of an open FATFS file from its cluster link map table
+// Returns NULL if FATFS fast seek is unavailable or memory runs out
+fat_extent_map_t* fat_extent_build(FIL* fil);
+
+// Sector reader for fat_extent_read on a FATFS volume (arg = FATFS*)
+bool fat_extent_disk_read(void* arg, uint64_t lba, void* buf, uint32_t count);
+#endif
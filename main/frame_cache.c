@@ -0,0 +1,102 @@
+// Frame Cache - LRU of decoded frames for paused viewing and frame stepping
+
+#include "frame_cache.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_cache.h"
+#endif
+
+static const char* TAG = "frame_cache";
+
+typedef struct {
+    int frame;                  // -1 = free
+    uint32_t last_used;
+} cache_slot_t;
+
+static cache_slot_t slots[FRAME_CACHE_SLOTS];
+static uint8_t* memory = NULL;
+static size_t capacity = 0;
+static size_t slot_size = 0;
+static uint32_t use_counter = 0;
+
+esp_err_t frame_cache_prepare(size_t frame_size) {
+    // Slots start cache-line aligned, so the JPEG engine can decode into them
+    size_t align = 64;
+#ifdef ESP_PLATFORM
+    esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &align);
+#endif
+    if (align < 4) align = 4;
+    slot_size = (frame_size + align - 1) & ~(align - 1);
+
+    for (int i = 0; i < FRAME_CACHE_SLOTS; i++) {
+        slots[i].frame = -1;
+    }
+    if (memory && slot_size * FRAME_CACHE_SLOTS <= capacity) {
+        return ESP_OK;
+    }
+
+    heap_caps_free(memory);
+    capacity = 0;
+    memory = heap_caps_aligned_alloc(align, slot_size * FRAME_CACHE_SLOTS, MALLOC_CAP_SPIRAM);
+    if (!memory) {
+        ESP_LOGE(TAG, "Failed to allocate %d frames of %zu bytes", FRAME_CACHE_SLOTS, slot_size);
+        return ESP_ERR_NO_MEM;
+    }
+    capacity = slot_size * FRAME_CACHE_SLOTS;
+    ESP_LOGI(TAG, "Allocated %d frames of %zu bytes in PSRAM", FRAME_CACHE_SLOTS, slot_size);
+    return ESP_OK;
+}
+
+static int find_slot(int frame) {
+    for (int i = 0; i < FRAME_CACHE_SLOTS; i++) {
+        if (slots[i].frame == frame) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t* frame_cache_get(int frame) {
+    int i = memory && frame >= 0 ? find_slot(frame) : -1;
+    if (i < 0) {
+        return NULL;
+    }
+    slots[i].last_used = ++use_counter;
+    return memory + i * slot_size;
+}
+
+uint8_t* frame_cache_claim(int frame) {
+    if (!memory || frame < 0) {
+        return NULL;
+    }
+    int i = find_slot(frame);
+    for (int j = 0; i < 0 && j < FRAME_CACHE_SLOTS; j++) {
+        if (slots[j].frame < 0) {
+            i = j;
+        }
+    }
+    if (i < 0) {
+        i = 0;
+        for (int j = 1; j < FRAME_CACHE_SLOTS; j++) {
+            if (slots[j].last_used < slots[i].last_used) {
+                i = j;
+            }
+        }
+    }
+    slots[i].frame = frame;
+    slots[i].last_used = ++use_counter;
+    return memory + i * slot_size;
+}
+
+void frame_cache_drop(int frame) {
+    int i = frame >= 0 ? find_slot(frame) : -1;
+    if (i >= 0) {
+        slots[i].frame = -1;
+    }
+}
+
+size_t frame_cache_slot_size(void) {
+    return slot_size;
+}
@@ -0,0 +1,27 @@
+// Frame Cache - LRU of decoded frames for paused viewing and frame stepping
+// Each slot holds the video rows of the framebuffer, laid out exactly like
+// them, so showing a cached frame is one copy and decoding into a slot works
+// like decoding into the framebuffer
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define FRAME_CACHE_SLOTS       8       // Decoded frames kept, least recently used dropped first
+
+// Size the slots for frames of frame_size bytes and forget all frames
+// The memory is allocated on first use and kept between videos
+esp_err_t frame_cache_prepare(size_t frame_size);
+
+// Decoded frame, or NULL when it is not cached; counts as a use
+uint8_t* frame_cache_get(int frame);
+
+// Slot to decode a frame into, taking the least recently used one
+// The frame is cached from now on; drop it again if decoding fails
+uint8_t* frame_cache_claim(int frame);
+
+void frame_cache_drop(int frame);
+
+// Slot size in bytes
+size_t frame_cache_slot_size(void);
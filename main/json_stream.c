@@ -0,0 +1,296 @@
+// JSON Stream - pull tokenizer reading a JSON file in small chunks
+
+#include "json_stream.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char* TAG = "json_stream";
+
+void json_stream_init(json_stream_t* js, FILE* file) {
+    memset(js, 0, sizeof(json_stream_t));
+    js->file = file;
+    js->line = 1;
+}
+
+static json_token_t fail(json_stream_t* js, const char* what) {
+    if (!js->failed) {
+        ESP_LOGE(TAG, "%s at line %d", what, js->line);
+        js->failed = true;
+    }
+    return JSON_TOKEN_ERROR;
+}
+
+// Next byte without consuming it, -1 at the end of the file
+static int peek_byte(json_stream_t* js) {
+    if (js->pos == js->len) {
+        js->len = fread(js->chunk, 1, sizeof(js->chunk), js->file);
+        js->pos = 0;
+        if (js->len == 0) {
+            return -1;
+        }
+    }
+    return js->chunk[js->pos];
+}
+
+static int read_byte(json_stream_t* js) {
+    int c = peek_byte(js);
+    if (c >= 0) {
+        js->pos++;
+        if (c == '\n') {
+            js->line++;
+        }
+    }
+    return c;
+}
+
+static int skip_space(json_stream_t* js) {
+    int c = peek_byte(js);
+    while (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        read_byte(js);
+        c = peek_byte(js);
+    }
+    return c;
+}
+
+static void put_text(json_stream_t* js, const char* bytes, size_t count) {
+    if (js->text_len + count >= sizeof(js->text)) {
+        js->truncated = true;
+        return;
+    }
+    memcpy(js->text + js->text_len, bytes, count);
+    js->text_len += count;
+}
+
+static void put_codepoint(json_stream_t* js, uint32_t cp) {
+    char utf8[4];
+    size_t count;
+    if (cp < 0x80) {
+        utf8[0] = (char)cp;
+        count = 1;
+    } else if (cp < 0x800) {
+        utf8[0] = (char)(0xC0 | (cp >> 6));
+        utf8[1] = (char)(0x80 | (cp & 0x3F));
+        count = 2;
+    } else if (cp < 0x10000) {
+        utf8[0] = (char)(0xE0 | (cp >> 12));
+        utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (cp & 0x3F));
+        count = 3;
+    } else {
+        utf8[0] = (char)(0xF0 | (cp >> 18));
+        utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        utf8[3] = (char)(0x80 | (cp & 0x3F));
+        count = 4;
+    }
+    put_text(js, utf8, count);
+}
+
+static bool read_hex4(json_stream_t* js, uint32_t* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = read_byte(js);
+        int digit = c >= '0' && c <= '9' ? c - '0'
+                  : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                  : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        *value = (*value << 4) | digit;
+    }
+    return true;
+}
+
+// String after its opening quote, unescaped into text
+static bool read_string(json_stream_t* js) {
+    js->text_len = 0;
+    js->truncated = false;
+    for (;;) {
+        int c = read_byte(js);
+        if (c < 0x20) {
+            return false;       // End of file or a raw control character
+        }
+        if (c == '"') {
+            break;
+        }
+        if (c != '\\') {
+            char byte = (char)c;
+            put_text(js, &byte, 1);
+            continue;
+        }
+
+        char escaped;
+        c = read_byte(js);
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/': escaped = (char)c; break;
+            case 'b': escaped = '\b'; break;
+            case 'f': escaped = '\f'; break;
+            case 'n': escaped = '\n'; break;
+            case 'r': escaped = '\r'; break;
+            case 't': escaped = '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!read_hex4(js, &cp) || (cp >= 0xDC00 && cp < 0xE000)) {
+                    return false;
+                }
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    // High surrogate, the low one must follow
+                    uint32_t low;
+                    if (read_byte(js) != '\\' || read_byte(js) != 'u' || !read_hex4(js, &low) || low < 0xDC00 ||
+                        low >= 0xE000) {
+                        return false;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                put_codepoint(js, cp);
+                continue;
+            }
+            default:
+                return false;
+        }
+        put_text(js, &escaped, 1);
+    }
+
+    // A cut may have split a UTF-8 sequence copied from the file
+    if (js->truncated) {
+        size_t lead = js->text_len;
+        while (lead > 0 && ((uint8_t)js->text[lead - 1] & 0xC0) == 0x80) {
+            lead--;
+        }
+        if (lead > 0 && ((uint8_t)js->text[lead - 1] & 0x80)) {
+            uint8_t first = (uint8_t)js->text[lead - 1];
+            size_t length = first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+            if (lead - 1 + length > js->text_len) {
+                js->text_len = lead - 1;
+            }
+        }
+    }
+    js->text[js->text_len] = '\0';
+    return true;
+}
+
+static bool read_number(json_stream_t* js, int first) {
+    js->text_len = 0;
+    js->truncated = false;
+    char byte = (char)first;
+    put_text(js, &byte, 1);
+    int c = peek_byte(js);
+    while ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+        byte = (char)read_byte(js);
+        put_text(js, &byte, 1);
+        c = peek_byte(js);
+    }
+    js->text[js->text_len] = '\0';
+    return !js->truncated && (first != '-' || (js->text[1] >= '0' && js->text[1] <= '9'));
+}
+
+static bool read_literal(json_stream_t* js, const char* rest) {
+    for (; *rest; rest++) {
+        if (read_byte(js) != *rest) {
+            return false;
+        }
+    }
+    return true;
+}
+
+json_token_t json_stream_next(json_stream_t* js) {
+    if (js->failed) {
+        return JSON_TOKEN_ERROR;
+    }
+    int c = skip_space(js);
+    int open = js->depth > 0 ? js->stack[js->depth - 1] : 0;
+
+    // Between values: a comma, or the container closes
+    if (js->after_value || js->just_opened) {
+        bool closes = (c == '}' && open == '{') || (c == ']' && open == '[');
+        if (closes) {
+            read_byte(js);
+            js->depth--;
+            js->after_value = true;
+            js->just_opened = false;
+            return c == '}' ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END;
+        }
+        if (js->after_value) {
+            if (js->depth == 0) {
+                return c < 0 ? JSON_TOKEN_END : fail(js, "Data after the document");
+            }
+            if (c != ',') {
+                return fail(js, c < 0 ? "Unexpected end of file" : "Expected ',' or a closing bracket");
+            }
+            read_byte(js);
+            js->after_value = false;
+            c = skip_space(js);
+        }
+        js->just_opened = false;
+    }
+
+    // Member name
+    if (open == '{' && !js->after_key) {
+        if (c != '"') {
+            return fail(js, c < 0 ? "Unexpected end of file" : "Expected a member name");
+        }
+        read_byte(js);
+        if (!read_string(js)) {
+            return fail(js, "Malformed string");
+        }
+        if (skip_space(js) != ':') {
+            return fail(js, "Expected ':'");
+        }
+        read_byte(js);
+        js->after_key = true;
+        return JSON_TOKEN_KEY;
+    }
+    js->after_key = false;
+
+    // Value
+    if (c < 0) {
+        return fail(js, "Unexpected end of file");
+    }
+    read_byte(js);
+    js->after_value = true;
+    switch (c) {
+        case '{':
+        case '[':
+            if (js->depth == JSON_STREAM_MAX_DEPTH) {
+                return fail(js, "Nested too deeply");
+            }
+            js->stack[js->depth++] = (uint8_t)c;
+            js->after_value = false;
+            js->just_opened = true;
+            return c == '{' ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY;
+        case '"':
+            return read_string(js) ? JSON_TOKEN_STRING : fail(js, "Malformed string");
+        case 't':
+            return read_literal(js, "rue") ? JSON_TOKEN_TRUE : fail(js, "Unknown literal");
+        case 'f':
+            return read_literal(js, "alse") ? JSON_TOKEN_FALSE : fail(js, "Unknown literal");
+        case 'n':
+            return read_literal(js, "ull") ? JSON_TOKEN_NULL : fail(js, "Unknown literal");
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                return read_number(js, c) ? JSON_TOKEN_NUMBER : fail(js, "Malformed number");
+            }
+            return fail(js, "Unexpected character");
+    }
+}
+
+esp_err_t json_stream_skip(json_stream_t* js, json_token_t token) {
+    if (token == JSON_TOKEN_ERROR) {
+        return ESP_FAIL;
+    }
+    int depth = token == JSON_TOKEN_OBJECT || token == JSON_TOKEN_ARRAY ? 1 : 0;
+    while (depth > 0) {
+        token = json_stream_next(js);
+        if (token == JSON_TOKEN_ERROR || token == JSON_TOKEN_END) {
+            return ESP_FAIL;
+        }
+        if (token == JSON_TOKEN_OBJECT || token == JSON_TOKEN_ARRAY) {
+            depth++;
+        } else if (token == JSON_TOKEN_OBJECT_END || token == JSON_TOKEN_ARRAY_END) {
+            depth--;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,56 @@
+// JSON Stream - pull tokenizer reading a JSON file in small chunks
+// Holds one chunk of the file and the text of one string or number at a time,
+// so memory does not depend on the file size and nothing is allocated. The
+// caller pulls tokens and keeps only what it needs; strings longer than the
+// text buffer are cut short and flagged
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#define JSON_STREAM_CHUNK       256     // Bytes read from the file at a time
+#define JSON_STREAM_TEXT_MAX    128     // Longest string or number kept, including the NUL
+#define JSON_STREAM_MAX_DEPTH   16      // Nested objects and arrays
+
+typedef enum {
+    JSON_TOKEN_ERROR = -1,      // Malformed, too deep, or a read error
+    JSON_TOKEN_END = 0,         // End of the document
+    JSON_TOKEN_OBJECT,          // {
+    JSON_TOKEN_OBJECT_END,      // }
+    JSON_TOKEN_ARRAY,           // [
+    JSON_TOKEN_ARRAY_END,       // ]
+    JSON_TOKEN_KEY,             // Object member name, in text
+    JSON_TOKEN_STRING,          // Unescaped UTF-8, in text
+    JSON_TOKEN_NUMBER,          // As written, in text
+    JSON_TOKEN_TRUE,
+    JSON_TOKEN_FALSE,
+    JSON_TOKEN_NULL,
+} json_token_t;
+
+typedef struct {
+    FILE* file;
+    uint8_t chunk[JSON_STREAM_CHUNK];
+    size_t pos;
+    size_t len;
+    char text[JSON_STREAM_TEXT_MAX];
+    size_t text_len;
+    bool truncated;             // text was cut short
+    uint8_t stack[JSON_STREAM_MAX_DEPTH];   // '{' or '[' per open container
+    int depth;
+    bool after_value;           // A value just ended: ',' or a close follows
+    bool after_key;             // A member name just ended: its value follows
+    bool just_opened;           // A container just opened: it may close at once
+    int line;                   // For error messages
+    bool failed;                // Errors are sticky
+} json_stream_t;
+
+void json_stream_init(json_stream_t* js, FILE* file);
+
+// Next token; KEY, STRING and NUMBER leave their text in js->text
+json_token_t json_stream_next(json_stream_t* js);
+
+// Skip the rest of the value that token started (a no-op for scalars)
+esp_err_t json_stream_skip(json_stream_t* js, json_token_t token);
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "bsp/device.h"
 #include "bsp/display.h"
@@ -10,6 +11,7 @@
 #include "bsp/led.h"
 #include "bsp/power.h"
 #include "driver/gpio.h"
+#include "esp_cache.h"
 #include "esp_heap_caps.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_types.h"
@@ -27,9 +29,21 @@
 #include "ui_draw.h"
 #include "ui_menu.h"
 #include "media_loader.h"
+#include "media_scan.h"
 #include "mjpeg_decoder.h"
+#include "sw_jpeg.h"
 #include "avi_parser.h"
 #include "audio_player.h"
+#include "storage_bench.h"
+#include "trace.h"
+#include "play_stats.h"
+#include "perf_hud.h"
+#include "sys_monitor.h"
+#include "playback.h"
+#include "resume_store.h"
+#include "scrub.h"
+#include "frame_cache.h"
+#include "chapters.h"
 
 static const char* TAG = "video_player";
 
@@ -39,6 +53,7 @@ typedef enum {
     APP_STATE_MENU,         // Video selection menu
     APP_STATE_PRELOADING,   // Preloading video to PSRAM
     APP_STATE_PLAYING,      // Video playback
+    APP_STATE_BENCHMARK,    // Storage benchmark results
     APP_STATE_ERROR,        // Error state
 } app_state_t;
 
@@ -55,48 +70,80 @@ static SemaphoreHandle_t vsync_sem = NULL;
 static app_state_t app_state = APP_STATE_LOADING;
 static playlist_t playlist = {0};
 static ui_menu_state_t menu_state = {0};
-static avi_parser_t avi_parser = {0};
-static int current_frame = 0;
 static bool video_ended = false;
-
-// Video frame ring buffer in PSRAM (stores compressed MJPEG data)
-#define VIDEO_BUFFER_FRAMES  16                // Max frames to buffer
-#define VIDEO_FRAME_MAX_SIZE (64 * 1024)       // 64KB max per compressed frame
-#define PRE_BUFFER_TIME_MS   300               // Pre-buffer 300ms of audio before starting
-
-typedef struct {
-    size_t size;
-    int frame_index;    // Which frame number this is (for sync)
-} buffered_frame_t;
-
-static uint8_t* video_buffer_memory = NULL;    // VIDEO_BUFFER_FRAMES * VIDEO_FRAME_MAX_SIZE in PSRAM
-static buffered_frame_t video_frames[VIDEO_BUFFER_FRAMES];
-static int video_write_idx = 0;                // Next slot to write
-static int video_read_idx = 0;                 // Next slot to read
-static int video_buffered = 0;                 // Frames currently buffered
-static int next_frame_index = 0;               // Frame counter for buffering
-static bool end_of_file = false;               // True when AVI EOF reached
-
-// Pending audio chunk (when queue was full and we need to retry)
-static uint8_t pending_audio_data[4096];       // Copy of audio chunk data
-static size_t pending_audio_size = 0;          // 0 = no pending chunk
-
-// Video playback - FPS read from AVI file
-static int video_fps = 30;
-static int frame_duration_ms = 33;
+static bool video_failed = false;          // Ended by an error, not by reaching the end of the file
+
+// Demux ring and frame scheduler (compressed MJPEG frames in PSRAM)
+// Buffering policy lives in PLAYBACK_CONFIG_DEFAULT; host/playsim replays it
+static playback_t playback;
+#define VIDEO_DIRECT_IO      1                 // Read via raw FATFS sectors instead of stdio
+
+// How decoded frames reach the framebuffer
+static bool video_pre_rotated = false;         // Stream stored in framebuffer orientation
+static uint8_t* video_direct_dest = NULL;      // Decode straight into the framebuffer here (NULL = copy)
+static size_t video_direct_size = 0;
+static uint8_t* reduced_frame = NULL;          // 1/8 scale frames while scanning fast
+static size_t reduced_frame_capacity = 0;
+static int reduced_frame_stride = 0;
+static int video_rows = 0;                     // Framebuffer rows of the video, whole 16-pixel blocks
 
 // Forward declarations
-static int prebuffer_chunks(void);
 static bool process_video_frame(uint8_t* fb_pixels, int fb_stride, int fb_height);
 
+// Playback hooks into the audio player; the clock defaults to esp_timer
+static esp_err_t playback_audio_push(void* ctx, const uint8_t* data, size_t size) {
+    return audio_player_push_chunk(data, size);
+}
+
+static uint32_t playback_audio_position_ms(void* ctx) {
+    return audio_player_get_position_ms();
+}
+
 // I2S buffer latency compensation (samples in DMA buffer not yet played)
 // At 44.1kHz with ~2048 samples buffered, this is ~46ms
 #define AUDIO_BUFFER_LATENCY_MS  50
 
 // Playback timing
-static int64_t playback_start_time_us = 0;
-static int64_t audio_end_time_us = 0;      // When audio stopped (for wall clock fallback)
-static uint32_t audio_end_position_ms = 0; // Audio position when it stopped
+static int frame_to_present = -1;          // Frame in the framebuffer waiting for the next blit
+static const video_entry_t* playing_entry = NULL;
+
+// Playback speeds selectable with - and +, in percent
+static const int playback_speeds[] = {50, 75, 100, 125, 150, 200};
+
+// Holding left or right scans at 2x, doubling this often up to PLAYBACK_TRICK_MAX
+#define TRICK_ACCEL_US       1000000
+
+// Paused viewing: left and right step one frame, holding them plays slowly
+// that way; frames come from the frame cache or are read through the index,
+// and while idle the next frames in the direction of travel are decoded
+#define PAUSE_REPEAT_US      400000            // Holding a step key this long plays slowly
+#define PAUSE_SLOW_FPS       5
+#define PAUSE_PREDECODE      3                 // Frames decoded ahead of the paused one
+#define PAUSE_EMPTY_LOOKBACK 8                 // An empty frame repeats one at most this far back
+static bool paused = false;
+static int paused_frame = 0;
+static int pause_direction = 1;                // Direction of travel
+static bool frame_cache_ready = false;         // Frame cache sized for the current video
+
+// Chapters: a tap on left or right jumps to the next or previous chapter,
+// holding the key longer scans as before; a strip over the top of the video
+// shows the chapters for a while after a jump, at the start and while scanning
+#define CHAPTER_TAP_US       300000            // Released sooner than this is a tap
+#define CHAPTER_STRIP_US     3000000           // Strip stays this long
+#define CHAPTER_STRIP_MARGIN 16                // Screen pixels between the video edges and the strip
+#define CHAPTER_STRIP_TOP    12
+#define CHAPTER_STRIP_HEIGHT 6
+#define CHAPTER_STRIP_GAP    3                 // Between chapter segments
+#define CHAPTER_TITLE_HEIGHT 18
+static int64_t chapter_strip_until_us = 0;
+
+// Positions to resume from are saved this often while a video plays
+#define RESUME_CHECKPOINT_US 5000000
+static int64_t resume_checkpoint_us = 0;
+
+// Performance HUD
+#define HUD_UPDATE_US        250000            // Refresh the HUD four times per second
+#define MONITOR_INTERVAL_US  1000000           // Task/heap sampling period
 
 void blit(void) {
     bsp_display_blit(0, 0, display_h_res, display_v_res, pax_buf_get_pixels(&fb));
@@ -129,72 +176,171 @@ static void draw_error_screen(uint8_t* fb_pixels, int stride, int height, const
     hershey_draw_string(fb_pixels, stride, height, 50, 350, "Press ESC to return to launcher", 16, 200, 200, 200);
 }
 
-// Forward declarations for startup video
-static int prebuffer_chunks(void);
-static bool process_video_frame(uint8_t* fb_pixels, int fb_stride, int fb_height);
+// Directory holding the videos and playlist
+#define VIDEO_DIR "/sd/apps/at.cavac.hhgg"
+#define STARTUP_VIDEO "dontpanic.avi"          // Played at boot, not listed
+
+// Cap per clip for the sustained read part of the storage benchmark
+#define BENCH_MAX_BYTES_PER_FILE (16 * 1024 * 1024)
+
+// Show benchmark progress on the loading screen
+static void bench_progress(const char* message, void* arg) {
+    (void)arg;
+    draw_loading_screen((uint8_t*)pax_buf_get_pixels_rw(&fb), display_h_res, display_v_res, message);
+    blit();
+}
+
+// Run storage benchmark over all playlist clips and draw the results
+static void run_storage_benchmark(uint8_t* fb_pixels, int stride, int height) {
+    static storage_bench_report_t report;
+    static char paths[STORAGE_BENCH_MAX_FILES][128];
+    const char* path_list[STORAGE_BENCH_MAX_FILES];
+
+    int count = playlist_count(&playlist);
+    if (count > STORAGE_BENCH_MAX_FILES) count = STORAGE_BENCH_MAX_FILES;
+    for (int i = 0; i < count; i++) {
+        snprintf(paths[i], sizeof(paths[i]), VIDEO_DIR "/%s", playlist_get(&playlist, i)->video_file);
+        path_list[i] = paths[i];
+    }
+
+    esp_err_t ret = storage_bench_run(path_list, count, BENCH_MAX_BYTES_PER_FILE, &report, bench_progress, NULL);
+    if (ret != ESP_OK) {
+        draw_error_screen(fb_pixels, stride, height, "Benchmark failed");
+        return;
+    }
+    storage_bench_log(&report);
+
+    ui_clear(fb_pixels, stride, height, COLOR_BG);
+    uint32_t bar_color = report.unsustainable_count > 0 ? 0xFF0000 : COLOR_ACCENT1;
+    ui_draw_lcars_bar(fb_pixels, stride, height, 0, 0, 800, 60, bar_color);
+    hershey_draw_string(fb_pixels, stride, height, 100, 30, "CARD BENCHMARK", 28, 0, 0, 0);
+
+    char lines[6 + STORAGE_BENCH_MAX_FILES][STORAGE_BENCH_LINE_LEN];
+    int n = storage_bench_format(&report, lines, 6 + STORAGE_BENCH_MAX_FILES);
+    for (int i = 0; i < n && 90 + i * 22 < 440; i++) {
+        bool slow = strncmp(lines[i], "SLOW", 4) == 0;
+        hershey_draw_string(fb_pixels, stride, height, 20, 90 + i * 22, lines[i], 14, 255, slow ? 100 : 255,
+                            slow ? 100 : 255);
+    }
+    hershey_draw_string(fb_pixels, stride, height, 20, 455, "Press ESC to return", 16, 200, 200, 200);
+}
+
+// Open AVI file for streaming
+// Direct mode reads frames as whole sectors straight into the ring buffer,
+// stdio mode goes through fastopen()'s internal RAM buffer
+static esp_err_t open_video(const char* video_path) {
+    avi_source_t source;
+    esp_err_t ret = ESP_FAIL;
+#if VIDEO_DIRECT_IO
+    ret = avi_source_open_direct(&source, video_path);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Direct FATFS open failed (%s), using stdio", esp_err_to_name(ret));
+    }
+#endif
+    if (ret != ESP_OK) {
+        ret = avi_source_open_file(&source, video_path);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return avi_parser_open_source(&playback.parser, &source);
+}
+
+// Pick how decoded frames reach the framebuffer
+// Pre-rotated streams need no rotation; when they are as wide as the
+// framebuffer the JPEG engine decodes them in place at the letterbox offset
+static void setup_video_output(const avi_info_t* info) {
+    video_pre_rotated = info->has_playback_info && (info->playback.flags & AVI_FLAG_PRE_ROTATED);
+    video_direct_dest = NULL;
+    video_direct_size = 0;
+
+    // Fast scans decode at 1/8 scale into a small buffer, kept between videos
+    reduced_frame_stride = sw_jpeg_reduced_size(info->width) * 3;
+    size_t reduced_size = (size_t)reduced_frame_stride * sw_jpeg_reduced_size(info->height);
+    if (reduced_size > reduced_frame_capacity) {
+        heap_caps_free(reduced_frame);
+        reduced_frame = heap_caps_malloc(reduced_size, MALLOC_CAP_SPIRAM);
+        reduced_frame_capacity = reduced_frame ? reduced_size : 0;
+    }
+    scrub_prepare(info->width, info->height);
+
+    // Screen x is the framebuffer row, so the video is a block of whole rows
+    int video_span = video_pre_rotated ? (int)info->height : (int)info->width;
+    video_rows = (video_span + 15) & ~15;
+
+    if (!video_pre_rotated) {
+        return;
+    }
+
+    // The engine writes whole 16-pixel blocks
+    int fb_width = display_h_res;
+    int fb_height = display_v_res;
+    int aligned_width = (info->width + 15) & ~15;
+    int aligned_height = (info->height + 15) & ~15;
+    if (aligned_width == fb_width && aligned_height <= fb_height) {
+        uint8_t* pixels = (uint8_t*)pax_buf_get_pixels_rw(&fb);
+        uint8_t* dest = pixels + (size_t)((fb_height - aligned_height) / 2) * fb_width * 3;
+        size_t size = (size_t)aligned_height * fb_width * 3;
+        if (mjpeg_decoder_can_decode_into(dest, size)) {
+            video_direct_dest = dest;
+            video_direct_size = size;
+        }
+    }
+
+    ESP_LOGI(TAG, "Pre-rotated stream %lux%lu: %s", (unsigned long)info->width, (unsigned long)info->height,
+             video_direct_dest ? "decoding into framebuffer" : "row copy");
+}
 
 // Play startup video (blocking - plays until video ends)
 static void play_startup_video(const char* video_path, uint8_t* fb_pixels, int fb_stride, int fb_height) {
     ESP_LOGI(TAG, "Playing startup video: %s", video_path);
 
     // Open AVI file
-    esp_err_t ret = avi_parser_open(&avi_parser, video_path);
+    esp_err_t ret = open_video(video_path);
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "Startup video not found: %s", video_path);
         return;
     }
 
-    const avi_info_t* avi_info = avi_parser_get_info(&avi_parser);
-    video_fps = avi_info->fps > 0 ? avi_info->fps : 15;
-    frame_duration_ms = 1000 / video_fps;
+    const avi_info_t* avi_info = avi_parser_get_info(&playback.parser);
 
-    ESP_LOGI(TAG, "Startup video: %lux%lu @ %d fps",
-             (unsigned long)avi_info->width, (unsigned long)avi_info->height, video_fps);
-
-    // Allocate video buffer if needed
-    if (!video_buffer_memory) {
-        size_t buffer_size = VIDEO_BUFFER_FRAMES * VIDEO_FRAME_MAX_SIZE;
-        video_buffer_memory = heap_caps_malloc(buffer_size, MALLOC_CAP_SPIRAM);
-        if (!video_buffer_memory) {
-            ESP_LOGE(TAG, "Failed to allocate video buffer");
-            avi_parser_close(&avi_parser);
-            return;
-        }
+    // Size the ring for this file and reset buffer state
+    if (playback_prepare(&playback, 15) != ESP_OK) {
+        avi_parser_close(&playback.parser);
+        return;
     }
-
-    // Reset buffer state
-    video_write_idx = 0;
-    video_read_idx = 0;
-    video_buffered = 0;
-    next_frame_index = 0;
-    end_of_file = false;
-    current_frame = 0;
     video_ended = false;
-    pending_audio_size = 0;
+    video_failed = false;
+
+    ESP_LOGI(TAG, "Startup video: %lux%lu @ %d fps",
+             (unsigned long)avi_info->width, (unsigned long)avi_info->height, playback.fps);
 
     // Initialize MJPEG decoder
+    setup_video_output(avi_info);
     ret = mjpeg_decoder_init(avi_info->width, avi_info->height);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to init MJPEG decoder");
-        avi_parser_close(&avi_parser);
+        playback_stop(&playback);
         return;
     }
 
     // Start audio player
     if (avi_info->has_audio) {
+        audio_player_set_whole_frames(avi_info->has_playback_info &&
+                                      (avi_info->playback.flags & AVI_FLAG_AUDIO_ALIGNED));
+        audio_player_set_speed(playback.speed);
         audio_player_start();
     }
 
     // Pre-buffer
-    prebuffer_chunks();
+    playback_prebuffer(&playback);
 
     // Clear screen
     pax_background(&fb, 0);
     blit();
 
     // Start timing
-    uint32_t audio_already_played_ms = audio_player_get_position_ms();
-    playback_start_time_us = esp_timer_get_time() - (audio_already_played_ms * 1000);
+    playback_start_clock(&playback);
 
     // Play until video ends
     while (!video_ended) {
@@ -213,20 +359,12 @@ static void play_startup_video(const char* video_path, uint8_t* fb_pixels, int f
     // Wait a moment for audio to finish
     vTaskDelay(pdMS_TO_TICKS(100));
 
-    // Cleanup
+    // Cleanup, resetting state for the next video
     audio_player_stop();
     mjpeg_decoder_deinit();
-    avi_parser_close(&avi_parser);
-
-    // Reset state for next video
-    video_write_idx = 0;
-    video_read_idx = 0;
-    video_buffered = 0;
-    next_frame_index = 0;
-    end_of_file = false;
-    current_frame = 0;
+    playback_stop(&playback);
     video_ended = false;
-    pending_audio_size = 0;
+    video_failed = false;
 
     ESP_LOGI(TAG, "Startup video finished");
 }
@@ -237,58 +375,67 @@ static esp_err_t start_playback(video_entry_t* entry) {
 
     // Build video file path
     char video_path[128];
-    snprintf(video_path, sizeof(video_path), "/sd/apps/at.cavac.hhgg/%s", entry->video_file);
+    snprintf(video_path, sizeof(video_path), VIDEO_DIR "/%s", entry->video_file);
 
-    // Open AVI file for streaming (uses fastopen for optimal SD card performance)
-    esp_err_t ret = avi_parser_open(&avi_parser, video_path);
+    // Open AVI file for streaming
+    esp_err_t ret = open_video(video_path);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open AVI file: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    const avi_info_t* avi_info = avi_parser_get_info(&avi_parser);
-
-    // Set playback FPS from AVI file
-    video_fps = avi_info->fps > 0 ? avi_info->fps : 30;
-    frame_duration_ms = 1000 / video_fps;
-
-    ESP_LOGI(TAG, "AVI: %lux%lu @ %d fps (%d ms/frame)",
-             (unsigned long)avi_info->width, (unsigned long)avi_info->height,
-             video_fps, frame_duration_ms);
-
-    // Allocate video frame buffer in PSRAM
-    if (!video_buffer_memory) {
-        size_t buffer_size = VIDEO_BUFFER_FRAMES * VIDEO_FRAME_MAX_SIZE;
-        video_buffer_memory = heap_caps_malloc(buffer_size, MALLOC_CAP_SPIRAM);
-        if (!video_buffer_memory) {
-            ESP_LOGE(TAG, "Failed to allocate video buffer (%zu bytes)", buffer_size);
-            avi_parser_close(&avi_parser);
-            return ESP_ERR_NO_MEM;
+    // Play the audio track in the language asked for, else the file's first one;
+    // chunks of the other tracks are skipped without reading them
+    const char* language = entry->audio_language ? entry->audio_language : playlist.audio_language;
+    if (language) {
+        int stream = avi_parser_find_audio(avi_parser_get_info(&playback.parser), language);
+        if (stream >= 0) {
+            avi_parser_select_audio(&playback.parser, stream);
+        } else {
+            ESP_LOGI(TAG, "No %s audio track, playing the first one", language);
         }
-        ESP_LOGI(TAG, "Allocated video buffer: %zu bytes in PSRAM", buffer_size);
     }
 
-    // Reset buffer state
-    video_write_idx = 0;
-    video_read_idx = 0;
-    video_buffered = 0;
-    next_frame_index = 0;
-    end_of_file = false;
-    current_frame = 0;
+    const avi_info_t* avi_info = avi_parser_get_info(&playback.parser);
+
+    // Take the FPS from the AVI file, allocate the frame ring in PSRAM and reset buffer state
+    ret = playback_prepare(&playback, 30);
+    if (ret != ESP_OK) {
+        avi_parser_close(&playback.parser);
+        return ret;
+    }
     video_ended = false;
-    pending_audio_size = 0;
+    video_failed = false;
+
+    ESP_LOGI(TAG, "AVI: %lux%lu @ %d fps (%.2f ms/frame)",
+             (unsigned long)avi_info->width, (unsigned long)avi_info->height,
+             playback.fps, playback.frame_duration_us / 1000.0f);
 
     // Initialize MJPEG decoder
+    setup_video_output(avi_info);
     ret = mjpeg_decoder_init(avi_info->width, avi_info->height);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to init MJPEG decoder");
-        avi_parser_close(&avi_parser);
+        playback_stop(&playback);
         return ret;
     }
 
+    // Continue where this video was left; prebuffering then reads from there
+    // The seek goes through the frame index, files without one start over
+    uint32_t start_ms = 0;
+    resume_position_t resume;
+    if (resume_store_get(entry->video_file, &resume) && playback_seek(&playback, resume.frame) == ESP_OK) {
+        start_ms = resume.audio_ms;
+        ESP_LOGI(TAG, "Resuming at frame %lu (%lu ms)", (unsigned long)resume.frame, (unsigned long)start_ms);
+    }
+
     // Start audio player (creates queue and task)
+    // Whole-frame chunks let the decoder skip its partial-frame handling
     if (avi_info->has_audio) {
-        ret = audio_player_start();
+        audio_player_set_whole_frames(avi_info->has_playback_info &&
+                                      (avi_info->playback.flags & AVI_FLAG_AUDIO_ALIGNED));
+        audio_player_set_speed(playback.speed);
+        ret = audio_player_start_at(start_ms);
         if (ret != ESP_OK) {
             ESP_LOGW(TAG, "Audio start failed, continuing without audio");
         }
@@ -296,218 +443,486 @@ static esp_err_t start_playback(video_entry_t* entry) {
 
     // Pre-buffer audio and video before starting playback timing
     // This ensures audio queue is filled and we have frames ready
-    prebuffer_chunks();
+    playback_prebuffer(&playback);
 
     // Clear screen to black for letterbox bars
     pax_background(&fb, 0);
     blit();
 
-    // Account for audio that already played during prebuffering
-    // This syncs video timing to where audio already is
-    uint32_t audio_already_played_ms = audio_player_get_position_ms();
-    playback_start_time_us = esp_timer_get_time() - (audio_already_played_ms * 1000);
-    audio_end_time_us = 0;
-    audio_end_position_ms = 0;
+    // Video timing starts where the audio already is
+    playback_start_clock(&playback);
 
-    ESP_LOGI(TAG, "Playback starting (audio offset: %lu ms)", (unsigned long)audio_already_played_ms);
+    trace_reset();  // A dump after the video shows just this video
+    play_stats_reset(playback_frame_interval_us(&playback));
+    playing_entry = entry;
+    resume_checkpoint_us = esp_timer_get_time();
+    playback.read_bytes = 0;
+    playback.read_busy_us = 0;
+
+    // The HUD goes in the letterbox left of the video
+    perf_hud_set_area((display_v_res - video_rows) / 2);
+    frame_cache_ready = false;
+
+    // Chapters are resolved to frames now so a jump is a single seek
+    chapters_load(&playback, entry);
+    chapter_strip_until_us = chapters_count() > 0 ? esp_timer_get_time() + CHAPTER_STRIP_US : 0;
     return ESP_OK;
 }
 
+// Remember the frame on screen so the video can be resumed there
+// Only updates the RAM table, the journal is written in the background
+static void save_position(void) {
+    if (!playing_entry || playback.shown_frame <= 0) {
+        return;
+    }
+    resume_position_t position = {
+        .frame = (uint32_t)playback.shown_frame,
+        .audio_ms = (uint32_t)(playback_pts_us(&playback, playback.shown_frame) / 1000),
+    };
+    resume_store_put(playing_entry->video_file, &position);
+}
+
+// A seek failed: stop the video as at its end, but keep the position on
+// screen so the next start resumes there
+static void abort_video(void) {
+    save_position();
+    video_failed = true;
+    video_ended = true;
+}
+
 // Stop video playback
 static void stop_playback(void) {
     ESP_LOGI(TAG, "Stopping playback");
+    play_stats_log(playing_entry ? playing_entry->display_name : NULL);
+    sys_monitor_log();
+    playing_entry = NULL;
+    frame_to_present = -1;
+    paused = false;
+    chapters_clear();
+    if (scrub_active()) {
+        scrub_end((uint8_t*)pax_buf_get_pixels_rw(&fb), display_h_res, display_v_res);
+    }
 
     audio_player_stop();
     mjpeg_decoder_deinit();
-    avi_parser_close(&avi_parser);
 
     // Reset buffer state (keep memory allocated for next video)
-    video_write_idx = 0;
-    video_read_idx = 0;
-    video_buffered = 0;
-    next_frame_index = 0;
-    end_of_file = false;
-    current_frame = 0;
+    playback_stop(&playback);
     video_ended = false;
+    video_failed = false;
 }
 
-// Timing statistics for performance debugging
-static uint32_t timing_decode_us = 0;
-static uint32_t timing_copy_us = 0;
-static uint32_t timing_frame_count = 0;
+// Step the playback speed up or down; the video clock and the time
+// stretcher change together, and a speed chosen in the menu applies to the
+// next video
+static void step_speed(int direction) {
+    int count = sizeof(playback_speeds) / sizeof(playback_speeds[0]);
+    int i = 0;
+    while (i < count - 1 && playback_speeds[i] < playback.speed) {
+        i++;
+    }
+    i += direction;
+    if (i < 0 || i >= count) {
+        return;
+    }
+    playback_set_speed(&playback, playback_speeds[i]);
+    audio_player_set_speed(playback.speed);
+    play_stats_set_frame_duration(playback_frame_interval_us(&playback));
+}
 
-// Get pointer to video buffer slot
-static inline uint8_t* video_buffer_slot(int idx) {
-    return video_buffer_memory + (idx * VIDEO_FRAME_MAX_SIZE);
+// Continue normal play after a seek: the audio restarts at the frame's time
+// and the ring is prebuffered as at startup, so audio and video are in sync
+static void continue_playback(void) {
+    if (avi_parser_get_info(&playback.parser)->has_audio) {
+        audio_player_set_speed(playback.speed);
+        audio_player_start_at((uint32_t)(playback_pts_us(&playback, playback.current_frame) / 1000));
+    }
+    playback_prebuffer(&playback);
+    playback_start_clock(&playback);
+    play_stats_set_frame_duration(playback_frame_interval_us(&playback));
 }
 
-// Buffer one chunk from AVI file
-// Returns: 0 = buffered audio or video, 1 = EOF, -1 = video buffer full, -2 = audio queue full
-static int buffer_one_chunk(void) {
-    // First try to push any pending audio chunk
-    if (pending_audio_size > 0) {
-        if (audio_player_push_chunk(pending_audio_data, pending_audio_size) == ESP_OK) {
-            pending_audio_size = 0;  // Success
-        } else {
-            // Can't push pending audio - don't read any more chunks
-            // This guarantees we never lose audio data
-            return -2;
+// Trick play while left or right is held: the audio stops and the rate
+// grows the longer the key is held; on release playback continues in sync
+// from the frame on screen
+static void update_trick(int direction) {
+    static int64_t held_since_us = 0;
+    if (direction == 0) {
+        if (playback.trick_rate == 0) {
+            return;
         }
+        if (playback_set_trick(&playback, 0) != ESP_OK) {
+            ESP_LOGE(TAG, "Cannot resume after trick play");
+            abort_video();
+            return;
+        }
+        continue_playback();
+        return;
+    }
+    if (playback_indexed_frames(&playback) == 0) {
+        return;     // Needs the frame index of a remuxed file
     }
 
-    // If video buffer is full
-    if (video_buffered >= VIDEO_BUFFER_FRAMES) {
-        return -1;  // Video buffer full
+    int64_t now = esp_timer_get_time();
+    if (playback.trick_rate == 0 || (playback.trick_rate > 0) != (direction > 0)) {
+        held_since_us = now;
     }
+    int rate = 2;
+    for (int64_t held = now - held_since_us; held >= TRICK_ACCEL_US && rate < PLAYBACK_TRICK_MAX;
+         held -= TRICK_ACCEL_US) {
+        rate *= 2;
+    }
+    rate *= direction;
+    if (rate == playback.trick_rate) {
+        return;
+    }
+    if (playback.trick_rate == 0) {
+        audio_player_stop();
+    }
+    playback_set_trick(&playback, rate);
+    play_stats_set_frame_duration(playback_frame_interval_us(&playback));
+}
 
-    avi_chunk_t chunk;
-    esp_err_t ret = avi_parser_next_chunk(&avi_parser, &chunk);
+// Jump to the next chapter, or back to the start of this or the previous one
+static void jump_chapter(int direction) {
+    int frame = playback.shown_frame >= 0 ? playback.shown_frame : playback.current_frame;
+    int target = chapters_target(frame, direction);
+    chapter_strip_until_us = esp_timer_get_time() + CHAPTER_STRIP_US;
+    if (target < 0) {
+        return;     // Past the last chapter
+    }
+    audio_player_stop();
+    if (playback_seek(&playback, target) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot jump to frame %d", target);
+        abort_video();
+        return;
+    }
+    continue_playback();
+    int chapter = chapters_at(target);
+    ESP_LOGI(TAG, "Chapter %d/%d at frame %d: %s", chapter + 1, chapters_count(), target, chapters_title(chapter));
+}
 
-    if (ret != ESP_OK || chunk.type == AVI_CHUNK_END) {
-        end_of_file = true;
-        return 1;  // EOF
+// Tell a tap on left or right from a hold: the key counts for trick play
+// only once held CHAPTER_TAP_US, a shorter press jumps a chapter on release
+// Returns the direction to scan in
+static int update_chapter_keys(int direction) {
+    static int held_direction = 0;
+    static int64_t held_since_us = 0;
+    if (chapters_count() == 0 || playback.trick_rate != 0) {
+        held_direction = direction;
+        held_since_us = 0;
+        return direction;
     }
 
-    if (chunk.type == AVI_CHUNK_AUDIO) {
-        // Try to push to audio queue
-        if (audio_player_push_chunk(chunk.data, chunk.size) == ESP_ERR_TIMEOUT) {
-            // Queue full - save for later (pending is guaranteed empty at this point)
-            if (chunk.size <= sizeof(pending_audio_data)) {
-                memcpy(pending_audio_data, chunk.data, chunk.size);
-                pending_audio_size = chunk.size;
-            }
+    int64_t now = esp_timer_get_time();
+    if (direction != held_direction) {
+        bool tap = held_direction != 0 && held_since_us > 0 && now - held_since_us < CHAPTER_TAP_US;
+        if (tap) {
+            jump_chapter(held_direction);
         }
-        return 0;
+        held_direction = direction;
+        held_since_us = now;
+    }
+    if (direction != 0 && held_since_us > 0 && now - held_since_us < CHAPTER_TAP_US) {
+        return 0;       // Not yet known to be a hold
     }
+    return direction;
+}
 
-    if (chunk.type == AVI_CHUNK_VIDEO) {
-        // Copy to video ring buffer
-        if (chunk.size > VIDEO_FRAME_MAX_SIZE) {
-            ESP_LOGW(TAG, "Video frame too large: %zu > %d, skipping", chunk.size, VIDEO_FRAME_MAX_SIZE);
-            next_frame_index++;
-            return 0;
-        }
+// Chapter segments along the top of the video, the current one lit, and
+// its number and title below them
+static void draw_chapter_strip(uint8_t* fb_pixels, int fb_stride, int fb_height, int frame) {
+    int frames = playback_indexed_frames(&playback);
+    int count = chapters_count();
+    int current = chapters_at(frame);
+    int left = (fb_height - video_rows) / 2 + CHAPTER_STRIP_MARGIN;
+    int width = video_rows - 2 * CHAPTER_STRIP_MARGIN;
+    for (int i = 0; i < count; i++) {
+        int end = i + 1 < count ? chapters_frame(i + 1) : frames;
+        int x0 = left + (int)((int64_t)width * chapters_frame(i) / frames);
+        int x1 = left + (int)((int64_t)width * end / frames) - (i + 1 < count ? CHAPTER_STRIP_GAP : 0);
+        ui_fill_rect(fb_pixels, fb_stride, fb_height, x0, CHAPTER_STRIP_TOP, x1 > x0 ? x1 - x0 : 1,
+                     CHAPTER_STRIP_HEIGHT, i == current ? COLOR_ACCENT1 : COLOR_DIM);
+    }
+    if (current < 0) {
+        return;
+    }
+
+    char label[CHAPTERS_TITLE_MAX + 16];
+    snprintf(label, sizeof(label), "%d/%d  %s", current + 1, count, chapters_title(current));
+    int label_y = CHAPTER_STRIP_TOP + CHAPTER_STRIP_HEIGHT + 6;
+    int label_w = hershey_string_width(label, CHAPTER_TITLE_HEIGHT) + 12;
+    ui_fill_rect(fb_pixels, fb_stride, fb_height, left, label_y, label_w < width ? label_w : width,
+                 CHAPTER_TITLE_HEIGHT + 10, COLOR_BG);
+    hershey_draw_string_bold(fb_pixels, fb_stride, fb_height, left + 6, label_y + 5, label, CHAPTER_TITLE_HEIGHT,
+                             COLOR_R(COLOR_TEXT), COLOR_G(COLOR_TEXT), COLOR_B(COLOR_TEXT));
+}
 
-        uint8_t* dest = video_buffer_slot(video_write_idx);
-        memcpy(dest, chunk.data, chunk.size);
-        video_frames[video_write_idx].size = chunk.size;
-        video_frames[video_write_idx].frame_index = next_frame_index++;
+// Redraw the strip over each new frame while it is shown
+static void update_chapter_strip(uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    if (chapters_count() == 0 || frame_to_present < 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (playback.trick_rate != 0) {
+        chapter_strip_until_us = now + CHAPTER_STRIP_US;
+    }
+    if (now < chapter_strip_until_us) {
+        draw_chapter_strip(fb_pixels, fb_stride, fb_height, frame_to_present);
+    }
+}
 
-        video_write_idx = (video_write_idx + 1) % VIDEO_BUFFER_FRAMES;
-        video_buffered++;
-        return 0;
+// Scrub while up or down is held: playback stops and a cursor moves over a
+// seek bar with previews; on release full playback continues from the cursor
+// Returns true while scrubbing
+static bool update_scrub(int direction, uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    if (!scrub_active()) {
+        if (direction == 0 || playback.trick_rate != 0 || scrub_begin(&playback) != ESP_OK) {
+            return false;   // Needs the frame index of a remuxed file
+        }
+        audio_player_stop();
+    }
+    if (direction != 0) {
+        scrub_update(&playback, direction, esp_timer_get_time());
+        scrub_draw(fb_pixels, fb_stride, fb_height, !video_pre_rotated);
+        return true;
     }
 
-    // Unknown chunk type, skip
-    return 0;
+    int frame = scrub_end(fb_pixels, fb_stride, fb_height);
+    if (playback_seek(&playback, frame) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot continue at frame %d", frame);
+        abort_video();
+        return false;
+    }
+    continue_playback();
+    return false;
 }
 
-// Pre-buffer audio and video before starting playback
-// Returns number of video frames buffered
-static int prebuffer_chunks(void) {
-    int target_frames = (PRE_BUFFER_TIME_MS * video_fps) / 1000;
-    if (target_frames < 3) target_frames = 3;  // Minimum 3 frames
-    if (target_frames > VIDEO_BUFFER_FRAMES - 2) target_frames = VIDEO_BUFFER_FRAMES - 2;
+// The video rows of the framebuffer, the layout of a frame cache slot
+static uint8_t* video_region(uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    return fb_pixels + (size_t)((fb_height - video_rows) / 2) * fb_stride * 3;
+}
 
-    ESP_LOGI(TAG, "Pre-buffering %d frames (%dms at %dfps)...", target_frames, PRE_BUFFER_TIME_MS, video_fps);
+// Decode a frame into a frame cache slot like into the framebuffer
+static esp_err_t decode_to_slot(const uint8_t* data, size_t size, uint8_t* slot, int fb_stride) {
+    size_t slot_size = (size_t)video_rows * fb_stride * 3;
+    uint8_t* jpeg = (uint8_t*)data;
+    int width = 0, height = 0;
+    if (video_direct_dest && mjpeg_decoder_can_decode_into(slot, slot_size)) {
+        esp_err_t ret = mjpeg_decoder_decode_into(jpeg, size, slot, slot_size, &width, &height);
+        if (ret == ESP_OK && mjpeg_decoder_is_hardware()) {
+            // Written by DMA, the CPU copies it out later
+            esp_cache_msync(slot, slot_size, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+        }
+        return ret;
+    }
+    if (!mjpeg_decoder_is_hardware()) {
+        return mjpeg_decoder_decode_to_framebuffer(jpeg, size, slot, fb_stride, video_rows, !video_pre_rotated,
+                                                   &width, &height);
+    }
+    uint8_t* bgr_out = NULL;
+    esp_err_t ret = mjpeg_decoder_decode(jpeg, size, &bgr_out, &width, &height);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (video_pre_rotated) {
+        return mjpeg_copy_rows_to_framebuffer(bgr_out, slot, width, height, fb_stride, video_rows);
+    }
+    return mjpeg_copy_to_framebuffer(bgr_out, slot, width, height, video_rows);
+}
 
-    while (video_buffered < target_frames && !end_of_file) {
-        int result = buffer_one_chunk();
-        if (result == 1) break;  // EOF
-        // result == -1 shouldn't happen since we check video_buffered < target
+// Decoded frame for paused viewing, from the cache or read through the index
+static const uint8_t* paused_frame_pixels(int frame, int fb_stride) {
+    uint8_t* pixels = frame_cache_get(frame);
+    if (pixels) {
+        return pixels;
     }
 
-    ESP_LOGI(TAG, "Pre-buffered %d video frames", video_buffered);
-    return video_buffered;
+    const uint8_t* data = NULL;
+    size_t size = 0;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    for (int f = frame; f >= 0 && f > frame - PAUSE_EMPTY_LOOKBACK && ret == ESP_ERR_NOT_FOUND; f--) {
+        ret = playback_read_frame(&playback, f, &data, &size);
+    }
+    pixels = ret == ESP_OK ? frame_cache_claim(frame) : NULL;
+    if (!pixels || decode_to_slot(data, size, pixels, fb_stride) != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot show frame %d", frame);
+        frame_cache_drop(frame);
+        return NULL;
+    }
+    return pixels;
 }
 
-// Process video frame with wall clock sync
-static bool process_video_frame(uint8_t* fb_pixels, int fb_stride, int fb_height) {
-    // Read chunks to maintain buffers
-    // Higher FPS needs more chunks per call to keep up
-    int chunks_read = 0;
-    int max_chunks = 8;  // Enough for ~2-3 video frames worth of data
-    while (video_buffered < VIDEO_BUFFER_FRAMES && !end_of_file && chunks_read < max_chunks) {
-        int result = buffer_one_chunk();
-        if (result != 0) break;  // EOF or video buffer full
-        chunks_read++;
+// Stop at the frame on screen, which becomes the first one cached
+static void enter_pause(uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    size_t frame_size = (size_t)video_rows * fb_stride * 3;
+    if (video_rows > fb_height) {
+        return;
     }
+    if (!frame_cache_ready) {
+        frame_cache_ready = frame_cache_prepare(frame_size) == ESP_OK;
+    }
+    int frame = playback.shown_frame >= 0 ? playback.shown_frame : playback.current_frame;
+    if (!frame_cache_ready || playback_seek(&playback, frame) != ESP_OK) {
+        return;     // Needs the frame index of a remuxed file
+    }
+    audio_player_stop();
 
-    // Check for end of video
-    if (video_buffered == 0 && end_of_file) {
-        audio_player_end_stream();
-        ESP_LOGI(TAG, "=== VIDEO END: frame=%d ===", current_frame);
-        return true;
+    uint8_t* slot = frame_cache_claim(frame);
+    memcpy(slot, video_region(fb_pixels, fb_stride, fb_height), frame_size);
+    paused = true;
+    paused_frame = frame;
+    pause_direction = 1;
+    ESP_LOGI(TAG, "Paused at frame %d", frame);
+}
+
+// Continue in sync from the paused frame
+static void leave_pause(void) {
+    paused = false;
+    if (playback_seek(&playback, paused_frame) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot continue at frame %d", paused_frame);
+        abort_video();
+        return;
     }
+    continue_playback();
+}
 
-    // Calculate which frame should be displayed based on wall clock
-    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - playback_start_time_us) / 1000);
-    int expected_frame = (int)(elapsed_ms / frame_duration_ms);
+// Step while left or right is pressed (direction -1 or +1), or decode ahead
+static void update_pause(int direction, uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    static int held_direction = 0;
+    static int64_t held_since_us = 0;
+    static int64_t last_step_us = 0;
+    int64_t now = esp_timer_get_time();
+    int step = 0;
+    if (direction != held_direction) {
+        held_direction = direction;
+        held_since_us = now;
+        last_step_us = now;
+        step = direction;       // A press steps one frame
+    } else if (direction && now - held_since_us >= PAUSE_REPEAT_US && now - last_step_us >= 1000000 / PAUSE_SLOW_FPS) {
+        last_step_us = now;
+        step = direction;
+    }
 
-    // If we're ahead of schedule, wait
-    if (current_frame > expected_frame) {
-        return false;
+    int frames = playback_indexed_frames(&playback);
+    int target = paused_frame + step;
+    if (step != 0) {
+        pause_direction = step;
+        const uint8_t* pixels = target >= 0 && target < frames ? paused_frame_pixels(target, fb_stride) : NULL;
+        if (pixels) {
+            memcpy(video_region(fb_pixels, fb_stride, fb_height), pixels, (size_t)video_rows * fb_stride * 3);
+            paused_frame = target;
+            playback.shown_frame = target;
+        }
+        return;
     }
 
-    // No frames buffered? Wait for more
-    if (video_buffered == 0) {
-        return false;
+    // Idle: decode the next uncached frame ahead, one per call
+    for (int i = 1; i <= PAUSE_PREDECODE; i++) {
+        int ahead = paused_frame + i * pause_direction;
+        if (ahead < 0 || ahead >= frames) {
+            break;
+        }
+        if (!frame_cache_get(ahead)) {
+            paused_frame_pixels(ahead, fb_stride);
+            break;
+        }
     }
+}
 
-    // Get the next buffered frame
-    buffered_frame_t* frame = &video_frames[video_read_idx];
-    uint8_t* frame_data = video_buffer_slot(video_read_idx);
+// Timing statistics for performance debugging
+static uint32_t timing_decode_us = 0;
+static uint32_t timing_copy_us = 0;
+static uint32_t timing_frame_count = 0;
 
-    // Skip frames if we're behind (drop frames to catch up)
-    int frames_skipped = 0;
-    while (frame->frame_index < expected_frame && video_buffered > 1) {
-        // Drop this frame
-        video_read_idx = (video_read_idx + 1) % VIDEO_BUFFER_FRAMES;
-        video_buffered--;
-        current_frame = frame->frame_index + 1;
-        frames_skipped++;
+// Process video frame with wall clock sync
+static bool process_video_frame(uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    // Read chunks to maintain buffers
+    playback_fill(&playback);
 
-        frame = &video_frames[video_read_idx];
-        frame_data = video_buffer_slot(video_read_idx);
+    // Check for end of video
+    if (playback_finished(&playback)) {
+        audio_player_end_stream();
+        ESP_LOGI(TAG, "=== VIDEO END: frame=%d ===", playback.current_frame);
+        return true;
     }
-    if (frames_skipped > 0) {
-        ESP_LOGW(TAG, "Skipped %d video frames (behind by %d)", frames_skipped, expected_frame - current_frame);
+
+    // Frame due on the wall clock, late ones are dropped; NULL = wait
+    const playback_frame_t* frame = playback_due_frame(&playback);
+    if (!frame) {
+        return false;
     }
+    uint8_t* frame_data = frame->data;
+    int frame_index = frame->frame_index;
 
     int64_t t0 = esp_timer_get_time();
+    TRACE_BEGIN(DECODE);
 
-    // Decode MJPEG frame
+    // Decode MJPEG frame (pre-rotated streams may land in the framebuffer directly,
+    // the software decoder always writes to the framebuffer, rotating as it goes)
+    // Fast scans decode at 1/8 scale (in software, the engine cannot scale)
     uint8_t* bgr_out = NULL;
     int width = 0, height = 0;
-    esp_err_t ret = mjpeg_decoder_decode(frame_data, frame->size, &bgr_out, &width, &height);
+    bool reduced = reduced_frame && abs(playback.trick_rate) >= PLAYBACK_TRICK_REDUCED;
+    bool in_place = reduced || video_direct_dest || !mjpeg_decoder_is_hardware();
+    esp_err_t ret;
+    if (reduced) {
+        ret = mjpeg_decoder_decode_reduced(frame_data, frame->size, reduced_frame, reduced_frame_stride, &width,
+                                           &height);
+        if (ret == ESP_OK) {
+            ret = mjpeg_draw_reduced_to_framebuffer(reduced_frame, width, height, reduced_frame_stride, fb_pixels,
+                                                    fb_stride, fb_height, !video_pre_rotated);
+        }
+        bgr_out = fb_pixels;
+    } else if (video_direct_dest) {
+        ret = mjpeg_decoder_decode_into(frame_data, frame->size, video_direct_dest, video_direct_size, &width,
+                                        &height);
+        bgr_out = video_direct_dest;
+    } else if (in_place) {
+        ret = mjpeg_decoder_decode_to_framebuffer(frame_data, frame->size, fb_pixels, fb_stride, fb_height,
+                                                  !video_pre_rotated, &width, &height);
+        bgr_out = fb_pixels;
+    } else {
+        ret = mjpeg_decoder_decode(frame_data, frame->size, &bgr_out, &width, &height);
+    }
 
     // Consume the frame from buffer
-    video_read_idx = (video_read_idx + 1) % VIDEO_BUFFER_FRAMES;
-    video_buffered--;
+    bool shown = ret == ESP_OK && bgr_out;
+    playback_release_frame(&playback, shown);
 
     int64_t t1 = esp_timer_get_time();
+    TRACE_END(DECODE, frame_index);
 
-    if (ret == ESP_OK && bgr_out) {
-        current_frame = frame->frame_index + 1;
+    if (shown) {
 
-        // Copy to framebuffer
-        mjpeg_copy_to_framebuffer(bgr_out, fb_pixels, width, height, 800);
+        // Copy to framebuffer (nothing left to do when decoded in place)
+        TRACE_BEGIN(COPY);
+        if (!in_place && video_pre_rotated) {
+            mjpeg_copy_rows_to_framebuffer(bgr_out, fb_pixels, width, height, fb_stride, fb_height);
+        } else if (!in_place) {
+            mjpeg_copy_to_framebuffer(bgr_out, fb_pixels, width, height, 800);
+        }
+        TRACE_END(COPY, frame_index);
 
         int64_t t2 = esp_timer_get_time();
 
         // Timing stats
+        play_stats_add(PLAY_STAT_DECODE, t1 - t0);
+        play_stats_add(PLAY_STAT_COPY, t2 - t1);
+        frame_to_present = frame_index;
         timing_decode_us += (t1 - t0);
         timing_copy_us += (t2 - t1);
         timing_frame_count++;
 
         if (timing_frame_count >= 30) {
             uint32_t audio_pos = audio_player_get_position_ms();
-            int64_t video_pos_ms = current_frame * frame_duration_ms;
+            int64_t video_pos_ms = playback_pts_us(&playback, playback.current_frame) / 1000;
 
             ESP_LOGI(TAG, "Timing (avg 30): Decode=%.1fms Copy=%.1fms | Buf=%d",
-                     timing_decode_us / 30000.0f, timing_copy_us / 30000.0f, video_buffered);
-            ESP_LOGI(TAG, "Sync: wall=%lums audio=%lums video=%lldms frame=%d",
-                     (unsigned long)elapsed_ms, (unsigned long)audio_pos, video_pos_ms, current_frame);
+                     timing_decode_us / 30000.0f, timing_copy_us / 30000.0f, playback.buffered);
+            ESP_LOGI(TAG, "Sync: clock=%lums audio=%lums video=%lldms frame=%d",
+                     (unsigned long)playback_elapsed_ms(&playback), (unsigned long)audio_pos, video_pos_ms,
+                     playback.current_frame);
             timing_decode_us = 0;
             timing_copy_us = 0;
             timing_frame_count = 0;
@@ -517,6 +932,36 @@ static bool process_video_frame(uint8_t* fb_pixels, int fb_stride, int fb_height
     return false;
 }
 
+// Refresh the HUD a few times per second during playback
+static void update_hud(uint8_t* fb_pixels, int fb_stride, int fb_height) {
+    static int64_t last_us = 0;
+    static uint32_t last_presented = 0;
+    int64_t now = esp_timer_get_time();
+    if (now - last_us < HUD_UPDATE_US) {
+        return;
+    }
+
+    perf_hud_values_t values = {0};
+    uint32_t presented = play_stats_presented();
+    if (last_us > 0 && presented >= last_presented) {
+        values.fps = (presented - last_presented) * 1000000.0f / (now - last_us);
+    }
+    last_us = now;
+    last_presented = presented;
+
+    values.dropped = play_stats_dropped_count();
+    values.ring_fill = playback.buffered;
+    values.ring_size = playback.ring_frames;
+    values.audio_queued = audio_player_queued_chunks(&values.audio_capacity);
+    values.av_drift_ms = (int32_t)(audio_player_get_position_ms() -
+                                   playback_pts_us(&playback, playback.current_frame) / 1000);
+    values.sd_mb_s = playback.read_busy_us > 0 ? (float)playback.read_bytes / playback.read_busy_us : 0;   // MB/s
+    const sys_monitor_t* monitor = sys_monitor_get();
+    values.core_load[0] = monitor->core_load[0];
+    values.core_load[1] = monitor->core_load[1];
+    perf_hud_draw(fb_pixels, fb_stride, fb_height, &values);
+}
+
 void app_main(void) {
     // Initialize USB debug console
     usb_initialize();
@@ -561,7 +1006,13 @@ void app_main(void) {
     }
 
     // Initialize graphics
-    pax_buf_init(&fb, NULL, display_h_res, display_v_res, format);
+    // The framebuffer is cache-line aligned in PSRAM so the JPEG engine can
+    // decode pre-rotated streams straight into it (PAX allocates if this fails)
+    size_t fb_align = 64;
+    esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &fb_align);
+    size_t fb_bytes = (size_t)display_h_res * display_v_res * (format == PAX_BUF_16_565RGB ? 2 : 3);
+    void* fb_memory = heap_caps_aligned_calloc(fb_align, 1, fb_bytes, MALLOC_CAP_SPIRAM);
+    pax_buf_init(&fb, fb_memory, display_h_res, display_v_res, format);
     pax_buf_reversed(&fb, display_data_endian == LCD_RGB_DATA_ENDIAN_BIG);
     pax_buf_set_orientation(&fb, orientation);
 
@@ -593,6 +1044,16 @@ void app_main(void) {
         blit();
     }
 
+    trace_init();
+    perf_hud_init();
+
+    const playback_config_t playback_config = PLAYBACK_CONFIG_DEFAULT;
+    const playback_ops_t playback_ops = {
+        .audio_push = playback_audio_push,
+        .audio_position_ms = playback_audio_position_ms,
+    };
+    playback_init(&playback, &playback_config, &playback_ops);
+
     // Initialize audio player (needed for startup video)
     if (app_state != APP_STATE_ERROR) {
         res = audio_player_init();
@@ -603,7 +1064,7 @@ void app_main(void) {
 
     // Play startup video before showing UI
     if (app_state != APP_STATE_ERROR) {
-        play_startup_video("/sd/apps/at.cavac.hhgg/dontpanic.avi", fb_pixels, fb_stride, fb_height);
+        play_startup_video(VIDEO_DIR "/" STARTUP_VIDEO, fb_pixels, fb_stride, fb_height);
     }
 
     // Load playlist
@@ -611,7 +1072,11 @@ void app_main(void) {
         draw_loading_screen(fb_pixels, fb_stride, fb_height, "Loading...");
         blit();
 
-        res = playlist_load("/sd/apps/at.cavac.hhgg/playlist.json", &playlist);
+        // List the videos found, then let playlist.json (optional) name and order them
+        res = media_scan(VIDEO_DIR, VIDEO_DIR "/media.bin", STARTUP_VIDEO, &playlist);
+        if (res == ESP_OK) {
+            playlist_load(VIDEO_DIR "/playlist.json", &playlist);
+        }
         if (res != ESP_OK || playlist.video_count == 0) {
             ESP_LOGE(TAG, "Failed to load playlist");
             app_state = APP_STATE_ERROR;
@@ -619,6 +1084,9 @@ void app_main(void) {
             blit();
         } else {
             ESP_LOGI(TAG, "Loaded playlist: %s (%d videos)", playlist.title, playlist.video_count);
+            if (resume_store_init(VIDEO_DIR "/resume.bin") != ESP_OK) {
+                ESP_LOGW(TAG, "Resume positions unavailable");
+            }
             ui_menu_init(&menu_state, &playlist);
             app_state = APP_STATE_MENU;
         }
@@ -627,8 +1095,23 @@ void app_main(void) {
     // Input state tracking
     bool key_up_pressed = false;
     bool key_down_pressed = false;
+    bool key_left_pressed = false;
+    bool key_right_pressed = false;
     bool key_enter_pressed = false;
     bool key_esc_pressed = false;
+    bool key_bench_pressed = false;
+    bool key_order_pressed = false;
+    bool key_trace_pressed = false;
+    bool key_stats_pressed = false;
+    bool key_hud_pressed = false;
+    bool key_monitor_pressed = false;
+    bool key_pause_pressed = false;
+    bool key_slower_pressed = false;
+    bool key_faster_pressed = false;
+    bool key_up_held = false;
+    bool key_down_held = false;
+    bool key_left_held = false;
+    bool key_right_held = false;
 
     // Main loop
     while (1) {
@@ -645,9 +1128,19 @@ void app_main(void) {
                 switch (base_scancode) {
                     case BSP_INPUT_SCANCODE_ESCAPED_GREY_UP:
                         key_up_pressed = !released;
+                        key_up_held = !released;
                         break;
                     case BSP_INPUT_SCANCODE_ESCAPED_GREY_DOWN:
                         key_down_pressed = !released;
+                        key_down_held = !released;
+                        break;
+                    case BSP_INPUT_SCANCODE_ESCAPED_GREY_LEFT:
+                        key_left_pressed = !released;
+                        key_left_held = !released;
+                        break;
+                    case BSP_INPUT_SCANCODE_ESCAPED_GREY_RIGHT:
+                        key_right_pressed = !released;
+                        key_right_held = !released;
                         break;
                     case BSP_INPUT_SCANCODE_ENTER:
                         key_enter_pressed = !released;
@@ -658,12 +1151,85 @@ void app_main(void) {
                     default:
                         break;
                 }
+            } else if (event.type == INPUT_EVENT_TYPE_KEYBOARD) {
+                switch (event.args_keyboard.ascii) {
+                    case 'b':
+                    case 'B':
+                        key_bench_pressed = true;
+                        break;
+                    case 'o':
+                    case 'O':
+                        key_order_pressed = true;
+                        break;
+                    case 't':
+                    case 'T':
+                        key_trace_pressed = true;
+                        break;
+                    case 's':
+                    case 'S':
+                        key_stats_pressed = true;
+                        break;
+                    case 'h':
+                    case 'H':
+                        key_hud_pressed = true;
+                        break;
+                    case 'm':
+                    case 'M':
+                        key_monitor_pressed = true;
+                        break;
+                    case ' ':
+                        key_pause_pressed = true;
+                        break;
+                    case '-':
+                        key_slower_pressed = true;
+                        break;
+                    case '+':
+                    case '=':
+                        key_faster_pressed = true;
+                        break;
+                    default:
+                        break;
+                }
             } else if (event.type == INPUT_EVENT_TYPE_ACTION) {
                 // Power button returns to launcher
+                save_position();
+                resume_store_flush();
                 bsp_device_restart_to_launcher();
             }
         }
 
+        // Dump the trace ring to the console (host/trace_to_chrome.py converts it)
+        if (key_trace_pressed) {
+            key_trace_pressed = false;
+            trace_dump();
+        }
+
+        // Log the statistics of the current (or last) video so far
+        if (key_stats_pressed) {
+            key_stats_pressed = false;
+            play_stats_log(playing_entry ? playing_entry->display_name : "last video");
+        }
+
+        // CPU load, stack and heap watermarks
+        sys_monitor_poll(MONITOR_INTERVAL_US);
+        if (key_monitor_pressed) {
+            key_monitor_pressed = false;
+            sys_monitor_log();
+        }
+
+        // Toggle the performance HUD (shown from the next refresh)
+        if (key_hud_pressed) {
+            key_hud_pressed = false;
+            perf_hud_set_enabled(!perf_hud_is_enabled());
+        }
+
+        // Playback speed
+        if (key_slower_pressed || key_faster_pressed) {
+            step_speed(key_faster_pressed ? 1 : -1);
+            key_slower_pressed = false;
+            key_faster_pressed = false;
+        }
+
         // State machine
         switch (app_state) {
             case APP_STATE_LOADING:
@@ -674,17 +1240,34 @@ void app_main(void) {
                 // Handle ESC in menu - return to launcher
                 if (key_esc_pressed) {
                     key_esc_pressed = false;
+                    resume_store_flush();
                     bsp_device_restart_to_launcher();
                 }
 
-                // Handle menu input
+                // Storage benchmark
+                if (key_bench_pressed) {
+                    key_bench_pressed = false;
+                    run_storage_benchmark(fb_pixels, fb_stride, fb_height);
+                    app_state = APP_STATE_BENCHMARK;
+                    break;
+                }
+
+                // Sort order
+                if (key_order_pressed) {
+                    key_order_pressed = false;
+                    ui_menu_next_order(&menu_state);
+                }
+
+                // Handle menu input, left and right page through long lists
                 video_entry_t* selected = NULL;
-                bool selection_made = ui_menu_handle_input(&menu_state,
-                    key_up_pressed, key_down_pressed, key_enter_pressed, &selected);
+                bool selection_made = ui_menu_handle_input(&menu_state, key_up_pressed, key_down_pressed,
+                    key_left_pressed, key_right_pressed, key_enter_pressed, &selected);
 
                 // Clear pressed state after handling
                 key_up_pressed = false;
                 key_down_pressed = false;
+                key_left_pressed = false;
+                key_right_pressed = false;
                 key_enter_pressed = false;
 
                 if (selection_made && selected) {
@@ -718,22 +1301,72 @@ void app_main(void) {
                 // Handle ESC - return to menu
                 if (key_esc_pressed) {
                     key_esc_pressed = false;
+                    save_position();
                     stop_playback();
                     app_state = APP_STATE_MENU;
                     break;
                 }
 
+                // Space pauses and continues; paused, left and right step frames
+                if (key_pause_pressed) {
+                    key_pause_pressed = false;
+                    if (paused) {
+                        leave_pause();
+                    } else if (playback.trick_rate == 0 && !scrub_active()) {
+                        enter_pause(fb_pixels, fb_stride, fb_height);
+                    }
+                }
+                if (paused) {
+                    update_pause(key_right_held - key_left_held, fb_pixels, fb_stride, fb_height);
+                    break;
+                }
+
+                // Scrub while up or down is held, the video stands still meanwhile
+                if (update_scrub(key_up_held - key_down_held, fb_pixels, fb_stride, fb_height)) {
+                    break;
+                }
+
+                // Scan while left or right is held, a tap jumps a chapter
+                update_trick(update_chapter_keys(key_right_held - key_left_held));
+
                 // Process video frame
-                video_ended = process_video_frame(fb_pixels, fb_stride, fb_height);
+                if (!video_ended) {
+                    video_ended = process_video_frame(fb_pixels, fb_stride, fb_height);
+                }
+                if (!video_ended) {
+                    update_chapter_strip(fb_pixels, fb_stride, fb_height);
+                    update_hud(fb_pixels, fb_stride, fb_height);
+                }
+
+                // Checkpoint the position now and then, not while scanning
+                int64_t now_us = esp_timer_get_time();
+                if (!video_ended && playback.trick_rate == 0 &&
+                    now_us - resume_checkpoint_us >= RESUME_CHECKPOINT_US) {
+                    resume_checkpoint_us = now_us;
+                    save_position();
+                }
 
                 if (video_ended) {
-                    // Video finished - stop playback
+                    // Watched to the end: the next start is from the beginning; after
+                    // an error the position saved by abort_video() stays
+                    if (!video_failed) {
+                        resume_store_clear(playing_entry->video_file);
+                    }
                     stop_playback();
                     app_state = APP_STATE_MENU;
                 }
                 break;
             }
 
+            case APP_STATE_BENCHMARK:
+                // Results stay on screen until ESC
+                if (key_esc_pressed) {
+                    key_esc_pressed = false;
+                    menu_state.needs_redraw = true;
+                    app_state = APP_STATE_MENU;
+                }
+                break;
+
             case APP_STATE_ERROR:
                 // Handle ESC in error state
                 if (key_esc_pressed) {
@@ -747,22 +1380,40 @@ void app_main(void) {
         static uint32_t timing_blit_us = 0;
         static uint32_t timing_loop_count = 0;
 
+        bool playing = app_state == APP_STATE_PLAYING;
         int64_t tv0 = esp_timer_get_time();
 
         // Wait for vsync
+        if (playing) TRACE_BEGIN(VSYNC);
         if (vsync_sem != NULL) {
             xSemaphoreTake(vsync_sem, pdMS_TO_TICKS(50));
         }
+        if (playing) TRACE_END(VSYNC, playback.current_frame);
 
         int64_t tv1 = esp_timer_get_time();
 
         // Blit to display
+        if (playing) TRACE_BEGIN(BLIT);
         blit();
+        if (playing) TRACE_END(BLIT, playback.current_frame);
 
         int64_t tv2 = esp_timer_get_time();
 
         // Log vsync/blit timing during playback
-        if (app_state == APP_STATE_PLAYING) {
+        if (playing) {
+            play_stats_add(PLAY_STAT_VSYNC, tv1 - tv0);
+            play_stats_add(PLAY_STAT_BLIT, tv2 - tv1);
+
+            // Present time of a new frame against its PTS, and where audio is at that moment
+            if (frame_to_present >= 0) {
+                int64_t pts_us = playback_pts_us(&playback, frame_to_present);
+                play_stats_present(tv2, (int32_t)(tv2 - playback_due_time_us(&playback, frame_to_present)));
+                if (audio_player_is_playing()) {
+                    play_stats_av((int32_t)(audio_player_get_position_ms() - pts_us / 1000));
+                }
+                frame_to_present = -1;
+            }
+
             timing_vsync_us += (tv1 - tv0);
             timing_blit_us += (tv2 - tv1);
             timing_loop_count++;
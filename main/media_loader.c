@@ -1,112 +1,209 @@
 // Media Loader - JSON playlist parsing
 
 #include "media_loader.h"
-#include "cJSON.h"
+#include "chapters.h"
+#include "json_stream.h"
 #include "esp_log.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 static const char* TAG = "media_loader";
 
-esp_err_t playlist_load(const char* json_path, playlist_t* playlist) {
-    memset(playlist, 0, sizeof(playlist_t));
+// Copy the token text into the arena; NULL keeps the old value
+static const char* keep_text(playlist_t* playlist, const json_stream_t* js, const char* old) {
+    const char* text = playlist_strdup(playlist, js->text, js->text_len);
+    return text ? text : old;
+}
 
-    // Open and read the JSON file
-    FILE* f = fopen(json_path, "r");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open playlist: %s", json_path);
-        return ESP_ERR_NOT_FOUND;
+// A chapters array, after its '['; each chapter is {"title": ..., "start": "m:ss.mmm"}
+// or {"title": ..., "start_sec": seconds}, kept in the arena
+static esp_err_t load_chapters(json_stream_t* js, playlist_t* playlist, const video_chapter_t** chapters,
+                               int* count) {
+    video_chapter_t found[CHAPTERS_MAX];
+    int found_count = 0;
+    json_token_t token;
+    while ((token = json_stream_next(js)) == JSON_TOKEN_OBJECT) {
+        video_chapter_t chapter = {.start_ms = UINT32_MAX, .title = ""};
+        while ((token = json_stream_next(js)) == JSON_TOKEN_KEY) {
+            bool is_title = strcmp(js->text, "title") == 0;
+            bool is_start = strcmp(js->text, "start") == 0;
+            bool is_start_sec = strcmp(js->text, "start_sec") == 0;
+
+            json_token_t value = json_stream_next(js);
+            const char* rest;
+            double seconds;
+            if (is_title && value == JSON_TOKEN_STRING) {
+                chapter.title = keep_text(playlist, js, chapter.title);
+            } else if (is_start && value == JSON_TOKEN_STRING) {
+                if (!chapters_parse_time(js->text, &chapter.start_ms, &rest) || *rest) {
+                    ESP_LOGW(TAG, "Bad chapter start \"%s\"", js->text);
+                    chapter.start_ms = UINT32_MAX;
+                }
+            } else if (is_start_sec && value == JSON_TOKEN_NUMBER && (seconds = strtod(js->text, NULL)) >= 0) {
+                chapter.start_ms = (uint32_t)(seconds * 1000 + 0.5);
+            } else if (json_stream_skip(js, value) != ESP_OK) {
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+        if (token != JSON_TOKEN_OBJECT_END) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (chapter.start_ms != UINT32_MAX && found_count < CHAPTERS_MAX) {
+            found[found_count++] = chapter;
+        }
+    }
+    if (token != JSON_TOKEN_ARRAY_END) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    // Get file size
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    video_chapter_t* kept = found_count ? playlist_alloc(playlist, found_count * sizeof(video_chapter_t)) : NULL;
+    if (kept) {
+        memcpy(kept, found, found_count * sizeof(video_chapter_t));
+        *chapters = kept;
+        *count = found_count;
+    }
+    return ESP_OK;
+}
 
-    if (file_size <= 0 || file_size > 64 * 1024) {
-        ESP_LOGE(TAG, "Invalid playlist file size: %ld", file_size);
-        fclose(f);
-        return ESP_ERR_INVALID_SIZE;
+// One object of the videos array, after its '{'
+// Listed videos move to the front in playlist order; only the entry
+// pointers move, the scanned order of the rest is kept behind them
+static esp_err_t load_video(json_stream_t* js, playlist_t* playlist, int* listed) {
+    char video_file[JSON_STREAM_TEXT_MAX] = "";
+    const char* id = NULL;
+    const char* display_name = NULL;
+    int duration = 0;
+    const video_chapter_t* chapters = NULL;
+    int chapter_count = 0;
+    const char* audio_language = NULL;
+
+    json_token_t token;
+    while ((token = json_stream_next(js)) == JSON_TOKEN_KEY) {
+        bool is_id = strcmp(js->text, "id") == 0;
+        bool is_name = strcmp(js->text, "display_name") == 0;
+        bool is_file = strcmp(js->text, "video_file") == 0;
+        bool is_duration = strcmp(js->text, "duration_sec") == 0;
+        bool is_chapters = strcmp(js->text, "chapters") == 0;
+        bool is_language = strcmp(js->text, "audio_language") == 0;
+
+        json_token_t value = json_stream_next(js);
+        if (is_id && value == JSON_TOKEN_STRING) {
+            id = keep_text(playlist, js, id);
+        } else if (is_name && value == JSON_TOKEN_STRING) {
+            display_name = keep_text(playlist, js, display_name);
+        } else if (is_file && value == JSON_TOKEN_STRING) {
+            memcpy(video_file, js->text, js->text_len + 1);
+        } else if (is_duration && value == JSON_TOKEN_NUMBER) {
+            duration = (int)strtol(js->text, NULL, 10);
+        } else if (is_chapters && value == JSON_TOKEN_ARRAY) {
+            if (load_chapters(js, playlist, &chapters, &chapter_count) != ESP_OK) {
+                return ESP_ERR_INVALID_ARG;
+            }
+        } else if (is_language && value == JSON_TOKEN_STRING) {
+            audio_language = keep_text(playlist, js, audio_language);
+        } else if (json_stream_skip(js, value) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (token != JSON_TOKEN_OBJECT_END) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!video_file[0]) {
+        return ESP_OK;
     }
 
-    // Read file content
-    char* json_str = malloc(file_size + 1);
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to allocate memory for JSON");
-        fclose(f);
-        return ESP_ERR_NO_MEM;
+    int match = -1;
+    for (int i = *listed; i < playlist->video_count && match < 0; i++) {
+        if (strcasecmp(playlist->entries[i]->video_file, video_file) == 0) {
+            match = i;
+        }
     }
+    if (match < 0) {
+        ESP_LOGW(TAG, "Playlist entry %s not found, skipped", video_file);
+        return ESP_OK;
+    }
+    video_entry_t* entry = playlist->entries[match];
+    memmove(&playlist->entries[*listed + 1], &playlist->entries[*listed], (match - *listed) * sizeof(video_entry_t*));
+    playlist->entries[(*listed)++] = entry;
 
-    size_t read_size = fread(json_str, 1, file_size, f);
-    fclose(f);
-    json_str[read_size] = '\0';
+    if (id) {
+        entry->id = id;
+    }
+    if (display_name) {
+        entry->display_name = display_name;
+    }
+    if (chapters) {
+        entry->chapters = chapters;
+        entry->chapter_count = chapter_count;
+    }
+    if (audio_language) {
+        entry->audio_language = audio_language;
+    }
+    // The headers give the exact duration, a hand-written one only fills in
+    if (entry->duration_sec == 0) {
+        entry->duration_sec = duration;
+    }
 
-    // Parse JSON
-    cJSON* root = cJSON_Parse(json_str);
-    free(json_str);
+    ESP_LOGI(TAG, "Loaded video %d: %s (%ds)", *listed - 1, entry->display_name, entry->duration_sec);
+    return ESP_OK;
+}
 
-    if (!root) {
-        ESP_LOGE(TAG, "Failed to parse playlist JSON");
+// The document: an object with "title", "audio_language" and "videos", other
+// members are skipped
+static esp_err_t load_document(json_stream_t* js, playlist_t* playlist) {
+    if (json_stream_next(js) != JSON_TOKEN_OBJECT) {
         return ESP_ERR_INVALID_ARG;
     }
-
-    // Get title
-    cJSON* title = cJSON_GetObjectItem(root, "title");
-    if (title && cJSON_IsString(title)) {
-        strncpy(playlist->title, title->valuestring, MAX_TITLE - 1);
-    } else {
-        strcpy(playlist->title, "Video Player");
+    int listed = 0;
+    json_token_t token;
+    while ((token = json_stream_next(js)) == JSON_TOKEN_KEY) {
+        bool is_title = strcmp(js->text, "title") == 0;
+        bool is_videos = strcmp(js->text, "videos") == 0;
+        bool is_language = strcmp(js->text, "audio_language") == 0;
+
+        json_token_t value = json_stream_next(js);
+        if (is_title && value == JSON_TOKEN_STRING) {
+            playlist->title = keep_text(playlist, js, playlist->title);
+        } else if (is_language && value == JSON_TOKEN_STRING) {
+            playlist->audio_language = keep_text(playlist, js, playlist->audio_language);
+        } else if (is_videos && value == JSON_TOKEN_ARRAY) {
+            while ((value = json_stream_next(js)) != JSON_TOKEN_ARRAY_END) {
+                esp_err_t res = value == JSON_TOKEN_OBJECT ? load_video(js, playlist, &listed)
+                                                           : json_stream_skip(js, value);
+                if (res != ESP_OK) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+            }
+        } else if (json_stream_skip(js, value) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
     }
-
-    // Get videos array
-    cJSON* videos = cJSON_GetObjectItem(root, "videos");
-    if (!videos || !cJSON_IsArray(videos)) {
-        ESP_LOGE(TAG, "No videos array in playlist");
-        cJSON_Delete(root);
+    if (token != JSON_TOKEN_OBJECT_END || json_stream_next(js) != JSON_TOKEN_END) {
         return ESP_ERR_INVALID_ARG;
     }
+    return ESP_OK;
+}
 
-    int count = cJSON_GetArraySize(videos);
-    if (count > MAX_VIDEOS) {
-        ESP_LOGW(TAG, "Playlist has %d videos, limiting to %d", count, MAX_VIDEOS);
-        count = MAX_VIDEOS;
+esp_err_t playlist_load(const char* json_path, playlist_t* playlist) {
+    FILE* f = fopen(json_path, "r");
+    if (!f) {
+        ESP_LOGI(TAG, "No playlist %s, listing the videos found", json_path);
+        return ESP_ERR_NOT_FOUND;
     }
 
-    playlist->video_count = count;
-
-    for (int i = 0; i < count; i++) {
-        cJSON* video = cJSON_GetArrayItem(videos, i);
-        video_entry_t* entry = &playlist->videos[i];
-
-        cJSON* id = cJSON_GetObjectItem(video, "id");
-        cJSON* display_name = cJSON_GetObjectItem(video, "display_name");
-        cJSON* video_file = cJSON_GetObjectItem(video, "video_file");
-        cJSON* duration = cJSON_GetObjectItem(video, "duration_sec");
-
-        if (id && cJSON_IsString(id)) {
-            strncpy(entry->id, id->valuestring, MAX_FILENAME - 1);
-        }
-        if (display_name && cJSON_IsString(display_name)) {
-            strncpy(entry->display_name, display_name->valuestring, MAX_DISPLAY_NAME - 1);
-        } else if (id && cJSON_IsString(id)) {
-            strncpy(entry->display_name, id->valuestring, MAX_DISPLAY_NAME - 1);
-        }
-        if (video_file && cJSON_IsString(video_file)) {
-            strncpy(entry->video_file, video_file->valuestring, MAX_FILENAME - 1);
-        }
-        if (duration && cJSON_IsNumber(duration)) {
-            entry->duration_sec = duration->valueint;
-        }
+    // Read in small chunks, fields go straight into the playlist's arena
+    json_stream_t js;
+    json_stream_init(&js, f);
+    esp_err_t res = load_document(&js, playlist);
+    fclose(f);
+    playlist_filter(playlist, NULL, NULL);
 
-        ESP_LOGI(TAG, "Loaded video %d: %s (%ds)", i, entry->display_name, entry->duration_sec);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to parse playlist JSON, keeping the entries read so far");
+        return res;
     }
-
-    cJSON_Delete(root);
     ESP_LOGI(TAG, "Loaded playlist '%s' with %d videos", playlist->title, playlist->video_count);
     return ESP_OK;
 }
-
-void playlist_free(playlist_t* playlist) {
-    // Static allocation, nothing to free
-    memset(playlist, 0, sizeof(playlist_t));
-}
@@ -1,33 +1,14 @@
 // Media Loader - JSON playlist parsing
+// The videos themselves are found by media_scan(); playlist.json is an
+// optional override for the title, names and order
 #pragma once
 
-#include <stdint.h>
-#include <stddef.h>
 #include "esp_err.h"
+#include "playlist.h"
 
-// Maximum values
-#define MAX_VIDEOS          16
-#define MAX_DISPLAY_NAME    64
-#define MAX_FILENAME        32
-#define MAX_TITLE           64
-
-// Video entry from playlist
-typedef struct {
-    char id[MAX_FILENAME];
-    char display_name[MAX_DISPLAY_NAME];
-    char video_file[MAX_FILENAME];  // AVI file with interleaved MJPEG video + MP3 audio
-    int duration_sec;
-} video_entry_t;
-
-// Playlist structure
-typedef struct {
-    char title[MAX_TITLE];
-    video_entry_t videos[MAX_VIDEOS];
-    int video_count;
-} playlist_t;
-
-// Load playlist from JSON file
+// Apply a JSON playlist to the scanned videos: its title replaces the default,
+// its entries come first in its order with their names, and videos it does
+// not list follow; entries whose file was not found are left out
+// The file is streamed, so its size is not limited. On a syntax error the
+// entries read before it are kept and ESP_ERR_INVALID_ARG is returned
 esp_err_t playlist_load(const char* json_path, playlist_t* playlist);
-
-// Free playlist resources (not needed if using static allocation)
-void playlist_free(playlist_t* playlist);
@@ -0,0 +1,262 @@
+// Media Scan - finds the videos in a directory and reads their headers
+
+#include "media_scan.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include "avi_parser.h"
+#include "esp_log.h"
+
+static const char* TAG = "media_scan";
+
+#define CACHE_MAGIC     0x4353484d  // "MHSC"
+#define CACHE_VERSION   3
+#define CACHE_LIMIT     4096    // Records accepted from a cache file
+#define NAME_MAX_LEN    64
+
+// Cache file: the header, then count records, stored as-is (little-endian)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t check;             // FNV-1a of the records
+} cache_header_t;
+
+// A file that could not be probed is remembered with width 0, so it is not
+// probed again until it changes
+typedef struct {
+    char name[NAME_MAX_LEN];
+    uint32_t size;
+    uint32_t mtime;
+    media_info_t info;
+} cache_record_t;
+
+static uint32_t records_check(const cache_record_t* records, int count) {
+    const uint8_t* p = (const uint8_t*)records;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < count * sizeof(cache_record_t); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Read the cache; returns the record count and sets *records (free() it),
+// 0 when missing or damaged
+static int load_cache(const char* path, cache_record_t** records) {
+    *records = NULL;
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+    cache_header_t header = {0};
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 && header.magic == CACHE_MAGIC &&
+                 header.version == CACHE_VERSION && header.count <= CACHE_LIMIT;
+    cache_record_t* loaded = valid && header.count ? malloc(header.count * sizeof(cache_record_t)) : NULL;
+    if (loaded) {
+        // One read, and the file must end right after the records
+        uint8_t extra;
+        valid = fread(loaded, sizeof(cache_record_t), header.count, f) == header.count &&
+                fread(&extra, 1, 1, f) == 0 && records_check(loaded, header.count) == header.check;
+    } else if (header.count) {
+        valid = false;
+    }
+    fclose(f);
+    if (!valid) {
+        ESP_LOGW(TAG, "Ignoring damaged cache %s", path);
+        free(loaded);
+        return 0;
+    }
+    *records = loaded;
+    return header.count;
+}
+
+// Replace the cache; the old one stays until the new one is complete
+static void save_cache(const char* path, const cache_record_t* records, int count) {
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    cache_header_t header = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .count = count,
+        .check = records_check(records, count),
+    };
+    FILE* f = fopen(tmp_path, "wb");
+    bool ok = f && fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(records, sizeof(cache_record_t), count, f) == (size_t)count;
+    if (f && fclose(f) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write %s", tmp_path);
+        remove(tmp_path);
+        return;
+    }
+    remove(path);
+    if (rename(tmp_path, path) != 0) {
+        ESP_LOGE(TAG, "Failed to replace %s", path);
+    }
+}
+
+static const cache_record_t* find_record(const cache_record_t* records, int count, const cache_record_t* file) {
+    for (int i = 0; i < count; i++) {
+        if (records[i].size == file->size && records[i].mtime == file->mtime &&
+            strcmp(records[i].name, file->name) == 0) {
+            return &records[i];
+        }
+    }
+    return NULL;
+}
+
+static void fill_info(const avi_info_t* avi, media_info_t* info) {
+    memset(info, 0, sizeof(*info));
+    uint32_t frames = avi->has_playback_info ? avi->playback.frame_count : avi->video_frames;
+    if (avi->video_rate > 0 && avi->video_scale > 0) {
+        info->duration_ms = (uint32_t)((uint64_t)frames * avi->video_scale * 1000 / avi->video_rate);
+    } else if (avi->fps > 0) {
+        info->duration_ms = (uint32_t)((uint64_t)frames * 1000 / avi->fps);
+    }
+    info->width = avi->width;
+    info->height = avi->height;
+    info->video_codec = avi->video_codec;
+    if (avi->has_audio) {
+        info->audio_format = avi->audio_format;
+        info->audio_channels = avi->audio_channels;
+        info->audio_sample_rate = avi->audio_sample_rate;
+    }
+
+    // Files from avi_remux carry peak tables over 2^i frames: take the
+    // longest window up to one second. For others it stays 0 (unknown): the
+    // avih max_bytes_per_sec is a placeholder most muxers fill with a constant
+    if (avi->has_playback_info && avi->video_rate > 0 && avi->video_scale > 0) {
+        int window = 0;
+        while (window + 1 < AVI_PEAK_WINDOWS && ((uint64_t)avi->video_scale << (window + 1)) <= avi->video_rate) {
+            window++;
+        }
+        info->peak_kbps = (uint32_t)((uint64_t)avi->playback.peak_bytes[window] * 8 * avi->video_rate /
+                                     ((uint64_t)avi->video_scale << window) / 1000);
+        info->playback_flags = avi->playback.flags;
+        info->indexed_frames = avi->playback.index_offset ? avi->playback.frame_count : 0;
+    }
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcasecmp(((const cache_record_t*)a)->name, ((const cache_record_t*)b)->name);
+}
+
+// "vogon_poetry.avi" becomes "vogon_poetry" and "Vogon poetry"
+static bool name_entry(playlist_t* playlist, video_entry_t* entry, const char* file) {
+    const char* dot = strrchr(file, '.');
+    size_t stem = dot ? (size_t)(dot - file) : strlen(file);
+    char display_name[NAME_MAX_LEN];
+    snprintf(display_name, sizeof(display_name), "%.*s", (int)stem, file);
+    for (char* p = display_name; *p; p++) {
+        if (*p == '_') {
+            *p = ' ';
+        }
+    }
+    display_name[0] = toupper((unsigned char)display_name[0]);
+
+    entry->video_file = playlist_strdup(playlist, file, strlen(file));
+    entry->id = entry->video_file ? playlist_strdup(playlist, file, stem) : NULL;
+    entry->display_name = entry->id ? playlist_strdup(playlist, display_name, stem) : NULL;
+    return entry->display_name != NULL;
+}
+
+esp_err_t media_scan(const char* dir, const char* cache_path, const char* skip, playlist_t* playlist) {
+    playlist_init(playlist);
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        ESP_LOGE(TAG, "Failed to open %s", dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+    cache_record_t* cached;
+    int cached_count = load_cache(cache_path, &cached);
+
+    cache_record_t* found = NULL;
+    int capacity = 0;
+    int count = 0;
+    int probed = 0;
+    esp_err_t res = ESP_OK;
+    struct dirent* de;
+    while ((de = readdir(d)) != NULL) {
+        const char* name = de->d_name;
+        size_t len = strlen(name);
+        if (len < 5 || strcasecmp(name + len - 4, ".avi") != 0 || (skip && strcasecmp(name, skip) == 0)) {
+            continue;
+        }
+        if (len >= NAME_MAX_LEN) {
+            ESP_LOGW(TAG, "Skipping %s, name longer than %d characters", name, NAME_MAX_LEN - 1);
+            continue;
+        }
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            cache_record_t* grown = realloc(found, capacity * sizeof(cache_record_t));
+            if (!grown) {
+                res = ESP_ERR_NO_MEM;
+                break;
+            }
+            found = grown;
+        }
+        cache_record_t* record = &found[count++];
+        memset(record, 0, sizeof(*record));
+        strcpy(record->name, name);
+        record->size = (uint32_t)st.st_size;
+        record->mtime = (uint32_t)st.st_mtime;
+
+        const cache_record_t* hit = find_record(cached, cached_count, record);
+        if (hit) {
+            record->info = hit->info;
+            continue;
+        }
+        avi_info_t avi;
+        if (avi_parser_probe(path, &avi) == ESP_OK && avi.has_video) {
+            fill_info(&avi, &record->info);
+        } else {
+            ESP_LOGW(TAG, "Skipping %s, not a playable AVI", name);
+        }
+        probed++;
+    }
+    closedir(d);
+    free(cached);
+
+    // New, changed or removed files
+    if (res == ESP_OK && (probed > 0 || count != cached_count)) {
+        save_cache(cache_path, found, count);
+    }
+
+    qsort(found, count, sizeof(cache_record_t), compare_names);
+    for (int i = 0; i < count && res == ESP_OK; i++) {
+        if (found[i].info.width == 0) {
+            continue;
+        }
+        video_entry_t* entry = playlist_add(playlist);
+        if (!entry || !name_entry(playlist, entry, found[i].name)) {
+            res = ESP_ERR_NO_MEM;
+            break;
+        }
+        entry->info = found[i].info;
+        entry->duration_sec = (int)((entry->info.duration_ms + 500) / 1000);
+    }
+    free(found);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Out of memory listing %s", dir);
+        playlist_free(playlist);
+        return res;
+    }
+
+    ESP_LOGI(TAG, "%d videos in %s, %d probed, %d from cache, list uses %zu bytes", playlist->video_count, dir,
+             probed, count - probed, playlist_memory(playlist));
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+// Media Scan - finds the videos in a directory and reads their headers
+// Only the header list of each AVI is read, for exact duration, resolution,
+// codec, audio format and peak data rate. The results are kept in a small
+// binary cache keyed by file name, size and modification time, so a later
+// boot reads the cache back and probes only files that changed
+#pragma once
+
+#include "esp_err.h"
+#include "playlist.h"
+
+// Fill playlist (initialized here, free with playlist_free) with every *.avi
+// in dir except skip (NULL = none), sorted by name and named after the file;
+// cache_path holds the header cache
+esp_err_t media_scan(const char* dir, const char* cache_path, const char* skip, playlist_t* playlist);
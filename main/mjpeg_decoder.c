@@ -1,13 +1,32 @@
 // MJPEG Decoder - Hardware JPEG decoding using ESP32-P4 JPEG peripheral
+// Falls back to the software decoder (sw_jpeg) split across both cores
 
 #include "mjpeg_decoder.h"
 #include "driver/jpeg_decode.h"
+#include "esp_cache.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sw_jpeg.h"
+#include "trace.h"
 #include <string.h>
 
 static const char* TAG = "mjpeg_decoder";
 
+// Software strip worker on the other core
+#define STRIP_TASK_STACK_SIZE   4096
+#define STRIP_TASK_PRIORITY     5     // Below the audio task
+
+typedef struct {
+    sw_jpeg_output_t out;
+    uint32_t first;
+    uint32_t count;
+    esp_err_t ret;
+} strip_job_t;
+
 static jpeg_decoder_handle_t decoder = NULL;
 static uint8_t* output_buffer = NULL;
 static size_t output_buffer_size = 0;
@@ -15,6 +34,106 @@ static int max_frame_width = 0;
 static int max_frame_height = 0;
 static int aligned_frame_width = 0;  // 16-pixel aligned width for hardware decoder
 
+// Software path (no JPEG engine)
+static sw_jpeg_t* sw_frame = NULL;              // Parsed headers of the frame being decoded
+static TaskHandle_t strip_task = NULL;
+static SemaphoreHandle_t strip_start = NULL;
+static SemaphoreHandle_t strip_done = NULL;
+static strip_job_t strip_job;
+
+// Decodes the second half of each frame's strips while the caller does the first
+static void strip_worker(void* arg) {
+    (void)arg;
+    for (;;) {
+        xSemaphoreTake(strip_start, portMAX_DELAY);
+        TRACE_BEGIN(STRIP);
+        strip_job.ret = sw_jpeg_decode_strips(sw_frame, strip_job.first, strip_job.count, &strip_job.out);
+        TRACE_END(STRIP, strip_job.count);
+        xSemaphoreGive(strip_done);
+    }
+}
+
+// Set up the software decoder, with a strip worker pinned to the other core
+static esp_err_t software_init(void) {
+    sw_frame = heap_caps_malloc(sizeof(sw_jpeg_t), MALLOC_CAP_INTERNAL);
+    if (!sw_frame) {
+        sw_frame = heap_caps_malloc(sizeof(sw_jpeg_t), MALLOC_CAP_DEFAULT);
+    }
+    if (!sw_frame) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    strip_start = xSemaphoreCreateBinary();
+    strip_done = xSemaphoreCreateBinary();
+    BaseType_t other_core = xPortGetCoreID() == 0 ? 1 : 0;
+    if (!strip_start || !strip_done ||
+        xTaskCreatePinnedToCore(strip_worker, "jpeg_strips", STRIP_TASK_STACK_SIZE, NULL, STRIP_TASK_PRIORITY,
+                                &strip_task, other_core) != pdPASS) {
+        // Still usable, just on one core
+        ESP_LOGW(TAG, "No strip worker, software decoding on one core");
+        strip_task = NULL;
+    }
+    ESP_LOGW(TAG, "JPEG engine unavailable, using software decoder (%s)",
+             strip_task ? "strips on both cores" : "one core");
+    return ESP_OK;
+}
+
+static void software_deinit(void) {
+    if (strip_task) {
+        vTaskDelete(strip_task);
+        strip_task = NULL;
+    }
+    if (strip_start) {
+        vSemaphoreDelete(strip_start);
+        strip_start = NULL;
+    }
+    if (strip_done) {
+        vSemaphoreDelete(strip_done);
+        strip_done = NULL;
+    }
+    heap_caps_free(sw_frame);
+    sw_frame = NULL;
+}
+
+// Decode the parsed frame, restart-marker strips split between both cores
+static esp_err_t software_decode_strips(const sw_jpeg_output_t* out) {
+    // Without restart markers the frame is one strip and stays on this core
+    uint32_t half = strip_task ? sw_frame->strip_count / 2 : 0;
+    if (half > 0) {
+        strip_job = (strip_job_t){*out, half, sw_frame->strip_count - half, ESP_OK};
+        xSemaphoreGive(strip_start);
+    }
+
+    TRACE_BEGIN(STRIP);
+    esp_err_t ret = sw_jpeg_decode_strips(sw_frame, 0, half > 0 ? half : sw_frame->strip_count, out);
+    TRACE_END(STRIP, half > 0 ? half : sw_frame->strip_count);
+
+    if (half > 0) {
+        xSemaphoreTake(strip_done, portMAX_DELAY);
+        if (ret == ESP_OK) {
+            ret = strip_job.ret;
+        }
+    }
+    return ret;
+}
+
+// Decode a frame in software into rows of the 16-pixel aligned width
+static esp_err_t software_decode(uint8_t* jpeg_data, size_t jpeg_size, uint8_t* dest, int* width, int* height) {
+    esp_err_t ret = sw_jpeg_parse(sw_frame, jpeg_data, jpeg_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (sw_frame->width > aligned_frame_width || sw_frame->height > ((max_frame_height + 15) & ~15)) {
+        ESP_LOGE(TAG, "Frame too large: %ux%u", sw_frame->width, sw_frame->height);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *width = sw_frame->width;
+    *height = sw_frame->height;
+    sw_jpeg_output_t out = sw_jpeg_output_rows(dest, aligned_frame_width * 3);
+    return software_decode_strips(&out);
+}
+
 esp_err_t mjpeg_decoder_init(int max_width, int max_height) {
     ESP_LOGI(TAG, "Initializing hardware JPEG decoder for %dx%d", max_width, max_height);
 
@@ -64,8 +183,12 @@ esp_err_t mjpeg_decoder_init(int max_width, int max_height) {
     esp_err_t ret = jpeg_new_decoder_engine(&engine_cfg, &decoder);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create JPEG decoder engine: %s", esp_err_to_name(ret));
-        heap_caps_free(output_buffer);
-        output_buffer = NULL;
+        decoder = NULL;
+        ret = software_init();
+        if (ret != ESP_OK) {
+            heap_caps_free(output_buffer);
+            output_buffer = NULL;
+        }
         return ret;
     }
 
@@ -73,12 +196,9 @@ esp_err_t mjpeg_decoder_init(int max_width, int max_height) {
     return ESP_OK;
 }
 
-esp_err_t mjpeg_decoder_decode(uint8_t* jpeg_data, size_t jpeg_size,
-                                uint8_t** bgr_out, int* width, int* height) {
-    if (!decoder || !jpeg_data || jpeg_size == 0) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
+// Decode into out (capacity out_size), picture info from the JPEG header
+static esp_err_t decode_to(uint8_t* jpeg_data, size_t jpeg_size, uint8_t* out, size_t out_size,
+                           jpeg_decode_picture_info_t* pic_info) {
     // Configure decode parameters
     // Output BGR888 format to match display (display uses BGR byte order)
     jpeg_decode_cfg_t decode_cfg = {
@@ -87,28 +207,25 @@ esp_err_t mjpeg_decoder_decode(uint8_t* jpeg_data, size_t jpeg_size,
         .conv_std = JPEG_YUV_RGB_CONV_STD_BT601,
     };
 
-    // Prepare decode picture description
-    jpeg_decode_picture_info_t pic_info = {0};
-
     // First, get the picture info (dimensions) from the JPEG header
-    esp_err_t ret = jpeg_decoder_get_info(jpeg_data, jpeg_size, &pic_info);
+    esp_err_t ret = jpeg_decoder_get_info(jpeg_data, jpeg_size, pic_info);
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "Failed to get JPEG info: %s", esp_err_to_name(ret));
         return ret;
     }
 
     // Check if frame fits in buffer
-    size_t needed_size = pic_info.width * pic_info.height * 3;
-    if (needed_size > output_buffer_size) {
-        ESP_LOGE(TAG, "Frame too large: %dx%d (%zu bytes) > buffer (%zu bytes)",
-                 pic_info.width, pic_info.height, needed_size, output_buffer_size);
+    size_t needed_size = pic_info->width * pic_info->height * 3;
+    if (needed_size > out_size) {
+        ESP_LOGE(TAG, "Frame too large: %lux%lu (%zu bytes) > buffer (%zu bytes)",
+                 (unsigned long)pic_info->width, (unsigned long)pic_info->height, needed_size, out_size);
         return ESP_ERR_NO_MEM;
     }
 
     // Decode the JPEG frame
     uint32_t decoded_size = 0;
     ret = jpeg_decoder_process(decoder, &decode_cfg, jpeg_data, jpeg_size,
-                               output_buffer, output_buffer_size, &decoded_size);
+                               out, out_size, &decoded_size);
 
     if (ret != ESP_OK) {
         // Log error only occasionally to avoid flooding
@@ -122,10 +239,30 @@ esp_err_t mjpeg_decoder_decode(uint8_t* jpeg_data, size_t jpeg_size,
     // Log first successful decode
     static bool first_decode_logged = false;
     if (!first_decode_logged) {
-        ESP_LOGI(TAG, "First frame decoded: %dx%d, %lu bytes",
-                 pic_info.width, pic_info.height, (unsigned long)decoded_size);
+        ESP_LOGI(TAG, "First frame decoded: %lux%lu, %lu bytes",
+                 (unsigned long)pic_info->width, (unsigned long)pic_info->height, (unsigned long)decoded_size);
         first_decode_logged = true;
     }
+    return ESP_OK;
+}
+
+esp_err_t mjpeg_decoder_decode(uint8_t* jpeg_data, size_t jpeg_size,
+                                uint8_t** bgr_out, int* width, int* height) {
+    if ((!decoder && !sw_frame) || !jpeg_data || jpeg_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Same layout as the engine's output
+    if (!decoder) {
+        *bgr_out = output_buffer;
+        return software_decode(jpeg_data, jpeg_size, output_buffer, width, height);
+    }
+
+    jpeg_decode_picture_info_t pic_info = {0};
+    esp_err_t ret = decode_to(jpeg_data, jpeg_size, output_buffer, output_buffer_size, &pic_info);
+    if (ret != ESP_OK) {
+        return ret;
+    }
 
     *width = pic_info.width;
     *height = pic_info.height;
@@ -134,11 +271,149 @@ esp_err_t mjpeg_decoder_decode(uint8_t* jpeg_data, size_t jpeg_size,
     return ESP_OK;
 }
 
+bool mjpeg_decoder_can_decode_into(const uint8_t* dest, size_t dest_size) {
+    size_t align = 0;
+    if (esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &align) != ESP_OK || align == 0) {
+        align = 64;
+    }
+    return dest && ((uintptr_t)dest % align) == 0 && (dest_size % align) == 0 &&
+           (esp_ptr_dma_capable(dest) || esp_ptr_external_ram(dest));
+}
+
+esp_err_t mjpeg_decoder_decode_into(uint8_t* jpeg_data, size_t jpeg_size,
+                                    uint8_t* dest, size_t dest_size, int* width, int* height) {
+    if ((!decoder && !sw_frame) || !jpeg_data || jpeg_size == 0 || !mjpeg_decoder_can_decode_into(dest, dest_size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!decoder) {
+        return software_decode(jpeg_data, jpeg_size, dest, width, height);
+    }
+
+    // The CPU draws into the framebuffer too: write back dirty lines first so
+    // a later eviction cannot land on top of the decoder's output
+    esp_cache_msync(dest, dest_size, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+
+    jpeg_decode_picture_info_t pic_info = {0};
+    esp_err_t ret = decode_to(jpeg_data, jpeg_size, dest, dest_size, &pic_info);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    *width = pic_info.width;
+    *height = pic_info.height;
+    return ESP_OK;
+}
+
+bool mjpeg_decoder_is_hardware(void) {
+    return decoder != NULL;
+}
+
+// Map a w x h frame into the framebuffer, centered
+// rotate: 270 degrees as in mjpeg_copy_to_framebuffer, source column x becomes
+// framebuffer row x (letterboxed) and source row y becomes column h-1-y
+static esp_err_t framebuffer_output(uint8_t* fb_out, int fb_width, int fb_height, int w, int h, bool rotate,
+                                    sw_jpeg_output_t* out) {
+    int stride = fb_width * 3;
+    if (rotate) {
+        if (w > fb_height || h > fb_width) return ESP_ERR_INVALID_SIZE;
+        int row0 = (fb_height - w) / 2;
+        int col0 = (fb_width - h) / 2;
+        *out = (sw_jpeg_output_t){fb_out + (size_t)row0 * stride + (size_t)(col0 + h - 1) * 3, stride, -3};
+    } else {
+        if (w > fb_width || h > fb_height) return ESP_ERR_INVALID_SIZE;
+        *out = (sw_jpeg_output_t){fb_out + (size_t)((fb_height - h) / 2) * stride + (size_t)((fb_width - w) / 2) * 3,
+                                  3, stride};
+    }
+    return ESP_OK;
+}
+
+esp_err_t mjpeg_decoder_decode_to_framebuffer(uint8_t* jpeg_data, size_t jpeg_size, uint8_t* fb_out,
+                                              int fb_width, int fb_height, bool rotate, int* width, int* height) {
+    if (!sw_frame || !jpeg_data || jpeg_size == 0 || !fb_out) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Headers first, to place the frame
+    esp_err_t ret = sw_jpeg_parse(sw_frame, jpeg_data, jpeg_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int w = sw_frame->width;
+    int h = sw_frame->height;
+    sw_jpeg_output_t out;
+    ret = framebuffer_output(fb_out, fb_width, fb_height, w, h, rotate, &out);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    *width = w;
+    *height = h;
+    return software_decode_strips(&out);
+}
+
+esp_err_t mjpeg_decoder_decode_reduced(const uint8_t* jpeg_data, size_t jpeg_size, uint8_t* dest, int stride,
+                                       int* width, int* height) {
+    if (!jpeg_data || jpeg_size == 0 || !dest) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // With the JPEG engine the headers are only parsed here, on first use
+    if (!sw_frame) {
+        sw_frame = heap_caps_malloc(sizeof(sw_jpeg_t), MALLOC_CAP_DEFAULT);
+        if (!sw_frame) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t ret = sw_jpeg_parse(sw_frame, jpeg_data, jpeg_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int w = sw_jpeg_reduced_size(sw_frame->width);
+    int h = sw_jpeg_reduced_size(sw_frame->height);
+    if (w * 3 > stride) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    sw_jpeg_output_t out = sw_jpeg_output_rows(dest, stride);
+    ret = sw_jpeg_decode_reduced(sw_frame, &out);
+    *width = w;
+    *height = h;
+    return ret;
+}
+
+esp_err_t mjpeg_draw_reduced_to_framebuffer(const uint8_t* src, int width, int height, int stride, uint8_t* fb_out,
+                                            int fb_width, int fb_height, bool rotate) {
+    if (!src || !fb_out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int scale = SW_JPEG_REDUCED_SCALE;
+    sw_jpeg_output_t out;
+    esp_err_t ret = framebuffer_output(fb_out, fb_width, fb_height, width * scale, height * scale, rotate, &out);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Each source pixel becomes a scale x scale block
+    for (int y = 0; y < height * scale; y++) {
+        const uint8_t* row = src + (size_t)(y / scale) * stride;
+        uint8_t* dst = out.origin + (intptr_t)y * out.y_step;
+        for (int x = 0; x < width * scale; x++, dst += out.x_step) {
+            const uint8_t* p = row + (x / scale) * 3;
+            dst[0] = p[0];
+            dst[1] = p[1];
+            dst[2] = p[2];
+        }
+    }
+    return ESP_OK;
+}
+
 void mjpeg_decoder_deinit(void) {
     if (decoder) {
         jpeg_del_decoder_engine(decoder);
         decoder = NULL;
     }
+    software_deinit();
 
     if (output_buffer) {
         heap_caps_aligned_free(output_buffer);
@@ -208,3 +483,28 @@ esp_err_t mjpeg_copy_to_framebuffer(uint8_t* bgr_in, uint8_t* fb_out,
 
     return ESP_OK;
 }
+
+// Copy pre-rotated BGR888 to framebuffer, centered, one memcpy per row
+// The stream is already in framebuffer orientation, so no pixel shuffling
+esp_err_t mjpeg_copy_rows_to_framebuffer(uint8_t* bgr_in, uint8_t* fb_out,
+                                         int src_width, int src_height,
+                                         int fb_width, int fb_height) {
+    if (!bgr_in || !fb_out || src_width > fb_width || src_height > fb_height) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int src_stride = aligned_frame_width * 3;
+    int dst_stride = fb_width * 3;
+    uint8_t* dst = fb_out + ((fb_height - src_height) / 2) * dst_stride + ((fb_width - src_width) / 2) * 3;
+
+    // Same width as the framebuffer: the whole frame is one block
+    if (src_stride == dst_stride && src_width == fb_width) {
+        memcpy(dst, bgr_in, (size_t)src_height * dst_stride);
+        return ESP_OK;
+    }
+
+    for (int y = 0; y < src_height; y++) {
+        memcpy(dst + y * dst_stride, bgr_in + y * src_stride, src_width * 3);
+    }
+    return ESP_OK;
+}
@@ -1,8 +1,11 @@
 // MJPEG Decoder - Hardware JPEG decoding using ESP32-P4 JPEG peripheral
+// Without the engine, frames are decoded in software (sw_jpeg); frames with
+// restart markers are then split into strips decoded on both cores
 #pragma once
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "esp_err.h"
 
 // Initialize the hardware JPEG decoder
@@ -18,6 +21,22 @@ esp_err_t mjpeg_decoder_init(int max_width, int max_height);
 esp_err_t mjpeg_decoder_decode(uint8_t* jpeg_data, size_t jpeg_size,
                                 uint8_t** bgr_out, int* width, int* height);
 
+// Decode a JPEG frame straight into dest, e.g. the framebuffer at the
+// letterbox offset for streams encoded in framebuffer orientation
+// dest must be DMA-capable and cache-line aligned and hold the frame padded
+// to whole 16-pixel blocks; returns ESP_ERR_INVALID_ARG if it is not
+esp_err_t mjpeg_decoder_decode_into(uint8_t* jpeg_data, size_t jpeg_size,
+                                    uint8_t* dest, size_t dest_size, int* width, int* height);
+
+// Check once whether mjpeg_decoder_decode_into() can target dest
+bool mjpeg_decoder_can_decode_into(const uint8_t* dest, size_t dest_size);
+
+// Copy a decoded pre-rotated frame (already in framebuffer orientation)
+// with one memcpy per row, centered in a framebuffer of fb_width x fb_height
+esp_err_t mjpeg_copy_rows_to_framebuffer(uint8_t* bgr_in, uint8_t* fb_out,
+                                         int src_width, int src_height,
+                                         int fb_width, int fb_height);
+
 // Copy decoded BGR to framebuffer with 270-degree rotation and letterboxing
 // bgr_in: decoded BGR888 from mjpeg_decoder_decode
 // fb_out: framebuffer pointer
@@ -27,6 +46,27 @@ esp_err_t mjpeg_copy_to_framebuffer(uint8_t* bgr_in, uint8_t* fb_out,
                                      int src_width, int src_height,
                                      int display_width);
 
+// True when frames go through the JPEG engine, false for the software decoder
+bool mjpeg_decoder_is_hardware(void);
+
+// Software decoder only: decode straight into the framebuffer, centered
+// rotate: landscape frame, rotated 270 degrees like mjpeg_copy_to_framebuffer
+// (otherwise the frame is already in framebuffer orientation)
+// Each strip writes its pixels to their final place, so no copy pass follows
+esp_err_t mjpeg_decoder_decode_to_framebuffer(uint8_t* jpeg_data, size_t jpeg_size, uint8_t* fb_out,
+                                              int fb_width, int fb_height, bool rotate, int* width, int* height);
+
+// Decode a frame at 1/8 scale in software (the JPEG engine cannot scale), one
+// pixel per 8x8 block, into dest as rows of stride bytes; width and height
+// receive the reduced size. Much cheaper than a full decode, for fast scanning
+esp_err_t mjpeg_decoder_decode_reduced(const uint8_t* jpeg_data, size_t jpeg_size, uint8_t* dest, int stride,
+                                       int* width, int* height);
+
+// Draw a reduced frame enlarged back to full size into the framebuffer,
+// centered and rotated like mjpeg_decoder_decode_to_framebuffer()
+esp_err_t mjpeg_draw_reduced_to_framebuffer(const uint8_t* src, int width, int height, int stride, uint8_t* fb_out,
+                                            int fb_width, int fb_height, bool rotate);
+
 // Deinitialize decoder and free resources
 void mjpeg_decoder_deinit(void);
 
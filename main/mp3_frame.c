@@ -0,0 +1,70 @@
+// MP3 Frame - MPEG audio frame header parsing
+
+#include "mp3_frame.h"
+#include <stdbool.h>
+
+// Bitrates in kbit/s by bitrate index: MPEG-1 Layer III, MPEG-2/2.5 Layer III
+static const uint16_t bitrates[2][15] = {
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+};
+
+// Sample rates by version (MPEG-2.5, reserved, MPEG-2, MPEG-1) and rate index
+static const uint32_t sample_rates[4][3] = {
+    {11025, 12000, 8000},
+    {0, 0, 0},
+    {22050, 24000, 16000},
+    {44100, 48000, 32000},
+};
+
+uint32_t mp3_frame_parse(const uint8_t* data, size_t len, mp3_frame_t* frame) {
+    if (len < 4 || data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) {
+        return 0;
+    }
+
+    uint8_t version = (data[1] >> 3) & 3;        // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+    uint8_t layer = (data[1] >> 1) & 3;          // 1 = Layer III
+    uint8_t bitrate_index = data[2] >> 4;
+    uint8_t rate_index = (data[2] >> 2) & 3;
+    uint8_t padding = (data[2] >> 1) & 1;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return 0;  // Reserved values, Layer I/II or free format
+    }
+
+    bool mpeg1 = version == 3;
+    uint32_t bitrate = bitrates[mpeg1 ? 0 : 1][bitrate_index];
+    uint32_t sample_rate = sample_rates[version][rate_index];
+    uint32_t samples = mpeg1 ? 1152 : 576;
+    uint32_t size = samples / 8 * bitrate * 1000 / sample_rate + padding;
+
+    if (frame) {
+        frame->size = size;
+        frame->sample_rate = sample_rate;
+        frame->bitrate_kbps = bitrate;
+        frame->samples = samples;
+        frame->channels = (data[3] >> 6) == 3 ? 1 : 2;
+    }
+    return size;
+}
+
+size_t mp3_frame_sync(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i + 4 <= len; i++) {
+        if (data[i] == 0xFF && mp3_frame_parse(data + i, len - i, NULL) > 0) {
+            return i;
+        }
+    }
+    return len;
+}
+
+size_t mp3_frame_whole(const uint8_t* data, size_t len, uint32_t* frames) {
+    size_t pos = 0;
+    uint32_t count = 0;
+    while (pos < len) {
+        uint32_t size = mp3_frame_parse(data + pos, len - pos, NULL);
+        if (size == 0 || size > len - pos) break;
+        pos += size;
+        count++;
+    }
+    if (frames) *frames = count;
+    return pos;
+}
@@ -0,0 +1,27 @@
+// MP3 Frame - MPEG audio frame header parsing
+// Used by the muxer to cut audio chunks on frame boundaries and by the
+// audio player to feed frame-aligned chunks to the decoder one frame at a time
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Header of one MPEG-1/2/2.5 Layer III frame
+typedef struct {
+    uint32_t size;              // Whole frame in bytes, header included
+    uint32_t sample_rate;
+    uint32_t bitrate_kbps;
+    uint16_t samples;           // PCM samples per channel (1152 or 576)
+    uint8_t channels;
+} mp3_frame_t;
+
+// Parse the 4-byte header at data (len bytes available)
+// Returns the frame size, 0 if data does not start with a valid Layer III header
+uint32_t mp3_frame_parse(const uint8_t* data, size_t len, mp3_frame_t* frame);
+
+// Offset of the first valid header at or after data, len if there is none
+size_t mp3_frame_sync(const uint8_t* data, size_t len);
+
+// Length of the run of whole frames at the start of data
+// Stops at the first byte that does not start a frame or at a frame that is cut off
+size_t mp3_frame_whole(const uint8_t* data, size_t len, uint32_t* frames);
@@ -0,0 +1,143 @@
+// Performance HUD - playback statistics drawn in the letterbox beside the video
+
+#include "perf_hud.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "hershey_font.h"
+#include "ui_draw.h"
+
+static const char* TAG = "perf_hud";
+
+#define HUD_COLOR       COLOR_ACCENT1
+#define FONT_HEIGHT     10
+#define GLYPH_FIRST     32          // Space .. underscore: digits, capitals, punctuation
+#define GLYPH_COUNT     64
+#define GLYPH_BYTES     (PERF_HUD_CELL_W * PERF_HUD_CELL_H * 3)
+#define LINE_LEN        32          // Formatting room, cut to PERF_HUD_COLS when drawn
+
+// Each glyph is stored as PERF_HUD_CELL_W framebuffer rows (one per screen
+// column) of PERF_HUD_CELL_H pixels, the layout the rotated framebuffer uses
+static uint8_t* glyphs = NULL;
+
+static bool enabled = false;
+static bool fits = false;           // The letterbox is wide enough
+static bool on_screen = false;      // Cells hold HUD text that must be cleared when disabled
+static int origin_x = 0, origin_y = 8;
+static char shown[PERF_HUD_ROWS][PERF_HUD_COLS];   // 0 = unknown, redraw
+
+esp_err_t perf_hud_init(void) {
+    if (glyphs) {
+        return ESP_OK;
+    }
+    glyphs = heap_caps_calloc(GLYPH_COUNT, GLYPH_BYTES, MALLOC_CAP_INTERNAL);
+    if (!glyphs) {
+        glyphs = heap_caps_calloc(GLYPH_COUNT, GLYPH_BYTES, MALLOC_CAP_DEFAULT);
+    }
+    if (!glyphs) {
+        ESP_LOGW(TAG, "No memory for the glyph cache");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Render through the normal rotated path into a cell-sized "framebuffer":
+    // PERF_HUD_CELL_H pixels wide, PERF_HUD_CELL_W rows
+    char text[2] = {0, 0};
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        text[0] = (char)(GLYPH_FIRST + i);
+        // Wide letters (M, W, O...) are shrunk to fit the fixed cell
+        float height = FONT_HEIGHT;
+        int advance = hershey_string_width(text, height);
+        if (advance > PERF_HUD_CELL_W) {
+            height = height * PERF_HUD_CELL_W / advance;
+            advance = hershey_string_width(text, height);
+        }
+        int x = (PERF_HUD_CELL_W - advance) / 2;
+        int y = 2 + (int)(FONT_HEIGHT - height);
+        hershey_draw_char(glyphs + i * GLYPH_BYTES, PERF_HUD_CELL_H, PERF_HUD_CELL_W, x < 0 ? 0 : x, y, text[0],
+                          height, COLOR_R(HUD_COLOR), COLOR_G(HUD_COLOR), COLOR_B(HUD_COLOR));
+    }
+    ESP_LOGI(TAG, "Glyph cache: %d glyphs, %d bytes", GLYPH_COUNT, GLYPH_COUNT * GLYPH_BYTES);
+    return ESP_OK;
+}
+
+void perf_hud_set_area(int letterbox_width) {
+    int width = PERF_HUD_COLS * PERF_HUD_CELL_W;
+    fits = glyphs && letterbox_width >= width;
+    origin_x = (letterbox_width - width) / 2;
+    on_screen = false;
+    memset(shown, 0, sizeof(shown));
+    if (enabled && !fits) {
+        ESP_LOGW(TAG, "Letterbox too narrow for the HUD (%d < %d pixels)", letterbox_width, width);
+    }
+}
+
+void perf_hud_set_enabled(bool enable) {
+    enabled = enable;
+}
+
+bool perf_hud_is_enabled(void) {
+    return enabled;
+}
+
+// Copy one cached glyph to cell (col, row)
+static void draw_cell(uint8_t* fb, int fb_stride, int col, int row, char c) {
+    if (c >= 'a' && c <= 'z') {
+        c -= 'a' - 'A';
+    }
+    if (c < GLYPH_FIRST || c >= GLYPH_FIRST + GLYPH_COUNT) {
+        c = '?';
+    }
+    const uint8_t* glyph = glyphs + (c - GLYPH_FIRST) * GLYPH_BYTES;
+    int screen_x = origin_x + col * PERF_HUD_CELL_W;
+    int screen_y = origin_y + row * PERF_HUD_CELL_H;
+    // Screen column x is framebuffer row x, screen rows run right to left
+    uint8_t* dst = fb + ((size_t)screen_x * fb_stride + (fb_stride - screen_y - PERF_HUD_CELL_H)) * 3;
+    for (int i = 0; i < PERF_HUD_CELL_W; i++) {
+        memcpy(dst, glyph, PERF_HUD_CELL_H * 3);
+        dst += fb_stride * 3;
+        glyph += PERF_HUD_CELL_H * 3;
+    }
+}
+
+static void format_load(char* line, int core, int load) {
+    if (load < 0) {
+        snprintf(line, LINE_LEN, "CPU%d --", core);
+    } else {
+        snprintf(line, LINE_LEN, "CPU%d %d%%", core, load);
+    }
+}
+
+void perf_hud_draw(uint8_t* fb, int fb_stride, int fb_height, const perf_hud_values_t* v) {
+    if (!fits || (!enabled && !on_screen)) {
+        return;
+    }
+
+    char lines[PERF_HUD_ROWS][LINE_LEN];
+    memset(lines, 0, sizeof(lines));
+    if (enabled) {
+        snprintf(lines[0], LINE_LEN, "FPS %.1f", v->fps);
+        snprintf(lines[1], LINE_LEN, "DROP %lu", (unsigned long)v->dropped);
+        snprintf(lines[2], LINE_LEN, "BUF %d/%d", v->ring_fill, v->ring_size);
+        snprintf(lines[3], LINE_LEN, "AQ %lu/%lu", (unsigned long)v->audio_queued,
+                 (unsigned long)v->audio_capacity);
+        snprintf(lines[4], LINE_LEN, "AV %+ldMS", (long)v->av_drift_ms);
+        snprintf(lines[5], LINE_LEN, "SD %.1fM/S", v->sd_mb_s);
+        format_load(lines[6], 0, v->core_load[0]);
+        format_load(lines[7], 1, v->core_load[1]);
+    }
+
+    // Only cells whose character changed are written
+    for (int row = 0; row < PERF_HUD_ROWS; row++) {
+        bool ended = false;
+        for (int col = 0; col < PERF_HUD_COLS; col++) {
+            ended = ended || lines[row][col] == 0;
+            char c = ended ? ' ' : lines[row][col];
+            if (shown[row][col] != c) {
+                draw_cell(fb, fb_stride, col, row, c);
+                shown[row][col] = c;
+            }
+        }
+    }
+    on_screen = enabled;
+}
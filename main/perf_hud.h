@@ -0,0 +1,40 @@
+// Performance HUD - playback statistics drawn in the letterbox beside the video
+// Glyphs are rendered once into a cache already rotated for the framebuffer,
+// so a character is a few row copies; only cells whose character changed are
+// redrawn, and the video never overwrites the letterbox
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define PERF_HUD_CELL_W     9       // Screen pixels per character cell
+#define PERF_HUD_CELL_H     14
+#define PERF_HUD_COLS       10
+#define PERF_HUD_ROWS       8
+
+// Values shown, gathered by the player a few times per second
+typedef struct {
+    float fps;                  // Presented frames per second
+    uint32_t dropped;           // Frames dropped since the video started
+    int ring_fill;              // Compressed frames buffered
+    int ring_size;
+    uint32_t audio_queued;      // Audio chunks waiting for the decoder
+    uint32_t audio_capacity;
+    int32_t av_drift_ms;        // Audio position minus video position
+    float sd_mb_s;              // Card throughput while reading
+    int core_load[2];           // Percent busy per core, -1 = unknown
+} perf_hud_values_t;
+
+// Build the glyph cache
+esp_err_t perf_hud_init(void);
+
+// Place the HUD in the letterbox strip screen x [0, letterbox_width)
+// Also forgets what is on screen, for after the framebuffer was cleared
+void perf_hud_set_area(int letterbox_width);
+
+void perf_hud_set_enabled(bool enabled);
+bool perf_hud_is_enabled(void);
+
+// Draw the changed cells, or clear the HUD once after it was disabled
+void perf_hud_draw(uint8_t* fb, int fb_stride, int fb_height, const perf_hud_values_t* values);
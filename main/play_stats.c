@@ -0,0 +1,178 @@
+// Play Stats - per-stage latency histograms and A/V statistics for one playback
+
+#include "play_stats.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char* TAG = "play_stats";
+
+#define SUB_BITS    3           // 8 buckets per octave
+#define SUB_COUNT   (1 << SUB_BITS)
+
+static const char* const stat_names[PLAY_STAT_COUNT] = {
+    "read", "decode", "copy", "vsync", "blit", "interval", "jitter",
+};
+
+static play_stats_hist_t hists[PLAY_STAT_COUNT];
+static uint32_t av_bins[2 * PLAY_STATS_AV_RANGE_MS + 1];
+static uint32_t av_count = 0;
+static int32_t av_min = 0, av_max = 0;
+static uint32_t frame_us = 33333;
+static int64_t last_present_us = 0;
+static uint32_t presented = 0;
+static uint32_t dropped = 0;
+static uint32_t repeated = 0;
+
+// Values below 8 get a bucket each, then 8 buckets per power of two
+static inline int bucket_of(uint32_t us) {
+    if (us < SUB_COUNT) {
+        return us;
+    }
+    int msb = 31 - __builtin_clz(us);
+    int b = (msb - SUB_BITS + 1) * SUB_COUNT + ((us >> (msb - SUB_BITS)) & (SUB_COUNT - 1));
+    return b < PLAY_STATS_BUCKETS ? b : PLAY_STATS_BUCKETS - 1;
+}
+
+// Middle of the range of values that fall into bucket b
+static uint32_t bucket_mid(int b) {
+    if (b < SUB_COUNT) {
+        return b;
+    }
+    int shift = b / SUB_COUNT - 1;
+    uint32_t low = (uint32_t)(SUB_COUNT + b % SUB_COUNT) << shift;
+    return low + ((1u << shift) >> 1);
+}
+
+void play_stats_reset(uint32_t frame_duration_us) {
+    memset(hists, 0, sizeof(hists));
+    memset(av_bins, 0, sizeof(av_bins));
+    av_count = 0;
+    av_min = av_max = 0;
+    frame_us = frame_duration_us > 0 ? frame_duration_us : 33333;
+    last_present_us = 0;
+    presented = dropped = repeated = 0;
+}
+
+void play_stats_set_frame_duration(uint32_t frame_duration_us) {
+    if (frame_duration_us > 0) {
+        frame_us = frame_duration_us;
+    }
+}
+
+void play_stats_add(play_stat_t stat, uint32_t us) {
+    play_stats_hist_t* h = &hists[stat];
+    h->buckets[bucket_of(us)]++;
+    h->count++;
+    h->sum += us;
+    if (us > h->max) {
+        h->max = us;
+    }
+}
+
+void play_stats_present(int64_t present_us, int32_t jitter_us) {
+    if (presented > 0) {
+        int64_t interval = present_us - last_present_us;
+        play_stats_add(PLAY_STAT_INTERVAL, (uint32_t)interval);
+        // Display periods the previous frame stayed up beyond its own
+        uint32_t periods = (uint32_t)((interval + frame_us / 2) / frame_us);
+        if (periods > 1) {
+            repeated += periods - 1;
+        }
+    }
+    last_present_us = present_us;
+    presented++;
+
+    play_stats_add(PLAY_STAT_JITTER, jitter_us > 0 ? (uint32_t)jitter_us : 0);
+}
+
+void play_stats_av(int32_t av_offset_ms) {
+    if (av_count == 0 || av_offset_ms < av_min) av_min = av_offset_ms;
+    if (av_count == 0 || av_offset_ms > av_max) av_max = av_offset_ms;
+    int32_t bin = av_offset_ms;
+    if (bin < -PLAY_STATS_AV_RANGE_MS) bin = -PLAY_STATS_AV_RANGE_MS;
+    if (bin > PLAY_STATS_AV_RANGE_MS) bin = PLAY_STATS_AV_RANGE_MS;
+    av_bins[bin + PLAY_STATS_AV_RANGE_MS]++;
+    av_count++;
+}
+
+void play_stats_dropped(uint32_t frames) {
+    dropped += frames;
+}
+
+// Middle of the first bucket with at least per_mille of the samples at or below it
+static uint32_t percentile(const play_stats_hist_t* h, uint32_t per_mille) {
+    uint64_t target = ((uint64_t)h->count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    for (int b = 0; b < PLAY_STATS_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= target && seen > 0) {
+            uint32_t mid = bucket_mid(b);
+            return mid < h->max ? mid : h->max;
+        }
+    }
+    return h->max;
+}
+
+void play_stats_summarize(play_stat_t stat, play_stats_summary_t* summary) {
+    const play_stats_hist_t* h = &hists[stat];
+    summary->count = h->count;
+    summary->max = h->max;
+    summary->mean = h->count ? (uint32_t)(h->sum / h->count) : 0;
+    summary->p50 = percentile(h, 500);
+    summary->p95 = percentile(h, 950);
+    summary->p99 = percentile(h, 990);
+}
+
+static int32_t av_percentile(uint32_t per_mille) {
+    uint64_t target = ((uint64_t)av_count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    for (int i = 0; i < 2 * PLAY_STATS_AV_RANGE_MS + 1; i++) {
+        seen += av_bins[i];
+        if (seen >= target && seen > 0) {
+            return i - PLAY_STATS_AV_RANGE_MS;
+        }
+    }
+    return 0;
+}
+
+void play_stats_av_offset(int32_t* p1, int32_t* p50, int32_t* p99, int32_t* min, int32_t* max) {
+    *p1 = av_percentile(10);
+    *p50 = av_percentile(500);
+    *p99 = av_percentile(990);
+    *min = av_min;
+    *max = av_max;
+}
+
+uint32_t play_stats_presented(void) {
+    return presented;
+}
+
+uint32_t play_stats_dropped_count(void) {
+    return dropped;
+}
+
+uint32_t play_stats_repeated_count(void) {
+    return repeated;
+}
+
+void play_stats_log(const char* title) {
+    ESP_LOGI(TAG, "=== PLAYBACK STATS: %s ===", title ? title : "");
+    ESP_LOGI(TAG, "Frames: %lu presented, %lu dropped, %lu repeated (%.1f ms period)",
+             (unsigned long)presented, (unsigned long)dropped, (unsigned long)repeated, frame_us / 1000.0f);
+    ESP_LOGI(TAG, "%-9s %7s %8s %8s %8s %8s %8s", "stage", "count", "mean", "p50", "p95", "p99", "max");
+    for (int i = 0; i < PLAY_STAT_COUNT; i++) {
+        play_stats_summary_t s;
+        play_stats_summarize(i, &s);
+        if (s.count == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-9s %7lu %6.2fms %6.2fms %6.2fms %6.2fms %6.2fms", stat_names[i], (unsigned long)s.count,
+                 s.mean / 1000.0f, s.p50 / 1000.0f, s.p95 / 1000.0f, s.p99 / 1000.0f, s.max / 1000.0f);
+    }
+    if (av_count > 0) {
+        int32_t p1, p50, p99, min, max;
+        play_stats_av_offset(&p1, &p50, &p99, &min, &max);
+        ESP_LOGI(TAG, "A/V offset (audio - video): p1=%+ldms p50=%+ldms p99=%+ldms, min=%+ldms max=%+ldms",
+                 (long)p1, (long)p50, (long)p99, (long)min, (long)max);
+    }
+}
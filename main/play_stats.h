@@ -0,0 +1,66 @@
+// Play Stats - per-stage latency histograms and A/V statistics for one playback
+// Fixed log-scale buckets (8 per octave, so percentiles are within about 6%) are
+// cheap enough to update on every frame in release builds; a summary with
+// p50/p95/p99/max per stage is logged at the end of each video and on demand
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PLAY_STATS_BUCKETS      200     // 1 us .. ~134 s
+#define PLAY_STATS_AV_RANGE_MS  256     // A/V offsets are kept in 1 ms bins within +-this
+
+typedef enum {
+    PLAY_STAT_READ,             // Card read of one chunk
+    PLAY_STAT_DECODE,           // JPEG decode of one frame
+    PLAY_STAT_COPY,             // Framebuffer copy / rotation
+    PLAY_STAT_VSYNC,            // Vsync wait in the main loop
+    PLAY_STAT_BLIT,             // Display blit
+    PLAY_STAT_INTERVAL,         // Time between two presented frames
+    PLAY_STAT_JITTER,           // Present time minus the frame's PTS
+    PLAY_STAT_COUNT
+} play_stat_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[PLAY_STATS_BUCKETS];
+} play_stats_hist_t;
+
+typedef struct {
+    uint32_t p50, p95, p99, max;
+    uint32_t count;
+    uint32_t mean;
+} play_stats_summary_t;
+
+// Reset everything, frame_duration_us is the nominal frame period
+void play_stats_reset(uint32_t frame_duration_us);
+
+// The period a frame should stay up changed (playback speed), counts repeats against it from now on
+void play_stats_set_frame_duration(uint32_t frame_duration_us);
+
+// Add one sample (microseconds) to a stage
+void play_stats_add(play_stat_t stat, uint32_t us);
+
+// A frame reached the display at present_us, jitter_us late against its PTS
+void play_stats_present(int64_t present_us, int32_t jitter_us);
+
+// Audio position minus the presented frame's PTS (positive = audio ahead)
+void play_stats_av(int32_t offset_ms);
+
+// Frames skipped to catch up with the clock
+void play_stats_dropped(uint32_t frames);
+
+// Percentiles of one stage
+void play_stats_summarize(play_stat_t stat, play_stats_summary_t* summary);
+
+// A/V offset percentiles in ms (signed, clamped to +-PLAY_STATS_AV_RANGE_MS)
+void play_stats_av_offset(int32_t* p1, int32_t* p50, int32_t* p99, int32_t* min, int32_t* max);
+
+uint32_t play_stats_presented(void);
+uint32_t play_stats_dropped_count(void);
+uint32_t play_stats_repeated_count(void);
+
+// Log the summary via ESP_LOGI, title names the clip
+void play_stats_log(const char* title);
@@ -0,0 +1,527 @@
+// Playback - demux ring buffer and wall-clock frame scheduler
+
+#include "playback.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "play_stats.h"
+#include "trace.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_cache.h"
+#endif
+
+static const char* TAG = "playback";
+
+static int64_t now_us(const playback_t* pb) {
+    return pb->ops.now_us ? pb->ops.now_us(pb->ops.ctx) : esp_timer_get_time();
+}
+
+static esp_err_t push_audio(playback_t* pb, const uint8_t* data, size_t size) {
+    return pb->ops.audio_push ? pb->ops.audio_push(pb->ops.ctx, data, size) : ESP_OK;
+}
+
+static uint32_t audio_position_ms(const playback_t* pb) {
+    return pb->ops.audio_position_ms ? pb->ops.audio_position_ms(pb->ops.ctx) : 0;
+}
+
+void playback_init(playback_t* pb, const playback_config_t* config, const playback_ops_t* ops) {
+    memset(pb, 0, sizeof(*pb));
+    pb->config = *config;
+    if (pb->config.ring_frames_max > PLAYBACK_RING_MAX) {
+        pb->config.ring_frames_max = PLAYBACK_RING_MAX;
+    }
+    if (pb->config.ring_frames > pb->config.ring_frames_max) {
+        pb->config.ring_frames = pb->config.ring_frames_max;
+    }
+    if (ops) {
+        pb->ops = *ops;
+    }
+    pb->speed = PLAYBACK_SPEED_NORMAL;
+    pb->frame_step = 1;
+}
+
+static void reset_state(playback_t* pb) {
+    pb->write_idx = 0;
+    pb->read_idx = 0;
+    pb->buffered = 0;
+    pb->next_frame_index = 0;
+    pb->end_of_file = false;
+    pb->pending_audio_size = 0;
+    pb->current_frame = 0;
+    pb->start_time_us = 0;
+    pb->clock_media_us = 0;
+    pb->clock_running = false;
+    pb->trick_rate = 0;
+    pb->trick_next = 0;
+    pb->shown_frame = -1;
+    pb->read_bytes = 0;
+    pb->read_busy_us = 0;
+}
+
+// Size ring slots for the open file and allocate the ring in PSRAM, aligned for DMA
+// Files from our muxer declare their largest frame and start every frame on a
+// sector, so slots shrink to exactly that and the same memory holds more frames
+static esp_err_t alloc_ring(playback_t* pb, const avi_info_t* info) {
+    const playback_config_t* config = &pb->config;
+    size_t align = 64;
+#ifdef ESP_PLATFORM
+    esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &align);
+#endif
+    if (align < 4) align = 4;
+
+    pb->frame_max = config->frame_max;
+    pb->slot_size = avi_source_span_size(config->frame_max);
+    pb->ring_frames = config->ring_frames;
+
+    const avi_playback_info_t* playback = &info->playback;
+    if (info->has_playback_info && playback->max_video_size > 0 && playback->max_video_size <= config->frame_max) {
+        pb->frame_max = playback->max_video_size;
+        if (playback->flags & AVI_FLAG_SECTOR_ALIGNED) {
+            pb->slot_size = (pb->frame_max + AVI_SOURCE_SECTOR_SIZE - 1) & ~(size_t)(AVI_SOURCE_SECTOR_SIZE - 1);
+        } else {
+            pb->slot_size = avi_source_span_size(pb->frame_max);
+        }
+        pb->slot_size = (pb->slot_size + align - 1) & ~(align - 1);
+
+        size_t frames = config->ring_bytes / pb->slot_size;
+        pb->ring_frames = frames > (size_t)config->ring_frames_max ? config->ring_frames_max : (int)frames;
+
+        ESP_LOGI(TAG, "Ring sized from playback info: %d slots of %zu bytes, peak %lu bytes/frame",
+                 pb->ring_frames, pb->slot_size, (unsigned long)playback->peak_bytes[0]);
+    }
+    if (pb->ring_frames < 3) {
+        pb->ring_frames = 3;
+    }
+
+    // Keep the allocation between videos, grow only when needed
+    size_t buffer_size = pb->ring_frames * pb->slot_size;
+    if (pb->ring_memory && buffer_size <= pb->ring_capacity) {
+        return ESP_OK;
+    }
+
+    heap_caps_free(pb->ring_memory);
+    pb->ring_capacity = 0;
+    pb->ring_memory = heap_caps_aligned_alloc(align, buffer_size, MALLOC_CAP_SPIRAM);
+    if (!pb->ring_memory) {
+        ESP_LOGE(TAG, "Failed to allocate video buffer (%zu bytes)", buffer_size);
+        return ESP_ERR_NO_MEM;
+    }
+    pb->ring_capacity = buffer_size;
+    ESP_LOGI(TAG, "Allocated video buffer: %zu bytes in PSRAM (%zu-byte aligned)", buffer_size, align);
+    return ESP_OK;
+}
+
+// Above normal speed, keep to the decode rate the config allows
+static void update_frame_step(playback_t* pb) {
+    pb->frame_step = 1;
+    if (pb->config.max_fps > 0 && pb->speed > PLAYBACK_SPEED_NORMAL && pb->frame_scale > 0) {
+        uint64_t shown = (uint64_t)pb->frame_rate * pb->speed;
+        uint64_t allowed = (uint64_t)pb->frame_scale * PLAYBACK_SPEED_NORMAL * pb->config.max_fps;
+        pb->frame_step = (int)((shown + allowed - 1) / allowed);
+    }
+}
+
+esp_err_t playback_prepare(playback_t* pb, int default_fps) {
+    const avi_info_t* info = avi_parser_get_info(&pb->parser);
+    pb->fps = info->fps > 0 ? (int)info->fps : default_fps;
+    if (info->fps > 0 && info->video_scale > 0 && info->video_rate > 0) {
+        pb->frame_scale = info->video_scale;
+        pb->frame_rate = info->video_rate;
+    } else {
+        // 1000 / fps in whole milliseconds would run the clock fast (66 ms at 15 fps)
+        pb->frame_scale = 1;
+        pb->frame_rate = pb->fps;
+    }
+    pb->frame_duration_us = (uint32_t)playback_pts_us(pb, 1);
+    update_frame_step(pb);
+    reset_state(pb);
+    return alloc_ring(pb, info);
+}
+
+// Read the rest of a chunk whose header was just parsed, timing the card
+static esp_err_t read_payload(playback_t* pb, avi_chunk_t* chunk, uint8_t* dest, size_t dest_size) {
+    int64_t t = now_us(pb);
+    TRACE_BEGIN(READ);
+    esp_err_t ret = avi_parser_read_payload(&pb->parser, chunk, dest, dest_size);
+    TRACE_END(READ, chunk->size >> 10);
+    t = now_us(pb) - t;
+    play_stats_add(PLAY_STAT_READ, t);
+    pb->read_busy_us += t;
+    pb->read_bytes += chunk->size;
+    return ret;
+}
+
+// Frames that can never be shown are skipped without reading them: above
+// normal speed, all but every frame_step-th frame, and frames whose
+// successor is already due. A late frame is still read into an empty ring so
+// the picture keeps moving when the card cannot keep up
+static bool skip_video_frame(playback_t* pb, int index) {
+    if (pb->speed <= PLAYBACK_SPEED_NORMAL) {
+        return false;
+    }
+    if (pb->frame_step > 1 && index % pb->frame_step != 0) {
+        TRACE_INSTANT(SKIP, index);
+        return true;
+    }
+    if (!pb->clock_running || pb->buffered == 0 ||
+        playback_pts_us(pb, index + pb->frame_step) > playback_media_us(pb)) {
+        return false;
+    }
+    TRACE_INSTANT(SKIP, index);
+    play_stats_dropped(1);
+    return true;
+}
+
+// Buffer one chunk from the AVI file
+// Returns: 0 = buffered audio or video, 1 = EOF, -1 = video buffer full, -2 = audio queue full
+static int buffer_one_chunk(playback_t* pb) {
+    // First try to push any pending audio chunk
+    if (pb->pending_audio_size > 0) {
+        if (push_audio(pb, pb->pending_audio, pb->pending_audio_size) == ESP_OK) {
+            pb->pending_audio_size = 0;
+        } else {
+            // Can't push pending audio - don't read any more chunks
+            // This guarantees we never lose audio data
+            return -2;
+        }
+    }
+
+    if (pb->buffered >= pb->ring_frames) {
+        return -1;
+    }
+
+    avi_chunk_t chunk;
+    esp_err_t ret = avi_parser_next_header(&pb->parser, &chunk);
+    if (ret != ESP_OK || chunk.type == AVI_CHUNK_END) {
+        pb->end_of_file = true;
+        return 1;
+    }
+
+    if (chunk.type == AVI_CHUNK_AUDIO) {
+        // Muxed files carry an empty audio chunk for frames without audio
+        if (chunk.size == 0) {
+            return 0;
+        }
+        if (read_payload(pb, &chunk, NULL, 0) != ESP_OK) {
+            pb->end_of_file = true;
+            return 1;
+        }
+
+        if (push_audio(pb, chunk.data, chunk.size) == ESP_ERR_TIMEOUT) {
+            // Queue full - save for later (pending is guaranteed empty at this point)
+            if (chunk.size <= sizeof(pb->pending_audio)) {
+                memcpy(pb->pending_audio, chunk.data, chunk.size);
+                pb->pending_audio_size = chunk.size;
+            }
+        }
+        return 0;
+    }
+
+    if (chunk.type == AVI_CHUNK_VIDEO) {
+        if (skip_video_frame(pb, pb->next_frame_index)) {
+            pb->next_frame_index++;
+            return 0;
+        }
+        if (chunk.size > pb->frame_max) {
+            ESP_LOGW(TAG, "Video frame too large: %zu > %zu, skipping", chunk.size, pb->frame_max);
+            pb->next_frame_index++;
+            return 0;
+        }
+
+        // Read straight into the ring slot (no intermediate copy)
+        uint8_t* dest = pb->ring_memory + pb->write_idx * pb->slot_size;
+        if (read_payload(pb, &chunk, dest, pb->slot_size) != ESP_OK) {
+            pb->end_of_file = true;
+            return 1;
+        }
+        playback_frame_t* frame = &pb->frames[pb->write_idx];
+        frame->data = (uint8_t*)chunk.data;
+        frame->size = chunk.size;
+        frame->frame_index = pb->next_frame_index++;
+
+        pb->write_idx = (pb->write_idx + 1) % pb->ring_frames;
+        pb->buffered++;
+        return 0;
+    }
+
+    // Unknown chunk type, skip
+    return 0;
+}
+
+static int64_t media_at(const playback_t* pb, int64_t now) {
+    return pb->clock_media_us + (now - pb->start_time_us) * playback_clock_speed(pb) / PLAYBACK_SPEED_NORMAL;
+}
+
+// Frame the presentation clock is at (rounded towards zero)
+static int clock_frame(const playback_t* pb) {
+    return (int)(playback_media_us(pb) * pb->frame_rate / ((int64_t)1000000 * pb->frame_scale));
+}
+
+// Trick play: read the next frame to show straight from its index entry
+// Frames the clock has passed are not read; rewinding holds at frame 0
+// Returns like buffer_one_chunk()
+static int buffer_trick_frame(playback_t* pb) {
+    if (pb->buffered >= pb->ring_frames) {
+        return -1;
+    }
+
+    int rate = pb->trick_rate;
+    if (pb->clock_running) {
+        int expected = clock_frame(pb);
+        if ((pb->trick_next - expected) * rate < 0) {
+            TRACE_INSTANT(SKIP, pb->trick_next);
+            pb->trick_next = expected + rate;
+        }
+    }
+    if (pb->trick_next < 0) {
+        return 1;
+    }
+    if (pb->trick_next >= playback_indexed_frames(pb)) {
+        pb->end_of_file = true;
+        return 1;
+    }
+
+    int index = pb->trick_next;
+    pb->trick_next = index > 0 && index + rate < 0 ? 0 : index + rate;
+
+    const uint8_t* data;
+    size_t size;
+    esp_err_t ret = playback_read_frame(pb, index, &data, &size);
+    // Empty frames repeat the previous one, there is nothing to show
+    if (ret == ESP_ERR_NOT_FOUND || ret == ESP_ERR_INVALID_SIZE) {
+        return 0;
+    }
+    if (ret != ESP_OK) {
+        pb->end_of_file = true;
+        return 1;
+    }
+    playback_frame_t* frame = &pb->frames[pb->write_idx];
+    frame->data = (uint8_t*)data;
+    frame->size = size;
+    frame->frame_index = index;
+
+    pb->write_idx = (pb->write_idx + 1) % pb->ring_frames;
+    pb->buffered++;
+    return 0;
+}
+
+int playback_prebuffer(playback_t* pb) {
+    int target_frames = (pb->config.prebuffer_ms * pb->fps) / 1000;
+    if (target_frames < 3) target_frames = 3;  // Minimum 3 frames
+    if (target_frames > pb->ring_frames - 2) target_frames = pb->ring_frames - 2;
+
+    ESP_LOGI(TAG, "Pre-buffering %d frames (%dms at %dfps)...", target_frames, pb->config.prebuffer_ms, pb->fps);
+
+    while (pb->buffered < target_frames && !pb->end_of_file) {
+        // -1 can't happen below the target, -2 retries until the audio queue drains
+        if (buffer_one_chunk(pb) == 1) {
+            break;
+        }
+    }
+
+    ESP_LOGI(TAG, "Pre-buffered %d video frames", pb->buffered);
+    return pb->buffered;
+}
+
+void playback_start_clock(playback_t* pb) {
+    // Account for audio that already played during prebuffering
+    // This syncs video timing to where audio already is
+    // After a seek the clock starts at the frame if there is no audio
+    uint32_t audio_already_played_ms = audio_position_ms(pb);
+    pb->start_time_us = now_us(pb);
+    pb->clock_media_us = (int64_t)audio_already_played_ms * 1000;
+    if (pb->clock_media_us < playback_pts_us(pb, pb->current_frame)) {
+        pb->clock_media_us = playback_pts_us(pb, pb->current_frame);
+    }
+    pb->clock_running = true;
+    ESP_LOGI(TAG, "Playback starting (audio offset: %lu ms)", (unsigned long)audio_already_played_ms);
+}
+
+void playback_fill(playback_t* pb) {
+    // Higher FPS needs more chunks per call to keep up
+    int chunks_read = 0;
+    while (pb->buffered < pb->ring_frames && !pb->end_of_file && chunks_read < pb->config.chunks_per_step) {
+        if ((pb->trick_rate ? buffer_trick_frame(pb) : buffer_one_chunk(pb)) != 0) {
+            break;  // EOF, video buffer or audio queue full
+        }
+        chunks_read++;
+    }
+}
+
+int64_t playback_media_us(const playback_t* pb) {
+    return media_at(pb, now_us(pb));
+}
+
+uint32_t playback_elapsed_ms(const playback_t* pb) {
+    return (uint32_t)(playback_media_us(pb) / 1000);
+}
+
+void playback_set_speed(playback_t* pb, int speed_percent) {
+    if (speed_percent < PLAYBACK_SPEED_MIN) speed_percent = PLAYBACK_SPEED_MIN;
+    if (speed_percent > PLAYBACK_SPEED_MAX) speed_percent = PLAYBACK_SPEED_MAX;
+    if (pb->clock_running) {
+        // Rebase so media time continues from where it is now
+        int64_t now = now_us(pb);
+        pb->clock_media_us = media_at(pb, now);
+        pb->start_time_us = now;
+    }
+    pb->speed = speed_percent;
+    update_frame_step(pb);
+    ESP_LOGI(TAG, "Speed %d%%, frame step %d", speed_percent, pb->frame_step);
+}
+
+int playback_indexed_frames(const playback_t* pb) {
+    const avi_info_t* info = &pb->parser.info;
+    if (!info->has_playback_info || info->playback.index_offset == 0) {
+        return 0;
+    }
+    return (int)info->playback.frame_count;
+}
+
+// Drop buffered frames and any held audio
+static void flush_ring(playback_t* pb) {
+    pb->write_idx = 0;
+    pb->read_idx = 0;
+    pb->buffered = 0;
+    pb->pending_audio_size = 0;
+    pb->end_of_file = false;
+}
+
+esp_err_t playback_seek(playback_t* pb, int frame) {
+    int count = playback_indexed_frames(pb);
+    if (count == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (frame < 0) frame = 0;
+    if (frame >= count) frame = count - 1;
+
+    // The frame's audio chunk comes first in the interleave
+    avi_index_entry_t entry;
+    esp_err_t ret = avi_parser_read_index(&pb->parser, frame, &entry, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = avi_parser_seek(&pb->parser, pb->parser.info.has_audio && entry.audio_offset ? entry.audio_offset
+                                                                                         : entry.video_offset);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    flush_ring(pb);
+    pb->trick_rate = 0;
+    pb->next_frame_index = frame;
+    pb->current_frame = frame;
+    pb->clock_running = false;
+    ESP_LOGI(TAG, "Seek to frame %d", frame);
+    return ESP_OK;
+}
+
+esp_err_t playback_read_frame(playback_t* pb, int frame, const uint8_t** data, size_t* size) {
+    if (frame < 0 || frame >= playback_indexed_frames(pb)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pb->buffered >= pb->ring_frames) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    avi_index_entry_t entry;
+    esp_err_t ret = avi_parser_read_index(&pb->parser, frame, &entry, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (entry.video_size == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (entry.video_size > pb->frame_max) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    avi_chunk_t chunk = {
+        .type = AVI_CHUNK_VIDEO,
+        .size = entry.video_size,
+        .offset = entry.video_offset,
+    };
+    ret = read_payload(pb, &chunk, pb->ring_memory + pb->write_idx * pb->slot_size, pb->slot_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *data = chunk.data;
+    *size = chunk.size;
+    return ESP_OK;
+}
+
+esp_err_t playback_set_trick(playback_t* pb, int rate) {
+    int from = pb->shown_frame >= 0 ? pb->shown_frame : pb->current_frame;
+    if (rate == 0) {
+        return pb->trick_rate ? playback_seek(pb, from) : ESP_OK;
+    }
+    if (playback_indexed_frames(pb) == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (rate > PLAYBACK_TRICK_MAX) rate = PLAYBACK_TRICK_MAX;
+    if (rate < -PLAYBACK_TRICK_MAX) rate = -PLAYBACK_TRICK_MAX;
+
+    // The clock restarts at the frame on screen and runs rate times as fast;
+    // the demux position is left alone, leaving trick play seeks anyway
+    flush_ring(pb);
+    pb->trick_rate = rate;
+    pb->trick_next = from + rate;
+    pb->current_frame = from + (rate > 0 ? 1 : -1);
+    pb->clock_media_us = playback_pts_us(pb, from);
+    pb->start_time_us = now_us(pb);
+    pb->clock_running = true;
+    ESP_LOGI(TAG, "Trick play %+dx from frame %d", rate, from);
+    return ESP_OK;
+}
+
+// Whether frame a comes after frame b in the direction of play
+static inline bool after(const playback_t* pb, int a, int b) {
+    return pb->trick_rate < 0 ? a < b : a > b;
+}
+
+const playback_frame_t* playback_due_frame(playback_t* pb) {
+    int expected_frame = clock_frame(pb);
+    int direction = pb->trick_rate < 0 ? -1 : 1;
+
+    // Ahead of schedule, or nothing to show yet
+    if (after(pb, pb->current_frame, expected_frame) || pb->buffered == 0 ||
+        after(pb, pb->frames[pb->read_idx].frame_index, expected_frame)) {
+        return NULL;
+    }
+
+    // Skip frames if we're behind (drop frames to catch up): a frame is
+    // dropped once the one after it is due
+    playback_frame_t* frame = &pb->frames[pb->read_idx];
+    int frames_skipped = 0;
+    while (pb->buffered > 1 &&
+           !after(pb, pb->frames[(pb->read_idx + 1) % pb->ring_frames].frame_index, expected_frame)) {
+        pb->read_idx = (pb->read_idx + 1) % pb->ring_frames;
+        pb->buffered--;
+        pb->current_frame = frame->frame_index + direction;
+        frames_skipped++;
+        TRACE_INSTANT(DROP, frame->frame_index);
+        frame = &pb->frames[pb->read_idx];
+    }
+    if (frames_skipped > 0) {
+        play_stats_dropped(frames_skipped);
+        ESP_LOGW(TAG, "Skipped %d video frames (behind by %d)", frames_skipped,
+                 (expected_frame - pb->current_frame) * direction);
+    }
+    return frame;
+}
+
+void playback_release_frame(playback_t* pb, bool shown) {
+    const playback_frame_t* frame = &pb->frames[pb->read_idx];
+    if (shown) {
+        pb->current_frame = frame->frame_index + (pb->trick_rate < 0 ? -1 : 1);
+        pb->shown_frame = frame->frame_index;
+    }
+    pb->read_idx = (pb->read_idx + 1) % pb->ring_frames;
+    pb->buffered--;
+}
+
+void playback_stop(playback_t* pb) {
+    avi_parser_close(&pb->parser);
+    reset_state(pb);
+}
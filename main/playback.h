@@ -0,0 +1,197 @@
+// Playback - demux ring buffer and wall-clock frame scheduler
+// Reads interleaved chunks into a ring of compressed frames, hands audio to
+// the audio sink and picks the frame that is due on the presentation clock,
+// dropping late ones. The clock runs at a selectable speed; above normal
+// speed, frames that would never be shown are skipped unread. With a frame
+// index, playback can seek and scan (trick play) in either direction.
+// Audio and the clock come in through ops, so the host simulator
+// (host/playsim) runs this same code under a virtual clock
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "avi_parser.h"
+
+#define PLAYBACK_RING_MAX       48              // Ring slots at most
+#define PLAYBACK_AUDIO_MAX      4096            // Largest audio chunk held back when the queue is full
+
+#define PLAYBACK_SPEED_NORMAL   100             // Clock speed in percent
+#define PLAYBACK_SPEED_MIN      50
+#define PLAYBACK_SPEED_MAX      200
+#define PLAYBACK_TRICK_MAX      16              // Fastest scan, frames advanced per frame shown
+#define PLAYBACK_TRICK_REDUCED  8               // Scans this fast decode at reduced scale
+
+// Buffering policy
+typedef struct {
+    int ring_frames;            // Ring depth for files without playback info
+    int ring_frames_max;        // Depth limit when slots are sized exactly (<= PLAYBACK_RING_MAX)
+    size_t frame_max;           // Largest frame for files without playback info
+    size_t ring_bytes;          // Memory the ring may use
+    int chunks_per_step;        // Chunks read per playback_fill() call
+    int prebuffer_ms;           // Media buffered before the clock starts
+    int max_fps;                // Frames per second decoded at most when playing fast, 0 = all
+} playback_config_t;
+
+// Ring slots hold whole sectors (frames are DMAed straight in), so each slot
+// has room for one partial sector on either side of the frame
+#define PLAYBACK_FRAME_MAX      (64 * 1024)
+#define PLAYBACK_SLOT_SIZE      (PLAYBACK_FRAME_MAX + 2 * AVI_SOURCE_SECTOR_SIZE)
+
+#define PLAYBACK_CONFIG_DEFAULT {                       \
+    .ring_frames = 16,                                  \
+    .ring_frames_max = PLAYBACK_RING_MAX,               \
+    .frame_max = PLAYBACK_FRAME_MAX,                    \
+    .ring_bytes = 16 * PLAYBACK_SLOT_SIZE,              \
+    .chunks_per_step = 8,                               \
+    .prebuffer_ms = 300,                                \
+    .max_fps = 30,                                      \
+}
+
+// Audio sink and clock
+typedef struct {
+    // Queue a chunk (copied), ESP_ERR_TIMEOUT when the queue stays full
+    esp_err_t (*audio_push)(void* ctx, const uint8_t* data, size_t size);
+    // Audio written to the output so far
+    uint32_t (*audio_position_ms)(void* ctx);
+    // Monotonic microseconds
+    int64_t (*now_us)(void* ctx);
+    void* ctx;
+} playback_ops_t;
+
+typedef struct {
+    uint8_t* data;              // Frame start inside its slot
+    size_t size;
+    int frame_index;            // Which frame number this is (for sync)
+} playback_frame_t;
+
+typedef struct {
+    playback_config_t config;
+    playback_ops_t ops;
+    avi_parser_t parser;        // Opened by the caller (source choice is platform specific)
+
+    // Compressed frame ring
+    uint8_t* ring_memory;
+    size_t ring_capacity;       // Bytes allocated (kept between videos)
+    size_t slot_size;
+    size_t frame_max;
+    int ring_frames;
+    playback_frame_t frames[PLAYBACK_RING_MAX];
+    int write_idx;              // Next slot to write
+    int read_idx;               // Next slot to read
+    int buffered;               // Frames currently buffered
+    int next_frame_index;       // Frame counter for buffering
+    bool end_of_file;
+
+    // Audio chunk that did not fit in the queue, retried before reading on
+    uint8_t pending_audio[PLAYBACK_AUDIO_MAX];
+    size_t pending_audio_size;
+
+    // Presentation clock, frames last frame_scale / frame_rate seconds exactly
+    // The clock reads clock_media_us at start_time_us and advances speed
+    // percent of a microsecond per microsecond from there
+    int fps;
+    uint32_t frame_scale;
+    uint32_t frame_rate;
+    uint32_t frame_duration_us; // Rounded, for statistics
+    int current_frame;          // Next frame to show
+    int64_t start_time_us;
+    int64_t clock_media_us;
+    bool clock_running;
+    int speed;                  // Percent, kept between videos
+    int frame_step;             // Every frame_step-th frame is read at this speed
+
+    // Trick play: only every trick_rate-th frame is read, through the index,
+    // and shown at the source frame rate; no audio is demuxed
+    int trick_rate;             // Frames advanced per frame shown, negative = rewind, 0 = normal play
+    int trick_next;             // Next frame to read
+    int shown_frame;            // Frame last shown, -1 = none yet
+
+    // Card reads since playback_prepare()
+    uint64_t read_bytes;
+    int64_t read_busy_us;
+} playback_t;
+
+// Set policy and platform hooks, once
+void playback_init(playback_t* pb, const playback_config_t* config, const playback_ops_t* ops);
+
+// After pb->parser was opened: take the frame rate (default_fps if the file
+// has none), size and allocate the ring and reset all state
+esp_err_t playback_prepare(playback_t* pb, int default_fps);
+
+// Read until prebuffer_ms of frames are buffered, returns the frame count
+int playback_prebuffer(playback_t* pb);
+
+// Start the presentation clock where the audio already is
+void playback_start_clock(playback_t* pb);
+
+// Read up to chunks_per_step chunks while the ring has room
+void playback_fill(playback_t* pb);
+
+// All frames read and shown
+static inline bool playback_finished(const playback_t* pb) {
+    return pb->buffered == 0 && pb->end_of_file;
+}
+
+// Milliseconds on the presentation clock
+uint32_t playback_elapsed_ms(const playback_t* pb);
+
+// Presentation clock in microseconds of media time
+int64_t playback_media_us(const playback_t* pb);
+
+// Presentation time of a frame relative to the clock start
+static inline int64_t playback_pts_us(const playback_t* pb, int frame) {
+    return (int64_t)frame * 1000000 * pb->frame_scale / pb->frame_rate;
+}
+
+// Clock speed in percent, negative while rewinding
+static inline int playback_clock_speed(const playback_t* pb) {
+    return pb->trick_rate ? pb->trick_rate * PLAYBACK_SPEED_NORMAL : pb->speed;
+}
+
+// Wall time (now_us) at which a frame is due at the current speed
+static inline int64_t playback_due_time_us(const playback_t* pb, int frame) {
+    return pb->start_time_us +
+           (playback_pts_us(pb, frame) - pb->clock_media_us) * PLAYBACK_SPEED_NORMAL / playback_clock_speed(pb);
+}
+
+// Change the clock speed (percent, clamped to PLAYBACK_SPEED_MIN..MAX) without
+// a jump in media time; also applies to videos prepared later
+void playback_set_speed(playback_t* pb, int speed_percent);
+
+// Wall time a shown frame stays up at the current speed and frame step
+static inline uint32_t playback_frame_interval_us(const playback_t* pb) {
+    if (pb->trick_rate) {
+        return pb->frame_duration_us;
+    }
+    return (uint32_t)((int64_t)pb->frame_duration_us * pb->frame_step * PLAYBACK_SPEED_NORMAL / pb->speed);
+}
+
+// Frames in the file's index, 0 without one (no seeking or trick play)
+int playback_indexed_frames(const playback_t* pb);
+
+// Continue at a frame: buffered frames are dropped and demuxing resumes at
+// the frame's audio chunk. The clock stops; prebuffer and start it again,
+// with the audio restarted at playback_pts_us(frame). Ends trick play
+esp_err_t playback_seek(playback_t* pb, int frame);
+
+// Read any frame through the index into the free ring slot, without queueing
+// it or moving the demux position; valid until the ring is filled again
+// ESP_ERR_NOT_FOUND for an empty frame (it repeats the previous one)
+esp_err_t playback_read_frame(playback_t* pb, int frame, const uint8_t** data, size_t* size);
+
+// Scan from the frame on screen, rate frames per frame shown (2 to
+// PLAYBACK_TRICK_MAX, negative to rewind); the audio is left to the caller
+// to mute. Rate 0 seeks back to normal play at the frame on screen
+esp_err_t playback_set_trick(playback_t* pb, int rate);
+
+// Frame to show now, skipping frames that are already late
+// NULL while ahead of the clock or when nothing is buffered
+const playback_frame_t* playback_due_frame(playback_t* pb);
+
+// Give the frame from playback_due_frame() back; shown advances the clock position
+void playback_release_frame(playback_t* pb, bool shown);
+
+// Forget buffered frames and close the file, keeping the ring memory
+void playback_stop(playback_t* pb);
@@ -0,0 +1,160 @@
+// Playlist - the list of videos, held in an arena sized to its content
+
+#include "playlist.h"
+#include <string.h>
+#include <strings.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char* TAG = "playlist";
+
+#define BLOCK_FIRST     512     // Bytes of the first arena block, doubled per block
+#define BLOCK_MAX       8192    // Largest regular block
+#define FIRST_CAPACITY  16      // Entries before the pointer arrays first grow
+
+struct playlist_block {
+    playlist_block_t* next;
+    size_t size;
+    size_t used;
+    uint8_t data[];
+};
+
+void playlist_init(playlist_t* playlist) {
+    memset(playlist, 0, sizeof(playlist_t));
+    playlist->title = "Video Player";
+}
+
+// Arena allocation; a request larger than a regular block gets its own
+static void* arena_alloc(playlist_t* playlist, size_t size, size_t align) {
+    playlist_block_t* block = playlist->blocks;
+    if (block) {
+        size_t offset = (block->used + align - 1) & ~(align - 1);
+        if (offset + size <= block->size) {
+            block->used = offset + size;
+            return block->data + offset;
+        }
+    }
+
+    size_t block_size = block ? block->size * 2 : BLOCK_FIRST;
+    if (block_size > BLOCK_MAX) block_size = BLOCK_MAX;
+    if (block_size < size) block_size = size;
+    playlist_block_t* fresh = heap_caps_malloc(sizeof(playlist_block_t) + block_size, MALLOC_CAP_SPIRAM);
+    if (!fresh) {
+        ESP_LOGE(TAG, "Failed to allocate %zu bytes", block_size);
+        return NULL;
+    }
+    fresh->size = block_size;
+    fresh->used = size;
+    fresh->next = playlist->blocks;
+    playlist->blocks = fresh;
+    playlist->arena_bytes += block_size;
+    return fresh->data;
+}
+
+static bool grow(playlist_t* playlist) {
+    int capacity = playlist->capacity ? playlist->capacity * 2 : FIRST_CAPACITY;
+    video_entry_t** entries = heap_caps_realloc(playlist->entries, capacity * sizeof(video_entry_t*),
+                                                MALLOC_CAP_SPIRAM);
+    if (!entries) {
+        return false;
+    }
+    playlist->entries = entries;
+    video_entry_t** view = heap_caps_realloc(playlist->view, capacity * sizeof(video_entry_t*), MALLOC_CAP_SPIRAM);
+    if (!view) {
+        return false;
+    }
+    playlist->view = view;
+    playlist->capacity = capacity;
+    return true;
+}
+
+video_entry_t* playlist_add(playlist_t* playlist) {
+    if (playlist->video_count == playlist->capacity && !grow(playlist)) {
+        ESP_LOGE(TAG, "Failed to grow the list past %d videos", playlist->capacity);
+        return NULL;
+    }
+    video_entry_t* entry = arena_alloc(playlist, sizeof(video_entry_t), _Alignof(video_entry_t));
+    if (!entry) {
+        return NULL;
+    }
+    memset(entry, 0, sizeof(*entry));
+    playlist->entries[playlist->video_count++] = entry;
+    playlist->view[playlist->view_count++] = entry;
+    return entry;
+}
+
+void* playlist_alloc(playlist_t* playlist, size_t size) {
+    return arena_alloc(playlist, size, _Alignof(video_entry_t));
+}
+
+const char* playlist_strdup(playlist_t* playlist, const char* text, size_t len) {
+    char* copy = arena_alloc(playlist, len + 1, 1);
+    if (copy) {
+        memcpy(copy, text, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+video_entry_t* playlist_find(const playlist_t* playlist, const char* video_file) {
+    for (int i = 0; i < playlist->video_count; i++) {
+        if (strcasecmp(playlist->entries[i]->video_file, video_file) == 0) {
+            return playlist->entries[i];
+        }
+    }
+    return NULL;
+}
+
+int playlist_view_index(const playlist_t* playlist, const video_entry_t* entry) {
+    for (int i = 0; i < playlist->view_count; i++) {
+        if (playlist->view[i] == entry) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Binary insertion sort: stable, no scratch memory, and only pointers move
+void playlist_sort(playlist_t* playlist, int (*compare)(const video_entry_t* a, const video_entry_t* b)) {
+    video_entry_t** view = playlist->view;
+    for (int i = 1; i < playlist->view_count; i++) {
+        video_entry_t* entry = view[i];
+        int low = 0;
+        int high = i;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (compare(entry, view[mid]) < 0) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+        memmove(&view[low + 1], &view[low], (i - low) * sizeof(video_entry_t*));
+        view[low] = entry;
+    }
+}
+
+void playlist_filter(playlist_t* playlist, bool (*match)(const video_entry_t* entry, void* arg), void* arg) {
+    playlist->view_count = 0;
+    for (int i = 0; i < playlist->video_count; i++) {
+        if (!match || match(playlist->entries[i], arg)) {
+            playlist->view[playlist->view_count++] = playlist->entries[i];
+        }
+    }
+}
+
+size_t playlist_memory(const playlist_t* playlist) {
+    return playlist->arena_bytes + 2 * playlist->capacity * sizeof(video_entry_t*);
+}
+
+void playlist_free(playlist_t* playlist) {
+    playlist_block_t* block = playlist->blocks;
+    while (block) {
+        playlist_block_t* next = block->next;
+        heap_caps_free(block);
+        block = next;
+    }
+    heap_caps_free(playlist->entries);
+    heap_caps_free(playlist->view);
+    playlist_init(playlist);
+}
@@ -0,0 +1,96 @@
+// Playlist - the list of videos, held in an arena sized to its content
+// Entries and their strings are carved from a chain of blocks that grows as
+// videos are added, so memory follows the actual list and entries never move
+// once added. The menu reads the list through a view, an array of entry
+// pointers that sorting and filtering rearrange without copying entries
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Stream properties read from the file headers
+typedef struct {
+    uint32_t duration_ms;
+    uint16_t width;
+    uint16_t height;
+    uint32_t video_codec;       // FourCC (MJPG)
+    uint16_t audio_format;      // WAVE format tag (0x55 = MP3), 0 = no audio
+    uint16_t audio_channels;
+    uint32_t audio_sample_rate;
+    uint32_t peak_kbps;         // Highest data rate over about a second, 0 = unknown
+    uint32_t playback_flags;    // AVI_FLAG_* of files from avi_remux
+    uint32_t indexed_frames;    // Frames in the frame index, 0 = none (no seeking)
+} media_info_t;
+
+// Chapter given in playlist.json
+typedef struct {
+    uint32_t start_ms;
+    const char* title;
+} video_chapter_t;
+
+// Video entry; the strings and chapters live in the playlist's arena
+typedef struct {
+    const char* id;
+    const char* display_name;
+    const char* video_file;     // AVI file with interleaved MJPEG video + MP3 audio
+    int duration_sec;
+    media_info_t info;
+    const video_chapter_t* chapters;    // NULL = take them from the file, if it has any
+    int chapter_count;
+    const char* audio_language; // Audio track to play, NULL = the playlist's
+} video_entry_t;
+
+typedef struct playlist_block playlist_block_t;
+
+typedef struct {
+    const char* title;
+    const char* audio_language; // Audio track to play (avi_parser_find_audio), NULL = the file's first
+    video_entry_t** entries;    // All entries in list order
+    int video_count;
+    video_entry_t** view;       // Entries shown, sorted and filtered
+    int view_count;
+    int capacity;               // Of entries and view
+    playlist_block_t* blocks;   // Arena, newest block first
+    size_t arena_bytes;         // Allocated for blocks
+} playlist_t;
+
+// Empty list titled "Video Player"
+void playlist_init(playlist_t* playlist);
+
+// Append a zeroed entry to the list and the view; NULL when out of memory
+video_entry_t* playlist_add(playlist_t* playlist);
+
+// Room for size bytes in the arena, aligned for any entry field; NULL when out of memory
+void* playlist_alloc(playlist_t* playlist, size_t size);
+
+// Copy len bytes of text into the arena, NUL-terminated; NULL when out of memory
+const char* playlist_strdup(playlist_t* playlist, const char* text, size_t len);
+
+// Entry playing video_file (case-insensitive), NULL when not listed
+video_entry_t* playlist_find(const playlist_t* playlist, const char* video_file);
+
+// Entries in the view
+static inline int playlist_count(const playlist_t* playlist) {
+    return playlist->view_count;
+}
+
+static inline video_entry_t* playlist_get(const playlist_t* playlist, int index) {
+    return playlist->view[index];
+}
+
+// Position of entry in the view, -1 when filtered out
+int playlist_view_index(const playlist_t* playlist, const video_entry_t* entry);
+
+// Sort the view, keeping the list order of entries that compare equal
+void playlist_sort(playlist_t* playlist, int (*compare)(const video_entry_t* a, const video_entry_t* b));
+
+// Show only the entries match accepts, in list order; NULL shows them all
+void playlist_filter(playlist_t* playlist, bool (*match)(const video_entry_t* entry, void* arg), void* arg);
+
+// Bytes held by the list: arena plus pointer arrays
+size_t playlist_memory(const playlist_t* playlist);
+
+// Free the arena and arrays; the playlist is empty afterwards
+void playlist_free(playlist_t* playlist);
@@ -0,0 +1,328 @@
+// Resume Store - last playback position per video, kept across sessions
+
+#include "resume_store.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char* TAG = "resume_store";
+
+// Writer task configuration
+#define WRITER_TASK_STACK_SIZE  4096
+#define WRITER_TASK_PRIORITY    1       // Below everything on the playback path
+
+#define RECORD_MAGIC            0x32535248  // "HRS2", 64-byte keys
+#define RECORD_MAGIC_V1         0x31535248  // "HRS1", 32-byte keys, no longer read
+#define FLUSH_TIMEOUT_MS        1000
+
+// Journal record, appended as-is (little-endian); frame 0 clears the video
+typedef struct {
+    uint32_t magic;
+    char key[RESUME_STORE_KEY_MAX];
+    uint32_t frame;
+    uint32_t audio_ms;
+    uint32_t check;             // FNV-1a of the fields before
+} journal_record_t;
+
+typedef struct {
+    char key[RESUME_STORE_KEY_MAX];
+    resume_position_t position;
+    uint32_t stamp;             // Save order, the oldest entry is dropped when the table is full
+    bool used;
+    bool dirty;                 // Not in the journal yet
+} resume_entry_t;
+
+static resume_entry_t entries[RESUME_STORE_MAX_VIDEOS];
+static uint32_t next_stamp = 1;
+static char journal_path[128];
+static int journal_records = 0;     // Records in the file, compacted beyond RESUME_STORE_COMPACT_AT
+static SemaphoreHandle_t table_lock = NULL;
+static SemaphoreHandle_t flush_done = NULL;
+static TaskHandle_t writer_task = NULL;
+static volatile bool flush_requested = false;
+
+// Written from the writer task only
+static journal_record_t batch[RESUME_STORE_MAX_VIDEOS];
+
+static uint32_t record_check(const journal_record_t* record) {
+    const uint8_t* p = (const uint8_t*)record;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(journal_record_t, check); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Entry for key, or NULL; call with the table locked
+// Keys are cut to RESUME_STORE_KEY_MAX - 1 characters, so compare only those
+// (media_scan lists no longer names, so every listed video has its own key)
+static resume_entry_t* find_entry(const char* key) {
+    for (int i = 0; i < RESUME_STORE_MAX_VIDEOS; i++) {
+        if (entries[i].used && strncmp(entries[i].key, key, RESUME_STORE_KEY_MAX - 1) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Entry for key, taking a free or the oldest slot for a new key
+static resume_entry_t* claim_entry(const char* key) {
+    resume_entry_t* entry = find_entry(key);
+    if (entry) {
+        return entry;
+    }
+    entry = &entries[0];
+    for (int i = 0; i < RESUME_STORE_MAX_VIDEOS; i++) {
+        if (!entries[i].used) {
+            entry = &entries[i];
+            break;
+        }
+        if (entries[i].stamp < entry->stamp) {
+            entry = &entries[i];
+        }
+    }
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->key, key, RESUME_STORE_KEY_MAX - 1);
+    entry->used = true;
+    return entry;
+}
+
+static void fill_record(journal_record_t* record, const resume_entry_t* entry) {
+    memset(record, 0, sizeof(*record));
+    record->magic = RECORD_MAGIC;
+    memcpy(record->key, entry->key, RESUME_STORE_KEY_MAX);
+    record->frame = entry->position.frame;
+    record->audio_ms = entry->position.audio_ms;
+    record->check = record_check(record);
+}
+
+static bool write_records(FILE* f, const journal_record_t* records, int count) {
+    bool ok = fwrite(records, sizeof(journal_record_t), count, f) == (size_t)count;
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    return fclose(f) == 0 && ok;
+}
+
+// Rewrite the journal with one record per saved position
+// The new file is complete before the old one goes; a leftover .tmp is
+// picked up on the next load
+static void compact(void) {
+    xSemaphoreTake(table_lock, portMAX_DELAY);
+    int count = 0;
+    for (int i = 0; i < RESUME_STORE_MAX_VIDEOS; i++) {
+        resume_entry_t* entry = &entries[i];
+        entry->dirty = false;
+        if (entry->used && entry->position.frame == 0) {
+            entry->used = false;
+        } else if (entry->used) {
+            fill_record(&batch[count++], entry);
+        }
+    }
+    xSemaphoreGive(table_lock);
+
+    char tmp_path[sizeof(journal_path) + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal_path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f || !write_records(f, batch, count)) {
+        ESP_LOGE(TAG, "Failed to write %s", tmp_path);
+        return;
+    }
+    remove(journal_path);
+    if (rename(tmp_path, journal_path) != 0) {
+        ESP_LOGE(TAG, "Failed to replace %s", journal_path);
+        return;
+    }
+    journal_records = count;
+    ESP_LOGI(TAG, "Journal compacted to %d positions", count);
+}
+
+// Append every changed position in one write
+static void write_pending(void) {
+    xSemaphoreTake(table_lock, portMAX_DELAY);
+    int count = 0;
+    for (int i = 0; i < RESUME_STORE_MAX_VIDEOS; i++) {
+        if (entries[i].used && entries[i].dirty) {
+            fill_record(&batch[count++], &entries[i]);
+            entries[i].dirty = false;
+        }
+    }
+    xSemaphoreGive(table_lock);
+    if (count == 0) {
+        return;
+    }
+
+    if (journal_records + count > RESUME_STORE_COMPACT_AT) {
+        compact();
+        return;
+    }
+    FILE* f = fopen(journal_path, "ab");
+    if (!f || !write_records(f, batch, count)) {
+        ESP_LOGE(TAG, "Failed to append to %s", journal_path);
+        return;
+    }
+    journal_records += count;
+}
+
+static void writer(void* arg) {
+    (void)arg;
+    for (;;) {
+        // Sleep until something changes, then collect changes for a while
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TickType_t start = xTaskGetTickCount();
+        TickType_t window = pdMS_TO_TICKS(RESUME_STORE_BATCH_MS);
+        while (!flush_requested && xTaskGetTickCount() - start < window) {
+            ulTaskNotifyTake(pdTRUE, window - (xTaskGetTickCount() - start));
+        }
+
+        write_pending();
+        if (flush_requested) {
+            flush_requested = false;
+            xSemaphoreGive(flush_done);
+        }
+    }
+}
+
+// Replay the journal into the table, one read; false if it ends in a bad record
+static bool load_journal(void) {
+    FILE* f = fopen(journal_path, "rb");
+    if (!f) {
+        // Interrupted compaction: the complete new journal is still under .tmp
+        char tmp_path[sizeof(journal_path) + 4];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal_path);
+        if (rename(tmp_path, journal_path) != 0 || !(f = fopen(journal_path, "rb"))) {
+            return true;
+        }
+    }
+
+    size_t capacity = (RESUME_STORE_COMPACT_AT + RESUME_STORE_MAX_VIDEOS) * sizeof(journal_record_t);
+    journal_record_t* records = malloc(capacity);
+    if (!records) {
+        fclose(f);
+        return true;
+    }
+    size_t bytes = fread(records, 1, capacity, f);
+    bool clean = feof(f) && bytes % sizeof(journal_record_t) == 0;
+    fclose(f);
+    if (bytes >= sizeof(uint32_t) && records[0].magic == RECORD_MAGIC_V1) {
+        ESP_LOGW(TAG, "Journal from an older version, positions start over");
+    }
+
+    int count = bytes / sizeof(journal_record_t);
+    int applied = 0;
+    for (; applied < count; applied++) {
+        journal_record_t* record = &records[applied];
+        if (record->magic != RECORD_MAGIC || record->check != record_check(record)) {
+            clean = false;
+            break;
+        }
+        record->key[RESUME_STORE_KEY_MAX - 1] = '\0';
+        if (record->frame == 0) {
+            // A clear only drops a position, it never takes a slot
+            resume_entry_t* entry = find_entry(record->key);
+            if (entry) {
+                entry->used = false;
+            }
+            continue;
+        }
+        resume_entry_t* entry = claim_entry(record->key);
+        entry->position.frame = record->frame;
+        entry->position.audio_ms = record->audio_ms;
+        entry->stamp = next_stamp++;
+    }
+    free(records);
+    journal_records = applied;
+    if (!clean) {
+        ESP_LOGW(TAG, "Journal damaged after %d records, rewriting", applied);
+    }
+    return clean;
+}
+
+esp_err_t resume_store_init(const char* path) {
+    if (writer_task) {
+        return ESP_OK;
+    }
+    snprintf(journal_path, sizeof(journal_path), "%s", path);
+    table_lock = xSemaphoreCreateMutex();
+    flush_done = xSemaphoreCreateBinary();
+    if (!table_lock || !flush_done) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    bool clean = load_journal();
+    if (!clean) {
+        compact();
+    }
+
+    int saved = 0;
+    for (int i = 0; i < RESUME_STORE_MAX_VIDEOS; i++) {
+        saved += entries[i].used;
+    }
+    ESP_LOGI(TAG, "%d saved positions (%d journal records)", saved, journal_records);
+
+    if (xTaskCreate(writer, "resume_store", WRITER_TASK_STACK_SIZE, NULL, WRITER_TASK_PRIORITY, &writer_task) !=
+        pdPASS) {
+        writer_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool resume_store_get(const char* key, resume_position_t* position) {
+    if (!table_lock) {
+        return false;
+    }
+    xSemaphoreTake(table_lock, portMAX_DELAY);
+    const resume_entry_t* entry = find_entry(key);
+    bool found = entry && entry->position.frame > 0;
+    if (found) {
+        *position = entry->position;
+    }
+    xSemaphoreGive(table_lock);
+    return found;
+}
+
+void resume_store_put(const char* key, const resume_position_t* position) {
+    if (!writer_task) {
+        return;
+    }
+    xSemaphoreTake(table_lock, portMAX_DELAY);
+    // Clearing a video without a saved position has nothing to do; claiming
+    // a slot for it could push out the oldest real position
+    resume_entry_t* entry = position->frame == 0 ? find_entry(key) : claim_entry(key);
+    if (!entry) {
+        xSemaphoreGive(table_lock);
+        return;
+    }
+    bool changed = entry->position.frame != position->frame || entry->position.audio_ms != position->audio_ms;
+    if (changed) {
+        entry->position = *position;
+        entry->stamp = next_stamp++;
+        entry->dirty = true;
+    }
+    xSemaphoreGive(table_lock);
+    if (changed) {
+        xTaskNotifyGive(writer_task);
+    }
+}
+
+void resume_store_clear(const char* key) {
+    const resume_position_t none = {0};
+    resume_store_put(key, &none);
+}
+
+void resume_store_flush(void) {
+    if (!writer_task) {
+        return;
+    }
+    flush_requested = true;
+    xTaskNotifyGive(writer_task);
+    if (xSemaphoreTake(flush_done, pdMS_TO_TICKS(FLUSH_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Flush timed out");
+    }
+}
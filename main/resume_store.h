@@ -0,0 +1,36 @@
+// Resume Store - last playback position per video, kept across sessions
+// Positions live in a RAM table; changes are appended to a journal file on
+// the SD card by a low-priority writer task in batches, so recording a
+// position never blocks the playback loop. Each journal record carries a
+// checksum, a torn last record from a power cut is simply dropped on load,
+// and the journal is compacted to one record per video when it grows
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define RESUME_STORE_MAX_VIDEOS     64      // Positions kept, least recently saved dropped first
+#define RESUME_STORE_KEY_MAX        64      // Key length including the terminator, as long as any listed file name
+#define RESUME_STORE_BATCH_MS       2000    // Changes are collected this long before one write
+#define RESUME_STORE_COMPACT_AT     256     // Records in the journal before it is rewritten
+
+typedef struct {
+    uint32_t frame;             // Frame index to seek to
+    uint32_t audio_ms;          // Audio position at that frame (media time)
+} resume_position_t;
+
+// Load the journal (one read) and start the writer task
+esp_err_t resume_store_init(const char* path);
+
+// Saved position of a video; false when there is none
+bool resume_store_get(const char* key, resume_position_t* position);
+
+// Record a position; returns at once, the write happens in the background
+void resume_store_put(const char* key, const resume_position_t* position);
+
+// Forget the position (video watched to the end)
+void resume_store_clear(const char* key);
+
+// Write pending changes now and wait for them (before a restart)
+void resume_store_flush(void);
@@ -0,0 +1,236 @@
+// Scrub - seek bar with live previews while up or down is held
+
+#include "scrub.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "mjpeg_decoder.h"
+#include "sw_jpeg.h"
+#include "ui_draw.h"
+#include "chapters.h"
+
+static const char* TAG = "scrub";
+
+// Bar along the bottom of the screen, drawn over the video
+#define BAR_MARGIN          40          // Screen pixels left and right of the bar
+#define BAR_BOTTOM          32          // Screen pixels from the bottom edge to the bar
+#define BAR_HEIGHT          8
+#define CURSOR_WIDTH        4
+#define CURSOR_OVERHANG     5           // Cursor reaches this far above and below the bar
+#define CHAPTER_TICK        2           // Gap in the bar where a chapter starts
+
+// A frame without data repeats the previous one; look back this far for one with a picture
+#define EMPTY_FRAME_LOOKBACK 8
+
+typedef struct {
+    int frame;                  // Frame shown by this preview, -1 = free
+    uint32_t last_used;
+    int width;
+    int height;
+    uint8_t* pixels;
+} preview_t;
+
+static preview_t previews[SCRUB_PREVIEWS];
+static uint8_t* preview_memory = NULL;
+static size_t preview_capacity = 0;
+static size_t preview_size = 0;
+static int preview_stride = 0;
+static uint32_t use_counter = 0;
+
+static struct {
+    bool active;
+    int cursor;                 // Frame under the cursor
+    int step;                   // Frames between previews
+    int frames;                 // Frames in the index
+    int direction;              // Key held, 0 = none
+    int64_t held_since_us;
+    int64_t last_us;
+    int64_t travel_us;          // Media time moved that is not a whole step yet
+    bool moved;                 // Cursor left the frame scrubbing began at
+    int drawn_cursor;           // Cursor position on screen, -1 = bar not drawn
+} scrub;
+
+esp_err_t scrub_prepare(int width, int height) {
+    preview_stride = sw_jpeg_reduced_size(width) * 3;
+    preview_size = (size_t)preview_stride * sw_jpeg_reduced_size(height);
+    if (preview_size * SCRUB_PREVIEWS > preview_capacity) {
+        heap_caps_free(preview_memory);
+        preview_memory = heap_caps_malloc(preview_size * SCRUB_PREVIEWS, MALLOC_CAP_SPIRAM);
+        preview_capacity = preview_memory ? preview_size * SCRUB_PREVIEWS : 0;
+        if (!preview_memory) {
+            ESP_LOGE(TAG, "Failed to allocate %d previews", SCRUB_PREVIEWS);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    for (int i = 0; i < SCRUB_PREVIEWS; i++) {
+        previews[i].frame = -1;
+        previews[i].pixels = preview_memory + i * preview_size;
+    }
+    return ESP_OK;
+}
+
+esp_err_t scrub_begin(playback_t* pb) {
+    int frames = playback_indexed_frames(pb);
+    if (frames == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!preview_memory) {
+        return ESP_ERR_NO_MEM;
+    }
+    int from = pb->shown_frame >= 0 ? pb->shown_frame : pb->current_frame;
+
+    // Empties the ring, whose free slot then takes the frames read for previews
+    esp_err_t ret = playback_seek(pb, from);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    int step = (int)((int64_t)SCRUB_STEP_MS * 1000 / pb->frame_duration_us);
+    memset(&scrub, 0, sizeof(scrub));
+    scrub.active = true;
+    scrub.cursor = pb->current_frame;
+    scrub.step = step > 0 ? step : 1;
+    scrub.frames = frames;
+    scrub.drawn_cursor = -1;
+    ESP_LOGI(TAG, "Scrubbing from frame %d", scrub.cursor);
+    return ESP_OK;
+}
+
+bool scrub_active(void) {
+    return scrub.active;
+}
+
+static preview_t* find_preview(int frame) {
+    for (int i = 0; i < SCRUB_PREVIEWS; i++) {
+        if (previews[i].frame == frame) {
+            return &previews[i];
+        }
+    }
+    return NULL;
+}
+
+// Read and decode a preview into the least recently used slot
+static preview_t* load_preview(playback_t* pb, int frame) {
+    const uint8_t* data = NULL;
+    size_t size = 0;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    for (int f = frame; f >= 0 && f > frame - EMPTY_FRAME_LOOKBACK && ret == ESP_ERR_NOT_FOUND; f--) {
+        ret = playback_read_frame(pb, f, &data, &size);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "No preview for frame %d: %s", frame, esp_err_to_name(ret));
+        return NULL;
+    }
+
+    preview_t* slot = &previews[0];
+    for (int i = 1; i < SCRUB_PREVIEWS && slot->frame >= 0; i++) {
+        if (previews[i].frame < 0 || previews[i].last_used < slot->last_used) {
+            slot = &previews[i];
+        }
+    }
+    slot->frame = -1;
+    if (mjpeg_decoder_decode_reduced(data, size, slot->pixels, preview_stride, &slot->width, &slot->height) !=
+        ESP_OK) {
+        return NULL;
+    }
+    slot->frame = frame;
+    slot->last_used = ++use_counter;
+    return slot;
+}
+
+// Cursor position one step from frame, on the step grid
+static int step_from(int frame, int direction) {
+    int step = scrub.step;
+    int next = direction > 0 ? (frame / step + 1) * step : ((frame + step - 1) / step - 1) * step;
+    if (next >= scrub.frames) {
+        next = (scrub.frames - 1) / step * step;
+    }
+    return next < 0 ? 0 : next;
+}
+
+void scrub_update(playback_t* pb, int direction, int64_t now_us) {
+    if (!scrub.active) {
+        return;
+    }
+
+    if (direction != scrub.direction) {
+        // A press moves one step at once
+        scrub.direction = direction;
+        scrub.held_since_us = now_us;
+        scrub.travel_us = 0;
+        if (direction) {
+            scrub.cursor = step_from(scrub.cursor, direction);
+            scrub.moved = true;
+        }
+    } else if (direction && now_us - scrub.held_since_us >= SCRUB_REPEAT_US) {
+        int rate = SCRUB_RATE_START;
+        for (int64_t held = now_us - scrub.held_since_us - SCRUB_REPEAT_US; held >= SCRUB_ACCEL_US &&
+             rate < SCRUB_RATE_MAX; held -= SCRUB_ACCEL_US) {
+            rate *= 2;
+        }
+        scrub.travel_us += (now_us - scrub.last_us) * rate;
+        int64_t step_us = (int64_t)scrub.step * pb->frame_duration_us;
+        for (; scrub.travel_us >= step_us; scrub.travel_us -= step_us) {
+            scrub.cursor = step_from(scrub.cursor, direction);
+        }
+    }
+    scrub.last_us = now_us;
+
+    // The preview under the cursor, or else the next one in the direction of travel
+    int wanted = scrub.cursor;
+    preview_t* preview = find_preview(wanted);
+    if (preview) {
+        preview->last_used = ++use_counter;
+        wanted = step_from(scrub.cursor, direction ? direction : 1);
+        preview = find_preview(wanted);
+    }
+    if (!preview) {
+        load_preview(pb, wanted);
+    }
+}
+
+void scrub_draw(uint8_t* fb, int fb_stride, int fb_height, bool rotate) {
+    if (!scrub.active || scrub.cursor == scrub.drawn_cursor) {
+        return;
+    }
+
+    // The full frame on screen stays until the cursor first moves
+    const preview_t* preview = scrub.moved ? find_preview(scrub.cursor) : NULL;
+    if (preview) {
+        mjpeg_draw_reduced_to_framebuffer(preview->pixels, preview->width, preview->height, preview_stride, fb,
+                                          fb_stride, fb_height, rotate);
+    }
+
+    // Screen x runs along the framebuffer rows, screen y across them
+    int bar_x = BAR_MARGIN;
+    int bar_w = fb_height - 2 * BAR_MARGIN;
+    int bar_y = fb_stride - BAR_BOTTOM - BAR_HEIGHT;
+    int last = scrub.frames > 1 ? scrub.frames - 1 : 1;
+    int played = (int)((int64_t)bar_w * scrub.cursor / last);
+    if (!preview && scrub.drawn_cursor >= 0) {
+        // No picture for this frame, the old cursor has to go some other way
+        ui_fill_rect(fb, fb_stride, fb_height, bar_x - CURSOR_WIDTH, bar_y - CURSOR_OVERHANG,
+                     bar_w + 2 * CURSOR_WIDTH, BAR_HEIGHT + 2 * CURSOR_OVERHANG, COLOR_BG);
+    }
+    ui_fill_rect(fb, fb_stride, fb_height, bar_x, bar_y, played, BAR_HEIGHT, COLOR_ACCENT1);
+    ui_fill_rect(fb, fb_stride, fb_height, bar_x + played, bar_y, bar_w - played, BAR_HEIGHT, COLOR_DIM);
+    for (int i = 1; i < chapters_count(); i++) {
+        int tick = (int)((int64_t)bar_w * chapters_frame(i) / last);
+        ui_fill_rect(fb, fb_stride, fb_height, bar_x + tick - CHAPTER_TICK / 2, bar_y, CHAPTER_TICK, BAR_HEIGHT,
+                     COLOR_BG);
+    }
+    ui_fill_rect(fb, fb_stride, fb_height, bar_x + played - CURSOR_WIDTH / 2, bar_y - CURSOR_OVERHANG, CURSOR_WIDTH,
+                 BAR_HEIGHT + 2 * CURSOR_OVERHANG, COLOR_SELECTED);
+    scrub.drawn_cursor = scrub.cursor;
+}
+
+int scrub_end(uint8_t* fb, int fb_stride, int fb_height) {
+    if (scrub.drawn_cursor >= 0) {
+        int bar_y = fb_stride - BAR_BOTTOM - BAR_HEIGHT;
+        ui_fill_rect(fb, fb_stride, fb_height, BAR_MARGIN - CURSOR_WIDTH, bar_y - CURSOR_OVERHANG,
+                     fb_height - 2 * BAR_MARGIN + 2 * CURSOR_WIDTH, BAR_HEIGHT + 2 * CURSOR_OVERHANG, COLOR_BG);
+    }
+    scrub.active = false;
+    ESP_LOGI(TAG, "Scrubbed to frame %d", scrub.cursor);
+    return scrub.cursor;
+}
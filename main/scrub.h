@@ -0,0 +1,39 @@
+// Scrub - seek bar with live previews while up or down is held
+// The cursor moves over the frame index in steps of SCRUB_STEP_MS, faster
+// the longer the key is held. The frame under it is decoded at 1/8 scale and
+// kept in a small LRU of previews, so moving back and forth reads nothing
+// twice. At most one frame is read per update, the one under the cursor or
+// else the next one ahead, so the bar keeps moving however slow the card is
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "playback.h"
+
+#define SCRUB_PREVIEWS          32          // Decoded previews kept, least recently shown dropped first
+#define SCRUB_STEP_MS           1000        // Media time between previews
+#define SCRUB_REPEAT_US         400000      // A press moves one step, holding this long moves continuously
+#define SCRUB_RATE_START        4           // Media seconds per second while moving continuously,
+#define SCRUB_RATE_MAX          64          // doubling every SCRUB_ACCEL_US up to this
+#define SCRUB_ACCEL_US          1000000
+
+// Size the preview cache for a video of width x height and forget the
+// previews of the last one; the memory is kept between videos
+esp_err_t scrub_prepare(int width, int height);
+
+// Stop the playback at the frame on screen and put the cursor there
+// Needs the frame index; the audio is left to the caller to stop
+esp_err_t scrub_begin(playback_t* pb);
+
+bool scrub_active(void);
+
+// Move the cursor for a held key (+1 forward, -1 back) and load a preview
+void scrub_update(playback_t* pb, int direction, int64_t now_us);
+
+// Draw the preview under the cursor and the bar when they changed;
+// rotate as for mjpeg_decoder_decode_to_framebuffer()
+void scrub_draw(uint8_t* fb, int fb_stride, int fb_height, bool rotate);
+
+// Remove the bar and return the frame under the cursor to continue from
+int scrub_end(uint8_t* fb, int fb_stride, int fb_height);
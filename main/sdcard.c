@@ -6,11 +6,16 @@
 #include "sd_pwr_ctrl.h"
 #include "sd_pwr_ctrl_by_on_chip_ldo.h"
 #include "sdmmc_cmd.h"
+#include "diskio_impl.h"
+#include "diskio_sdmmc.h"
+#include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 static const char* TAG = "sdcard";
 static bool mounted = false;
+static sdmmc_card_t* mounted_card = NULL;
 static sd_pwr_ctrl_handle_t pwr_ctrl_handle = NULL;
 
 // DMA buffer in internal RAM (required for SDMMC)
@@ -83,6 +88,7 @@ esp_err_t sdcard_init(void) {
 
     ESP_LOGI(TAG, "SD card mounted successfully");
     sdmmc_card_print_info(stdout, card);
+    mounted_card = card;
     mounted = true;
     return ESP_OK;
 }
@@ -90,3 +96,21 @@ esp_err_t sdcard_init(void) {
 bool sdcard_is_mounted(void) {
     return mounted;
 }
+
+esp_err_t sdcard_get_fatfs_path(const char* vfs_path, char* out, size_t out_size) {
+    if (!mounted || !vfs_path || strncmp(vfs_path, "/sd/", 4) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The FATFS drive number is assigned at mount time
+    BYTE pdrv = ff_diskio_get_pdrv_card(mounted_card);
+    if (pdrv == 0xFF) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int len = snprintf(out, out_size, "%u:%s", (unsigned)pdrv, vfs_path + 3);
+    if (len < 0 || (size_t)len >= out_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 // Initialize SD card power and mount filesystem at /sd
@@ -8,3 +9,7 @@ esp_err_t sdcard_init(void);
 
 // Check if SD card is mounted
 bool sdcard_is_mounted(void);
+
+// Translate a VFS path below /sd (e.g. /sd/apps/x.avi) into a FATFS path
+// (e.g. 0:/apps/x.avi) for direct f_open() calls that bypass the VFS
+esp_err_t sdcard_get_fatfs_path(const char* vfs_path, char* out, size_t out_size);
@@ -0,0 +1,344 @@
+// Storage Benchmark - SD card throughput and latency qualification
+
+#include "storage_bench.h"
+#include "avi_parser.h"
+#include "avi_source.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "storage_bench";
+
+// Largest transfer used by any test
+#define BENCH_BUFFER_SIZE       (1024 * 1024)
+#define BENCH_BUFFER_ALIGN      64
+
+// Sequential test: bytes per block size and time limit per block size
+#define SEQ_SMALL_BYTES         (1024 * 1024)       // Blocks up to 4 KB
+#define SEQ_LARGE_BYTES         (4 * 1024 * 1024)   // Larger blocks
+#define SEQ_TIME_LIMIT_US       2000000
+
+// Random test
+#define RAND_READ_SIZE          4096
+#define RAND_READ_COUNT         256
+
+// Sustained file reads
+#define STDIO_BLOCK_SIZE        (32 * 1024)
+#define DIRECT_BLOCK_SIZE       (256 * 1024)
+
+// Reading shares the frame budget with decode and blit, so only this share
+// of the measured throughput counts as available for the stream
+#define SUSTAIN_MARGIN_PCT      75
+
+// Fall back to this rate when the AVI header carries no fps
+#define DEFAULT_FPS             30
+
+static void report_progress(storage_bench_progress_cb_t progress, void* arg, const char* fmt, const char* name) {
+    if (!progress) return;
+    char msg[80];
+    snprintf(msg, sizeof(msg), fmt, name);
+    progress(msg, arg);
+}
+
+static const char* base_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static float mb_per_s(uint64_t bytes, int64_t us) {
+    if (us <= 0) return 0.0f;
+    return (bytes / (1024.0f * 1024.0f)) / (us / 1000000.0f);
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Sequential direct reads at each block size
+static void run_sequential(avi_source_t* src, uint8_t* buffer, storage_bench_report_t* report) {
+    for (int i = 0; i < STORAGE_BENCH_BLOCK_SIZES; i++) {
+        size_t block = (size_t)AVI_SOURCE_SECTOR_SIZE << i;
+        size_t budget = block <= 4096 ? SEQ_SMALL_BYTES : SEQ_LARGE_BYTES;
+        if (budget > src->size) budget = src->size & ~(block - 1);
+        report->block_size[i] = block;
+        report->seq_mb_s[i] = 0.0f;
+        if (budget < block) continue;
+
+        // Start each block size somewhere else so card-side caching doesn't help
+        size_t span = src->size - budget;
+        size_t start = span > 0 ? ((size_t)i * SEQ_LARGE_BYTES) % span : 0;
+        start &= ~(block - 1);
+
+        uint64_t done = 0;
+        int64_t t0 = esp_timer_get_time();
+        int64_t elapsed = 0;
+        while (done < budget && elapsed < SEQ_TIME_LIMIT_US) {
+            if (src->ops->read_sectors(src, start + done, buffer, block) != block) break;
+            done += block;
+            elapsed = esp_timer_get_time() - t0;
+        }
+        report->seq_mb_s[i] = mb_per_s(done, elapsed);
+    }
+}
+
+// Random 4 KB direct reads, latency percentiles
+static void run_random(avi_source_t* src, uint8_t* buffer, storage_bench_report_t* report) {
+    uint32_t* latency = malloc(RAND_READ_COUNT * sizeof(uint32_t));
+    if (!latency || src->size < RAND_READ_SIZE) {
+        free(latency);
+        return;
+    }
+
+    size_t sectors = (src->size - RAND_READ_SIZE) / AVI_SOURCE_SECTOR_SIZE;
+    uint32_t seed = 0x2A2A2A2A;  // Fixed seed keeps runs comparable
+    int64_t total_us = 0;
+    int count = 0;
+
+    for (int i = 0; i < RAND_READ_COUNT; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        size_t offset = (size_t)(seed % (sectors + 1)) * AVI_SOURCE_SECTOR_SIZE;
+
+        int64_t t0 = esp_timer_get_time();
+        size_t got = src->ops->read_sectors(src, offset, buffer, RAND_READ_SIZE);
+        int64_t dt = esp_timer_get_time() - t0;
+        if (got != RAND_READ_SIZE) break;
+
+        latency[count++] = (uint32_t)dt;
+        total_us += dt;
+    }
+
+    if (count > 0) {
+        qsort(latency, count, sizeof(uint32_t), compare_u32);
+        report->rand_p50_us = latency[(count * 50) / 100];
+        report->rand_p90_us = latency[(count * 90) / 100];
+        report->rand_p99_us = latency[(count * 99) / 100];
+        report->rand_max_us = latency[count - 1];
+        report->rand_iops = total_us > 0 ? count * 1000000.0f / total_us : 0.0f;
+    }
+    free(latency);
+}
+
+// Sustained stdio (fastopen) read of a whole file
+static float run_stdio(const char* path, uint8_t* buffer, size_t max_bytes) {
+    avi_source_t src;
+    if (avi_source_open_file(&src, path) != ESP_OK) return 0.0f;
+
+    size_t limit = (max_bytes && max_bytes < src.size) ? max_bytes : src.size;
+    uint64_t done = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (done < limit) {
+        size_t n = limit - done < STDIO_BLOCK_SIZE ? limit - done : STDIO_BLOCK_SIZE;
+        if (!avi_source_read(&src, done, buffer, n)) break;
+        done += n;
+    }
+    float result = mb_per_s(done, esp_timer_get_time() - t0);
+    avi_source_close(&src);
+    return result;
+}
+
+// Sustained direct sector read of a whole file
+static float run_direct(const char* path, uint8_t* buffer, size_t max_bytes) {
+    avi_source_t src;
+    if (avi_source_open_direct(&src, path) != ESP_OK) return 0.0f;
+
+    size_t limit = (max_bytes && max_bytes < src.size) ? max_bytes : src.size;
+    uint64_t done = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (done < limit) {
+        size_t n = DIRECT_BLOCK_SIZE;
+        size_t got = src.ops->read_sectors(&src, done, buffer, n);
+        done += got;
+        if (got != n) break;
+    }
+    float result = mb_per_s(done, esp_timer_get_time() - t0);
+    avi_source_close(&src);
+    return result;
+}
+
+// Average and peak (1-second window) bitrate, counting the bytes on disk
+// Files from avi_remux carry peak tables over 2^i frames that include the
+// alignment padding: the longest window up to one second is scaled to a
+// second. Others are walked chunk by chunk, each frame slot charged with
+// everything since the previous video chunk (audio, padding, other streams)
+static bool measure_bitrate(const char* path, storage_bench_file_t* file) {
+    avi_source_t src;
+    if (avi_source_open_direct(&src, path) != ESP_OK) return false;
+
+    avi_parser_t parser;
+    if (avi_parser_open_source(&parser, &src) != ESP_OK) return false;
+
+    const avi_info_t* info = avi_parser_get_info(&parser);
+    uint32_t rate = info->video_rate;
+    uint32_t scale = info->video_scale;
+    if (rate == 0 || scale == 0) {
+        rate = info->fps > 0 ? info->fps : DEFAULT_FPS;
+        scale = 1;
+    }
+    uint64_t total = parser.movi_end - parser.movi_start;
+    uint32_t frames = 0;
+    uint64_t peak_kbps = 0;
+
+    if (info->has_playback_info && info->playback.frame_count > 0) {
+        int w = 0;
+        while (w + 1 < AVI_PEAK_WINDOWS && ((uint64_t)scale << (w + 1)) <= rate) {
+            w++;
+        }
+        frames = info->playback.frame_count;
+        peak_kbps = (uint64_t)info->playback.peak_bytes[w] * 8 * rate / ((uint64_t)scale << w) / 1000;
+    } else {
+        // Frame slots in one second, rounded up so 29.97 fps counts 30
+        int slots = (int)((rate + scale - 1) / scale);
+        uint32_t* window = calloc(slots > 0 ? slots : 1, sizeof(uint32_t));
+        if (!window) {
+            avi_parser_close(&parser);
+            return false;
+        }
+
+        uint64_t window_sum = 0;
+        uint64_t peak = 0;
+        size_t counted_to = parser.movi_start;
+
+        avi_chunk_t chunk;
+        while (avi_parser_next_header(&parser, &chunk) == ESP_OK) {
+            if (chunk.type != AVI_CHUNK_VIDEO) continue;
+
+            size_t end = chunk.offset + chunk.size;
+            uint32_t bytes = (uint32_t)(end - counted_to);
+            counted_to = end;
+
+            int slot = frames % slots;
+            window_sum -= window[slot];
+            window[slot] = bytes;
+            window_sum += bytes;
+            frames++;
+            if (window_sum > peak) peak = window_sum;
+        }
+        free(window);
+        peak_kbps = peak * 8 / 1000;
+    }
+    avi_parser_close(&parser);
+
+    if (frames == 0) return false;
+
+    uint64_t duration_ms = (uint64_t)frames * scale * 1000 / rate;
+    file->avg_kbps = (uint32_t)(total * 8 / (duration_ms > 0 ? duration_ms : 1));
+    file->peak_kbps = (uint32_t)peak_kbps;
+    return true;
+}
+
+esp_err_t storage_bench_run(const char* const* paths, int count, size_t max_bytes_per_file,
+                            storage_bench_report_t* report, storage_bench_progress_cb_t progress, void* arg) {
+    if (!paths || count <= 0 || !report) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(report, 0, sizeof(storage_bench_report_t));
+    if (count > STORAGE_BENCH_MAX_FILES) count = STORAGE_BENCH_MAX_FILES;
+
+    uint8_t* buffer = heap_caps_aligned_alloc(BENCH_BUFFER_ALIGN, BENCH_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+    if (!buffer) {
+        ESP_LOGE(TAG, "Failed to allocate %d byte benchmark buffer", BENCH_BUFFER_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Pick the largest file for the raw card tests
+    int largest = -1;
+    size_t largest_size = 0;
+    for (int i = 0; i < count; i++) {
+        avi_source_t src;
+        if (avi_source_open_direct(&src, paths[i]) != ESP_OK) continue;
+        if (src.size > largest_size) {
+            largest_size = src.size;
+            largest = i;
+        }
+        avi_source_close(&src);
+    }
+
+    if (largest < 0) {
+        heap_caps_aligned_free(buffer);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    avi_source_t src;
+    if (avi_source_open_direct(&src, paths[largest]) == ESP_OK) {
+        report_progress(progress, arg, "Sequential reads: %s", base_name(paths[largest]));
+        run_sequential(&src, buffer, report);
+        report_progress(progress, arg, "Random 4 KB reads: %s", base_name(paths[largest]));
+        run_random(&src, buffer, report);
+        avi_source_close(&src);
+    }
+
+    // Sustained reads and bitrate needs per clip
+    for (int i = 0; i < count; i++) {
+        storage_bench_file_t* file = &report->files[report->file_count++];
+        strncpy(file->name, base_name(paths[i]), sizeof(file->name) - 1);
+
+        report_progress(progress, arg, "Reading %s", file->name);
+        file->stdio_mb_s = run_stdio(paths[i], buffer, max_bytes_per_file);
+        file->direct_mb_s = run_direct(paths[i], buffer, max_bytes_per_file);
+        file->valid = measure_bitrate(paths[i], file);
+
+        float available_kbps = file->direct_mb_s * 1024.0f * 1024.0f * 8.0f / 1000.0f * SUSTAIN_MARGIN_PCT / 100.0f;
+        file->sustainable = file->valid && file->peak_kbps <= available_kbps;
+        if (file->valid && !file->sustainable) {
+            report->unsustainable_count++;
+        }
+    }
+
+    heap_caps_aligned_free(buffer);
+    return ESP_OK;
+}
+
+int storage_bench_format(const storage_bench_report_t* report, char lines[][STORAGE_BENCH_LINE_LEN], int max_lines) {
+    int n = 0;
+
+    // Sequential results, three block sizes per line
+    for (int i = 0; i < STORAGE_BENCH_BLOCK_SIZES && n < max_lines; i += 3) {
+        int len = snprintf(lines[n], STORAGE_BENCH_LINE_LEN, "Seq");
+        for (int j = i; j < i + 3 && j < STORAGE_BENCH_BLOCK_SIZES; j++) {
+            size_t bs = report->block_size[j];
+            len += snprintf(lines[n] + len, STORAGE_BENCH_LINE_LEN - len, "  %4zu%s %5.1f MB/s",
+                            bs >= 1024 ? bs / 1024 : bs, bs >= 1024 ? "K" : "B", report->seq_mb_s[j]);
+        }
+        n++;
+    }
+
+    if (n < max_lines) {
+        snprintf(lines[n++], STORAGE_BENCH_LINE_LEN, "Rand 4K: p50 %lu us  p90 %lu us  p99 %lu us  max %lu us  (%.0f IOPS)",
+                 (unsigned long)report->rand_p50_us, (unsigned long)report->rand_p90_us,
+                 (unsigned long)report->rand_p99_us, (unsigned long)report->rand_max_us, report->rand_iops);
+    }
+
+    for (int i = 0; i < report->file_count && n < max_lines; i++) {
+        const storage_bench_file_t* f = &report->files[i];
+        if (!f->valid) {
+            snprintf(lines[n++], STORAGE_BENCH_LINE_LEN, "%s: not a playable AVI", f->name);
+            continue;
+        }
+        snprintf(lines[n++], STORAGE_BENCH_LINE_LEN, "%s %s: stdio %.1f direct %.1f MB/s, needs %lu/%lu kbps",
+                 f->sustainable ? "OK  " : "SLOW", f->name, f->stdio_mb_s, f->direct_mb_s,
+                 (unsigned long)f->avg_kbps, (unsigned long)f->peak_kbps);
+    }
+
+    return n;
+}
+
+void storage_bench_log(const storage_bench_report_t* report) {
+    char lines[6 + STORAGE_BENCH_MAX_FILES][STORAGE_BENCH_LINE_LEN];
+    int n = storage_bench_format(report, lines, 6 + STORAGE_BENCH_MAX_FILES);
+    for (int i = 0; i < n; i++) {
+        ESP_LOGI(TAG, "%s", lines[i]);
+    }
+
+    for (int i = 0; i < report->file_count; i++) {
+        const storage_bench_file_t* f = &report->files[i];
+        if (f->valid && !f->sustainable) {
+            ESP_LOGW(TAG, "Card cannot sustain %s: peak %lu kbps vs %.0f kbps usable", f->name,
+                     (unsigned long)f->peak_kbps, f->direct_mb_s * 8388.608f * SUSTAIN_MARGIN_PCT / 100.0f);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+// Storage Benchmark - SD card throughput and latency qualification
+// Runs on the badge (menu) and on the host (host/build/sdbench)
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define STORAGE_BENCH_BLOCK_SIZES   12      // 512 B .. 1 MB, powers of two
+#define STORAGE_BENCH_MAX_FILES     16
+#define STORAGE_BENCH_LINE_LEN      96
+
+// Result for one clip
+typedef struct {
+    char name[32];
+    bool valid;                 // AVI parsed successfully
+    float stdio_mb_s;           // Sustained read through fastopen()
+    float direct_mb_s;          // Sustained read through direct sector reads
+    uint32_t avg_kbps;          // Average bitrate the clip needs
+    uint32_t peak_kbps;         // Highest 1-second window bitrate
+    bool sustainable;           // Card keeps up with the peak (with margin)
+} storage_bench_file_t;
+
+// Full benchmark report
+typedef struct {
+    size_t block_size[STORAGE_BENCH_BLOCK_SIZES];
+    float seq_mb_s[STORAGE_BENCH_BLOCK_SIZES];  // Sequential direct reads per block size
+    uint32_t rand_p50_us;       // Random 4 KB read latency percentiles
+    uint32_t rand_p90_us;
+    uint32_t rand_p99_us;
+    uint32_t rand_max_us;
+    float rand_iops;
+    storage_bench_file_t files[STORAGE_BENCH_MAX_FILES];
+    int file_count;
+    int unsustainable_count;
+} storage_bench_report_t;
+
+// Progress callback (message for the UI, may be NULL)
+typedef void (*storage_bench_progress_cb_t)(const char* message, void* arg);
+
+// Run the benchmark over the given AVI files
+// Sequential and random tests use the largest file
+// max_bytes_per_file caps the sustained reads (0 = whole file)
+esp_err_t storage_bench_run(const char* const* paths, int count, size_t max_bytes_per_file,
+                            storage_bench_report_t* report, storage_bench_progress_cb_t progress, void* arg);
+
+// Format report as text lines, returns number of lines written
+int storage_bench_format(const storage_bench_report_t* report, char lines[][STORAGE_BENCH_LINE_LEN], int max_lines);
+
+// Print report via ESP_LOGI / ESP_LOGW
+void storage_bench_log(const storage_bench_report_t* report);
@@ -0,0 +1,653 @@
+// Software JPEG - baseline JPEG decoder split into restart-interval strips
+
+#include "sw_jpeg.h"
+#include <string.h>
+
+const uint8_t sw_jpeg_zigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Standard tables (ITU T.81 Annex K.3) for MJPEG frames that omit DHT
+static const uint8_t std_dc_luma_bits[17] = {0, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t std_dc_chroma_bits[17] = {0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t std_dc_symbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t std_ac_luma_bits[17] = {0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t std_ac_luma_symbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t std_ac_chroma_bits[17] = {0, 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t std_ac_chroma_symbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+// Build decoding tables from bits/symbols, false if the code lengths overflow
+static bool build_huffman(sw_jpeg_huffman_t* h, const uint8_t bits[17], const uint8_t* symbols) {
+    int total = 0;
+    for (int l = 1; l <= 16; l++) total += bits[l];
+    if (total > 256) return false;
+
+    memcpy(h->bits, bits, 17);
+    memcpy(h->symbols, symbols, total);
+    memset(h->lookup, 0, sizeof(h->lookup));
+
+    int code = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+        h->valptr[l] = k;
+        h->mincode[l] = code;
+        for (int i = 0; i < bits[l]; i++, k++, code++) {
+            if (l <= 9) {
+                int shift = 9 - l;
+                for (int j = 0; j < (1 << shift); j++) {
+                    h->lookup[(code << shift) | j] = (uint16_t)((l << 8) | h->symbols[k]);
+                }
+            }
+        }
+        if (code > (1 << l)) return false;
+        h->maxcode[l] = bits[l] ? code - 1 : -1;
+        code <<= 1;
+    }
+    h->maxcode[17] = 0x7FFFFFFF;
+    h->present = true;
+    return true;
+}
+
+// --- Entropy decoding ---
+
+static inline uint32_t next_byte(sw_jpeg_bits_t* b) {
+    if (b->marker || b->p >= b->end) return 0;
+    uint32_t byte = *b->p++;
+    if (byte == 0xFF) {
+        uint8_t next = b->p < b->end ? *b->p : 0xD9;
+        if (next == 0) {
+            b->p++;                 // Stuffed zero
+        } else {
+            b->p--;                 // Leave the marker for sw_jpeg_bits_restart
+            b->marker = true;
+            return 0;
+        }
+    }
+    return byte;
+}
+
+static inline void fill(sw_jpeg_bits_t* b) {
+    while (b->count <= 24) {
+        b->bits |= next_byte(b) << (24 - b->count);
+        b->count += 8;
+    }
+}
+
+static inline int get_bits(sw_jpeg_bits_t* b, int n) {
+    fill(b);
+    int v = (int)(b->bits >> (32 - n));
+    b->bits <<= n;
+    b->count -= n;
+    return v;
+}
+
+// Read an n-bit magnitude and sign-extend it (T.81 F.2.2.1 EXTEND)
+static inline int receive_extend(sw_jpeg_bits_t* b, int n) {
+    int v = get_bits(b, n);
+    return v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+}
+
+static inline int decode_huffman(sw_jpeg_bits_t* b, const sw_jpeg_huffman_t* h) {
+    fill(b);
+    uint16_t e = h->lookup[b->bits >> 23];
+    if (e) {
+        int len = e >> 8;
+        b->bits <<= len;
+        b->count -= len;
+        return e & 0xFF;
+    }
+    for (int l = 10; l <= 16; l++) {
+        int code = (int)(b->bits >> (32 - l));
+        if (code <= h->maxcode[l]) {
+            b->bits <<= l;
+            b->count -= l;
+            return h->symbols[h->valptr[l] + code - h->mincode[l]];
+        }
+    }
+    return -1;  // Corrupt data
+}
+
+void sw_jpeg_bits_init(sw_jpeg_bits_t* bits, const uint8_t* data, const uint8_t* end) {
+    bits->p = data;
+    bits->end = end;
+    bits->bits = 0;
+    bits->count = 0;
+    bits->marker = false;
+}
+
+void sw_jpeg_bits_restart(sw_jpeg_bits_t* bits) {
+    const uint8_t* p = bits->p;
+    while (p + 1 < bits->end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) p++;
+    sw_jpeg_bits_init(bits, p + 1 < bits->end ? p + 2 : bits->end, bits->end);
+}
+
+// Decode one block; q = NULL gives raw zigzag coefficients, otherwise
+// dequantized ones in natural order. Returns the last coefficient index, -1 on error
+static inline int decode_block(const sw_jpeg_t* jpeg, sw_jpeg_bits_t* b, int c, int* dc_pred, int16_t* out,
+                               const uint16_t* q) {
+    const sw_jpeg_component_t* comp = &jpeg->comp[c];
+
+    int s = decode_huffman(b, &jpeg->dc[comp->dc_table]);
+    if (s < 0 || s > 11) return -1;
+    *dc_pred += s ? receive_extend(b, s) : 0;
+    out[0] = (int16_t)(q ? *dc_pred * q[0] : *dc_pred);
+
+    const sw_jpeg_huffman_t* ac = &jpeg->ac[comp->ac_table];
+    int last = 0;
+    for (int k = 1; k < 64; k++) {
+        int rs = decode_huffman(b, ac);
+        if (rs < 0) return -1;
+        int r = rs >> 4;
+        s = rs & 15;
+        if (s == 0) {
+            if (r != 15) break;     // End of block
+            k += 15;                // Run of 16 zeros
+            continue;
+        }
+        k += r;
+        if (k > 63) return -1;
+        int v = receive_extend(b, s);
+        if (q) {
+            out[sw_jpeg_zigzag[k]] = (int16_t)(v * q[k]);
+        } else {
+            out[k] = (int16_t)v;
+        }
+        last = k;
+    }
+    return last;
+}
+
+bool sw_jpeg_decode_coefficients(const sw_jpeg_t* jpeg, sw_jpeg_bits_t* bits, int c, int* dc_pred,
+                                 int16_t coef[64]) {
+    memset(coef, 0, 64 * sizeof(int16_t));
+    return decode_block(jpeg, bits, c, dc_pred, coef, NULL) >= 0;
+}
+
+// --- Inverse DCT ---
+
+// Integer LLM IDCT (the libjpeg "islow" algorithm), 12-bit fixed point constants
+#define FIX(x) ((int)((x) * 4096 + 0.5))
+
+#define IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7)         \
+    int p1 = ((s2) + (s6)) * FIX(0.5411961);            \
+    int t2 = p1 + (s6) * -FIX(1.847759065);             \
+    int t3 = p1 + (s2) * FIX(0.765366865);              \
+    int t0 = ((s0) + (s4)) * 4096;                      \
+    int t1 = ((s0) - (s4)) * 4096;                      \
+    int x0 = t0 + t3, x3 = t0 - t3;                     \
+    int x1 = t1 + t2, x2 = t1 - t2;                     \
+    t0 = (s7);                                          \
+    t1 = (s5);                                          \
+    t2 = (s3);                                          \
+    t3 = (s1);                                          \
+    int p3 = t0 + t2, p4 = t1 + t3;                     \
+    p1 = t0 + t3;                                       \
+    int p2 = t1 + t2;                                   \
+    int p5 = (p3 + p4) * FIX(1.175875602);              \
+    t0 *= FIX(0.298631336);                             \
+    t1 *= FIX(2.053119869);                             \
+    t2 *= FIX(3.072711026);                             \
+    t3 *= FIX(1.501321110);                             \
+    p1 = p5 + p1 * -FIX(0.899976223);                   \
+    p2 = p5 + p2 * -FIX(2.562915447);                   \
+    p3 *= -FIX(1.961570560);                            \
+    p4 *= -FIX(0.390180644);                            \
+    t3 += p1 + p4;                                      \
+    t2 += p2 + p3;                                      \
+    t1 += p2 + p4;                                      \
+    t0 += p1 + p3;
+
+static inline uint8_t clamp8(int v) {
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+// Transform dequantized coefficients (natural order) into 8x8 pixels at out
+static void idct_block(const int16_t* in, uint8_t* out, int stride) {
+    int tmp[64];
+
+    // Columns, with a shortcut for the common all-zero AC column
+    for (int i = 0; i < 8; i++) {
+        const int16_t* d = in + i;
+        int* v = tmp + i;
+        if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0) {
+            int dc = d[0] * 4;
+            for (int k = 0; k < 64; k += 8) v[k] = dc;
+            continue;
+        }
+        IDCT_1D(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56])
+        x0 += 512;
+        x1 += 512;
+        x2 += 512;
+        x3 += 512;
+        v[0] = (x0 + t3) >> 10;
+        v[56] = (x0 - t3) >> 10;
+        v[8] = (x1 + t2) >> 10;
+        v[48] = (x1 - t2) >> 10;
+        v[16] = (x2 + t1) >> 10;
+        v[40] = (x2 - t1) >> 10;
+        v[24] = (x3 + t0) >> 10;
+        v[32] = (x3 - t0) >> 10;
+    }
+
+    // Rows, folding in the +128 level shift and rounding
+    for (int i = 0; i < 8; i++, out += stride) {
+        const int* v = tmp + i * 8;
+        IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+        int bias = 65536 + (128 << 17);
+        x0 += bias;
+        x1 += bias;
+        x2 += bias;
+        x3 += bias;
+        out[0] = clamp8((x0 + t3) >> 17);
+        out[7] = clamp8((x0 - t3) >> 17);
+        out[1] = clamp8((x1 + t2) >> 17);
+        out[6] = clamp8((x1 - t2) >> 17);
+        out[2] = clamp8((x2 + t1) >> 17);
+        out[5] = clamp8((x2 - t1) >> 17);
+        out[3] = clamp8((x3 + t0) >> 17);
+        out[4] = clamp8((x3 - t0) >> 17);
+    }
+}
+
+// DC-only block: one flat value
+static void fill_block(int dc, uint8_t* out, int stride) {
+    uint8_t v = clamp8(((dc + 4) >> 3) + 128);
+    for (int y = 0; y < 8; y++, out += stride) memset(out, v, 8);
+}
+
+// --- Headers ---
+
+static inline uint16_t be16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static esp_err_t parse_dqt(sw_jpeg_t* jpeg, const uint8_t* p, size_t len, uint8_t* present) {
+    while (len > 0) {
+        int precision = p[0] >> 4;
+        int id = p[0] & 3;
+        size_t n = 1 + 64 * (precision ? 2 : 1);
+        if (len < n) return ESP_ERR_INVALID_SIZE;
+        for (int i = 0; i < 64; i++) {
+            jpeg->quant[id][i] = precision ? be16(p + 1 + i * 2) : p[1 + i];
+        }
+        *present |= 1 << id;
+        p += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_dht(sw_jpeg_t* jpeg, const uint8_t* p, size_t len) {
+    while (len >= 17) {
+        int cls = p[0] >> 4;
+        int id = p[0] & 3;
+        uint8_t bits[17] = {0};
+        size_t total = 0;
+        for (int l = 1; l <= 16; l++) {
+            bits[l] = p[l];
+            total += bits[l];
+        }
+        if (cls > 1 || len < 17 + total) return ESP_ERR_INVALID_SIZE;
+        sw_jpeg_huffman_t* h = cls ? &jpeg->ac[id] : &jpeg->dc[id];
+        if (!build_huffman(h, bits, p + 17)) return ESP_ERR_INVALID_ARG;
+        p += 17 + total;
+        len -= 17 + total;
+    }
+    return len == 0 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+static esp_err_t parse_sof(sw_jpeg_t* jpeg, const uint8_t* p, size_t len) {
+    if (len < 6 || p[0] != 8) return ESP_ERR_NOT_SUPPORTED;  // 8-bit samples only
+    jpeg->height = be16(p + 1);
+    jpeg->width = be16(p + 3);
+    jpeg->components = p[5];
+    if (jpeg->width == 0 || jpeg->height == 0) return ESP_ERR_NOT_SUPPORTED;  // DNL not supported
+    if ((jpeg->components != 1 && jpeg->components != 3) || len < 6 + 3u * jpeg->components) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    jpeg->h_max = jpeg->v_max = 1;
+    for (int c = 0; c < jpeg->components; c++) {
+        sw_jpeg_component_t* comp = &jpeg->comp[c];
+        comp->id = p[6 + c * 3];
+        comp->h = p[7 + c * 3] >> 4;
+        comp->v = p[7 + c * 3] & 15;
+        comp->quant = p[8 + c * 3] & 3;
+        if (comp->h < 1 || comp->h > 2 || comp->v < 1 || comp->v > 2) return ESP_ERR_NOT_SUPPORTED;
+        if (comp->h > jpeg->h_max) jpeg->h_max = comp->h;
+        if (comp->v > jpeg->v_max) jpeg->v_max = comp->v;
+    }
+
+    // Luma must carry the highest sampling factors (true for every common layout)
+    if (jpeg->comp[0].h != jpeg->h_max || jpeg->comp[0].v != jpeg->v_max) return ESP_ERR_NOT_SUPPORTED;
+
+    // A single-component scan is never interleaved: one block per MCU
+    if (jpeg->components == 1) {
+        jpeg->comp[0].h = jpeg->comp[0].v = 1;
+        jpeg->h_max = jpeg->v_max = 1;
+    }
+    jpeg->mcus_x = (jpeg->width + 8 * jpeg->h_max - 1) / (8 * jpeg->h_max);
+    jpeg->mcus_y = (jpeg->height + 8 * jpeg->v_max - 1) / (8 * jpeg->v_max);
+    return ESP_OK;
+}
+
+static esp_err_t parse_sos(sw_jpeg_t* jpeg, const uint8_t* p, size_t len) {
+    if (jpeg->components == 0) return ESP_ERR_INVALID_STATE;  // No SOF yet
+    int count = p[0];
+    if (count != jpeg->components || len < 4 + 2u * count) return ESP_ERR_NOT_SUPPORTED;
+    for (int i = 0; i < count; i++) {
+        int c = 0;
+        while (c < jpeg->components && jpeg->comp[c].id != p[1 + i * 2]) c++;
+        if (c == jpeg->components) return ESP_ERR_INVALID_ARG;
+        jpeg->comp[c].dc_table = p[2 + i * 2] >> 4 & 3;
+        jpeg->comp[c].ac_table = p[2 + i * 2] & 3;
+    }
+    return ESP_OK;
+}
+
+// Record where each restart interval starts; when there are more intervals
+// than strips, every other strip is dropped and the spacing doubles
+static void find_strips(sw_jpeg_t* jpeg) {
+    jpeg->strips[0] = (sw_jpeg_strip_t){0, 0};
+    jpeg->strip_count = 1;
+
+    const uint8_t* scan = jpeg->scan;
+    size_t size = jpeg->scan_size;
+    uint32_t total = (uint32_t)jpeg->mcus_x * jpeg->mcus_y;
+    uint32_t interval = 0;
+    uint32_t spacing = 1;
+    size_t i = 0;
+    while (i + 1 < size) {
+        const uint8_t* ff = memchr(scan + i, 0xFF, size - i - 1);
+        if (!ff) break;
+        i = ff - scan;
+        uint8_t m = scan[i + 1];
+        if (m == 0x00 || m == 0xFF) {
+            i += 1 + (m == 0x00);
+            continue;
+        }
+        if (m < 0xD0 || m > 0xD7) {
+            jpeg->scan_size = i;    // EOI or another marker ends the scan
+            break;
+        }
+
+        i += 2;
+        interval++;
+        uint32_t first_mcu = interval * jpeg->restart_interval;
+        if (!jpeg->restart_interval || first_mcu >= total || interval % spacing != 0) continue;
+
+        if (jpeg->strip_count == SW_JPEG_MAX_STRIPS) {
+            for (uint32_t s = 0; s < SW_JPEG_MAX_STRIPS / 2; s++) jpeg->strips[s] = jpeg->strips[s * 2];
+            jpeg->strip_count = SW_JPEG_MAX_STRIPS / 2;
+            spacing *= 2;
+            if (interval % spacing != 0) continue;
+        }
+        jpeg->strips[jpeg->strip_count++] = (sw_jpeg_strip_t){(uint32_t)i, first_mcu};
+    }
+}
+
+esp_err_t sw_jpeg_parse(sw_jpeg_t* jpeg, const uint8_t* data, size_t size) {
+    memset(jpeg, 0, sizeof(sw_jpeg_t));
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return ESP_ERR_INVALID_ARG;
+
+    bool have_sof = false;
+    uint8_t quant_present = 0;
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            pos++;                  // Garbage between segments
+            continue;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;                  // Fill byte
+            continue;
+        }
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xD9) return ESP_ERR_INVALID_SIZE;  // EOI before any scan
+
+        size_t len = be16(data + pos + 2);
+        if (len < 2 || pos + 2 + len > size) return ESP_ERR_INVALID_SIZE;
+        const uint8_t* p = data + pos + 4;
+        len -= 2;
+
+        esp_err_t ret = ESP_OK;
+        switch (marker) {
+            case 0xC0:
+            case 0xC1:
+                ret = parse_sof(jpeg, p, len);
+                have_sof = true;
+                break;
+            case 0xC4:
+                ret = parse_dht(jpeg, p, len);
+                break;
+            case 0xDB:
+                ret = parse_dqt(jpeg, p, len, &quant_present);
+                break;
+            case 0xDD:
+                if (len < 2) return ESP_ERR_INVALID_SIZE;
+                jpeg->restart_interval = be16(p);
+                break;
+            case 0xDA:
+                if (!have_sof) return ESP_ERR_INVALID_STATE;
+                ret = parse_sos(jpeg, p, len);
+                if (ret != ESP_OK) return ret;
+                jpeg->scan = p + len;
+                jpeg->scan_size = size - (pos + 4 + len);
+                break;
+            default:
+                // Progressive, lossless, hierarchical and arithmetic-coded frames
+                if ((marker >= 0xC2 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                break;  // APPn, COM: skip
+        }
+        if (ret != ESP_OK) return ret;
+        if (jpeg->scan) break;
+        pos += 4 + len;
+    }
+    if (!jpeg->scan) return ESP_ERR_INVALID_SIZE;
+
+    // MJPEG streams may leave out DHT and rely on the standard tables
+    if (!jpeg->dc[0].present) build_huffman(&jpeg->dc[0], std_dc_luma_bits, std_dc_symbols);
+    if (!jpeg->dc[1].present) build_huffman(&jpeg->dc[1], std_dc_chroma_bits, std_dc_symbols);
+    if (!jpeg->ac[0].present) build_huffman(&jpeg->ac[0], std_ac_luma_bits, std_ac_luma_symbols);
+    if (!jpeg->ac[1].present) build_huffman(&jpeg->ac[1], std_ac_chroma_bits, std_ac_chroma_symbols);
+
+    for (int c = 0; c < jpeg->components; c++) {
+        const sw_jpeg_component_t* comp = &jpeg->comp[c];
+        if (!(quant_present & (1 << comp->quant)) || !jpeg->dc[comp->dc_table].present ||
+            !jpeg->ac[comp->ac_table].present) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    find_strips(jpeg);
+    return ESP_OK;
+}
+
+// --- Strip decoding ---
+
+static inline void ycc_to_bgr(uint8_t* dst, int Y, int cb, int cr) {
+    dst[0] = clamp8(Y + ((116130 * cb + 32768) >> 16));                // B = Y + 1.772 Cb
+    dst[1] = clamp8(Y - ((22554 * cb + 46802 * cr - 32768) >> 16));    // G = Y - 0.344 Cb - 0.714 Cr
+    dst[2] = clamp8(Y + ((91881 * cr + 32768) >> 16));                 // R = Y + 1.402 Cr
+}
+
+// Convert one MCU's planes to BGR at its place in the output
+static void write_mcu(const sw_jpeg_t* jpeg, uint8_t planes[SW_JPEG_MAX_COMPONENTS][256], uint32_t mcu,
+                      const sw_jpeg_output_t* out) {
+    int mcu_w = 8 * jpeg->h_max;
+    int mcu_h = 8 * jpeg->v_max;
+    int x0 = (mcu % jpeg->mcus_x) * mcu_w;
+    int y0 = (mcu / jpeg->mcus_x) * mcu_h;
+    int w = jpeg->width - x0 < mcu_w ? jpeg->width - x0 : mcu_w;
+    int h = jpeg->height - y0 < mcu_h ? jpeg->height - y0 : mcu_h;
+
+    uint8_t* row = out->origin + (intptr_t)x0 * out->x_step + (intptr_t)y0 * out->y_step;
+    const uint8_t* luma = planes[0];
+
+    if (jpeg->components == 1) {
+        for (int y = 0; y < h; y++, row += out->y_step) {
+            uint8_t* dst = row;
+            for (int x = 0; x < w; x++, dst += out->x_step) {
+                dst[0] = dst[1] = dst[2] = luma[y * 8 + x];
+            }
+        }
+        return;
+    }
+
+    // Chroma planes are mcu_w/h_shift wide; subsampled ones are sampled at half rate
+    int cb_hs = jpeg->comp[1].h < jpeg->h_max, cb_vs = jpeg->comp[1].v < jpeg->v_max;
+    int cr_hs = jpeg->comp[2].h < jpeg->h_max, cr_vs = jpeg->comp[2].v < jpeg->v_max;
+    int cb_stride = 8 * jpeg->comp[1].h, cr_stride = 8 * jpeg->comp[2].h;
+
+    for (int y = 0; y < h; y++, row += out->y_step) {
+        const uint8_t* yrow = luma + y * mcu_w;
+        const uint8_t* cbrow = planes[1] + (y >> cb_vs) * cb_stride;
+        const uint8_t* crrow = planes[2] + (y >> cr_vs) * cr_stride;
+        uint8_t* dst = row;
+        for (int x = 0; x < w; x++, dst += out->x_step) {
+            ycc_to_bgr(dst, yrow[x], cbrow[x >> cb_hs] - 128, crrow[x >> cr_hs] - 128);
+        }
+    }
+}
+
+esp_err_t sw_jpeg_decode_strips(const sw_jpeg_t* jpeg, uint32_t first, uint32_t count, const sw_jpeg_output_t* out) {
+    if (first + count > jpeg->strip_count) return ESP_ERR_INVALID_ARG;
+    if (count == 0) return ESP_OK;
+
+    uint32_t total = (uint32_t)jpeg->mcus_x * jpeg->mcus_y;
+    uint32_t mcu = jpeg->strips[first].first_mcu;
+    uint32_t end_mcu = first + count < jpeg->strip_count ? jpeg->strips[first + count].first_mcu : total;
+    size_t end = first + count < jpeg->strip_count ? jpeg->strips[first + count].offset : jpeg->scan_size;
+
+    sw_jpeg_bits_t bits;
+    sw_jpeg_bits_init(&bits, jpeg->scan + jpeg->strips[first].offset, jpeg->scan + end);
+
+    uint8_t planes[SW_JPEG_MAX_COMPONENTS][256];
+    int16_t coef[64];
+    int pred[SW_JPEG_MAX_COMPONENTS] = {0};
+    int mcu_w = 8 * jpeg->h_max;
+
+    for (; mcu < end_mcu; mcu++) {
+        // Restart marker: DC predictors reset and the bit stream realigns
+        if (jpeg->restart_interval && mcu != jpeg->strips[first].first_mcu && mcu % jpeg->restart_interval == 0) {
+            sw_jpeg_bits_restart(&bits);
+            memset(pred, 0, sizeof(pred));
+        }
+
+        for (int c = 0; c < jpeg->components; c++) {
+            const sw_jpeg_component_t* comp = &jpeg->comp[c];
+            const uint16_t* q = jpeg->quant[comp->quant];
+            int stride = c == 0 ? mcu_w : 8 * comp->h;
+            if (jpeg->components == 1) stride = 8;
+            for (int by = 0; by < comp->v; by++) {
+                for (int bx = 0; bx < comp->h; bx++) {
+                    memset(coef, 0, sizeof(coef));
+                    int last = decode_block(jpeg, &bits, c, &pred[c], coef, q);
+                    if (last < 0) return ESP_ERR_INVALID_RESPONSE;
+                    uint8_t* dst = planes[c] + by * 8 * stride + bx * 8;
+                    if (last == 0) {
+                        fill_block(coef[0], dst, stride);
+                    } else {
+                        idct_block(coef, dst, stride);
+                    }
+                }
+            }
+        }
+        write_mcu(jpeg, planes, mcu, out);
+    }
+    return ESP_OK;
+}
+
+esp_err_t sw_jpeg_decode_reduced(const sw_jpeg_t* jpeg, const sw_jpeg_output_t* out) {
+    uint32_t total = (uint32_t)jpeg->mcus_x * jpeg->mcus_y;
+    int out_w = sw_jpeg_reduced_size(jpeg->width);
+    int out_h = sw_jpeg_reduced_size(jpeg->height);
+
+    sw_jpeg_bits_t bits;
+    sw_jpeg_bits_init(&bits, jpeg->scan, jpeg->scan + jpeg->scan_size);
+
+    // One DC level per block: at most 2x2 blocks per component and MCU
+    uint8_t level[SW_JPEG_MAX_COMPONENTS][2][2];
+    int16_t coef[64];
+    int pred[SW_JPEG_MAX_COMPONENTS] = {0};
+    int cb_hs = 0, cb_vs = 0, cr_hs = 0, cr_vs = 0;
+    if (jpeg->components == 3) {
+        cb_hs = jpeg->comp[1].h < jpeg->h_max;
+        cb_vs = jpeg->comp[1].v < jpeg->v_max;
+        cr_hs = jpeg->comp[2].h < jpeg->h_max;
+        cr_vs = jpeg->comp[2].v < jpeg->v_max;
+    }
+
+    for (uint32_t mcu = 0; mcu < total; mcu++) {
+        if (jpeg->restart_interval && mcu != 0 && mcu % jpeg->restart_interval == 0) {
+            sw_jpeg_bits_restart(&bits);
+            memset(pred, 0, sizeof(pred));
+        }
+
+        // The AC coefficients still have to be entropy decoded to find the next block,
+        // but no IDCT runs and only one pixel per block is converted
+        for (int c = 0; c < jpeg->components; c++) {
+            const sw_jpeg_component_t* comp = &jpeg->comp[c];
+            const uint16_t* q = jpeg->quant[comp->quant];
+            int blocks_v = jpeg->components == 1 ? 1 : comp->v;
+            int blocks_h = jpeg->components == 1 ? 1 : comp->h;
+            for (int by = 0; by < blocks_v; by++) {
+                for (int bx = 0; bx < blocks_h; bx++) {
+                    if (decode_block(jpeg, &bits, c, &pred[c], coef, q) < 0) return ESP_ERR_INVALID_RESPONSE;
+                    level[c][by][bx] = clamp8(((coef[0] + 4) >> 3) + 128);
+                }
+            }
+        }
+
+        int x0 = (mcu % jpeg->mcus_x) * jpeg->h_max;
+        int y0 = (mcu / jpeg->mcus_x) * jpeg->v_max;
+        for (int by = 0; by < jpeg->v_max && y0 + by < out_h; by++) {
+            for (int bx = 0; bx < jpeg->h_max && x0 + bx < out_w; bx++) {
+                uint8_t* dst = out->origin + (intptr_t)(x0 + bx) * out->x_step + (intptr_t)(y0 + by) * out->y_step;
+                int Y = level[0][by][bx];
+                if (jpeg->components == 1) {
+                    dst[0] = dst[1] = dst[2] = (uint8_t)Y;
+                } else {
+                    ycc_to_bgr(dst, Y, level[1][by >> cb_vs][bx >> cb_hs] - 128,
+                               level[2][by >> cr_vs][bx >> cr_hs] - 128);
+                }
+            }
+        }
+    }
+    return ESP_OK;
+}
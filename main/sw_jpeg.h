@@ -0,0 +1,115 @@
+// Software JPEG - baseline JPEG decoder split into restart-interval strips
+// Used when the JPEG engine is unavailable and for host tools. Frames with
+// DRI restart markers decode as independent strips (one per core), each
+// writing its pixels straight to their final, possibly rotated, position
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define SW_JPEG_MAX_COMPONENTS  3
+#define SW_JPEG_MAX_STRIPS      64    // Restart intervals are merged pairwise beyond this
+
+// Huffman table, with a 9-bit lookahead for the common short codes
+typedef struct {
+    uint8_t bits[17];           // Number of codes of each length (bits[0] unused)
+    uint8_t symbols[256];
+    uint16_t lookup[512];       // (length << 8) | symbol, 0 = longer code
+    int32_t maxcode[18];        // Largest code of each length, -1 if none
+    int32_t valptr[17];         // Index of the first symbol of each length
+    uint16_t mincode[17];
+    bool present;
+} sw_jpeg_huffman_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h, v;               // Sampling factors
+    uint8_t quant;              // Quantization table index
+    uint8_t dc_table, ac_table;
+} sw_jpeg_component_t;
+
+// Start of a strip in the entropy-coded data
+typedef struct {
+    uint32_t offset;            // Byte offset into the scan data
+    uint32_t first_mcu;
+} sw_jpeg_strip_t;
+
+// Parsed frame, refers to the caller's JPEG data
+typedef struct {
+    uint16_t width, height;
+    uint8_t components;
+    uint8_t h_max, v_max;
+    uint16_t mcus_x, mcus_y;    // MCU grid
+    uint16_t restart_interval;  // MCUs per interval, 0 = none
+    sw_jpeg_component_t comp[SW_JPEG_MAX_COMPONENTS];
+    uint16_t quant[4][64];      // Zigzag order
+    sw_jpeg_huffman_t dc[4];
+    sw_jpeg_huffman_t ac[4];
+    const uint8_t* scan;        // Entropy-coded data
+    size_t scan_size;
+    sw_jpeg_strip_t strips[SW_JPEG_MAX_STRIPS];
+    uint32_t strip_count;       // 1 without restart markers
+} sw_jpeg_t;
+
+// Output mapping: image pixel (x, y) is written as BGR888 to
+// origin + x * x_step + y * y_step, so any 90-degree rotation or mirror
+// is done while the pixels are produced
+typedef struct {
+    uint8_t* origin;
+    int32_t x_step;
+    int32_t y_step;
+} sw_jpeg_output_t;
+
+// Entropy decoder position
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t bits;
+    int count;
+    bool marker;                // Hit a marker, feeding zeros from here
+} sw_jpeg_bits_t;
+
+// Parse headers and locate the restart markers
+// Baseline (SOF0/SOF1) 8-bit only; MJPEG frames without DHT get the standard tables
+esp_err_t sw_jpeg_parse(sw_jpeg_t* jpeg, const uint8_t* data, size_t size);
+
+// Decode strips [first, first + count) into out
+// Strips cover disjoint pixels, so different strips may decode concurrently
+esp_err_t sw_jpeg_decode_strips(const sw_jpeg_t* jpeg, uint32_t first, uint32_t count, const sw_jpeg_output_t* out);
+
+#define SW_JPEG_REDUCED_SCALE   8     // sw_jpeg_decode_reduced() output is 1/8 of the frame size
+
+// Pixels per row or column of an image decoded at reduced scale
+static inline int sw_jpeg_reduced_size(int size) {
+    return (size + SW_JPEG_REDUCED_SCALE - 1) / SW_JPEG_REDUCED_SCALE;
+}
+
+// Decode the whole frame at 1/8 scale, one pixel per 8x8 block from its DC
+// coefficient (no IDCT), for previews and fast scanning. out addresses pixels
+// of the sw_jpeg_reduced_size() x sw_jpeg_reduced_size() image
+esp_err_t sw_jpeg_decode_reduced(const sw_jpeg_t* jpeg, const sw_jpeg_output_t* out);
+
+// Plain row-major output into buf with stride bytes per row
+static inline sw_jpeg_output_t sw_jpeg_output_rows(uint8_t* buf, int stride) {
+    return (sw_jpeg_output_t){buf, 3, stride};
+}
+
+// Entropy decoding for tools that work on coefficients (e.g. re-encoding with restart markers)
+void sw_jpeg_bits_init(sw_jpeg_bits_t* bits, const uint8_t* data, const uint8_t* end);
+
+// Skip to the data after the next restart marker and reset the bit buffer
+void sw_jpeg_bits_restart(sw_jpeg_bits_t* bits);
+
+// Decode one block of component c as quantized coefficients in zigzag order
+bool sw_jpeg_decode_coefficients(const sw_jpeg_t* jpeg, sw_jpeg_bits_t* bits, int c, int* dc_pred,
+                                 int16_t coef[64]);
+
+// Number of blocks of component c in one MCU
+static inline int sw_jpeg_blocks_per_mcu(const sw_jpeg_t* jpeg, int c) {
+    return jpeg->components == 1 ? 1 : jpeg->comp[c].h * jpeg->comp[c].v;
+}
+
+// Zigzag index to natural (row-major) index
+extern const uint8_t sw_jpeg_zigzag[64];
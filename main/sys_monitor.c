@@ -0,0 +1,161 @@
+// System Monitor - per-core and per-task CPU load, stack and heap watermarks
+
+#include "sys_monitor.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "trace.h"
+
+static const char* TAG = "sys_monitor";
+
+#define RUN_TIME_STATS  (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY)
+
+static sys_monitor_t current = {.core_load = {-1, -1}};
+static int64_t last_sample_us = 0;
+
+static const uint32_t heap_cap_masks[SYS_MONITOR_HEAP_COUNT] = {
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_DMA,
+    MALLOC_CAP_SPIRAM,
+};
+
+static const char* const heap_names[SYS_MONITOR_HEAP_COUNT] = {"internal", "dma", "spiram"};
+
+#if RUN_TIME_STATS
+// Each task at the previous sample, to turn totals into load
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE run_time;
+    uint32_t stack_free;
+} task_previous_t;
+
+static TaskStatus_t task_status[SYS_MONITOR_MAX_TASKS];
+static task_previous_t previous[SYS_MONITOR_MAX_TASKS];
+static int previous_count = 0;
+static configRUN_TIME_COUNTER_TYPE last_total = 0;
+static configRUN_TIME_COUNTER_TYPE last_idle[2] = {0};
+
+static const task_previous_t* find_previous(TaskHandle_t handle) {
+    for (int i = 0; i < previous_count; i++) {
+        if (previous[i].handle == handle) {
+            return &previous[i];
+        }
+    }
+    return NULL;
+}
+
+static void sample_tasks(void) {
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(task_status, SYS_MONITOR_MAX_TASKS, &total);
+    if (count == 0) {
+        // More tasks than slots: keep the previous sample
+        ESP_LOGW(TAG, "More than %d tasks, not sampled", SYS_MONITOR_MAX_TASKS);
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE span = total - last_total;
+    bool have_span = last_total > 0 && span > 0;
+
+    for (int core = 0; core < 2; core++) {
+        configRUN_TIME_COUNTER_TYPE idle = ulTaskGetIdleRunTimeCounterForCore(core);
+        int load = have_span ? 100 - (int)((uint64_t)(idle - last_idle[core]) * 100 / span) : -1;
+        current.core_load[core] = load < -1 ? 0 : load;
+        last_idle[core] = idle;
+    }
+
+    // Collect into a scratch copy first, previous[] is still being looked up
+    task_previous_t next[SYS_MONITOR_MAX_TASKS];
+    current.task_count = count;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t* s = &task_status[i];
+        sys_monitor_task_t* t = &current.tasks[i];
+        strncpy(t->name, s->pcTaskName, sizeof(t->name) - 1);
+        t->name[sizeof(t->name) - 1] = 0;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        t->core = s->xCoreID == tskNO_AFFINITY ? -1 : (int8_t)s->xCoreID;
+#else
+        t->core = -1;
+#endif
+        t->priority = s->uxCurrentPriority;
+        t->stack_free = s->usStackHighWaterMark;        // Bytes in ESP-IDF
+        const task_previous_t* prev = find_previous(s->xHandle);
+        uint64_t percent = have_span && prev ? (uint64_t)(s->ulRunTimeCounter - prev->run_time) * 100 / span : 0;
+        t->load = percent > 100 ? 100 : (uint8_t)percent;
+
+        // Warn each time a task reaches a new low under the threshold
+        if (t->stack_free < SYS_MONITOR_STACK_WARN && (!prev || t->stack_free < prev->stack_free)) {
+            ESP_LOGW(TAG, "Task %s is low on stack: %lu bytes left", t->name, (unsigned long)t->stack_free);
+        }
+        next[i] = (task_previous_t){s->xHandle, s->ulRunTimeCounter, t->stack_free};
+    }
+    memcpy(previous, next, sizeof(next[0]) * count);
+    previous_count = count;
+    last_total = total;
+}
+#endif
+
+static void sample_heaps(void) {
+    for (int i = 0; i < SYS_MONITOR_HEAP_COUNT; i++) {
+        sys_monitor_heap_t* h = &current.heap[i];
+        h->free = heap_caps_get_free_size(heap_cap_masks[i]);
+        h->largest = heap_caps_get_largest_free_block(heap_cap_masks[i]);
+        h->min_free = heap_caps_get_minimum_free_size(heap_cap_masks[i]);
+    }
+}
+
+bool sys_monitor_poll(int64_t interval_us) {
+    int64_t now = esp_timer_get_time();
+    if (last_sample_us > 0 && now - last_sample_us < interval_us) {
+        return false;
+    }
+    last_sample_us = now;
+
+#if RUN_TIME_STATS
+    sample_tasks();
+#endif
+    sample_heaps();
+
+    TRACE_COUNTER(CPU0_LOAD, current.core_load[0] < 0 ? 0 : current.core_load[0]);
+    TRACE_COUNTER(CPU1_LOAD, current.core_load[1] < 0 ? 0 : current.core_load[1]);
+    TRACE_COUNTER(HEAP_INTERNAL, current.heap[SYS_MONITOR_HEAP_INTERNAL].free >> 10);
+    TRACE_COUNTER(HEAP_SPIRAM, current.heap[SYS_MONITOR_HEAP_SPIRAM].free >> 10);
+    return true;
+}
+
+const sys_monitor_t* sys_monitor_get(void) {
+    return &current;
+}
+
+static int compare_load(const void* a, const void* b) {
+    const sys_monitor_task_t* ta = a;
+    const sys_monitor_task_t* tb = b;
+    return (int)tb->load - (int)ta->load;
+}
+
+void sys_monitor_log(void) {
+    ESP_LOGI(TAG, "=== SYSTEM: core0 %d%%, core1 %d%% ===", current.core_load[0], current.core_load[1]);
+
+    sys_monitor_task_t tasks[SYS_MONITOR_MAX_TASKS];
+    memcpy(tasks, current.tasks, sizeof(tasks[0]) * current.task_count);
+    qsort(tasks, current.task_count, sizeof(tasks[0]), compare_load);
+    ESP_LOGI(TAG, "%-16s %4s %4s %5s %10s", "task", "core", "prio", "load", "stack free");
+    for (int i = 0; i < current.task_count; i++) {
+        const sys_monitor_task_t* t = &tasks[i];
+        char core[4] = "-";
+        if (t->core >= 0) {
+            core[0] = '0' + t->core;
+        }
+        ESP_LOGI(TAG, "%-16s %4s %4u %4u%% %10lu", t->name, core, t->priority, t->load,
+                 (unsigned long)t->stack_free);
+    }
+
+    for (int i = 0; i < SYS_MONITOR_HEAP_COUNT; i++) {
+        const sys_monitor_heap_t* h = &current.heap[i];
+        ESP_LOGI(TAG, "Heap %-8s free %7zu KB, largest block %7zu KB, lowest free %7zu KB", heap_names[i],
+                 h->free >> 10, h->largest >> 10, h->min_free >> 10);
+    }
+}
@@ -0,0 +1,49 @@
+// System Monitor - per-core and per-task CPU load, stack and heap watermarks
+// Sampled about once a second from the main loop; each sample is the load
+// since the previous one. Feeds the HUD and (as counters) the trace
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define SYS_MONITOR_MAX_TASKS       24
+#define SYS_MONITOR_STACK_WARN      512     // Warn when a task has less stack than this left (bytes)
+
+typedef struct {
+    char name[16];
+    int8_t core;                // Pinned core, -1 = either
+    uint8_t priority;
+    uint8_t load;               // Percent of one core since the previous sample
+    uint32_t stack_free;        // Smallest free stack ever seen (bytes)
+} sys_monitor_task_t;
+
+typedef enum {
+    SYS_MONITOR_HEAP_INTERNAL,
+    SYS_MONITOR_HEAP_DMA,
+    SYS_MONITOR_HEAP_SPIRAM,
+    SYS_MONITOR_HEAP_COUNT
+} sys_monitor_heap_kind_t;
+
+typedef struct {
+    size_t free;
+    size_t largest;             // Largest allocatable block
+    size_t min_free;            // Low-water mark since boot
+} sys_monitor_heap_t;
+
+typedef struct {
+    int core_load[2];           // Percent busy, -1 = run-time stats not available
+    sys_monitor_task_t tasks[SYS_MONITOR_MAX_TASKS];
+    int task_count;
+    sys_monitor_heap_t heap[SYS_MONITOR_HEAP_COUNT];
+} sys_monitor_t;
+
+// Take a new sample if interval_us passed since the last one; returns true when it did
+bool sys_monitor_poll(int64_t interval_us);
+
+// Latest sample
+const sys_monitor_t* sys_monitor_get(void);
+
+// Print the latest sample via ESP_LOGI, tasks sorted by load
+void sys_monitor_log(void);
@@ -0,0 +1,213 @@
+// Time Stretch - WSOLA tempo change for interleaved stereo 16-bit PCM
+
+#include "time_stretch.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char* TAG = "time_stretch";
+
+// The search runs on mono samples scaled to 12 bits, so a correlation over
+// the overlap (at most OVERLAP_MAX frames of 2^22 products) fits in 32 bits
+#define MONO_SHIFT      5
+#define OVERLAP_MAX     480
+
+esp_err_t time_stretch_init(time_stretch_t* ts, uint32_t sample_rate, int put_max) {
+    memset(ts, 0, sizeof(*ts));
+    ts->sample_rate = sample_rate;
+    ts->speed = 100;
+    ts->sequence = sample_rate * TIME_STRETCH_SEQUENCE_MS / 1000;
+    ts->overlap = sample_rate * TIME_STRETCH_OVERLAP_MS / 1000;
+    ts->seek = sample_rate * TIME_STRETCH_SEEK_MS / 1000;
+    if (ts->overlap > OVERLAP_MAX) {
+        ts->overlap = OVERLAP_MAX;
+    }
+    if (ts->overlap < 8 || ts->sequence < 3 * ts->overlap || put_max < 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ts->put_max = put_max;
+
+    // Kept from the previous segment's fade-out frames (at most one output
+    // segment behind the nominal position at 2x) to the end of the next
+    // segment's seek window, plus one batch of new input
+    ts->input_capacity = (ts->sequence - ts->overlap) + ts->seek + ts->sequence + put_max;
+    ts->input = heap_caps_malloc(ts->input_capacity * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ts->mono = heap_caps_malloc((2 * ts->overlap + ts->seek) * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!ts->input || !ts->mono) {
+        ESP_LOGE(TAG, "No memory for %d frames of input", ts->input_capacity);
+        time_stretch_free(ts);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "%lu Hz: segment %d, overlap %d, seek %d frames, %d KB", (unsigned long)sample_rate,
+             ts->sequence, ts->overlap, ts->seek,
+             (int)((ts->input_capacity * 4 + (2 * ts->overlap + ts->seek) * 2) / 1024));
+    return ESP_OK;
+}
+
+void time_stretch_set_speed(time_stretch_t* ts, int speed_percent) {
+    if (speed_percent < TIME_STRETCH_SPEED_MIN) speed_percent = TIME_STRETCH_SPEED_MIN;
+    if (speed_percent > TIME_STRETCH_SPEED_MAX) speed_percent = TIME_STRETCH_SPEED_MAX;
+    ts->speed = speed_percent;
+}
+
+void time_stretch_reset(time_stretch_t* ts) {
+    ts->input_frames = 0;
+    ts->position_q16 = 0;
+    ts->resume = 0;
+    ts->primed = false;
+}
+
+int time_stretch_put(time_stretch_t* ts, const int16_t* pcm, int frames) {
+    int room = ts->input_capacity - ts->input_frames;
+    if (frames > room) {
+        frames = room;
+    }
+    memcpy(ts->input + ts->input_frames * 2, pcm, frames * 2 * sizeof(int16_t));
+    ts->input_frames += frames;
+    return frames;
+}
+
+static void to_mono(int16_t* dst, const int16_t* src, int frames) {
+    for (int i = 0; i < frames; i++) {
+        dst[i] = (int16_t)((src[2 * i] + src[2 * i + 1]) >> MONO_SHIFT);
+    }
+}
+
+static uint32_t isqrt32(uint32_t x) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Normalized correlation of the fade-out frames with the window at offset k
+static int64_t splice_score(const int16_t* ref, const int16_t* window, int k, int overlap) {
+    int32_t corr = 0;
+    int32_t energy = 0;
+    const int16_t* w = window + k;
+    for (int i = 0; i < overlap; i++) {
+        corr += ref[i] * w[i];
+        energy += w[i] * w[i];
+    }
+    return ((int64_t)corr << 16) / (int64_t)(isqrt32((uint32_t)energy) + 1);
+}
+
+// Start of the segment in [pos, pos + seek] that best continues the last one:
+// every COARSE_STEP-th offset first, then the neighbours of the best
+static int find_splice(time_stretch_t* ts, int pos) {
+    int overlap = ts->overlap;
+    int16_t* ref = ts->mono;
+    int16_t* window = ts->mono + overlap;
+    to_mono(ref, ts->input + (ts->resume - overlap) * 2, overlap);
+    to_mono(window, ts->input + pos * 2, ts->seek + overlap);
+
+    int best = 0;
+    int64_t best_score = INT64_MIN;
+    for (int k = 0; k <= ts->seek; k += TIME_STRETCH_COARSE_STEP) {
+        int64_t score = splice_score(ref, window, k, overlap);
+        if (score > best_score) {
+            best_score = score;
+            best = k;
+        }
+    }
+    int coarse = best;
+    for (int k = coarse - TIME_STRETCH_COARSE_STEP + 1; k < coarse + TIME_STRETCH_COARSE_STEP; k++) {
+        if (k < 0 || k > ts->seek || k == coarse) {
+            continue;
+        }
+        int64_t score = splice_score(ref, window, k, overlap);
+        if (score > best_score) {
+            best_score = score;
+            best = k;
+        }
+    }
+    return pos + best;
+}
+
+// Drop input before frame base
+static void discard(time_stretch_t* ts, int base) {
+    if (base <= 0) {
+        return;
+    }
+    ts->input_frames -= base;
+    memmove(ts->input, ts->input + base * 2, ts->input_frames * 2 * sizeof(int16_t));
+    ts->position_q16 -= (uint32_t)base << 16;
+    ts->resume -= base;
+}
+
+int time_stretch_get(time_stretch_t* ts, int16_t* out) {
+    int pos = ts->position_q16 >> 16;
+    if (ts->input_frames < pos + ts->seek + ts->sequence) {
+        return 0;
+    }
+
+    int overlap = ts->overlap;
+    int frames = ts->sequence - overlap;
+    int start = ts->primed ? find_splice(ts, pos) : pos;
+    const int16_t* segment = ts->input + start * 2;
+    if (ts->primed) {
+        // Fade from the natural continuation of the last segment into the new one
+        const int16_t* prev = ts->input + (ts->resume - overlap) * 2;
+        for (int i = 0; i < overlap; i++) {
+            int32_t w = (i << 15) / overlap;
+            for (int c = 0; c < 2; c++) {
+                int32_t a = prev[2 * i + c];
+                int32_t b = segment[2 * i + c];
+                out[2 * i + c] = (int16_t)(a + (((b - a) * w) >> 15));
+            }
+        }
+        memcpy(out + overlap * 2, segment + overlap * 2, (frames - overlap) * 2 * sizeof(int16_t));
+    } else {
+        memcpy(out, segment, frames * 2 * sizeof(int16_t));
+    }
+
+    ts->resume = start + ts->sequence;
+    ts->primed = true;
+    ts->position_q16 += (uint32_t)(((uint64_t)frames * ts->speed << 16) / 100);
+    ts->segments++;
+
+    int next = ts->position_q16 >> 16;
+    discard(ts, next < ts->resume - overlap ? next : ts->resume - overlap);
+    return frames;
+}
+
+int time_stretch_drain(time_stretch_t* ts, int16_t* out) {
+    int start = ts->primed ? ts->resume - ts->overlap : (int)(ts->position_q16 >> 16);
+    if (start > ts->input_frames) {
+        start = ts->input_frames;
+    }
+    int frames = ts->input_frames - start;
+    if (frames > ts->sequence - ts->overlap) {
+        frames = ts->sequence - ts->overlap;
+    }
+    memcpy(out, ts->input + start * 2, frames * 2 * sizeof(int16_t));
+
+    discard(ts, start + frames);
+    ts->position_q16 = 0;
+    ts->resume = 0;
+    ts->primed = false;
+    return frames;
+}
+
+uint32_t time_stretch_search_macs(const time_stretch_t* ts) {
+    int candidates = ts->seek / TIME_STRETCH_COARSE_STEP + 1 + 2 * (TIME_STRETCH_COARSE_STEP - 1);
+    return (uint32_t)(2 * candidates * ts->overlap / (ts->sequence - ts->overlap));
+}
+
+void time_stretch_free(time_stretch_t* ts) {
+    heap_caps_free(ts->input);
+    heap_caps_free(ts->mono);
+    ts->input = NULL;
+    ts->mono = NULL;
+}
@@ -0,0 +1,71 @@
+// Time Stretch - WSOLA tempo change for interleaved stereo 16-bit PCM
+// Plays audio faster or slower without changing its pitch: the output is
+// built from overlapping input segments taken at the scaled rate, each one
+// picked within a small seek window where it best continues the previous
+// one (fixed-point cross-correlation), and cross-faded over the overlap.
+// Integer only, no allocation after init, so it runs in the audio task
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define TIME_STRETCH_SEQUENCE_MS    40      // Segment length
+#define TIME_STRETCH_OVERLAP_MS     8       // Cross-fade between segments
+#define TIME_STRETCH_SEEK_MS        15      // Window searched for the best splice
+#define TIME_STRETCH_COARSE_STEP    4       // Seek offsets tried before refining around the best
+
+#define TIME_STRETCH_SPEED_MIN      50      // Percent
+#define TIME_STRETCH_SPEED_MAX      200
+
+typedef struct {
+    uint32_t sample_rate;
+    int speed;                  // Percent of normal tempo
+    int sequence;               // Frames per segment
+    int overlap;                // Frames cross-faded
+    int seek;                   // Frames searched
+    int put_max;                // Most frames time_stretch_put() takes per call
+
+    // Input not consumed yet, stereo frames from position 0
+    int16_t* input;
+    int input_frames;
+    int input_capacity;
+
+    uint32_t position_q16;      // Nominal start of the next segment (Q16 frames)
+    int resume;                 // End of the last segment; its last overlap frames fade into the next
+    bool primed;                // A segment was output, the next one cross-fades
+
+    int16_t* mono;              // Scaled-down mono of the overlap and seek window for the search
+    uint32_t segments;
+} time_stretch_t;
+
+// Allocate buffers for a stream, put_max is the largest batch of frames put at once
+esp_err_t time_stretch_init(time_stretch_t* ts, uint32_t sample_rate, int put_max);
+
+// Change the tempo, takes effect with the next segment
+void time_stretch_set_speed(time_stretch_t* ts, int speed_percent);
+
+// Forget all buffered audio
+void time_stretch_reset(time_stretch_t* ts);
+
+// Frames time_stretch_get() and time_stretch_drain() write at most per call
+static inline int time_stretch_output_frames(const time_stretch_t* ts) {
+    return ts->sequence - ts->overlap;
+}
+
+// Append input, returns the frames taken (fewer only when time_stretch_get() must run first)
+int time_stretch_put(time_stretch_t* ts, const int16_t* pcm, int frames);
+
+// Produce the next segment into out (time_stretch_output_frames() frames of room)
+// Returns the frames written, 0 until enough input is buffered
+int time_stretch_get(time_stretch_t* ts, int16_t* out);
+
+// Hand back the buffered audio unstretched, continuing seamlessly from the
+// last segment (for returning to normal speed). Call until it returns 0
+int time_stretch_drain(time_stretch_t* ts, int16_t* out);
+
+// Multiply-accumulates of the splice search per output frame, for CPU budgeting
+uint32_t time_stretch_search_macs(const time_stretch_t* ts);
+
+void time_stretch_free(time_stretch_t* ts);
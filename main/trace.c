@@ -0,0 +1,176 @@
+// Trace - lock-free ring of begin/end events for pipeline profiling
+
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+static const char* TAG = "trace";
+
+#define EVENTS_PER_LINE 8
+
+static trace_record_t* ring = NULL;
+static atomic_uint_fast32_t ring_head = 0;     // Total events recorded, wraps the ring
+static atomic_bool paused = false;
+
+static const char* const event_names[TRACE_EVENT_COUNT] = {
+#define TRACE_NAME(id, name) name,
+    TRACE_EVENTS(TRACE_NAME)
+#undef TRACE_NAME
+};
+
+#ifdef ESP_PLATFORM
+// Tasks get a slot on their first event so the host can give each its own track
+// Slots are keyed by task name, not handle: audio_player and jpeg_strips are
+// deleted and re-created per video and seek, and a re-created task keeps its
+// track while a freed handle is never looked at again
+static char task_names[TRACE_MAX_TASKS][configMAX_TASK_NAME_LEN];
+static atomic_int task_slot_count = 0;
+static portMUX_TYPE task_slot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int find_task_slot(const char* name, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strncmp(task_names[i], name, configMAX_TASK_NAME_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint8_t task_slot(void) {
+    const char* name = pcTaskGetName(NULL);
+    int slot = find_task_slot(name, atomic_load(&task_slot_count));
+    if (slot >= 0) {
+        return slot;
+    }
+    // First event of this task name: look again under the lock, fill the
+    // name in, then publish the slot so a dump never sees it half written
+    taskENTER_CRITICAL(&task_slot_lock);
+    int count = atomic_load(&task_slot_count);
+    slot = find_task_slot(name, count);
+    if (slot < 0 && count < TRACE_MAX_TASKS) {
+        slot = count;
+        strncpy(task_names[slot], name, configMAX_TASK_NAME_LEN - 1);
+        atomic_store(&task_slot_count, count + 1);
+    }
+    taskEXIT_CRITICAL(&task_slot_lock);
+    return slot >= 0 ? slot : TRACE_MAX_TASKS - 1;
+}
+
+static void reset_task_slots(void) {
+    taskENTER_CRITICAL(&task_slot_lock);
+    atomic_store(&task_slot_count, 0);
+    taskEXIT_CRITICAL(&task_slot_lock);
+}
+
+static inline uint8_t core_id(void) {
+    return (uint8_t)xPortGetCoreID();
+}
+#else
+static uint8_t task_slot(void) {
+    return 0;
+}
+
+static void reset_task_slots(void) {
+}
+
+static inline uint8_t core_id(void) {
+    return 0;
+}
+#endif
+
+void trace_init(void) {
+    if (ring) {
+        return;
+    }
+    ring = heap_caps_malloc(TRACE_RING_EVENTS * sizeof(trace_record_t), MALLOC_CAP_SPIRAM);
+    if (!ring) {
+        ring = heap_caps_malloc(TRACE_RING_EVENTS * sizeof(trace_record_t), MALLOC_CAP_DEFAULT);
+    }
+    if (!ring) {
+        ESP_LOGW(TAG, "No memory for the trace ring, tracing disabled");
+        return;
+    }
+    ESP_LOGI(TAG, "Trace ring: %d events", TRACE_RING_EVENTS);
+}
+
+void trace_event(trace_event_t event, trace_phase_t phase, uint16_t arg) {
+    if (!ring || atomic_load_explicit(&paused, memory_order_relaxed)) {
+        return;
+    }
+    uint32_t index = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed) & (TRACE_RING_EVENTS - 1);
+    trace_record_t* r = &ring[index];
+    r->time_us = (uint32_t)esp_timer_get_time();
+    r->event = event;
+    r->flags = phase | (core_id() << 2) | (task_slot() << 4);
+    r->arg = arg;
+}
+
+void trace_reset(void) {
+    atomic_store(&ring_head, 0);
+    reset_task_slots();
+}
+
+void trace_dump(void) {
+    if (!ring) {
+        return;
+    }
+    atomic_store(&paused, true);
+#ifdef ESP_PLATFORM
+    vTaskDelay(1);          // Let events being written on the other core land
+#endif
+
+    uint32_t recorded = atomic_load(&ring_head);
+    uint32_t count = recorded < TRACE_RING_EVENTS ? recorded : TRACE_RING_EVENTS;
+    uint32_t first = recorded - count;
+
+    printf("@T begin %lu %lu %lu\n", (unsigned long)recorded, (unsigned long)count,
+           (unsigned long)(uint32_t)esp_timer_get_time());
+    for (int i = 0; i < TRACE_EVENT_COUNT; i++) {
+        printf("@T event %d %s\n", i, event_names[i]);
+    }
+#ifdef ESP_PLATFORM
+    int tasks = atomic_load(&task_slot_count);
+    for (int i = 0; i < tasks; i++) {
+        printf("@T task %d %s\n", i, task_names[i]);
+    }
+#else
+    printf("@T task 0 main\n");
+#endif
+
+    // Raw little-endian records, hex encoded
+    static const char hex[] = "0123456789abcdef";
+    char line[8 + EVENTS_PER_LINE * sizeof(trace_record_t) * 2 + 2];
+    for (uint32_t i = 0; i < count; i += EVENTS_PER_LINE) {
+        char* p = line;
+        p += sprintf(p, "@T data ");
+        for (uint32_t j = i; j < count && j < i + EVENTS_PER_LINE; j++) {
+            const uint8_t* b = (const uint8_t*)&ring[(first + j) & (TRACE_RING_EVENTS - 1)];
+            for (size_t k = 0; k < sizeof(trace_record_t); k++) {
+                *p++ = hex[b[k] >> 4];
+                *p++ = hex[b[k] & 15];
+            }
+        }
+        *p++ = '\n';
+        *p = 0;
+        fputs(line, stdout);
+    }
+    printf("@T end\n");
+    fflush(stdout);
+
+    atomic_store(&paused, false);
+}
+
+#endif
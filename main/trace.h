@@ -0,0 +1,92 @@
+// Trace - lock-free ring of begin/end events for pipeline profiling
+// Each event is 8 bytes: a microsecond timestamp, the event id, the phase,
+// the core and the recording task. The ring is dumped as hex over the
+// console and host/trace_to_chrome.py turns it into Chrome/Perfetto JSON.
+// Compiled out (macros expand to nothing) when TRACE_ENABLED is 0, which is
+// the default for builds with NDEBUG
+#pragma once
+
+#include <stdint.h>
+
+#ifndef TRACE_ENABLED
+#ifdef NDEBUG
+#define TRACE_ENABLED 0
+#else
+#define TRACE_ENABLED 1
+#endif
+#endif
+
+#define TRACE_RING_EVENTS   16384       // Power of two, 128KB in PSRAM
+#define TRACE_MAX_TASKS     16          // Distinct task names that can record, later ones share the last track
+
+// Event ids and their names in the dump
+#define TRACE_EVENTS(X) \
+    X(READ,           "read")                     \
+    X(DECODE,         "decode")                   \
+    X(COPY,           "copy")                     \
+    X(VSYNC,          "vsync wait")               \
+    X(BLIT,           "blit")                     \
+    X(STRIP,          "jpeg strips")              \
+    X(AUDIO_DECODE,   "audio decode")             \
+    X(I2S_WRITE,      "i2s write")                \
+    X(DROP,           "frame drop")               \
+    X(CPU0_LOAD,      "cpu0 %")                   \
+    X(CPU1_LOAD,      "cpu1 %")                   \
+    X(HEAP_INTERNAL,  "internal free KB")         \
+    X(HEAP_SPIRAM,    "spiram free KB")           \
+    X(SKIP,           "demux skip")               \
+    X(STRETCH,        "time stretch")
+
+typedef enum {
+#define TRACE_ENUM(id, name) TRACE_##id,
+    TRACE_EVENTS(TRACE_ENUM)
+#undef TRACE_ENUM
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+typedef enum {
+    TRACE_PHASE_BEGIN   = 0,
+    TRACE_PHASE_END     = 1,
+    TRACE_PHASE_INSTANT = 2,
+    TRACE_PHASE_COUNTER = 3,    // arg is the new value of a counter track
+} trace_phase_t;
+
+typedef struct {
+    uint32_t time_us;           // Low 32 bits of esp_timer_get_time()
+    uint8_t event;              // trace_event_t
+    uint8_t flags;              // Phase in bits 0-1, core in bit 2, task slot in bits 4-7
+    uint16_t arg;               // Event specific (frame index, KB read, ...)
+} trace_record_t;
+
+#if TRACE_ENABLED
+
+// Allocate the ring; recording before this is a no-op
+void trace_init(void);
+
+// Append one event, safe from any task on either core
+void trace_event(trace_event_t event, trace_phase_t phase, uint16_t arg);
+
+// Forget everything recorded so far
+void trace_reset(void);
+
+// Print the ring to the console between "@T begin" and "@T end" lines
+// Recording is paused while dumping
+void trace_dump(void);
+
+#define TRACE_BEGIN(id)             trace_event(TRACE_##id, TRACE_PHASE_BEGIN, 0)
+#define TRACE_END(id, arg)          trace_event(TRACE_##id, TRACE_PHASE_END, (uint16_t)(arg))
+#define TRACE_INSTANT(id, arg)      trace_event(TRACE_##id, TRACE_PHASE_INSTANT, (uint16_t)(arg))
+#define TRACE_COUNTER(id, value)    trace_event(TRACE_##id, TRACE_PHASE_COUNTER, (uint16_t)(value))
+
+#else
+
+static inline void trace_init(void) {}
+static inline void trace_reset(void) {}
+static inline void trace_dump(void) {}
+
+#define TRACE_BEGIN(id)             do {} while (0)
+#define TRACE_END(id, arg)          do { (void)(arg); } while (0)
+#define TRACE_INSTANT(id, arg)      do { (void)(arg); } while (0)
+#define TRACE_COUNTER(id, value)    do { (void)(value); } while (0)
+
+#endif
@@ -5,6 +5,7 @@
 #include "hershey_font.h"
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 // Layout constants (screen coordinates: 800x480)
 #define HEADER_HEIGHT       60
@@ -23,6 +24,7 @@ void ui_menu_init(ui_menu_state_t* state, playlist_t* playlist) {
     state->playlist = playlist;
     state->selected_index = 0;
     state->scroll_offset = 0;
+    state->order = UI_MENU_ORDER_PLAYLIST;
     state->needs_redraw = true;
 }
 
@@ -63,16 +65,24 @@ void ui_menu_draw(ui_menu_state_t* state, uint8_t* fb, int fb_stride, int fb_hei
     int menu_item_x = MENU_PADDING + 20;
     int menu_item_w = screen_w - MENU_PADDING * 2 - 40;
 
-    if (state->playlist && state->playlist->video_count > 0) {
+    int count = state->playlist ? playlist_count(state->playlist) : 0;
+    if (count > 0) {
+        // Position and order at the right end of the header
+        static const char* order_names[UI_MENU_ORDER_COUNT] = {"LIST", "A-Z", "LONGEST"};
+        char position[32];
+        snprintf(position, sizeof(position), "%d/%d %s", state->selected_index + 1, count, order_names[state->order]);
+        hershey_draw_string_bold(fb, fb_stride, fb_height, screen_w - 30 - hershey_string_width(position, 18), 20,
+                                 position, 18, COLOR_R(COLOR_BG), COLOR_G(COLOR_BG), COLOR_B(COLOR_BG));
+
         int visible_start = state->scroll_offset;
         int visible_end = visible_start + MAX_VISIBLE_ITEMS;
-        if (visible_end > state->playlist->video_count) {
-            visible_end = state->playlist->video_count;
+        if (visible_end > count) {
+            visible_end = count;
         }
 
         for (int i = visible_start; i < visible_end; i++) {
             int item_y = menu_start_y + (i - visible_start) * (ITEM_HEIGHT + ITEM_SPACING);
-            video_entry_t* entry = &state->playlist->videos[i];
+            const video_entry_t* entry = playlist_get(state->playlist, i);
             bool is_selected = (i == state->selected_index);
 
             // Draw item background
@@ -125,7 +135,7 @@ void ui_menu_draw(ui_menu_state_t* state, uint8_t* fb, int fb_stride, int fb_hei
                                screen_w / 2 - 10, menu_start_y - 15, "^", 20,
                                COLOR_R(COLOR_ACCENT2), COLOR_G(COLOR_ACCENT2), COLOR_B(COLOR_ACCENT2));
         }
-        if (visible_end < state->playlist->video_count) {
+        if (visible_end < count) {
             // Down arrow indicator
             int bottom_y = menu_start_y + MAX_VISIBLE_ITEMS * (ITEM_HEIGHT + ITEM_SPACING);
             hershey_draw_string(fb, fb_stride, fb_height,
@@ -152,6 +162,9 @@ void ui_menu_draw(ui_menu_state_t* state, uint8_t* fb, int fb_stride, int fb_hei
     hershey_draw_string_bold(fb, fb_stride, fb_height, 380, screen_h - 35,
                              "EXIT: ESC", 18,
                              COLOR_R(COLOR_BG), COLOR_G(COLOR_BG), COLOR_B(COLOR_BG));
+    hershey_draw_string_bold(fb, fb_stride, fb_height, 540, screen_h - 35,
+                             "CARD TEST: B", 18,
+                             COLOR_R(COLOR_BG), COLOR_G(COLOR_BG), COLOR_B(COLOR_BG));
 
     // Decorative accent bars in footer
     //ui_fill_rect(fb, fb_stride, fb_height, 550, screen_h - FOOTER_HEIGHT + 12, 60, 8, COLOR_ACCENT3);
@@ -161,35 +174,70 @@ void ui_menu_draw(ui_menu_state_t* state, uint8_t* fb, int fb_stride, int fb_hei
     state->needs_redraw = false;
 }
 
+// Keep the selection on screen
+static void scroll_to_selection(ui_menu_state_t* state) {
+    if (state->selected_index < state->scroll_offset) {
+        state->scroll_offset = state->selected_index;
+    }
+    if (state->selected_index >= state->scroll_offset + MAX_VISIBLE_ITEMS) {
+        state->scroll_offset = state->selected_index - MAX_VISIBLE_ITEMS + 1;
+    }
+}
+
 // Handle input, returns true if a video was selected
-bool ui_menu_handle_input(ui_menu_state_t* state, bool up, bool down, bool enter,
+bool ui_menu_handle_input(ui_menu_state_t* state, bool up, bool down, bool page_up, bool page_down, bool enter,
                           video_entry_t** selected_entry) {
-    if (!state->playlist || state->playlist->video_count == 0) {
+    int count = state->playlist ? playlist_count(state->playlist) : 0;
+    if (count == 0) {
         return false;
     }
 
-    if (up && state->selected_index > 0) {
-        state->selected_index--;
-        // Adjust scroll if needed
-        if (state->selected_index < state->scroll_offset) {
-            state->scroll_offset = state->selected_index;
-        }
-        state->needs_redraw = true;
-    }
-
-    if (down && state->selected_index < state->playlist->video_count - 1) {
-        state->selected_index++;
+    int selected = state->selected_index;
+    if (up) selected--;
+    if (down) selected++;
+    if (page_up) selected -= MAX_VISIBLE_ITEMS;
+    if (page_down) selected += MAX_VISIBLE_ITEMS;
+    if (selected < 0) selected = 0;
+    if (selected > count - 1) selected = count - 1;
+    if (selected != state->selected_index) {
+        state->selected_index = selected;
         // Adjust scroll if needed
-        if (state->selected_index >= state->scroll_offset + MAX_VISIBLE_ITEMS) {
-            state->scroll_offset = state->selected_index - MAX_VISIBLE_ITEMS + 1;
-        }
+        scroll_to_selection(state);
         state->needs_redraw = true;
     }
 
     if (enter) {
-        *selected_entry = &state->playlist->videos[state->selected_index];
+        *selected_entry = playlist_get(state->playlist, state->selected_index);
         return true;
     }
 
     return false;
 }
+
+static int compare_name(const video_entry_t* a, const video_entry_t* b) {
+    return strcasecmp(a->display_name, b->display_name);
+}
+
+static int compare_longest(const video_entry_t* a, const video_entry_t* b) {
+    return (b->info.duration_ms > a->info.duration_ms) - (b->info.duration_ms < a->info.duration_ms);
+}
+
+void ui_menu_next_order(ui_menu_state_t* state) {
+    if (!state->playlist || playlist_count(state->playlist) == 0) {
+        return;
+    }
+    const video_entry_t* selected = playlist_get(state->playlist, state->selected_index);
+    state->order = (state->order + 1) % UI_MENU_ORDER_COUNT;
+
+    // Each order starts from the list order, so equal entries stay in it
+    playlist_filter(state->playlist, NULL, NULL);
+    if (state->order == UI_MENU_ORDER_NAME) {
+        playlist_sort(state->playlist, compare_name);
+    } else if (state->order == UI_MENU_ORDER_LONGEST) {
+        playlist_sort(state->playlist, compare_longest);
+    }
+
+    state->selected_index = playlist_view_index(state->playlist, selected);
+    scroll_to_selection(state);
+    state->needs_redraw = true;
+}
@@ -3,13 +3,24 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "media_loader.h"
+#include "playlist.h"
+
+// Orders the menu cycles through
+typedef enum {
+    UI_MENU_ORDER_PLAYLIST,     // As listed: playlist.json first, then by file name
+    UI_MENU_ORDER_NAME,
+    UI_MENU_ORDER_LONGEST,
+    UI_MENU_ORDER_COUNT,
+} ui_menu_order_t;
 
 // Menu state
+// Only the visible window of the playlist's view is drawn, so the list can be
+// any length
 typedef struct {
     playlist_t* playlist;       // Loaded playlist
-    int selected_index;         // Currently selected video
+    int selected_index;         // Currently selected video (view position)
     int scroll_offset;          // For scrolling if many videos
+    ui_menu_order_t order;
     bool needs_redraw;          // Flag to trigger redraw
 } ui_menu_state_t;
 
@@ -21,8 +32,12 @@ void ui_menu_draw(ui_menu_state_t* state, uint8_t* fb, int fb_stride, int fb_hei
 
 // Handle input, returns true if a video was selected
 // selected_entry will be set to the chosen video entry
-bool ui_menu_handle_input(ui_menu_state_t* state, bool up, bool down, bool enter,
+// page_up and page_down move by a screenful
+bool ui_menu_handle_input(ui_menu_state_t* state, bool up, bool down, bool page_up, bool page_down, bool enter,
                           video_entry_t** selected_entry);
 
+// Sort the list by the next order, keeping the selected video selected
+void ui_menu_next_order(ui_menu_state_t* state);
+
 // Format duration as MM:SS string
 void ui_format_duration(int seconds, char* buf, int buf_size);